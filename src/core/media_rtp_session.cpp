@@ -4,6 +4,7 @@
 #include "media_rtp_udpv4_transmitter.h"
 #include "media_rtp_udpv6_transmitter.h"
 #include "media_rtp_tcp_transmitter.h"
+#include "media_rtp_tcp_server_transmitter.h"
 #include "media_rtp_session_params.h"
 #include "media_rtp_defines.h"
 #include "media_rtp_packet_factory.h"
@@ -78,6 +79,9 @@ int RTPSession::Create(const RTPSessionParams &sessparams,const RTPTransmissionP
 	case RTPTransmitter::TCPProto:
 		rtptrans = new RTPTCPTransmitter();
 		break;
+	case RTPTransmitter::TCPServerProto:
+		rtptrans = new RTPTCPServerTransmitter();
+		break;
 	default:
 		return MEDIA_RTP_ERR_INVALID_PARAMETER;
 	}
@@ -151,6 +155,9 @@ int RTPSession::InternalCreate(const RTPSessionParams &sessparams)
 
 #endif // RTP_SUPPORT_PROBATION
 
+	sources.SetPacketQueueLimits(sessparams.GetSourcePacketQueueMaximumPackets(),sessparams.GetSourcePacketQueueMaximumBytes(),
+	                             sessparams.GetSourcePacketQueueDropPolicy());
+
 	// 将我们自己的 ssrc 添加到源表中
 	
 	if ((status = sources.CreateOwnSSRC(packetbuilder.GetSSRC())) < 0)
@@ -469,7 +476,7 @@ int RTPSession::SendPacket(const void *data,size_t len)
 		return MEDIA_RTP_ERR_INVALID_STATE;
 
 	BUILDER_LOCK
-	if ((status = packetbuilder.BuildPacket(data,len)) < 0)
+	if ((status = WaitForPacketBuffer()) < 0 || (status = packetbuilder.BuildPacket(data,len)) < 0)
 	{
 		BUILDER_UNLOCK
 		return status;
@@ -499,7 +506,7 @@ int RTPSession::SendPacket(const void *data,size_t len,
 		return MEDIA_RTP_ERR_INVALID_STATE;
 	
 	BUILDER_LOCK
-	if ((status = packetbuilder.BuildPacket(data,len,pt,mark,timestampinc)) < 0)
+	if ((status = WaitForPacketBuffer()) < 0 || (status = packetbuilder.BuildPacket(data,len,pt,mark,timestampinc)) < 0)
 	{
 		BUILDER_UNLOCK
 		return status;
@@ -529,7 +536,7 @@ int RTPSession::SendPacketEx(const void *data,size_t len,
 		return MEDIA_RTP_ERR_INVALID_STATE;
 
 	BUILDER_LOCK
-	if ((status = packetbuilder.BuildPacketEx(data,len,hdrextID,hdrextdata,numhdrextwords)) < 0)
+	if ((status = WaitForPacketBuffer()) < 0 || (status = packetbuilder.BuildPacketEx(data,len,hdrextID,hdrextdata,numhdrextwords)) < 0)
 	{
 		BUILDER_UNLOCK
 		return status;
@@ -560,7 +567,7 @@ int RTPSession::SendPacketEx(const void *data,size_t len,
 		return MEDIA_RTP_ERR_INVALID_STATE;
 	
 	BUILDER_LOCK
-	if ((status = packetbuilder.BuildPacketEx(data,len,pt,mark,timestampinc,hdrextID,hdrextdata,numhdrextwords)) < 0)
+	if ((status = WaitForPacketBuffer()) < 0 || (status = packetbuilder.BuildPacketEx(data,len,pt,mark,timestampinc,hdrextID,hdrextdata,numhdrextwords)) < 0)
 	{
 		BUILDER_UNLOCK
 		return status;
@@ -581,6 +588,173 @@ int RTPSession::SendPacketEx(const void *data,size_t len,
 	return 0;
 }
 
+int RTPSession::SendPacketV(const struct iovec *payload,size_t count)
+{
+	int status;
+	
+	if (!created)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	if (count >= RTPTRANS_MAXSENDIOV) // 还需要一个数据块存放头部
+		return MEDIA_RTP_ERR_INVALID_PARAMETER;
+
+	BUILDER_LOCK
+	if ((status = WaitForPacketBuffer()) < 0 || (status = packetbuilder.BuildPacketHeader(RTPGetIOVecLength(payload,count))) < 0)
+	{
+		BUILDER_UNLOCK
+		return status;
+	}
+	if ((status = SendBuiltHeader(payload,count)) < 0)
+	{
+		BUILDER_UNLOCK
+		return status;
+	}
+	BUILDER_UNLOCK
+
+	SOURCES_LOCK
+	sources.SentRTPPacket();
+	SOURCES_UNLOCK
+	PACKSENT_LOCK
+	sentpackets = true;
+	PACKSENT_UNLOCK
+	return 0;
+}
+
+int RTPSession::SendPacketV(const struct iovec *payload,size_t count,
+                uint8_t pt,bool mark,uint32_t timestampinc)
+{
+	int status;
+	
+	if (!created)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	if (count >= RTPTRANS_MAXSENDIOV) // 还需要一个数据块存放头部
+		return MEDIA_RTP_ERR_INVALID_PARAMETER;
+
+	BUILDER_LOCK
+	if ((status = WaitForPacketBuffer()) < 0 || (status = packetbuilder.BuildPacketHeader(RTPGetIOVecLength(payload,count),pt,mark,timestampinc)) < 0)
+	{
+		BUILDER_UNLOCK
+		return status;
+	}
+	if ((status = SendBuiltHeader(payload,count)) < 0)
+	{
+		BUILDER_UNLOCK
+		return status;
+	}
+	BUILDER_UNLOCK
+
+	SOURCES_LOCK
+	sources.SentRTPPacket();
+	SOURCES_UNLOCK
+	PACKSENT_LOCK
+	sentpackets = true;
+	PACKSENT_UNLOCK
+	return 0;
+}
+
+int RTPSession::SendPacketExV(const struct iovec *payload,size_t count,
+                  uint16_t hdrextID,const void *hdrextdata,size_t numhdrextwords)
+{
+	int status;
+	
+	if (!created)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	if (count >= RTPTRANS_MAXSENDIOV) // 还需要一个数据块存放头部
+		return MEDIA_RTP_ERR_INVALID_PARAMETER;
+
+	BUILDER_LOCK
+	if ((status = WaitForPacketBuffer()) < 0 || (status = packetbuilder.BuildPacketHeaderEx(RTPGetIOVecLength(payload,count),hdrextID,hdrextdata,numhdrextwords)) < 0)
+	{
+		BUILDER_UNLOCK
+		return status;
+	}
+	if ((status = SendBuiltHeader(payload,count)) < 0)
+	{
+		BUILDER_UNLOCK
+		return status;
+	}
+	BUILDER_UNLOCK
+
+	SOURCES_LOCK
+	sources.SentRTPPacket();
+	SOURCES_UNLOCK
+	PACKSENT_LOCK
+	sentpackets = true;
+	PACKSENT_UNLOCK
+	return 0;
+}
+
+int RTPSession::SendPacketExV(const struct iovec *payload,size_t count,
+                  uint8_t pt,bool mark,uint32_t timestampinc,
+                  uint16_t hdrextID,const void *hdrextdata,size_t numhdrextwords)
+{
+	int status;
+	
+	if (!created)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	if (count >= RTPTRANS_MAXSENDIOV) // 还需要一个数据块存放头部
+		return MEDIA_RTP_ERR_INVALID_PARAMETER;
+
+	BUILDER_LOCK
+	if ((status = WaitForPacketBuffer()) < 0 || (status = packetbuilder.BuildPacketHeaderEx(RTPGetIOVecLength(payload,count),pt,mark,timestampinc,hdrextID,hdrextdata,numhdrextwords)) < 0)
+	{
+		BUILDER_UNLOCK
+		return status;
+	}
+	if ((status = SendBuiltHeader(payload,count)) < 0)
+	{
+		BUILDER_UNLOCK
+		return status;
+	}
+	BUILDER_UNLOCK
+
+	SOURCES_LOCK
+	sources.SentRTPPacket();
+	SOURCES_UNLOCK
+	PACKSENT_LOCK
+	sentpackets = true;
+	PACKSENT_UNLOCK
+	return 0;
+}
+
+int RTPSession::SendPackets(const RTPPacketDescriptor *packets,size_t count)
+{
+	int status;
+
+	if (!created)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	BUILDER_LOCK
+	if ((status = WaitForBatchBuffer()) < 0 || (status = packetbuilder.BuildPackets(packets,count)) < 0)
+	{
+		BUILDER_UNLOCK
+		return status;
+	}
+	if (m_changeOutgoingData)
+	{
+		// 修改数据的回调每次处理一个数据包
+		const struct iovec *built = packetbuilder.GetPackets();
+
+		for (size_t i = 0 ; status >= 0 && i < count ; i++)
+			status = SendRTPData(built[i].iov_base,built[i].iov_len);
+	}
+	else
+		status = rtptrans->SendRTPDataBatch(packetbuilder.GetPackets(),packetbuilder.GetNumPackets());
+	if (status < 0)
+	{
+		BUILDER_UNLOCK
+		return status;
+	}
+	BUILDER_UNLOCK
+
+	SOURCES_LOCK
+	sources.SentRTPPacket();
+	SOURCES_UNLOCK
+	PACKSENT_LOCK
+	sentpackets = true;
+	PACKSENT_UNLOCK
+	return 0;
+}
+
 #ifdef RTP_SUPPORT_SENDAPP
 
 int RTPSession::SendRTCPAPPPacket(uint8_t subtype, const uint8_t name[4], const void *appdata, size_t appdatalen)
@@ -1116,106 +1290,51 @@ int RTPSession::SetTimestampUnit(double u)
 
 int RTPSession::ProcessPolledData()
 {
-	RTPRawPacket *rawpack;
+	RTPRawPacket *batch[RTPHEADERVALIDATOR_BATCHSIZE];
+	bool valid[RTPHEADERVALIDATOR_BATCHSIZE];
+	size_t num;
 	int status;
 	
 	SOURCES_LOCK
-	while ((rawpack = rtptrans->GetNextPacket()) != 0)
+	do
 	{
-		if (m_changeIncomingData)
+		RTPRawPacket *rawpack;
+
+		// 一次取出一批数据包，在创建任何对象之前一起检查头部
+		num = 0;
+		while (num < RTPHEADERVALIDATOR_BATCHSIZE && (rawpack = rtptrans->GetNextPacket()) != 0)
 		{
-			// 提供一种更改传入数据的方法，例如用于解密
-			if (!OnChangeIncomingData(rawpack))
+			if (m_changeIncomingData)
 			{
-				delete rawpack;
-				continue;
+				// 提供一种更改传入数据的方法，例如用于解密
+				if (!OnChangeIncomingData(rawpack))
+				{
+					delete rawpack;
+					continue;
+				}
 			}
+			batch[num++] = rawpack;
 		}
 
-		sources.ClearOwnCollisionFlag();
+		RTPHeaderValidator::Validate(batch,num,valid);
 
-		// 由于我们的 sources 实例也使用调度程序（分析传入的数据包）
-		// 我们将其锁定
-		SCHED_LOCK
-		if ((status = sources.ProcessRawPacket(rawpack,rtptrans,acceptownpackets)) < 0)
-		{
-			SCHED_UNLOCK
-			SOURCES_UNLOCK
-			delete rawpack;
-			return status;
-		}
-		SCHED_UNLOCK
-				
-		if (sources.DetectedOwnCollision()) // 冲突处理!
+		for (size_t i = 0 ; i < num ; i++)
 		{
-			bool created;
-			
-			if ((status = collisionlist.UpdateAddress(rawpack->GetSenderAddress(),rawpack->GetReceiveTime(),&created)) < 0)
+			if (!valid[i]) // 完整解析时同样会被丢弃
 			{
-				SOURCES_UNLOCK
-				delete rawpack;
-				return status;
+				delete batch[i];
+				continue;
 			}
 
-			if (created) // 第一次遇到此地址，发送 BYE 包并更改我们自己的 SSRC
+			if ((status = ProcessReceivedPacket(batch[i])) < 0)
 			{
-				PACKSENT_LOCK
-				bool hassentpackets = sentpackets;
-				PACKSENT_UNLOCK
-
-				if (hassentpackets)
-				{
-					// 仅当我们实际使用此SSRC发送了数据时才发送BYE数据包
-					
-					RTCPCompoundPacket *rtcpcomppack;
-
-					BUILDER_LOCK
-					if ((status = rtcpbuilder.BuildBYEPacket(&rtcpcomppack,0,0,useSR_BYEifpossible)) < 0)
-					{
-						BUILDER_UNLOCK
-						SOURCES_UNLOCK
-						delete rawpack;
-						return status;
-					}
-					BUILDER_UNLOCK
-
-					byepackets.push_back(rtcpcomppack);
-					if (byepackets.size() == 1) // 是第一个数据包，调度一个BYE数据包（否则已经有一个调度了）
-					{
-						SCHED_LOCK
-						rtcpsched.ScheduleBYEPacket(rtcpcomppack->GetCompoundPacketLength());
-						SCHED_UNLOCK
-					}
-				}
-				// BYE数据包已构建并调度，现在更改我们的SSRC
-				// 并重置发送器中的数据包计数
-				
-				BUILDER_LOCK
-				uint32_t newssrc = packetbuilder.CreateNewSSRC(sources);
-				BUILDER_UNLOCK
-					
-				PACKSENT_LOCK
-				sentpackets = false;
-				PACKSENT_UNLOCK
-	
-				// 删除源表中的旧条目并添加新条目
-
-				if ((status = sources.DeleteOwnSSRC()) < 0)
-				{
-					SOURCES_UNLOCK
-					delete rawpack;
-					return status;
-				}
-				if ((status = sources.CreateOwnSSRC(newssrc)) < 0)
-				{
-					SOURCES_UNLOCK
-					delete rawpack;
-					return status;
-				}
+				for (size_t j = i+1 ; j < num ; j++)
+					delete batch[j];
+				SOURCES_UNLOCK
+				return status;
 			}
 		}
-		delete rawpack;
-	}
+	} while (num == RTPHEADERVALIDATOR_BATCHSIZE);
 
 	SCHED_LOCK
 	RTPTime d = rtcpsched.CalculateDeterministicInterval(false);
@@ -1303,6 +1422,92 @@ int RTPSession::ProcessPolledData()
 	return 0;
 }
 
+// 处理一个通过头部检查的数据包，调用者持有 SOURCES 锁；数据包总是被删除
+int RTPSession::ProcessReceivedPacket(RTPRawPacket *rawpack)
+{
+	int status;
+
+	sources.ClearOwnCollisionFlag();
+
+	// 由于我们的 sources 实例也使用调度程序（分析传入的数据包）
+	// 我们将其锁定
+	SCHED_LOCK
+	if ((status = sources.ProcessRawPacket(rawpack,rtptrans,acceptownpackets)) < 0)
+	{
+		SCHED_UNLOCK
+		delete rawpack;
+		return status;
+	}
+	SCHED_UNLOCK
+			
+	if (sources.DetectedOwnCollision()) // 冲突处理!
+	{
+		bool created;
+		
+		if ((status = collisionlist.UpdateAddress(rawpack->GetSenderAddress(),rawpack->GetReceiveTime(),&created)) < 0)
+		{
+			delete rawpack;
+			return status;
+		}
+
+		if (created) // 第一次遇到此地址，发送 BYE 包并更改我们自己的 SSRC
+		{
+			PACKSENT_LOCK
+			bool hassentpackets = sentpackets;
+			PACKSENT_UNLOCK
+
+			if (hassentpackets)
+			{
+				// 仅当我们实际使用此SSRC发送了数据时才发送BYE数据包
+				
+				RTCPCompoundPacket *rtcpcomppack;
+
+				BUILDER_LOCK
+				if ((status = rtcpbuilder.BuildBYEPacket(&rtcpcomppack,0,0,useSR_BYEifpossible)) < 0)
+				{
+					BUILDER_UNLOCK
+					delete rawpack;
+					return status;
+				}
+				BUILDER_UNLOCK
+
+				byepackets.push_back(rtcpcomppack);
+				if (byepackets.size() == 1) // 是第一个数据包，调度一个BYE数据包（否则已经有一个调度了）
+				{
+					SCHED_LOCK
+					rtcpsched.ScheduleBYEPacket(rtcpcomppack->GetCompoundPacketLength());
+					SCHED_UNLOCK
+				}
+			}
+			// BYE数据包已构建并调度，现在更改我们的SSRC
+			// 并重置发送器中的数据包计数
+			
+			BUILDER_LOCK
+			uint32_t newssrc = packetbuilder.CreateNewSSRC(sources);
+			BUILDER_UNLOCK
+				
+			PACKSENT_LOCK
+			sentpackets = false;
+			PACKSENT_UNLOCK
+
+			// 删除源表中的旧条目并添加新条目
+
+			if ((status = sources.DeleteOwnSSRC()) < 0)
+			{
+				delete rawpack;
+				return status;
+			}
+			if ((status = sources.CreateOwnSSRC(newssrc)) < 0)
+			{
+				delete rawpack;
+				return status;
+			}
+		}
+	}
+	delete rawpack;
+	return 0;
+}
+
 int RTPSession::CreateCNAME(uint8_t *buffer,size_t *bufferlength,bool resolve)
 {
 	bool gotlogin = true;
@@ -1385,6 +1590,7 @@ int RTPSession::SendRTPData(const void *data, size_t len)
 
 	if (pSendData)
 	{
+		// 零拷贝发送时内核可能还在读取 pSendData，这里不等待，由应用程序在重用它之前等待
 		status = rtptrans->SendRTPData(pSendData, sendLen);
 		OnSentRTPOrRTCPData(pSendData, sendLen, true);
 	}
@@ -1392,6 +1598,48 @@ int RTPSession::SendRTPData(const void *data, size_t len)
 	return status;
 }
 
+// 发送构建器中的头部和调用者的载荷，调用时持有构建器的锁
+int RTPSession::SendBuiltHeader(const struct iovec *payload,size_t count)
+{
+	uint8_t *header = packetbuilder.GetPacket();
+	size_t headerlen = packetbuilder.GetPacketLength();
+
+	if (m_changeOutgoingData)
+	{
+		// 修改数据的回调需要连续的数据包；构建器已经按完整的长度检查过缓冲区大小
+		size_t payloadlen = RTPCopyIOVec(payload,count,0,header+headerlen);
+		return SendRTPData(header,headerlen+payloadlen);
+	}
+
+	struct iovec iov[RTPTRANS_MAXSENDIOV];
+
+	iov[0].iov_base = header;
+	iov[0].iov_len = headerlen;
+	memcpy(iov+1,payload,count*sizeof(struct iovec));
+	return rtptrans->SendRTPDataV(iov,count+1);
+}
+
+int RTPSession::WaitForPacketBuffer()
+{
+	// 构建器的缓冲区中仍是上一个数据包，零拷贝发送时内核可能还在读取它
+	return rtptrans->WaitForSendCompletion(packetbuilder.GetPacket(), packetbuilder.GetPacketLength());
+}
+
+int RTPSession::WaitForBatchBuffer()
+{
+	// 批量缓冲区中仍是上一批数据包，它们在缓冲区中连续存放
+	size_t num = packetbuilder.GetNumPackets();
+
+	if (num == 0)
+		return 0;
+
+	const struct iovec *packets = packetbuilder.GetPackets();
+	const uint8_t *start = (const uint8_t *)packets[0].iov_base;
+	const uint8_t *end = (const uint8_t *)packets[num-1].iov_base+packets[num-1].iov_len;
+
+	return rtptrans->WaitForSendCompletion(start,end-start);
+}
+
 int RTPSession::SendRTCPData(const void *data, size_t len)
 {
 	if (!m_changeOutgoingData)
@@ -11,6 +11,8 @@
 #include "media_rtp_collisionlist.h"
 #include "rtpconfig.h"
 #include "media_rtp_packet_factory.h"
+#include "media_rtp_header_extensions.h"
+#include "media_rtp_header_validator.h"
 #include "media_rtp_sources.h"
 #include "media_rtp_utils.h"
 #include "media_rtp_transmitter.h"
@@ -134,6 +136,42 @@ public:
   int SendPacketEx(const void *data, size_t len, uint8_t pt, bool mark,
                    uint32_t timestampinc, uint16_t hdrextID,
                    const void *hdrextdata, size_t numhdrextwords);
+
+  /** 发送有效载荷由 \c payload 中的 \c count 个数据块依次组成的RTP数据包。
+   *  构建器只生成RTP头部，传输器把头部和这些数据块一起交给内核（见
+   *  RTPTransmitter::SendRTPDataV），载荷不会先复制到数据包构建器的缓冲区，
+   *  因此可以直接发送编码器输出缓冲区中的大载荷。\c count 最多为
+   *  RTPTRANS_MAXSENDIOV-1。使用RTPSession::OnChangeRTPOrRTCPData时仍需要连续的
+   *  数据包，此时载荷照常复制到构建器的缓冲区。其他方面与 SendPacket 相同。
+   */
+  int SendPacketV(const struct iovec *payload, size_t count);
+
+  /** 与上一个函数相同，但使用有效载荷类型\c pt、标记\c mark，并且在数据包
+   *  构建后，时间戳将增加\c timestampinc。 */
+  int SendPacketV(const struct iovec *payload, size_t count, uint8_t pt,
+                  bool mark, uint32_t timestampinc);
+
+  /** 与 SendPacketV 相同，但数据包包含标识符为\c hdrextID且包含数据\c hdrextdata
+   *  的头部扩展，其长度\c numhdrextwords以32位字的数量指定。 */
+  int SendPacketExV(const struct iovec *payload, size_t count,
+                    uint16_t hdrextID, const void *hdrextdata,
+                    size_t numhdrextwords);
+
+  /** 与上一个函数相同，但使用有效载荷类型\c pt、标记\c mark和时间戳增量
+   *  \c timestampinc。 */
+  int SendPacketExV(const struct iovec *payload, size_t count, uint8_t pt,
+                    bool mark, uint32_t timestampinc, uint16_t hdrextID,
+                    const void *hdrextdata, size_t numhdrextwords);
+
+  /** 一次发送 \c packets 描述的 \c count 个RTP数据包，例如一个视频帧的所有分片。
+   *  数据包使用连续的序列号，各自的有效载荷类型和标记，每个数据包之后时间戳
+   *  增加其 timestampinc（见 RTPPacketBuilder::BuildPackets）。构建器、源表和
+   *  传输器的锁在整批中只获取一次，数据包通过 RTPTransmitter::SendRTPDataBatch
+   *  一起交给传输器，例如启用 UDP GSO 时用一次系统调用发送。任何一个数据包
+   *  无效时不发送任何数据包。使用RTPSession::OnChangeRTPOrRTCPData时每个数据包
+   *  仍单独修改和发送。
+   */
+  int SendPackets(const RTPPacketDescriptor *packets, size_t count);
 #ifdef RTP_SUPPORT_SENDAPP
   /** 如果在编译时启用了RTCP APP数据包的发送，此函数将创建一个包含RTCP
    * APP数据包的复合数据包并立即发送。 如果在编译时启用了RTCP
@@ -278,6 +316,17 @@ public:
   /** 释放\c p使用的内存。 */
   void DeletePacket(RTPPacket *p);
 
+  /** 返回会话的头部扩展映射，在其中注册协商的 RFC 8285 扩展标识符后，
+   *  可以用它解析收到的数据包的扩展（RTPHeaderExtensionMap::Find），
+   *  或者为发送的数据包打包扩展（RTPHeaderExtensionWriter）。映射不加锁，
+   *  应在发送和接收数据包之前配置好。 */
+  RTPHeaderExtensionMap &GetHeaderExtensionMap() { return hdrextmap; }
+
+  /** 返回会话的头部扩展映射。 */
+  const RTPHeaderExtensionMap &GetHeaderExtensionMap() const {
+    return hdrextmap;
+  }
+
   /** 参见BeginDataAccess。 */
   int EndDataAccess();
 
@@ -323,7 +372,16 @@ protected:
   /** 当传入的RTP数据包即将被处理时调用。
    *  当传入的RTP数据包即将被处理时调用。这不是处理RTP数据包的好函数，
    *  如果您想避免使用GotoFirst/GotoNext函数遍历源。在这种情况下，
-   *  应该使用RTPSession::OnValidatedRTPPacket函数。
+   *  应该使用RTPSession::OnValidatedRTPPacket函数。数据包 \c pack 是接收缓冲区
+   *  上的视图，只在调用期间有效。默认实现在视图上创建一个不拥有数据的RTPPacket
+   *  并调用 RTPSession::OnRTPPacket。
+   */
+  virtual void OnRTPPacketView(const RTPPacketView &pack,
+                               const RTPTime &receivetime,
+                               const RTPEndpoint *senderaddress);
+
+  /** 与 RTPSession::OnRTPPacketView 相同，由它的默认实现调用。数据包 \c pack
+   *  直接使用接收缓冲区，只在调用期间有效。
    */
   virtual void OnRTPPacket(RTPPacket *pack, const RTPTime &receivetime,
                            const RTPEndpoint *senderaddress);
@@ -433,7 +491,9 @@ protected:
                                     size_t *sendlen);
 
   /** 当发送RTP或RTCP数据包时调用此函数，当在RTPSession::OnChangeRTPOrRTCPData中分配数据时，
-   *  在这里释放它可能很有帮助。 */
+   *  在这里释放它可能很有帮助。传输器使用零拷贝发送（例如 MSG_ZEROCOPY）时，
+   *  内核在此之后仍可能读取RTP数据，释放或重用 \c senddata 之前应调用
+   *  RTPTransmitter::WaitForSendCompletion；会话本身不会为此等待。 */
   virtual void OnSentRTPOrRTCPData(void *senddata, size_t sendlen, bool isrtp);
 
   /** 通过重写此函数，可以检查和修改原始传入数据（例如用于加密）。
@@ -453,14 +513,35 @@ protected:
   virtual void OnValidatedRTPPacket(RTPSourceData *srcdat, RTPPacket *rtppack,
                                     bool isonprobation, bool *ispackethandled);
 
+  /** 在RTPSession::OnValidatedRTPPacket之前调用，允许直接在接收缓冲区上使用
+   *  指定源的RTP数据包，视图 \c view 只在调用期间有效。如果`ispackethandled`
+   *  设置为`true`，不会为该数据包分配RTPPacket实例，也不再调用
+   *  RTPSession::OnValidatedRTPPacket；只检查头部或就地复制载荷的应用程序
+   *  可以借此避免每个数据包的内存分配。
+   */
+  virtual void OnValidatedRTPPacketView(RTPSourceData *srcdat,
+                                        const RTPPacketView &view,
+                                        bool isonprobation,
+                                        bool *ispackethandled);
+
+  /** 源的数据包队列超过限制且使用 RTPSources::DropNonKeyFrames 策略时调用，
+   *  返回源 \c srcdat 的数据包 \c rtppack 是否属于关键帧，关键帧不会被整帧丢弃。
+   *  如何识别关键帧取决于载荷格式，默认实现总是返回 \c false。
+   */
+  virtual bool IsKeyFramePacket(RTPSourceData *srcdat, RTPPacket *rtppack);
+
 private:
   int InternalCreate(const RTPSessionParams &sessparams);
   int CreateCNAME(uint8_t *buffer, size_t *bufferlength, bool resolve);
   int ProcessPolledData();
+  int ProcessReceivedPacket(RTPRawPacket *rawpack);
   int ProcessRTCPCompoundPacket(RTCPCompoundPacket &rtcpcomppack,
                                 RTPRawPacket *pack);
   int SendRTPData(const void *data, size_t len);
   int SendRTCPData(const void *data, size_t len);
+  int SendBuiltHeader(const struct iovec *payload, size_t count);
+  int WaitForPacketBuffer();
+  int WaitForBatchBuffer();
 
   RTPTransmitter *rtptrans;
   bool created;
@@ -485,6 +566,7 @@ private:
   RTCPScheduler rtcpsched;
   RTCPPacketBuilder rtcpbuilder;
   RTPCollisionList collisionlist;
+  RTPHeaderExtensionMap hdrextmap;
 
   std::list<RTCPCompoundPacket *> byepackets;
 
@@ -496,6 +578,12 @@ private:
   friend class RTCPSessionPacketBuilder;
 };
 
+inline void RTPSession::OnRTPPacketView(const RTPPacketView &pack,
+                                        const RTPTime &receivetime,
+                                        const RTPEndpoint *senderaddress) {
+  RTPPacket rtppack(pack);
+  OnRTPPacket(&rtppack, receivetime, senderaddress);
+}
 inline void RTPSession::OnRTPPacket(RTPPacket *, const RTPTime &,
                                     const RTPEndpoint *) {}
 inline void RTPSession::OnRTCPCompoundPacket(RTCPCompoundPacket *,
@@ -539,5 +627,11 @@ inline void RTPSession::OnSentRTPOrRTCPData(void *, size_t, bool) {}
 inline bool RTPSession::OnChangeIncomingData(RTPRawPacket *) { return true; }
 inline void RTPSession::OnValidatedRTPPacket(RTPSourceData *, RTPPacket *, bool,
                                              bool *) {}
+inline void RTPSession::OnValidatedRTPPacketView(RTPSourceData *,
+                                                 const RTPPacketView &, bool,
+                                                 bool *) {}
+inline bool RTPSession::IsKeyFramePacket(RTPSourceData *, RTPPacket *) {
+  return false;
+}
 
 #endif // MEDIA_RTP_SESSION_H
@@ -17,6 +17,9 @@ RTPSessionParams::RTPSessionParams() : mininterval(0,0)
 #ifdef RTP_SUPPORT_PROBATION
 	probationtype = RTPSources::ProbationStore;
 #endif // RTP_SUPPORT_PROBATION
+	maxsourcequeuepackets = 0;
+	maxsourcequeuebytes = 0;
+	sourcequeuedroppolicy = RTPSources::DropOldest;
 
 	mininterval = RTPTime(RTCP_DEFAULTMININTERVAL);
 	sessionbandwidth = RTP_DEFAULTSESSIONBANDWIDTH;
@@ -85,6 +85,31 @@ public:
   RTPSources::ProbationType GetProbationType() const { return probationtype; }
 #endif // RTP_SUPPORT_PROBATION
 
+  /** 限制每个源的数据包队列最多容纳 \c maxpackets 个数据包和 \c maxbytes 字节，
+   *  超过限制时按 \c policy 丢弃数据包。为零的值表示不限制，详见
+   *  RTPSources::SetPacketQueueLimits。传输器接收队列的限制通过
+   *  RTPTransmissionParams::SetReceiveQueueLimits 设置。
+   */
+  void SetSourcePacketQueueLimits(size_t maxpackets, size_t maxbytes,
+                                  RTPSources::QueueDropPolicy policy) {
+    maxsourcequeuepackets = maxpackets;
+    maxsourcequeuebytes = maxbytes;
+    sourcequeuedroppolicy = policy;
+  }
+
+  /** 返回每个源的数据包队列最多容纳的数据包数量（默认为零，即不限制）。 */
+  size_t GetSourcePacketQueueMaximumPackets() const {
+    return maxsourcequeuepackets;
+  }
+
+  /** 返回每个源的数据包队列最多容纳的字节数（默认为零，即不限制）。 */
+  size_t GetSourcePacketQueueMaximumBytes() const { return maxsourcequeuebytes; }
+
+  /** 返回每个源的数据包队列的丢弃策略（默认为RTPSources::DropOldest）。 */
+  RTPSources::QueueDropPolicy GetSourcePacketQueueDropPolicy() const {
+    return sourcequeuedroppolicy;
+  }
+
   /** 设置会话带宽（以字节/秒为单位）。 */
   void SetSessionBandwidth(double sessbw) { sessionbandwidth = sessbw; }
 
@@ -199,6 +224,9 @@ private:
 #ifdef RTP_SUPPORT_PROBATION
   RTPSources::ProbationType probationtype;
 #endif // RTP_SUPPORT_PROBATION
+  size_t maxsourcequeuepackets;
+  size_t maxsourcequeuebytes;
+  RTPSources::QueueDropPolicy sourcequeuedroppolicy;
 
   double sessionbandwidth;
   double controlfrac;
@@ -0,0 +1,227 @@
+#include "media_rtp_socket_waiter.h"
+#include "media_rtp_errors.h"
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+#ifdef RTP_HAVE_EPOLL
+#include <sys/epoll.h>
+#else
+#include <algorithm>
+#endif // RTP_HAVE_EPOLL
+
+#define RTPSOCKETWAITER_MAXEVENTS						16
+
+RTPSocketWaiter::RTPSocketWaiter()
+{
+	m_init = false;
+#ifdef RTP_HAVE_EPOLL
+	m_epollfd = RTPSOCKERR;
+#endif // RTP_HAVE_EPOLL
+}
+
+RTPSocketWaiter::~RTPSocketWaiter()
+{
+	Destroy();
+}
+
+#ifdef RTP_HAVE_EPOLL
+
+int RTPSocketWaiter::Init()
+{
+	if (m_init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	m_epollfd = epoll_create1(EPOLL_CLOEXEC);
+	if (m_epollfd < 0)
+	{
+		m_epollfd = RTPSOCKERR;
+		return MEDIA_RTP_ERR_OPERATION_FAILED;
+	}
+
+	m_init = true;
+	return 0;
+}
+
+void RTPSocketWaiter::Destroy()
+{
+	if (!m_init)
+		return;
+
+	RTPCLOSE(m_epollfd);
+	m_epollfd = RTPSOCKERR;
+	m_init = false;
+}
+
+int RTPSocketWaiter::AddSocket(int s, bool edgetriggered)
+{
+	if (!m_init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	struct epoll_event ev;
+
+	ev.events = (edgetriggered)?(EPOLLIN|EPOLLET):EPOLLIN;
+	ev.data.u64 = 0;
+	ev.data.fd = s;
+	if (epoll_ctl(m_epollfd,EPOLL_CTL_ADD,s,&ev) != 0)
+		return (errno == EEXIST)?MEDIA_RTP_ERR_INVALID_STATE:MEDIA_RTP_ERR_OPERATION_FAILED;
+	return 0;
+}
+
+int RTPSocketWaiter::ModifySocket(int s, bool edgetriggered, bool writable)
+{
+	if (!m_init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	struct epoll_event ev;
+
+	ev.events = EPOLLIN;
+	if (edgetriggered)
+		ev.events |= EPOLLET;
+	if (writable)
+		ev.events |= EPOLLOUT;
+	ev.data.u64 = 0;
+	ev.data.fd = s;
+	if (epoll_ctl(m_epollfd,EPOLL_CTL_MOD,s,&ev) != 0)
+		return (errno == ENOENT)?MEDIA_RTP_ERR_INVALID_STATE:MEDIA_RTP_ERR_OPERATION_FAILED;
+	return 0;
+}
+
+int RTPSocketWaiter::RemoveSocket(int s)
+{
+	if (!m_init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	struct epoll_event ev; // 旧内核要求非空指针
+
+	memset(&ev,0,sizeof(struct epoll_event));
+	if (epoll_ctl(m_epollfd,EPOLL_CTL_DEL,s,&ev) != 0)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	return 0;
+}
+
+int RTPSocketWaiter::Wait(const RTPTime &timeout, int *readysocks, size_t maxsocks)
+{
+	if (!m_init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	// 事件数组放在栈上，这样注册和注销不会与等待中的线程争用同一块内存；
+	// 本次未返回的就绪描述符（包括边沿触发的）留在内核的就绪列表中，下一次等待时立即返回
+	struct epoll_event events[RTPSOCKETWAITER_MAXEVENTS];
+	int maxevents = (maxsocks < RTPSOCKETWAITER_MAXEVENTS)?(int)maxsocks:RTPSOCKETWAITER_MAXEVENTS;
+
+	if (maxevents <= 0)
+		return MEDIA_RTP_ERR_INVALID_PARAMETER;
+
+	int timeoutms = -1;
+	if (timeout.GetDouble() >= 0)
+	{
+		double ms = ceil(timeout.GetDouble()*1000.0);
+		timeoutms = (ms > (double)INT_MAX)?INT_MAX:(int)ms;
+	}
+
+	int status = epoll_wait(m_epollfd,events,maxevents,timeoutms);
+	if (status < 0)
+	{
+		// 忽略 EINTR 中断
+		if (errno == EINTR)
+			return 0;
+		return MEDIA_RTP_ERR_OPERATION_FAILED;
+	}
+
+	for (int i = 0 ; i < status ; i++)
+		readysocks[i] = events[i].data.fd;
+	return status;
+}
+
+#else // 没有 epoll，对已注册的描述符使用 RTPSelect
+
+int RTPSocketWaiter::Init()
+{
+	if (m_init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	m_sockets.clear();
+	m_init = true;
+	return 0;
+}
+
+void RTPSocketWaiter::Destroy()
+{
+	if (!m_init)
+		return;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_sockets.clear();
+	m_init = false;
+}
+
+int RTPSocketWaiter::AddSocket(int s, bool edgetriggered)
+{
+	MEDIA_RTP_UNUSED(edgetriggered); // select 只支持水平触发
+
+	if (!m_init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (std::find(m_sockets.begin(),m_sockets.end(),s) != m_sockets.end())
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	m_sockets.push_back(s);
+	return 0;
+}
+
+int RTPSocketWaiter::ModifySocket(int s, bool edgetriggered, bool writable)
+{
+	MEDIA_RTP_UNUSED(edgetriggered);
+	MEDIA_RTP_UNUSED(writable); // RTPSelect 只检查可读性
+
+	if (!m_init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (std::find(m_sockets.begin(),m_sockets.end(),s) == m_sockets.end())
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	return 0;
+}
+
+int RTPSocketWaiter::RemoveSocket(int s)
+{
+	if (!m_init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::vector<int>::iterator it = std::find(m_sockets.begin(),m_sockets.end(),s);
+	if (it == m_sockets.end())
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	m_sockets.erase(it);
+	return 0;
+}
+
+int RTPSocketWaiter::Wait(const RTPTime &timeout, int *readysocks, size_t maxsocks)
+{
+	if (!m_init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	std::vector<int> socks;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		socks = m_sockets;
+	}
+	if (socks.empty())
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	std::vector<int8_t> readflags(socks.size());
+	int status = RTPSelect(&socks[0],&readflags[0],socks.size(),timeout);
+	if (status <= 0)
+		return status;
+
+	size_t num = 0;
+	for (size_t i = 0 ; i < socks.size() && num < maxsocks ; i++)
+	{
+		if (readflags[i])
+			readysocks[num++] = socks[i];
+	}
+	return (int)num;
+}
+
+#endif // RTP_HAVE_EPOLL
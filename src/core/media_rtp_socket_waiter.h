@@ -0,0 +1,71 @@
+/**
+ * \file media_rtp_socket_waiter.h
+ */
+
+#ifndef RTPSOCKETWAITER_H
+
+#define RTPSOCKETWAITER_H
+
+#include "rtpconfig.h"
+#include "media_rtp_utils.h"
+
+#ifndef RTP_HAVE_EPOLL
+#include <mutex>
+#include <vector>
+#endif // RTP_HAVE_EPOLL
+
+/**
+ * 等待一组套接字描述符变为可读的辅助类，供传输器的 WaitForIncomingData 使用。
+ *
+ * 与每次等待都重新构造描述符集合的 RTPSelect 不同，此类持有一个持久的 epoll
+ * 实例：描述符在传输器创建（或添加目标）时注册一次，之后每次等待只需一次
+ * epoll_wait 调用，开销与注册的描述符数量无关，也不受 FD_SETSIZE 的限制。
+ * 不支持 epoll 的平台上退化为对已注册描述符调用 RTPSelect。
+ *
+ * 注册和注销可以与另一个线程中正在进行的 Wait 调用并发执行。
+ */
+class RTPSocketWaiter {
+  MEDIA_RTP_NO_COPY(RTPSocketWaiter)
+public:
+  RTPSocketWaiter();
+  ~RTPSocketWaiter();
+
+  /** 初始化此实例。 */
+  int Init();
+
+  /** 返回指示此实例是否已初始化的标志。 */
+  bool IsInitialized() const { return m_init; }
+
+  /** 反初始化此实例，所有注册都会被丢弃，但不会关闭这些描述符。 */
+  void Destroy();
+
+  /** 注册描述符 \c s，此后的等待将监视它是否可读。\c edgetriggered 为 true 时
+   *  使用边沿触发（EPOLLET）：描述符只在有新数据到达时返回一次，调用者必须读到
+   *  没有数据为止，并自己记住尚未读完的描述符。不支持 epoll 时总是水平触发，
+   *  这种用法仍然正确，只是同一个描述符可能被重复返回。 */
+  int AddSocket(int s, bool edgetriggered = false);
+
+  /** 修改已注册的描述符 \c s：\c writable 为 true 时等待同时监视它是否可写，
+   *  传输器在套接字有待发送的数据时使用。\c edgetriggered 的含义与 AddSocket
+   *  相同。不支持 epoll 时不监视可写性，待发送的数据只能在下一次调用时发送。 */
+  int ModifySocket(int s, bool edgetriggered, bool writable);
+
+  /** 注销描述符 \c s；已被关闭的描述符会自动注销。 */
+  int RemoveSocket(int s);
+
+  /** 最多等待 \c timeout 时间，直到至少一个已注册的描述符可读（或者在要求监视时
+   *  可写）；负的超时值表示无限等待。就绪的描述符写入 \c readysocks，最多
+   *  \c maxsocks 个，返回写入的数量，超时时返回零。 */
+  int Wait(const RTPTime &timeout, int *readysocks, size_t maxsocks);
+
+private:
+  bool m_init;
+#ifdef RTP_HAVE_EPOLL
+  int m_epollfd;
+#else
+  std::mutex m_mutex;
+  std::vector<int> m_sockets;
+#endif // RTP_HAVE_EPOLL
+};
+
+#endif // RTPSOCKETWAITER_H
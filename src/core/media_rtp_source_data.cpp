@@ -37,7 +37,7 @@
 		if (!ownpacket) /* for own packet, this value is set on an outgoing packet */	\
 			lastrtptime = prevpacktime;
 
-void RTPSourceStats::ProcessPacket(RTPPacket *pack,const RTPTime &receivetime,double tsunit,
+void RTPSourceStats::ProcessPacket(RTPPacketView *pack,const RTPTime &receivetime,double tsunit,
                                    bool ownpacket,bool *accept,bool applyprobation,bool *onprobation)
 {
 	MEDIA_RTP_UNUSED(applyprobation); // 可能未使用
@@ -238,6 +238,10 @@ RTPSourceData::RTPSourceData(uint32_t s) : byetime(0,0)
 	processedinrtcp = false;			
 	isrtpaddrset = false;
 	isrtcpaddrset = false;
+	packetlistbytes = 0;
+	numdroppedpackets = 0;
+	numdroppedbytes = 0;
+	ResetDropScan();
 #ifdef RTP_SUPPORT_PROBATION
 	probationtype = RTPSources::ProbationStore;
 #endif // RTP_SUPPORT_PROBATION
@@ -259,6 +263,10 @@ RTPSourceData::RTPSourceData(uint32_t s, RTPSources::ProbationType probtype) : b
 	processedinrtcp = false;			
 	isrtpaddrset = false;
 	isrtcpaddrset = false;
+	packetlistbytes = 0;
+	numdroppedpackets = 0;
+	numdroppedbytes = 0;
+	ResetDropScan();
 #ifdef RTP_SUPPORT_PROBATION
 	probationtype = probtype;
 #endif // RTP_SUPPORT_PROBATION
@@ -315,8 +323,8 @@ RTPTime RTPSourceData::INF_GetRoundtripTime() const
 
 #define RTPSOURCEDATA_MAXPROBATIONPACKETS		32
 
-// 以下函数应在必要时删除 rtppack
-int RTPSourceData::ProcessRTPPacket(RTPPacket *rtppack,const RTPTime &receivetime,bool *stored,RTPSources *sources)
+// 数据包在视图上接受检查，只有需要保留时才创建 RTPPacket 实例
+int RTPSourceData::ProcessRTPPacket(RTPPacketView &view,RTPRawPacket *rawpack,RTPPacket **rtppack,const RTPTime &receivetime,bool *stored,RTPSources *sources)
 {
 	bool accept,onprobation,applyprobation;
 	double tsunit;
@@ -342,7 +350,7 @@ int RTPSourceData::ProcessRTPPacket(RTPPacket *rtppack,const RTPTime &receivetim
 	applyprobation = false;
 #endif // RTP_SUPPORT_PROBATION
 
-	stats.ProcessPacket(rtppack,receivetime,tsunit,ownssrc,&accept,applyprobation,&onprobation);
+	stats.ProcessPacket(&view,receivetime,tsunit,ownssrc,&accept,applyprobation,&onprobation);
 
 #ifdef RTP_SUPPORT_PROBATION
 	switch (probationtype)
@@ -374,7 +382,23 @@ int RTPSourceData::ProcessRTPPacket(RTPPacket *rtppack,const RTPTime &receivetim
 	bool isonprobation = !validated;
 	bool ispackethandled = false;
 
-	sources->OnValidatedRTPPacket(this, rtppack, isonprobation, &ispackethandled);
+	sources->OnValidatedRTPPacketView(this, view, isonprobation, &ispackethandled);
+	if (ispackethandled) // 数据包已在视图上处理，不需要创建 RTPPacket 实例
+		return 0;
+
+	// 应用程序需要保留数据包，此时才创建拥有数据的实例
+	if (*rtppack == 0)
+	{
+		*rtppack = new RTPPacket(view,*rawpack);
+		if (*rtppack == 0)
+			return MEDIA_RTP_ERR_RESOURCE_ERROR;
+		if ((*rtppack)->GetCreationError() < 0)
+			return (*rtppack)->GetCreationError();
+	}
+	else
+		(*rtppack)->SetExtendedSequenceNumber(view.GetExtendedSequenceNumber());
+
+	sources->OnValidatedRTPPacket(this, *rtppack, isonprobation, &ispackethandled);
 	if (ispackethandled) // 数据包已在回调中处理，无需存储在列表中
 	{
 		// 将 'stored' 设置为 true 以避免数据包被释放
@@ -383,11 +407,27 @@ int RTPSourceData::ProcessRTPPacket(RTPPacket *rtppack,const RTPTime &receivetim
 	}
 
 	// 现在，我们可以将数据包放入队列
-	
+
+	return StorePacket(*rtppack,stored,sources);
+}
+
+// 将数据包按扩展序列号插入队列
+int RTPSourceData::StorePacket(RTPPacket *rtppack,bool *stored,RTPSources *sources)
+{
+	size_t packlen = rtppack->GetPacketLength();
+
+	if (sources->queuedroppolicy == RTPSources::DropNewest && IsPacketQueueFull(packlen,sources))
+	{
+		// 保留队列中的数据包；'stored' 仍为 false，新的数据包由调用者删除
+		CountDroppedPacket(packlen,sources);
+		return 0;
+	}
+
 	if (packetlist.empty())
 	{
 		*stored = true;
 		packetlist.push_back(rtppack);
+		packetlistbytes += packlen;
 		return 0;
 	}
 	
@@ -398,7 +438,9 @@ int RTPSourceData::ProcessRTPPacket(RTPPacket *rtppack,const RTPTime &receivetim
 		if (packetlist.size() == RTPSOURCEDATA_MAXPROBATIONPACKETS)
 		{
 			RTPPacket *p = *(packetlist.begin());
+			DropScanFrontRemoved(p);
 			packetlist.pop_front();
+			packetlistbytes -= p->GetPacketLength();
 			delete p;
 		}
 	}
@@ -429,10 +471,14 @@ int RTPSourceData::ProcessRTPPacket(RTPPacket *rtppack,const RTPTime &receivetim
 				*stored = true;
 				done = true;
 				packetlist.push_front(rtppack);
+				ResetDropScan();
 			}
 		}
 		else if (seqnr < newseqnr) // 在此数据包后插入
 		{
+			// 插入到 DropNonKeyFrame 已经检查过的部分时，帧的边界可能改变
+			if (dropscannum != 0 && newseqnr < (*dropscanlast)->GetExtendedSequenceNumber())
+				ResetDropScan();
 			++it;
 			packetlist.insert(it,rtppack);
 			done = true;
@@ -444,9 +490,139 @@ int RTPSourceData::ProcessRTPPacket(RTPPacket *rtppack,const RTPTime &receivetim
 		}
 	}
 
+	if (*stored)
+	{
+		packetlistbytes += packlen;
+		EnforcePacketQueueLimits(rtppack,stored,sources);
+	}
 	return 0;
 }
 
+// 加入一个 packlen 字节的数据包是否会超过队列的限制；队列为空时总是可以加入，
+// 否则比字节限制还大的数据包永远无法交付
+bool RTPSourceData::IsPacketQueueFull(size_t packlen,const RTPSources *sources) const
+{
+	if (packetlist.empty())
+		return false;
+	if (sources->maxqueuepackets != 0 && packetlist.size() + 1 > sources->maxqueuepackets)
+		return true;
+	if (sources->maxqueuebytes != 0 && packetlistbytes + packlen > sources->maxqueuebytes)
+		return true;
+	return false;
+}
+
+bool RTPSourceData::IsPacketQueueOverLimit(const RTPSources *sources) const
+{
+	if (packetlist.size() <= 1)
+		return false;
+	if (sources->maxqueuepackets != 0 && packetlist.size() > sources->maxqueuepackets)
+		return true;
+	if (sources->maxqueuebytes != 0 && packetlistbytes > sources->maxqueuebytes)
+		return true;
+	return false;
+}
+
+// newpack 是刚加入队列的数据包，它本身也可能被丢弃
+void RTPSourceData::EnforcePacketQueueLimits(RTPPacket *newpack,bool *stored,RTPSources *sources)
+{
+	while (IsPacketQueueOverLimit(sources))
+	{
+		if (sources->queuedroppolicy == RTPSources::DropNonKeyFrames && DropNonKeyFrame(newpack,stored,sources))
+			continue;
+		DropScanFrontRemoved(*(packetlist.begin()));
+		DropPacket(packetlist.begin(),newpack,stored,sources);
+	}
+}
+
+// 丢弃最旧的一个完整的非关键帧，没有这样的帧时返回 false。帧是以设置了标记位的数据包
+// 结束的一段连续数据包，队列末尾尚未结束的帧不会被丢弃。
+// 检查从上一次停止的位置继续（见 dropscannum），队列按顺序增长时每个数据包只检查一次
+bool RTPSourceData::DropNonKeyFrame(RTPPacket *newpack,bool *stored,RTPSources *sources)
+{
+	std::list<RTPPacket *>::iterator it;
+
+	// 读取或丢弃了队首关键帧中的关键帧数据包后，这个帧的其余部分成为最旧的非关键帧
+	if (!dropscanframes.empty() && dropscanframes.front().second == 0)
+	{
+		size_t framelen = dropscanframes.front().first;
+
+		dropscanframes.pop_front();
+		dropscannum -= framelen;
+		it = packetlist.begin();
+		for (size_t i = 0 ; i < framelen ; i++)
+			it = DropPacket(it,newpack,stored,sources);
+		return true;
+	}
+
+	if (dropscannum == 0)
+		it = packetlist.begin();
+	else
+	{
+		it = dropscanlast;
+		++it;
+	}
+
+	for ( ; it != packetlist.end() ; ++it)
+	{
+		dropscanlast = it;
+		dropscannum++;
+		dropscanframelen++;
+		if (sources->IsKeyFramePacket(this,*it))
+			dropscanlastkey = *it;
+		if (!(*it)->HasMarker())
+			continue;
+
+		if (dropscanlastkey == 0)
+		{
+			std::list<RTPPacket *>::iterator framestart = it;
+			std::list<RTPPacket *>::iterator frameend = it;
+
+			for (size_t i = 1 ; i < dropscanframelen ; i++)
+				--framestart;
+			++frameend;
+
+			// 之前检查过的帧都是关键帧，不需要重新检查
+			dropscannum -= dropscanframelen;
+			dropscanframelen = 0;
+			if (dropscannum != 0)
+			{
+				dropscanlast = framestart;
+				--dropscanlast;
+			}
+
+			while (framestart != frameend)
+				framestart = DropPacket(framestart,newpack,stored,sources);
+			return true;
+		}
+		dropscanframes.push_back(std::make_pair(dropscanframelen,dropscanlastkey));
+		dropscanframelen = 0;
+		dropscanlastkey = 0;
+	}
+	return false;
+}
+
+std::list<RTPPacket *>::iterator RTPSourceData::DropPacket(std::list<RTPPacket *>::iterator it,RTPPacket *newpack,bool *stored,RTPSources *sources)
+{
+	RTPPacket *p = *it;
+	size_t packlen = p->GetPacketLength();
+
+	packetlistbytes -= packlen;
+	CountDroppedPacket(packlen,sources);
+	if (p == newpack) // 将 'stored' 重新设置为 false，新的数据包由调用者删除
+		*stored = false;
+	else
+		delete p;
+	return packetlist.erase(it);
+}
+
+void RTPSourceData::CountDroppedPacket(size_t packlen,RTPSources *sources)
+{
+	numdroppedpackets++;
+	numdroppedbytes += packlen;
+	sources->numdroppedpackets++;
+	sources->numdroppedbytes += packlen;
+}
+
 int RTPSourceData::ProcessSDESItem(uint8_t sdesid,const uint8_t *data,size_t itemlen,const RTPTime &receivetime,bool *cnamecollis)
 {
 	*cnamecollis = false;
@@ -13,6 +13,7 @@
 #include <cstdint>
 #include "media_rtp_sources.h"
 #include "media_rtp_endpoint.h"
+#include <deque>
 #include <list>
 #include <string>
 
@@ -70,7 +71,7 @@ class RTPSourceStats
 {
 public:
 	RTPSourceStats();
-	void ProcessPacket(RTPPacket *pack,const RTPTime &receivetime,double tsunit,bool ownpacket,bool *accept,bool applyprobation,bool *onprobation);
+	void ProcessPacket(RTPPacketView *pack,const RTPTime &receivetime,double tsunit,bool ownpacket,bool *accept,bool applyprobation,bool *onprobation);
 
 	bool HasSentData() const						{ return sentdata; }
 	uint32_t GetNumPacketsReceived() const					{ return packetsreceived; }
@@ -345,8 +346,23 @@ public:
 	/** 返回接收到最后一个SDES NOTE项的时间。 */
 	RTPTime INF_GetLastSDESNoteTime() const					{ return stats.GetLastNoteTime(); }
 
+	/** 返回因数据包队列超过限制而丢弃的此参与者的数据包数量（见RTPSources::SetPacketQueueLimits）。 */
+	uint64_t INF_GetNumDroppedPackets() const				{ return numdroppedpackets; }
+
+	/** 返回因数据包队列超过限制而丢弃的此参与者的数据包的总字节数。 */
+	uint64_t INF_GetNumDroppedBytes() const					{ return numdroppedbytes; }
+
+	/** 返回此参与者的数据包队列中的数据包数量。 */
+	size_t INF_GetNumQueuedPackets() const					{ return packetlist.size(); }
+
+	/** 返回此参与者的数据包队列中数据包的总字节数。 */
+	size_t INF_GetNumQueuedBytes() const					{ return packetlistbytes; }
+
 	// 内部处理方法（从RTPInternalSourceData合并）
-	int ProcessRTPPacket(RTPPacket *rtppack,const RTPTime &receivetime,bool *stored, RTPSources *sources);
+	// 在视图 view 上处理数据包；数据包需要保留时才创建 RTPPacket 实例，接管 rawpack 的数据。
+	// 如果 *rtppack 不为零，使用该实例而不是 rawpack；创建的实例通过 *rtppack 返回，
+	// stored 为 false 时由调用者删除
+	int ProcessRTPPacket(RTPPacketView &view,RTPRawPacket *rawpack,RTPPacket **rtppack,const RTPTime &receivetime,bool *stored, RTPSources *sources);
 	void ProcessSenderInfo(const RTPNTPTime &ntptime,uint32_t rtptime,uint32_t packetcount,
 	                       uint32_t octetcount,const RTPTime &receivetime)				{ SRprevinf = SRinf; SRinf.Set(ntptime,rtptime,packetcount,octetcount,receivetime); stats.SetLastMessageTime(receivetime); }
 	void ProcessReportBlock(uint8_t fractionlost,int32_t lostpackets,uint32_t exthighseqnr,
@@ -369,8 +385,31 @@ public:
 
 	
 
+private:
+	int StorePacket(RTPPacket *rtppack,bool *stored,RTPSources *sources);
+	bool IsPacketQueueFull(size_t packlen,const RTPSources *sources) const;
+	bool IsPacketQueueOverLimit(const RTPSources *sources) const;
+	void EnforcePacketQueueLimits(RTPPacket *newpack,bool *stored,RTPSources *sources);
+	bool DropNonKeyFrame(RTPPacket *newpack,bool *stored,RTPSources *sources);
+	void ResetDropScan()										{ dropscannum = 0; dropscanframes.clear(); dropscanframelen = 0; dropscanlastkey = 0; }
+	void DropScanFrontRemoved(RTPPacket *p);
+	std::list<RTPPacket *>::iterator DropPacket(std::list<RTPPacket *>::iterator it,RTPPacket *newpack,bool *stored,RTPSources *sources);
+	void CountDroppedPacket(size_t packlen,RTPSources *sources);
+
 protected:
 	std::list<RTPPacket *> packetlist;
+	size_t packetlistbytes;
+	// DropNonKeyFrame 的检查进度：队首的 dropscannum 个数据包已经检查过，最后一个是
+	// dropscanlast。它们先是 dropscanframes 中的完整关键帧（每个帧的长度和最后一个
+	// 关键帧数据包），然后是尚未结束的帧的 dropscanframelen 个数据包，dropscanlastkey
+	// 是其中最后一个关键帧数据包；没有关键帧数据包时为 0
+	std::list<RTPPacket *>::iterator dropscanlast;
+	size_t dropscannum;
+	std::deque<std::pair<size_t, RTPPacket *> > dropscanframes;
+	size_t dropscanframelen;
+	RTPPacket *dropscanlastkey;
+	uint64_t numdroppedpackets;
+	uint64_t numdroppedbytes;
 
 	uint32_t ssrc;
 	bool ownssrc;
@@ -408,7 +447,9 @@ inline RTPPacket *RTPSourceData::GetNextPacket()
 	if (packetlist.empty())
 		return 0;
 	p = *(packetlist.begin());
+	DropScanFrontRemoved(p);
 	packetlist.pop_front();
+	packetlistbytes -= p->GetPacketLength();
 	return p;
 }
 
@@ -419,6 +460,31 @@ inline void RTPSourceData::FlushPackets()
 	for (it = packetlist.begin() ; it != packetlist.end() ; ++it)
 		delete *it;
 	packetlist.clear();
+	packetlistbytes = 0;
+	ResetDropScan();
+}
+
+// 在移除队首的数据包 p 之前调用，更新 DropNonKeyFrame 的检查进度
+inline void RTPSourceData::DropScanFrontRemoved(RTPPacket *p)
+{
+	if (dropscannum == 0)
+		return;
+
+	dropscannum--;
+	if (dropscanframes.empty()) // 移除的是尚未结束的帧的第一个数据包
+	{
+		dropscanframelen--;
+		if (p == dropscanlastkey)
+			dropscanlastkey = 0;
+		return;
+	}
+
+	// 移除了帧中最后一个关键帧数据包时，帧的其余部分不再是关键帧，见 DropNonKeyFrame
+	std::pair<size_t, RTPPacket *> &frame = dropscanframes.front();
+	if (p == frame.second)
+		frame.second = 0;
+	if (--frame.first == 0)
+		dropscanframes.pop_front();
 }
 
 inline int RTPSourceData::SetRTPDataAddress(const RTPEndpoint *a)
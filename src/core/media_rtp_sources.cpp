@@ -20,6 +20,11 @@ RTPSources::RTPSources(ProbationType probtype)
 	current_it = sourcelist.end();
 	rtpsession = 0;
 	owncollision = false;
+	maxqueuepackets = 0;
+	maxqueuebytes = 0;
+	queuedroppolicy = DropOldest;
+	numdroppedpackets = 0;
+	numdroppedbytes = 0;
 #ifdef RTP_SUPPORT_PROBATION
 	probationtype = probtype;
 #endif // RTP_SUPPORT_PROBATION
@@ -36,6 +41,11 @@ RTPSources::RTPSources(RTPSession &sess, ProbationType probtype) : rtpsession(&s
 	owndata = 0;
 	current_it = sourcelist.end();
 	owncollision = false;
+	maxqueuepackets = 0;
+	maxqueuebytes = 0;
+	queuedroppolicy = DropOldest;
+	numdroppedpackets = 0;
+	numdroppedbytes = 0;
 #ifdef RTP_SUPPORT_PROBATION
 	probationtype = probtype;
 #endif // RTP_SUPPORT_PROBATION
@@ -145,29 +155,17 @@ int RTPSources::ProcessRawPacket(RTPRawPacket *rawpack,RTPTransmitter *rtptrans[
 	
 	if (rawpack->IsRTP()) // RTP 数据包
 	{
-		RTPPacket *rtppack;
-		
-		// 首先，我们将查看数据包是否可以解析
-		rtppack = new RTPPacket(*rawpack);
-		if (rtppack == 0)
-			return MEDIA_RTP_ERR_RESOURCE_ERROR;
-		if ((status = rtppack->GetCreationError()) < 0)
+		// 首先，我们将查看数据包是否可以解析；视图直接使用接收缓冲区，不分配内存
+		RTPPacketView view(*rawpack);
+
+		if ((status = view.GetCreationError()) < 0)
 		{
-			if (status == MEDIA_RTP_ERR_PROTOCOL_ERROR)
-			{
-				delete rtppack;
-				rtppack = 0;
-			}
-			else
-			{
-				delete rtppack;
+			if (status != MEDIA_RTP_ERR_PROTOCOL_ERROR)
 				return status;
-			}
 		}
-				
-		// 检查数据包是否有效
-		if (rtppack != 0)
+		else // 检查数据包是否有效
 		{
+			RTPPacket *rtppack = 0; // 只有应用程序需要保留数据包时才会创建
 			bool stored = false;
 			bool ownpacket = false;
 			int i;
@@ -179,6 +177,8 @@ int RTPSources::ProcessRawPacket(RTPRawPacket *rawpack,RTPTransmitter *rtptrans[
 					ownpacket = true;
 			}
 			
+			status = 0;
+
 			// 检查数据包是否是我们自己的。
 			if (ownpacket)
 			{
@@ -187,25 +187,16 @@ int RTPSources::ProcessRawPacket(RTPRawPacket *rawpack,RTPTransmitter *rtptrans[
 				if (acceptownpackets)
 				{
 					// 自己的数据包的发送方地址必须为 NULL！
-					if ((status = ProcessRTPPacket(rtppack,rawpack->GetReceiveTime(),0,&stored)) < 0)
-					{
-						if (!stored)
-							delete rtppack;
-						return status;
-					}
+					status = ProcessRTPPacketView(view,rawpack,&rtppack,rawpack->GetReceiveTime(),0,&stored);
 				}
 			}
 			else 
-			{
-				if ((status = ProcessRTPPacket(rtppack,rawpack->GetReceiveTime(),senderaddress,&stored)) < 0)
-				{
-					if (!stored)
-						delete rtppack;
-					return status;
-				}
-			}
+				status = ProcessRTPPacketView(view,rawpack,&rtppack,rawpack->GetReceiveTime(),senderaddress,&stored);
+
 			if (!stored)
 				delete rtppack;
+			if (status < 0)
+				return status;
 		}
 	}
 	else // RTCP 数据包
@@ -257,17 +248,30 @@ int RTPSources::ProcessRawPacket(RTPRawPacket *rawpack,RTPTransmitter *rtptrans[
 }
 
 int RTPSources::ProcessRTPPacket(RTPPacket *rtppack,const RTPTime &receivetime,const RTPEndpoint *senderaddress,bool *stored)
+{
+	RTPPacketView view(*rtppack);
+	int status;
+
+	*stored = false;
+	if ((status = view.GetCreationError()) < 0)
+		return status;
+	return ProcessRTPPacketView(view,0,&rtppack,receivetime,senderaddress,stored);
+}
+
+// 如果 *rtppack 为零，需要保留数据包时由 rawpack 创建实例并通过 *rtppack 返回
+int RTPSources::ProcessRTPPacketView(RTPPacketView &view,RTPRawPacket *rawpack,RTPPacket **rtppack,const RTPTime &receivetime,
+                                     const RTPEndpoint *senderaddress,bool *stored)
 {
 	uint32_t ssrc;
 	RTPSourceData *srcdat;
 	int status;
 	bool created;
 
-	OnRTPPacket(rtppack,receivetime,senderaddress);
+	OnRTPPacketView(view,receivetime,senderaddress);
 
 	*stored = false;
 	
-	ssrc = rtppack->GetSSRC();
+	ssrc = view.GetSSRC();
 	if ((status = ObtainSourceDataInstance(ssrc,&srcdat,&created)) < 0)
 		return status;
 
@@ -286,19 +290,18 @@ int RTPSources::ProcessRTPPacket(RTPPacket *rtppack,const RTPTime &receivetime,c
 	bool prevactive = srcdat->IsActive();
 	
 	uint32_t CSRCs[RTP_MAXCSRCS];
-	int numCSRCs = rtppack->GetCSRCCount();
+	int numCSRCs = view.GetCSRCCount();
 	if (numCSRCs > RTP_MAXCSRCS) // 不应该发生，但检查比越界好
 		numCSRCs = RTP_MAXCSRCS;
 
 	for (int i = 0 ; i < numCSRCs ; i++)
-		CSRCs[i] = rtppack->GetCSRC(i);
+		CSRCs[i] = view.GetCSRC(i);
 
 	// 数据包来自有效源，我们现在可以进一步处理它
-	// 如果出现问题，以下函数应自行删除 rtppack
-	if ((status = srcdat->ProcessRTPPacket(rtppack,receivetime,stored,this)) < 0)
+	if ((status = srcdat->ProcessRTPPacket(view,rawpack,rtppack,receivetime,stored,this)) < 0)
 		return status;
 
-	// 注意：我们不能再使用 'rtppack'，因为它可能已在
+	// 注意：我们不能再使用 'view' 和 'rtppack'，因为数据包可能已在
 	//       OnValidatedRTPPacket 中被删除
 
 	if (!prevsender && srcdat->IsSender())
@@ -1138,8 +1141,20 @@ bool RTPSources::CheckCollision(RTPSourceData *srcdat,const RTPEndpoint *sendera
 }
 
 // Virtual function implementations - forward to RTPSession if available
-void RTPSources::OnRTPPacket(RTPPacket *pack, const RTPTime &receivetime, const RTPEndpoint *senderaddress)                               
-{ 
+void RTPSources::OnRTPPacketView(const RTPPacketView &pack, const RTPTime &receivetime, const RTPEndpoint *senderaddress)
+{
+	if (rtpsession)
+		rtpsession->OnRTPPacketView(pack, receivetime, senderaddress);
+	else
+	{
+		// 没有会话时直接调用 OnRTPPacket，会话的默认实现也这样做
+		RTPPacket rtppack(pack);
+		OnRTPPacket(&rtppack, receivetime, senderaddress);
+	}
+}
+
+void RTPSources::OnRTPPacket(RTPPacket *pack, const RTPTime &receivetime, const RTPEndpoint *senderaddress)
+{
 	if (rtpsession)
 		rtpsession->OnRTPPacket(pack, receivetime, senderaddress);
 }
@@ -1255,3 +1270,15 @@ void RTPSources::OnValidatedRTPPacket(RTPSourceData *srcdat, RTPPacket *rtppack,
 		rtpsession->OnValidatedRTPPacket(srcdat, rtppack, isonprobation, ispackethandled);
 }
 
+void RTPSources::OnValidatedRTPPacketView(RTPSourceData *srcdat, const RTPPacketView &view, bool isonprobation, bool *ispackethandled)
+{
+	if (rtpsession)
+		rtpsession->OnValidatedRTPPacketView(srcdat, view, isonprobation, ispackethandled);
+}
+
+bool RTPSources::IsKeyFramePacket(RTPSourceData *srcdat, RTPPacket *rtppack)
+{
+	if (rtpsession)
+		return rtpsession->IsKeyFramePacket(srcdat, rtppack);
+	return false;
+}
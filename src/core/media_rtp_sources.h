@@ -18,6 +18,7 @@ class RTPTransmitter;
 class RTCPAPPPacket;
 class RTPRawPacket;
 class RTPPacket;
+class RTPPacketView;
 class RTPTime;
 class RTPEndpoint;
 class RTPSourceData;
@@ -40,6 +41,16 @@ public:
 			ProbationDiscard, 	/**< 丢弃来自试用期源的数据包。 */
 			ProbationStore 		/**< 存储来自试用期源的数据包以供稍后检索。 */
 	};
+
+	/** 源的数据包队列超过限制时选择丢弃哪些数据包（见SetPacketQueueLimits）。 */
+	enum QueueDropPolicy
+	{
+			DropOldest,		/**< 丢弃序列号最小的数据包。 */
+			DropNewest,		/**< 丢弃新到达的数据包，队列中的数据包保持不变。 */
+			DropNonKeyFrames	/**< 从最旧的开始丢弃整个非关键帧，即以设置了标记位的数据包结束、
+						     且IsKeyFramePacket对其中每个数据包都返回false的数据包序列；
+						     没有这样的帧时丢弃序列号最小的数据包。 */
+	};
 	
 	/** 在构造函数中，您可以选择要使用的试用期类型以及内存管理器。 */
 	RTPSources(ProbationType = ProbationStore);
@@ -59,6 +70,28 @@ public:
 	void SetProbationType(ProbationType probtype)							{ probationtype = probtype; }
 #endif // RTP_SUPPORT_PROBATION
 
+	/** 限制每个源的数据包队列：最多 \c maxpackets 个数据包和 \c maxbytes 字节，
+	 *  为零的值表示不限制（默认两者都不限制）。队列超过限制时按 \c policy 丢弃数据包，
+	 *  丢弃的数量记录在源的 RTPSourceData::INF_GetNumDroppedPackets 和本表格的
+	 *  GetNumDroppedPackets 中。没有取出数据包的应用程序因此不会使内存无限增长。
+	 */
+	void SetPacketQueueLimits(size_t maxpackets,size_t maxbytes,QueueDropPolicy policy)	{ maxqueuepackets = maxpackets; maxqueuebytes = maxbytes; queuedroppolicy = policy; }
+
+	/** 返回每个源的数据包队列最多容纳的数据包数量，零表示不限制。 */
+	size_t GetPacketQueueMaximumPackets() const							{ return maxqueuepackets; }
+
+	/** 返回每个源的数据包队列最多容纳的字节数，零表示不限制。 */
+	size_t GetPacketQueueMaximumBytes() const							{ return maxqueuebytes; }
+
+	/** 返回队列超过限制时使用的丢弃策略。 */
+	QueueDropPolicy GetPacketQueueDropPolicy() const						{ return queuedroppolicy; }
+
+	/** 返回所有源因数据包队列超过限制而丢弃的数据包总数，包括已删除的源。 */
+	uint64_t GetNumDroppedPackets() const								{ return numdroppedpackets; }
+
+	/** 返回所有源因数据包队列超过限制而丢弃的总字节数。 */
+	uint64_t GetNumDroppedBytes() const								{ return numdroppedbytes; }
+
 	/** 为我们自己的SSRC标识符创建一个条目。 */
 	int CreateOwnSSRC(uint32_t ssrc);
 
@@ -219,7 +252,10 @@ public:
 	int GetActiveMemberCount() const								{ return activecount; } 
 
 protected:
-	/** 当RTP数据包即将被处理时调用。 */
+	/** 当RTP数据包即将被处理时调用，\c pack 是接收缓冲区上的视图，只在调用期间有效。 */
+	virtual void OnRTPPacketView(const RTPPacketView &pack,const RTPTime &receivetime, const RTPEndpoint *senderaddress);
+
+	/** 当RTP数据包即将被处理时调用，默认由 OnRTPPacketView 调用；\c pack 不拥有数据，只在调用期间有效。 */
 	virtual void OnRTPPacket(RTPPacket *pack,const RTPTime &receivetime, const RTPEndpoint *senderaddress);
 
 	/** 当RTCP复合数据包即将被处理时调用。 */
@@ -282,11 +318,21 @@ protected:
 	 *  允许您直接使用指定源的RTP数据包。如果 `ispackethandled` 设置为 `true`，
 	 *  数据包将不再存储在此源的数据包列表中。 */
 	virtual void OnValidatedRTPPacket(RTPSourceData *srcdat, RTPPacket *rtppack, bool isonprobation, bool *ispackethandled);
+
+	/** 在OnValidatedRTPPacket之前调用，允许直接在接收缓冲区上使用指定源的RTP数据包。
+	 *  视图 \c view 只在调用期间有效。如果 `ispackethandled` 设置为 `true`，
+	 *  不会为该数据包创建RTPPacket实例，也不再调用OnValidatedRTPPacket。 */
+	virtual void OnValidatedRTPPacketView(RTPSourceData *srcdat, const RTPPacketView &view, bool isonprobation, bool *ispackethandled);
+
+	/** 使用DropNonKeyFrames策略时调用，返回源 \c srcdat 的数据包 \c rtppack 是否属于关键帧。 */
+	virtual bool IsKeyFramePacket(RTPSourceData *srcdat, RTPPacket *rtppack);
 private:
 	void ClearSourceList();
 	int ObtainSourceDataInstance(uint32_t ssrc,RTPSourceData **srcdat,bool *created);
 	int GetRTCPSourceData(uint32_t ssrc,const RTPEndpoint *senderaddress,RTPSourceData **srcdat,bool *newsource);
 	bool CheckCollision(RTPSourceData *srcdat,const RTPEndpoint *senderaddress,bool isrtp);
+	int ProcessRTPPacketView(RTPPacketView &view,RTPRawPacket *rawpack,RTPPacket **rtppack,const RTPTime &receivetime,
+	                         const RTPEndpoint *senderaddress,bool *stored);
 	
 	std::unordered_map<uint32_t,RTPSourceData*> sourcelist;
 	std::unordered_map<uint32_t,RTPSourceData*>::iterator current_it;
@@ -299,6 +345,12 @@ private:
 	ProbationType probationtype;
 #endif // RTP_SUPPORT_PROBATION
 
+	size_t maxqueuepackets;
+	size_t maxqueuebytes;
+	QueueDropPolicy queuedroppolicy;
+	uint64_t numdroppedpackets;
+	uint64_t numdroppedbytes;
+
 	RTPSourceData *owndata;
 	
 	// 会话特定成员
@@ -267,6 +267,7 @@ RTCPCompoundPacket::RTCPCompoundPacket(RTPRawPacket &rawpack)
 {
 	compoundpacket = 0;
 	compoundpacketlength = 0;
+	pooledpacket = false;
 	error = 0;
 	
 	if (rawpack.IsRTP())
@@ -285,6 +286,7 @@ RTCPCompoundPacket::RTCPCompoundPacket(RTPRawPacket &rawpack)
 	compoundpacket = rawpack.GetData();
 	compoundpacketlength = rawpack.GetDataLength();
 	deletepacket = true;
+	pooledpacket = rawpack.IsDataPooled();
 
 	rawpack.ZeroData();
 	
@@ -295,6 +297,7 @@ RTCPCompoundPacket::RTCPCompoundPacket(uint8_t *packet, size_t packetlen, bool d
 {
 	compoundpacket = 0;
 	compoundpacketlength = 0;
+	pooledpacket = false;
 	
 	error = ParseData(packet,packetlen);
 	if (error < 0)
@@ -311,6 +314,7 @@ RTCPCompoundPacket::RTCPCompoundPacket()
 {
 	compoundpacket = 0;
 	compoundpacketlength = 0;
+	pooledpacket = false;
 	error = 0;
 	deletepacket = true;
 }
@@ -414,7 +418,12 @@ RTCPCompoundPacket::~RTCPCompoundPacket()
 {
 	ClearPacketList();
 	if (compoundpacket && deletepacket)
-		delete [] compoundpacket;
+	{
+		if (pooledpacket)
+			RTPBufferPool::Release(compoundpacket);
+		else
+			delete [] compoundpacket;
+	}
 }
 
 void RTCPCompoundPacket::ClearPacketList()
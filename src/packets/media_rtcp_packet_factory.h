@@ -20,6 +20,7 @@
 #include "media_rtp_defines.h"
 #include "media_rtp_errors.h"
 #include "media_rtp_structs.h"
+#include "media_rtp_buffer_pool.h"
 #include "media_rtp_utils.h"
 #include <cstddef>
 #include <cstdint>
@@ -848,6 +849,7 @@ protected:
   uint8_t *compoundpacket;
   size_t compoundpacketlength;
   bool deletepacket;
+  bool pooledpacket; // 数据来自 RTPBufferPool，删除时归还
 
   std::list<RTCPPacket *> rtcppacklist;
   std::list<RTCPPacket *>::const_iterator rtcppackit;
@@ -0,0 +1,240 @@
+#include "media_rtp_header_extensions.h"
+#include "media_rtp_errors.h"
+#include <string.h>
+
+// ===================== RTPHeaderExtensionMap implementation =====================
+
+static const char *const rtphdrexturis[RTPHeaderExtensionMap::NumTypes] =
+{
+	0,
+	"http://www.webrtc.org/experiments/rtp-hdrext/abs-send-time",
+	"http://www.ietf.org/id/draft-holmer-rmcat-transport-wide-cc-extensions-01",
+	"urn:ietf:params:rtp-hdrext:ssrc-audio-level",
+	"urn:ietf:params:rtp-hdrext:sdes:mid"
+};
+
+int RTPHeaderExtensionMap::Register(Type type,uint8_t id)
+{
+	if (type <= None || type >= NumTypes || id == 0)
+		return MEDIA_RTP_ERR_INVALID_PARAMETER;
+	if (m_ids[type] == id)
+		return 0;
+	if (m_ids[type] != 0 || m_types[id] != None)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	m_ids[type] = id;
+	m_types[id] = (uint8_t)type;
+	return 0;
+}
+
+int RTPHeaderExtensionMap::Register(const char *uri,uint8_t id)
+{
+	if (uri == 0)
+		return MEDIA_RTP_ERR_INVALID_PARAMETER;
+
+	for (int i = None+1 ; i < NumTypes ; i++)
+	{
+		if (strcmp(uri,rtphdrexturis[i]) == 0)
+			return Register((Type)i,id);
+	}
+	return MEDIA_RTP_ERR_INVALID_PARAMETER;
+}
+
+int RTPHeaderExtensionMap::Unregister(Type type)
+{
+	if (type <= None || type >= NumTypes)
+		return MEDIA_RTP_ERR_INVALID_PARAMETER;
+	if (m_ids[type] == 0)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	m_types[m_ids[type]] = None;
+	m_ids[type] = 0;
+	return 0;
+}
+
+void RTPHeaderExtensionMap::Clear()
+{
+	memset(m_ids,0,sizeof(m_ids));
+	memset(m_types,None,sizeof(m_types));
+}
+
+const char *RTPHeaderExtensionMap::GetURI(Type type)
+{
+	if (type <= None || type >= NumTypes)
+		return 0;
+	return rtphdrexturis[type];
+}
+
+// ===================== RTPHeaderExtensionIterator implementation =====================
+
+RTPHeaderExtensionIterator::RTPHeaderExtensionIterator(uint16_t profile,const uint8_t *data,size_t length)
+{
+	Init(profile,data,length);
+}
+
+RTPHeaderExtensionIterator::RTPHeaderExtensionIterator(const RTPPacketView &view)
+{
+	Init(view.GetExtensionID(),view.GetExtensionData(),view.GetExtensionLength());
+}
+
+RTPHeaderExtensionIterator::RTPHeaderExtensionIterator(const RTPPacket &packet)
+{
+	if (packet.HasExtension())
+		Init(packet.GetExtensionID(),packet.GetExtensionData(),packet.GetExtensionLength());
+	else
+		Init(0,0,0);
+}
+
+void RTPHeaderExtensionIterator::Init(uint16_t profile,const uint8_t *data,size_t length)
+{
+	if (data == 0)
+		m_format = Unsupported;
+	else if (profile == RTP_HDREXT_ONEBYTEPROFILE)
+		m_format = OneByte;
+	else if ((profile&0xfff0) == RTP_HDREXT_TWOBYTEPROFILE) // 低四位是应用相关的位
+		m_format = TwoByte;
+	else
+		m_format = Unsupported;
+
+	m_data = data;
+	m_length = (m_format == Unsupported)?0:length;
+	Reset();
+}
+
+bool RTPHeaderExtensionIterator::Next()
+{
+	ClearElement();
+
+	while (m_pos < m_length)
+	{
+		uint8_t b = m_data[m_pos];
+		uint8_t id;
+		size_t len, hdrlen;
+
+		if (b == 0) // 元素之间的填充
+		{
+			m_pos++;
+			continue;
+		}
+
+		if (m_format == OneByte)
+		{
+			id = b >> 4;
+			if (id == 15) // 保留的标识符，之后的数据不再处理
+			{
+				m_pos = m_length;
+				return false;
+			}
+			len = (size_t)(b&0x0f)+1;
+			hdrlen = 1;
+		}
+		else
+		{
+			if (m_pos+2 > m_length)
+			{
+				m_malformed = true;
+				m_pos = m_length;
+				return false;
+			}
+			id = b;
+			len = m_data[m_pos+1];
+			hdrlen = 2;
+		}
+
+		if (m_pos+hdrlen+len > m_length)
+		{
+			m_malformed = true;
+			m_pos = m_length;
+			return false;
+		}
+
+		m_id = id;
+		m_elementData = m_data+m_pos+hdrlen;
+		m_elementLength = len;
+		m_pos += hdrlen+len;
+		return true;
+	}
+	return false;
+}
+
+bool RTPHeaderExtensionIterator::Find(uint8_t id)
+{
+	Reset();
+	while (Next())
+	{
+		if (m_id == id)
+			return true;
+	}
+	return false;
+}
+
+// ===================== RTPHeaderExtensionWriter implementation =====================
+
+int RTPHeaderExtensionWriter::Add(uint8_t id,const void *data,size_t len)
+{
+	if (id == 0 || len > RTP_HDREXT_TWOBYTEMAXLENGTH || (data == 0 && len > 0))
+		return MEDIA_RTP_ERR_INVALID_PARAMETER;
+
+	uint8_t *dest = Reserve(id,len);
+	if (dest == 0)
+		return MEDIA_RTP_ERR_RESOURCE_ERROR;
+	if (len > 0)
+		memcpy(dest,data,len);
+	return 0;
+}
+
+// 写入元素的头部并返回数据的位置，缓冲区放不下时返回零且不改变已有的元素
+uint8_t *RTPHeaderExtensionWriter::Reserve(uint8_t id,size_t len)
+{
+	bool needtwobyte = (id > RTP_HDREXT_ONEBYTEMAXID || len == 0 || len > RTP_HDREXT_ONEBYTEMAXLENGTH);
+	bool convert = (needtwobyte && !m_twoByte);
+	size_t newlength = m_length;
+
+	if (convert)
+	{
+		// 改为双字节格式时每个已有的元素多一个字节
+		RTPHeaderExtensionIterator it(RTP_HDREXT_ONEBYTEPROFILE,m_buffer,m_length);
+		while (it.Next())
+			newlength++;
+	}
+	newlength += ((m_twoByte || needtwobyte)?2:1)+len;
+	if (((newlength+3)&~((size_t)3)) > m_bufferLength)
+		return 0;
+
+	if (convert)
+		ConvertToTwoByte();
+
+	uint8_t *hdr = m_buffer+m_length;
+	if (m_twoByte)
+	{
+		hdr[0] = id;
+		hdr[1] = (uint8_t)len;
+	}
+	else
+		hdr[0] = (uint8_t)((id << 4)|(len-1));
+
+	m_length = newlength;
+	memset(m_buffer+m_length,0,((m_length+3)&~((size_t)3))-m_length);
+	return m_buffer+m_length-len;
+}
+
+void RTPHeaderExtensionWriter::ConvertToTwoByte()
+{
+	// 从前往后逐个改写，调用者已经确认缓冲区放得下
+	size_t pos = 0;
+
+	while (pos < m_length)
+	{
+		uint8_t b = m_buffer[pos];
+		size_t len = (size_t)(b&0x0f)+1;
+
+		memmove(m_buffer+pos+2,m_buffer+pos+1,m_length-pos-1);
+		m_buffer[pos] = b >> 4;
+		m_buffer[pos+1] = (uint8_t)len;
+		m_length++;
+		pos += 2+len;
+	}
+	m_twoByte = true;
+}
+
+// ===================== End of RTPHeaderExtensionWriter implementation =====================
@@ -0,0 +1,363 @@
+/**
+ * \file media_rtp_header_extensions.h
+ * \brief RFC 8285 头部扩展：标识符与扩展类型的映射 RTPHeaderExtensionMap、
+ *        遍历收到的扩展元素的 RTPHeaderExtensionIterator、打包多个元素的
+ *        RTPHeaderExtensionWriter，以及常用扩展的类型定义
+ */
+
+#ifndef MEDIA_RTP_HEADER_EXTENSIONS_H
+#define MEDIA_RTP_HEADER_EXTENSIONS_H
+
+#include "rtpconfig.h"
+#include "media_rtp_errors.h"
+#include "media_rtp_utils.h"
+#include "media_rtp_packet_factory.h"
+#include <cstdint>
+#include <string.h>
+
+/** 单字节头部格式（RFC 8285 第 4.2 节）的扩展标识符。 */
+#define RTP_HDREXT_ONEBYTEPROFILE 0xBEDE
+/** 双字节头部格式（RFC 8285 第 4.3 节）的扩展标识符，低四位是应用相关的位。 */
+#define RTP_HDREXT_TWOBYTEPROFILE 0x1000
+/** 单字节格式中元素的最大标识符和最大数据长度。 */
+#define RTP_HDREXT_ONEBYTEMAXID 14
+#define RTP_HDREXT_ONEBYTEMAXLENGTH 16
+/** 双字节格式中元素的最大数据长度。 */
+#define RTP_HDREXT_TWOBYTEMAXLENGTH 255
+
+/** 一个会话中协商的扩展标识符（例如 SDP 的 a=extmap）与扩展类型之间的映射。
+ *  映射保存在固定大小的数组中，注册和查找都不分配内存；它不加锁，应在发送和
+ *  接收数据包之前配置好。常用的扩展有对应的类型定义（例如
+ *  RTPAbsoluteSendTimeExtension），可以用 Register<Ext>、Find<Ext> 和
+ *  RTPHeaderExtensionWriter::Add<Ext> 按类型使用。
+ */
+class RTPHeaderExtensionMap {
+public:
+  /** 已知的扩展类型。 */
+  enum Type {
+    None,                    /**< 未注册的标识符。 */
+    AbsoluteSendTime,        /**< abs-send-time，24 位 6.18 定点的发送时间。 */
+    TransportSequenceNumber, /**< transport-wide-cc 的 16 位传输序列号。 */
+    AudioLevel,              /**< RFC 6464 客户端到混音器的音频电平。 */
+    Mid,                     /**< RFC 8843 的媒体标识 MID。 */
+    NumTypes
+  };
+
+  RTPHeaderExtensionMap() { Clear(); }
+
+  /** 把标识符 \c id（1 到 255）分配给扩展类型 \c type。标识符已分配给其他类型，
+   *  或者该类型已使用其他标识符时返回错误。 */
+  int Register(Type type, uint8_t id);
+
+  /** 按扩展的 URI \c uri 注册，例如直接使用 a=extmap 中的 URI；
+   *  未知的 URI 返回 MEDIA_RTP_ERR_INVALID_PARAMETER。 */
+  int Register(const char *uri, uint8_t id);
+
+  /** 按类型定义 \c Ext 注册。 */
+  template <class Ext> int Register(uint8_t id) {
+    return Register(Ext::GetType(), id);
+  }
+
+  /** 删除扩展类型 \c type 的标识符。 */
+  int Unregister(Type type);
+
+  /** 删除所有映射。 */
+  void Clear();
+
+  /** 返回扩展类型 \c type 的标识符，未注册时返回零。 */
+  uint8_t GetID(Type type) const {
+    return (type > None && type < NumTypes) ? m_ids[type] : 0;
+  }
+
+  /** 返回标识符 \c id 对应的扩展类型，未注册时返回 None。 */
+  Type GetType(uint8_t id) const { return (Type)m_types[id]; }
+
+  /** 返回扩展类型 \c type 的 URI，None 返回空指针。 */
+  static const char *GetURI(Type type);
+
+  /** 在视图 \c view 的头部扩展中查找类型定义 \c Ext 的元素，找到且内容有效时
+   *  把它的值写入 \c value 并返回 \c true。值可能指向数据包的数据。 */
+  template <class Ext>
+  bool Find(const RTPPacketView &view, typename Ext::value_type *value) const;
+
+  /** 与上一个函数相同，但在数据包 \c packet 中查找。 */
+  template <class Ext>
+  bool Find(const RTPPacket &packet, typename Ext::value_type *value) const;
+
+private:
+  uint8_t m_ids[NumTypes];
+  uint8_t m_types[256];
+};
+
+/** 依次遍历RTP数据包头部扩展中的 RFC 8285 元素，不复制数据：元素的数据指向
+ *  数据包本身。同时支持单字节和双字节格式，其他扩展标识符的扩展没有元素。
+ *  典型的用法是
+ *  \code
+ *  for (RTPHeaderExtensionIterator it(view); it.Next(); )
+ *    ... it.GetID(), it.GetData(), it.GetLength() ...
+ *  \endcode
+ *  遇到填充字节时跳过，遇到单字节格式的标识符 15 或数据越界时结束遍历，
+ *  后一种情况 IsMalformed 返回 \c true。
+ */
+class RTPHeaderExtensionIterator {
+public:
+  /** 遍历扩展标识符为 \c profile、数据为 \c data、长度为 \c length 的扩展。 */
+  RTPHeaderExtensionIterator(uint16_t profile, const uint8_t *data,
+                             size_t length);
+
+  /** 遍历视图 \c view 的头部扩展。 */
+  explicit RTPHeaderExtensionIterator(const RTPPacketView &view);
+
+  /** 遍历数据包 \c packet 的头部扩展。 */
+  explicit RTPHeaderExtensionIterator(const RTPPacket &packet);
+
+  /** 前进到下一个元素，没有更多元素时返回 \c false。 */
+  bool Next();
+
+  /** 从头开始查找标识符为 \c id 的元素，找到时停在该元素上并返回 \c true。 */
+  bool Find(uint8_t id);
+
+  /** 回到第一个元素之前。 */
+  void Reset() {
+    m_pos = 0;
+    m_malformed = false;
+    ClearElement();
+  }
+
+  /** 如果扩展使用 RFC 8285 的格式之一，返回 \c true。 */
+  bool IsSupported() const { return m_format != Unsupported; }
+
+  /** 如果扩展使用双字节格式，返回 \c true。 */
+  bool IsTwoByte() const { return m_format == TwoByte; }
+
+  /** 如果遍历因数据越界而结束，返回 \c true。 */
+  bool IsMalformed() const { return m_malformed; }
+
+  /** 返回当前元素的标识符。 */
+  uint8_t GetID() const { return m_id; }
+
+  /** 返回指向当前元素数据的指针。 */
+  const uint8_t *GetData() const { return m_elementData; }
+
+  /** 返回当前元素数据的长度。 */
+  size_t GetLength() const { return m_elementLength; }
+
+private:
+  enum Format { Unsupported, OneByte, TwoByte };
+
+  void Init(uint16_t profile, const uint8_t *data, size_t length);
+  void ClearElement() {
+    m_id = 0;
+    m_elementData = 0;
+    m_elementLength = 0;
+  }
+
+  Format m_format;
+  const uint8_t *m_data;
+  size_t m_length;
+  size_t m_pos;
+  bool m_malformed;
+
+  uint8_t m_id;
+  const uint8_t *m_elementData;
+  size_t m_elementLength;
+};
+
+/** 把多个 RFC 8285 元素依次打包到调用者提供的缓冲区中，不分配内存。
+ *  所有元素都能使用单字节格式时使用单字节格式，加入第一个需要双字节格式的元素
+ *  （标识符大于 14、数据为空或长于 16 字节）时，已有的元素就地改为双字节格式。
+ *  缓冲区总是用零填充到 32 位边界，因此随时可以把 GetProfile、GetData 和
+ *  GetNumWords 的结果交给 RTPPacketBuilder::BuildPacketEx、
+ *  RTPSession::SendPacketEx 或 RTPPacketDescriptor::SetExtension。
+ *  同一个标识符不应加入两次。
+ */
+class RTPHeaderExtensionWriter {
+public:
+  /** 使用长度为 \c length 的缓冲区 \c buffer。 */
+  RTPHeaderExtensionWriter(uint8_t *buffer, size_t length)
+      : m_buffer(buffer), m_bufferLength(length), m_length(0),
+        m_twoByte(false) {}
+
+  /** 加入标识符为 \c id、数据为 \c data、长度为 \c len 的元素。
+   *  标识符为零或数据长于 255 字节时返回 MEDIA_RTP_ERR_INVALID_PARAMETER，
+   *  缓冲区放不下时返回 MEDIA_RTP_ERR_RESOURCE_ERROR，已加入的元素不变。 */
+  int Add(uint8_t id, const void *data, size_t len);
+
+  /** 按映射 \c map 中类型定义 \c Ext 的标识符加入值 \c value；
+   *  该类型没有注册时返回 MEDIA_RTP_ERR_INVALID_STATE。 */
+  template <class Ext>
+  int Add(const RTPHeaderExtensionMap &map,
+          const typename Ext::value_type &value);
+
+  /** 删除所有元素。 */
+  void Clear() {
+    m_length = 0;
+    m_twoByte = false;
+  }
+
+  /** 如果还没有加入元素，返回 \c true。 */
+  bool IsEmpty() const { return m_length == 0; }
+
+  /** 返回应使用的扩展标识符（单字节或双字节格式）。 */
+  uint16_t GetProfile() const {
+    return m_twoByte ? RTP_HDREXT_TWOBYTEPROFILE : RTP_HDREXT_ONEBYTEPROFILE;
+  }
+
+  /** 返回扩展数据。 */
+  const uint8_t *GetData() const { return m_buffer; }
+
+  /** 返回扩展数据的长度，以32位字的数量表示。 */
+  size_t GetNumWords() const { return (m_length + 3) / 4; }
+
+private:
+  void ConvertToTwoByte();
+  uint8_t *Reserve(uint8_t id, size_t len);
+
+  uint8_t *m_buffer;
+  size_t m_bufferLength;
+  size_t m_length; // 不包括末尾的填充
+  bool m_twoByte;
+};
+
+/** 以下的类型定义描述一种扩展的值和编码：value_type 是值的类型，
+ *  GetSize 返回编码后的长度，Parse 解码元素的数据，Write 编码到目标缓冲区。 */
+
+/** abs-send-time：发送时间的 NTP 时间戳中间 24 位，即 6.18 定点格式的秒数。 */
+struct RTPAbsoluteSendTimeExtension {
+  typedef uint32_t value_type;
+
+  static RTPHeaderExtensionMap::Type GetType() {
+    return RTPHeaderExtensionMap::AbsoluteSendTime;
+  }
+  static size_t GetSize(const value_type &) { return 3; }
+  static bool Parse(const uint8_t *data, size_t len, value_type *value) {
+    if (len != 3)
+      return false;
+    *value = (((uint32_t)data[0]) << 16) | (((uint32_t)data[1]) << 8) | data[2];
+    return true;
+  }
+  static void Write(uint8_t *dest, const value_type &value) {
+    dest[0] = (uint8_t)(value >> 16);
+    dest[1] = (uint8_t)(value >> 8);
+    dest[2] = (uint8_t)value;
+  }
+
+  /** 把时间 \c t 转换为 abs-send-time 的值。 */
+  static value_type FromTime(const RTPTime &t) {
+    RTPNTPTime ntp = t.GetNTPTime();
+    return ((ntp.GetMSW() & 0x3f) << 18) | (ntp.GetLSW() >> 14);
+  }
+};
+
+/** transport-wide-cc：每个传输层数据包的 16 位序列号。 */
+struct RTPTransportSequenceNumberExtension {
+  typedef uint16_t value_type;
+
+  static RTPHeaderExtensionMap::Type GetType() {
+    return RTPHeaderExtensionMap::TransportSequenceNumber;
+  }
+  static size_t GetSize(const value_type &) { return 2; }
+  static bool Parse(const uint8_t *data, size_t len, value_type *value) {
+    if (len != 2)
+      return false;
+    *value = (uint16_t)((((uint16_t)data[0]) << 8) | data[1]);
+    return true;
+  }
+  static void Write(uint8_t *dest, const value_type &value) {
+    dest[0] = (uint8_t)(value >> 8);
+    dest[1] = (uint8_t)value;
+  }
+};
+
+/** RFC 6464 的音频电平：是否有语音，以及 0 到 127 的电平（-dBov）。 */
+struct RTPAudioLevel {
+  bool voiceactivity;
+  uint8_t level;
+};
+
+struct RTPAudioLevelExtension {
+  typedef RTPAudioLevel value_type;
+
+  static RTPHeaderExtensionMap::Type GetType() {
+    return RTPHeaderExtensionMap::AudioLevel;
+  }
+  static size_t GetSize(const value_type &) { return 1; }
+  static bool Parse(const uint8_t *data, size_t len, value_type *value) {
+    if (len < 1)
+      return false;
+    value->voiceactivity = (data[0] & 0x80) != 0;
+    value->level = data[0] & 0x7f;
+    return true;
+  }
+  static void Write(uint8_t *dest, const value_type &value) {
+    dest[0] = (uint8_t)((value.voiceactivity ? 0x80 : 0) | (value.level & 0x7f));
+  }
+};
+
+/** 扩展中的字符串，不以零结尾；解码得到的字符串指向数据包的数据。 */
+struct RTPHeaderExtensionString {
+  const char *data;
+  size_t length;
+};
+
+/** RFC 8843 的媒体标识 MID。 */
+struct RTPMidExtension {
+  typedef RTPHeaderExtensionString value_type;
+
+  static RTPHeaderExtensionMap::Type GetType() {
+    return RTPHeaderExtensionMap::Mid;
+  }
+  static size_t GetSize(const value_type &value) { return value.length; }
+  static bool Parse(const uint8_t *data, size_t len, value_type *value) {
+    if (len < 1)
+      return false;
+    value->data = (const char *)data;
+    value->length = len;
+    return true;
+  }
+  static void Write(uint8_t *dest, const value_type &value) {
+    memcpy(dest, value.data, value.length);
+  }
+};
+
+template <class Ext>
+inline bool RTPHeaderExtensionMap::Find(const RTPPacketView &view,
+                                        typename Ext::value_type *value) const {
+  uint8_t id = GetID(Ext::GetType());
+  if (id == 0)
+    return false;
+
+  RTPHeaderExtensionIterator it(view);
+  return it.Find(id) && Ext::Parse(it.GetData(), it.GetLength(), value);
+}
+
+template <class Ext>
+inline bool RTPHeaderExtensionMap::Find(const RTPPacket &packet,
+                                        typename Ext::value_type *value) const {
+  uint8_t id = GetID(Ext::GetType());
+  if (id == 0)
+    return false;
+
+  RTPHeaderExtensionIterator it(packet);
+  return it.Find(id) && Ext::Parse(it.GetData(), it.GetLength(), value);
+}
+
+template <class Ext>
+inline int RTPHeaderExtensionWriter::Add(const RTPHeaderExtensionMap &map,
+                                         const typename Ext::value_type &value) {
+  uint8_t id = map.GetID(Ext::GetType());
+  if (id == 0)
+    return MEDIA_RTP_ERR_INVALID_STATE;
+
+  size_t len = Ext::GetSize(value);
+  if (len > RTP_HDREXT_TWOBYTEMAXLENGTH)
+    return MEDIA_RTP_ERR_INVALID_PARAMETER;
+
+  uint8_t *dest = Reserve(id, len);
+  if (dest == 0)
+    return MEDIA_RTP_ERR_RESOURCE_ERROR;
+  Ext::Write(dest, value);
+  return 0;
+}
+
+#endif // MEDIA_RTP_HEADER_EXTENSIONS_H
@@ -0,0 +1,237 @@
+#include "media_rtp_header_validator.h"
+#include "media_rtp_defines.h"
+#ifdef RTP_HAVE_X86_SIMD
+	#include <immintrin.h>
+#endif // RTP_HAVE_X86_SIMD
+
+// 长度只需要与头部中最多约 2^18 的值比较，截断后可以用有符号的 32 位比较
+#define RTPHEADERVALIDATOR_MAXLENGTH 0x01000000
+
+namespace
+{
+
+// 一批数据包的头部字段，每个数组一个元素对应一个数据包
+struct HeaderBatch
+{
+	alignas(32) uint32_t header[RTPHEADERVALIDATOR_BATCHSIZE]; // 前四个字节，按网络字节序组成
+	alignas(32) uint32_t length[RTPHEADERVALIDATOR_BATCHSIZE];
+	alignas(32) uint32_t last[RTPHEADERVALIDATOR_BATCHSIZE]; // 最后一个字节，即可能的填充字节数
+	alignas(32) uint32_t isrtp[RTPHEADERVALIDATOR_BATCHSIZE]; // RTP 数据包为全 1
+	alignas(32) uint32_t result[RTPHEADERVALIDATOR_BATCHSIZE];
+};
+
+void Gather(RTPRawPacket *const *packets, size_t count, HeaderBatch &batch)
+{
+	for (size_t i = 0 ; i < count ; i++)
+	{
+		const uint8_t *data = packets[i]->GetData();
+		size_t len = (data == 0)?0:packets[i]->GetDataLength();
+		uint32_t header = 0;
+
+		// 不足四个字节时缺少的字节为零，这样的数据包总是无效
+		for (size_t j = 0 ; j < 4 ; j++)
+			header = (header << 8)|((j < len)?data[j]:0);
+
+		batch.header[i] = header;
+		batch.length[i] = (uint32_t)((len > RTPHEADERVALIDATOR_MAXLENGTH)?RTPHEADERVALIDATOR_MAXLENGTH:len);
+		batch.last[i] = (len > 0)?data[len-1]:0;
+		batch.isrtp[i] = (packets[i]->IsRTP())?0xffffffff:0;
+	}
+}
+
+bool CheckScalar(uint32_t header, uint32_t length, uint32_t last, bool isrtp)
+{
+	uint32_t b0 = header >> 24;
+	uint32_t b1 = (header >> 16)&0xff;
+
+	if ((b0&0xc0) != (RTP_VERSION << 6))
+		return false;
+
+	if (isrtp)
+	{
+		// 与 RTPPacketView::Parse 相同；扩展的长度在完整解析时检查
+		uint32_t base = 12+((b0&0x0f) << 2)+((b0&0x10) >> 2);
+
+		if (b1 == RTP_RTCPTYPE_SR || b1 == RTP_RTCPTYPE_RR)
+			return false;
+		if (base > length)
+			return false;
+		if ((b0&0x20) && (last == 0 || base+last > length))
+			return false;
+		return true;
+	}
+
+	// 与 RTCPCompoundPacket::ParseData 对第一个数据包的检查相同
+	uint32_t firstlength = ((header&0xffff)+1) << 2;
+
+	if (b1 != RTP_RTCPTYPE_SR && b1 != RTP_RTCPTYPE_RR)
+		return false;
+	if (firstlength > length)
+		return false;
+	if ((b0&0x20) && firstlength != length)
+		return false;
+	return true;
+}
+
+void ValidateScalar(HeaderBatch &batch, size_t count)
+{
+	for (size_t i = 0 ; i < count ; i++)
+		batch.result[i] = (CheckScalar(batch.header[i],batch.length[i],batch.last[i],batch.isrtp[i] != 0))?0xffffffff:0;
+}
+
+#ifdef RTP_HAVE_X86_SIMD
+
+// 向量实现与 CheckScalar 的检查一一对应，每个 32 位通道处理一个数据包
+__attribute__((target("sse4.1"))) void ValidateSSE41(HeaderBatch &batch, size_t count)
+{
+	const __m128i ones = _mm_set1_epi32(-1);
+	const __m128i version = _mm_set1_epi32(RTP_VERSION << 6);
+	const __m128i sr = _mm_set1_epi32(RTP_RTCPTYPE_SR);
+	const __m128i rr = _mm_set1_epi32(RTP_RTCPTYPE_RR);
+
+	for (size_t i = 0 ; i < count ; i += 4)
+	{
+		__m128i header = _mm_load_si128((const __m128i *)(batch.header+i));
+		__m128i length = _mm_load_si128((const __m128i *)(batch.length+i));
+		__m128i last = _mm_load_si128((const __m128i *)(batch.last+i));
+		__m128i isrtp = _mm_load_si128((const __m128i *)(batch.isrtp+i));
+
+		__m128i b0 = _mm_srli_epi32(header,24);
+		__m128i b1 = _mm_and_si128(_mm_srli_epi32(header,16),_mm_set1_epi32(0xff));
+		__m128i versionok = _mm_cmpeq_epi32(_mm_and_si128(b0,_mm_set1_epi32(0xc0)),version);
+		__m128i padding = _mm_cmpeq_epi32(_mm_and_si128(b0,_mm_set1_epi32(0x20)),_mm_set1_epi32(0x20));
+		__m128i srrr = _mm_or_si128(_mm_cmpeq_epi32(b1,sr),_mm_cmpeq_epi32(b1,rr));
+
+		__m128i base = _mm_add_epi32(_mm_set1_epi32(12),
+		                             _mm_add_epi32(_mm_slli_epi32(_mm_and_si128(b0,_mm_set1_epi32(0x0f)),2),
+		                                           _mm_srli_epi32(_mm_and_si128(b0,_mm_set1_epi32(0x10)),2)));
+		__m128i baseok = _mm_xor_si128(_mm_cmpgt_epi32(base,length),ones);
+		__m128i padok = _mm_andnot_si128(_mm_or_si128(_mm_cmpeq_epi32(last,_mm_setzero_si128()),
+		                                              _mm_cmpgt_epi32(_mm_add_epi32(base,last),length)),ones);
+		__m128i rtpok = _mm_andnot_si128(srrr,_mm_and_si128(baseok,_mm_or_si128(_mm_xor_si128(padding,ones),padok)));
+
+		__m128i firstlength = _mm_slli_epi32(_mm_add_epi32(_mm_and_si128(header,_mm_set1_epi32(0xffff)),_mm_set1_epi32(1)),2);
+		__m128i firstok = _mm_xor_si128(_mm_cmpgt_epi32(firstlength,length),ones);
+		__m128i rtcppadok = _mm_or_si128(_mm_xor_si128(padding,ones),_mm_cmpeq_epi32(firstlength,length));
+		__m128i rtcpok = _mm_and_si128(srrr,_mm_and_si128(firstok,rtcppadok));
+
+		__m128i result = _mm_and_si128(versionok,_mm_blendv_epi8(rtcpok,rtpok,isrtp));
+		_mm_store_si128((__m128i *)(batch.result+i),result);
+	}
+}
+
+__attribute__((target("avx2"))) void ValidateAVX2(HeaderBatch &batch, size_t count)
+{
+	const __m256i ones = _mm256_set1_epi32(-1);
+	const __m256i version = _mm256_set1_epi32(RTP_VERSION << 6);
+	const __m256i sr = _mm256_set1_epi32(RTP_RTCPTYPE_SR);
+	const __m256i rr = _mm256_set1_epi32(RTP_RTCPTYPE_RR);
+
+	for (size_t i = 0 ; i < count ; i += 8)
+	{
+		__m256i header = _mm256_load_si256((const __m256i *)(batch.header+i));
+		__m256i length = _mm256_load_si256((const __m256i *)(batch.length+i));
+		__m256i last = _mm256_load_si256((const __m256i *)(batch.last+i));
+		__m256i isrtp = _mm256_load_si256((const __m256i *)(batch.isrtp+i));
+
+		__m256i b0 = _mm256_srli_epi32(header,24);
+		__m256i b1 = _mm256_and_si256(_mm256_srli_epi32(header,16),_mm256_set1_epi32(0xff));
+		__m256i versionok = _mm256_cmpeq_epi32(_mm256_and_si256(b0,_mm256_set1_epi32(0xc0)),version);
+		__m256i padding = _mm256_cmpeq_epi32(_mm256_and_si256(b0,_mm256_set1_epi32(0x20)),_mm256_set1_epi32(0x20));
+		__m256i srrr = _mm256_or_si256(_mm256_cmpeq_epi32(b1,sr),_mm256_cmpeq_epi32(b1,rr));
+
+		__m256i base = _mm256_add_epi32(_mm256_set1_epi32(12),
+		                                _mm256_add_epi32(_mm256_slli_epi32(_mm256_and_si256(b0,_mm256_set1_epi32(0x0f)),2),
+		                                                 _mm256_srli_epi32(_mm256_and_si256(b0,_mm256_set1_epi32(0x10)),2)));
+		__m256i baseok = _mm256_xor_si256(_mm256_cmpgt_epi32(base,length),ones);
+		__m256i padok = _mm256_andnot_si256(_mm256_or_si256(_mm256_cmpeq_epi32(last,_mm256_setzero_si256()),
+		                                                    _mm256_cmpgt_epi32(_mm256_add_epi32(base,last),length)),ones);
+		__m256i rtpok = _mm256_andnot_si256(srrr,_mm256_and_si256(baseok,_mm256_or_si256(_mm256_xor_si256(padding,ones),padok)));
+
+		__m256i firstlength = _mm256_slli_epi32(_mm256_add_epi32(_mm256_and_si256(header,_mm256_set1_epi32(0xffff)),_mm256_set1_epi32(1)),2);
+		__m256i firstok = _mm256_xor_si256(_mm256_cmpgt_epi32(firstlength,length),ones);
+		__m256i rtcppadok = _mm256_or_si256(_mm256_xor_si256(padding,ones),_mm256_cmpeq_epi32(firstlength,length));
+		__m256i rtcpok = _mm256_and_si256(srrr,_mm256_and_si256(firstok,rtcppadok));
+
+		__m256i result = _mm256_and_si256(versionok,_mm256_blendv_epi8(rtcpok,rtpok,isrtp));
+		_mm256_store_si256((__m256i *)(batch.result+i),result);
+	}
+}
+
+#endif // RTP_HAVE_X86_SIMD
+
+} // namespace
+
+bool RTPHeaderValidator::IsSupported(Implementation impl)
+{
+	switch (impl)
+	{
+	case Scalar:
+		return true;
+#ifdef RTP_HAVE_X86_SIMD
+	case SSE41:
+		return __builtin_cpu_supports("sse4.1") != 0;
+	case AVX2:
+		return __builtin_cpu_supports("avx2") != 0;
+#endif // RTP_HAVE_X86_SIMD
+	default:
+		return false;
+	}
+}
+
+RTPHeaderValidator::Implementation RTPHeaderValidator::GetBestImplementation()
+{
+	// 处理器的特性不会改变，只检查一次
+	static const Implementation best = IsSupported(AVX2)?AVX2:((IsSupported(SSE41))?SSE41:Scalar);
+	return best;
+}
+
+void RTPHeaderValidator::Validate(RTPRawPacket *const *packets,size_t count,bool *valid)
+{
+	Validate(packets,count,valid,GetBestImplementation());
+}
+
+void RTPHeaderValidator::Validate(RTPRawPacket *const *packets,size_t count,bool *valid,Implementation impl)
+{
+	HeaderBatch batch;
+
+	if (impl != Scalar && !IsSupported(impl))
+		impl = Scalar;
+
+	for (size_t pos = 0 ; pos < count ; pos += RTPHEADERVALIDATOR_BATCHSIZE)
+	{
+		size_t num = count-pos;
+		if (num > RTPHEADERVALIDATOR_BATCHSIZE)
+			num = RTPHEADERVALIDATOR_BATCHSIZE;
+
+		Gather(packets+pos,num,batch);
+
+		// 向量实现总是处理完整的寄存器，多出的通道使用一定无效的零
+		size_t padded = (num+7)&~((size_t)7);
+		for (size_t i = num ; i < padded ; i++)
+		{
+			batch.header[i] = 0;
+			batch.length[i] = 0;
+			batch.last[i] = 0;
+			batch.isrtp[i] = 0;
+		}
+
+		switch (impl)
+		{
+#ifdef RTP_HAVE_X86_SIMD
+		case AVX2:
+			ValidateAVX2(batch,padded);
+			break;
+		case SSE41:
+			ValidateSSE41(batch,padded);
+			break;
+#endif // RTP_HAVE_X86_SIMD
+		default:
+			ValidateScalar(batch,num);
+			break;
+		}
+
+		for (size_t i = 0 ; i < num ; i++)
+			valid[pos+i] = (batch.result[i] != 0);
+	}
+}
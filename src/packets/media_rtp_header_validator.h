@@ -0,0 +1,47 @@
+/**
+ * \file media_rtp_header_validator.h
+ * \brief 批量检查收到的RTP和RTCP数据包头部的 RTPHeaderValidator
+ */
+
+#ifndef MEDIA_RTP_HEADER_VALIDATOR_H
+#define MEDIA_RTP_HEADER_VALIDATOR_H
+
+#include "rtpconfig.h"
+#include "media_rtp_packet_factory.h"
+#include <cstdint>
+
+/** 向量实现一次检查的数据包数量；更多的数据包分批检查。 */
+#define RTPHEADERVALIDATOR_BATCHSIZE 16
+
+/** 在创建任何对象之前，一次检查一批原始数据包的头部。
+ *  对 RTP 数据包检查版本号、与 SR/RR 标识符相同的标记位和负载类型、CSRC 数量和
+ *  扩展头部是否在数据包内，以及填充字节数是否非零且不超过数据包；对 RTCP 数据包
+ *  检查复合包中第一个数据包的版本号、SR/RR 类型、长度字段，以及只有最后一个
+ *  数据包才能带填充。这些检查与 RTPPacketView 和 RTCPCompoundPacket 的第一步
+ *  解析相同，不会比它们更严格：被拒绝的数据包在完整解析时同样会被丢弃，通过
+ *  检查的数据包仍需完整解析。
+ *
+ *  各数据包的头部字段先收集到连续的数组中，然后在支持的处理器上用 AVX2（每次 8 个）
+ *  或 SSE4.1（每次 4 个）同时检查，其他情况使用标量实现；实现在运行时选择。
+ */
+class RTPHeaderValidator {
+public:
+  /** 检查的实现。 */
+  enum Implementation { Scalar, SSE41, AVX2 };
+
+  /** 检查 \c packets 中的 \c count 个原始数据包，数据包可能有效时把
+   *  \c valid 中对应的元素设置为 \c true。使用处理器支持的最快实现。 */
+  static void Validate(RTPRawPacket *const *packets, size_t count, bool *valid);
+
+  /** 与上一个函数相同，但使用实现 \c impl；处理器不支持时使用标量实现。 */
+  static void Validate(RTPRawPacket *const *packets, size_t count, bool *valid,
+                       Implementation impl);
+
+  /** 返回处理器支持的最快实现。 */
+  static Implementation GetBestImplementation();
+
+  /** 如果处理器支持实现 \c impl，返回 \c true。 */
+  static bool IsSupported(Implementation impl);
+};
+
+#endif // MEDIA_RTP_HEADER_VALIDATOR_H
@@ -11,6 +11,72 @@
 #include <time.h>
 #include <stdlib.h>
 
+// ===================== RTPPacketView implementation =====================
+
+RTPPacketView::RTPPacketView(const RTPPacket &pack) : m_receiveTime(pack.GetReceiveTime())
+{
+	if ((m_error = Parse(pack.GetPacketData(),pack.GetPacketLength())) == 0)
+		m_extseqnr = pack.GetExtendedSequenceNumber();
+	if (pack.GetCreationError() < 0)
+		m_error = pack.GetCreationError();
+}
+
+int RTPPacketView::Parse(const uint8_t *data,size_t len)
+{
+	size_t payloadoffset,numpadbytes;
+
+	m_packet = data;
+	m_packetLength = len;
+	m_payloadOffset = 0;
+	m_payloadLength = 0;
+	m_extseqnr = 0;
+
+	// 长度至少应为 RTP 报头的大小
+	if (data == 0 || len < sizeof(RTPHeader))
+		return MEDIA_RTP_ERR_PROTOCOL_ERROR;
+
+	// 版本号应该正确
+	if ((data[0] >> 6) != RTP_VERSION)
+		return MEDIA_RTP_ERR_PROTOCOL_ERROR;
+
+	// 标记位和有效负载类型的组合为 SR 或 RR 标识符时，这可能是 RTCP 数据包
+	if (HasMarker())
+	{
+		if (GetPayloadType() == (RTP_RTCPTYPE_SR & 127))
+			return MEDIA_RTP_ERR_PROTOCOL_ERROR;
+		if (GetPayloadType() == (RTP_RTCPTYPE_RR & 127))
+			return MEDIA_RTP_ERR_PROTOCOL_ERROR;
+	}
+
+	payloadoffset = sizeof(RTPHeader)+GetCSRCCount()*sizeof(uint32_t);
+
+	if (data[0] & 0x20) // 调整有效负载长度以考虑填充
+	{
+		numpadbytes = data[len-1]; // 最后一个字节包含填充字节数
+		if (numpadbytes == 0)
+			return MEDIA_RTP_ERR_PROTOCOL_ERROR;
+	}
+	else
+		numpadbytes = 0;
+
+	if (HasExtension()) // 有报头扩展，读取扩展长度前先确认它在数据包内
+	{
+		if (payloadoffset+sizeof(RTPExtensionHeader) > len)
+			return MEDIA_RTP_ERR_PROTOCOL_ERROR;
+		payloadoffset += sizeof(RTPExtensionHeader)+((size_t)Read16(data+payloadoffset+2))*sizeof(uint32_t);
+	}
+
+	if (payloadoffset+numpadbytes > len)
+		return MEDIA_RTP_ERR_PROTOCOL_ERROR;
+
+	m_payloadOffset = payloadoffset;
+	m_payloadLength = len-numpadbytes-payloadoffset;
+
+	// 注意：扩展序列号的高 16 位取决于源，此处只填写低 16 位
+	m_extseqnr = (uint32_t)Read16(data+2);
+	return 0;
+}
+
 // ===================== RTPPacket implementation (moved from media_rtp_packet.cpp) =====================
 
 void RTPPacket::Clear()
@@ -31,6 +97,7 @@ void RTPPacket::Clear()
 	extensionlength = 0;
 	error = 0;
 	externalbuffer = false;
+	pooledbuffer = false;
 }
 
 RTPPacket::RTPPacket(RTPRawPacket &rawpack) : receivetime(rawpack.GetReceiveTime())
@@ -39,6 +106,23 @@ RTPPacket::RTPPacket(RTPRawPacket &rawpack) : receivetime(rawpack.GetReceiveTime
 	error = ParseRawPacket(rawpack);
 }
 
+RTPPacket::RTPPacket(const RTPPacketView &view,RTPRawPacket &rawpack) : receivetime(view.GetReceiveTime())
+{
+	Clear();
+	if ((error = view.GetCreationError()) == 0)
+		error = TakeRawPacket(view,rawpack);
+}
+
+RTPPacket::RTPPacket(const RTPPacketView &view) : receivetime(view.GetReceiveTime())
+{
+	Clear();
+	if ((error = view.GetCreationError()) == 0)
+	{
+		SetFromView(view,const_cast<uint8_t *>(view.GetPacketData()));
+		externalbuffer = true;
+	}
+}
+
 RTPPacket::RTPPacket(uint8_t payloadtype,const void *payloaddata,size_t payloadlen,uint16_t seqnr,
 		  uint32_t timestamp,uint32_t ssrc,bool gotmarker,uint8_t numcsrcs,const uint32_t *csrcs,
 		  bool gotextension,uint16_t extensionid,uint16_t extensionlen_numwords,const void *extensiondata,
@@ -66,100 +150,21 @@ RTPPacket::RTPPacket(uint8_t payloadtype,const void *payloaddata,size_t payloadl
 
 int RTPPacket::ParseRawPacket(RTPRawPacket &rawpack)
 {
-	uint8_t *packetbytes;
-	size_t packetlen;
-	uint8_t payloadtype;
-	RTPHeader *rtpheader;
-	bool marker;
-	int csrccount;
-	bool hasextension;
-	int payloadoffset,payloadlength;
-	int numpadbytes;
-	RTPExtensionHeader *rtpextheader;
-	
-	if (!rawpack.IsRTP()) // 如果我们没有在 RTP 端口上收到它，我们将忽略它
-		return MEDIA_RTP_ERR_PROTOCOL_ERROR;
-	
-	// 长度至少应为 RTP 报头的大小
-	packetlen = rawpack.GetDataLength();
-	if (packetlen < sizeof(RTPHeader))
-		return MEDIA_RTP_ERR_PROTOCOL_ERROR;
-	
-	packetbytes = (uint8_t *)rawpack.GetData();
-	rtpheader = (RTPHeader *)packetbytes;
-	
-	// 版本号应该正确
-	if (rtpheader->version != RTP_VERSION)
-		return MEDIA_RTP_ERR_PROTOCOL_ERROR;
-	
-	// 我们将检查这是否可能是 RTCP 数据包。为此，
-	// 标记位和有效负载类型的组合应为 SR 或 RR
-	// 标识符
-	marker = (rtpheader->marker == 0)?false:true;
-	payloadtype = rtpheader->payloadtype;
-	if (marker)
-	{
-		if (payloadtype == (RTP_RTCPTYPE_SR & 127)) // 不检查高位（这是标记！！）
-			return MEDIA_RTP_ERR_PROTOCOL_ERROR;
-		if (payloadtype == (RTP_RTCPTYPE_RR & 127))
-			return MEDIA_RTP_ERR_PROTOCOL_ERROR;
-	}
-
-	csrccount = rtpheader->csrccount;
-	payloadoffset = sizeof(RTPHeader)+(int)(csrccount*sizeof(uint32_t));
-	
-	if (rtpheader->padding) // 调整有效负载长度以考虑填充
-	{
-		numpadbytes = (int)packetbytes[packetlen-1]; // 最后一个字节包含填充字节数
-		if (numpadbytes <= 0)
-			return MEDIA_RTP_ERR_PROTOCOL_ERROR;
-	}
-	else
-		numpadbytes = 0;
+	RTPPacketView view(rawpack);
+	int status;
 
-	hasextension = (rtpheader->extension == 0)?false:true;
-	if (hasextension) // 有报头扩展
-	{
-		rtpextheader = (RTPExtensionHeader *)(packetbytes+payloadoffset);
-		payloadoffset += sizeof(RTPExtensionHeader);
-		
-		uint16_t exthdrlen = ntohs(rtpextheader->length);
-		payloadoffset += ((int)exthdrlen)*sizeof(uint32_t);
-	}
-	else
-	{
-		rtpextheader = 0;
-	}	
-	
-	payloadlength = packetlen-numpadbytes-payloadoffset;
-	if (payloadlength < 0)
-		return MEDIA_RTP_ERR_PROTOCOL_ERROR;
-
-	// 现在，我们有了一个有效的数据包，因此我们可以创建 RTPPacket 的一个新实例并填充成员
-	
-	RTPPacket::hasextension = hasextension;
-	if (hasextension)
-	{
-		RTPPacket::extid = ntohs(rtpextheader->extid);
-		RTPPacket::extensionlength = ((int)ntohs(rtpextheader->length))*sizeof(uint32_t);
-		RTPPacket::extension = ((uint8_t *)rtpextheader)+sizeof(RTPExtensionHeader);
-	}
+	if ((status = view.GetCreationError()) < 0)
+		return status;
+	return TakeRawPacket(view,rawpack);
+}
 
-	RTPPacket::hasmarker = marker;
-	RTPPacket::numcsrcs = csrccount;
-	RTPPacket::payloadtype = payloadtype;
-	
-	// 注意：我们在此处不填写扩展序列号，因为
-	// 我们在此处没有关于源的信息。我们只填写低
-	// 16 位
-	RTPPacket::extseqnr = (uint32_t)ntohs(rtpheader->sequencenumber);
+int RTPPacket::TakeRawPacket(const RTPPacketView &view,RTPRawPacket &rawpack)
+{
+	if (view.GetPacketData() != rawpack.GetData())
+		return MEDIA_RTP_ERR_INVALID_PARAMETER;
 
-	RTPPacket::timestamp = ntohl(rtpheader->timestamp);
-	RTPPacket::ssrc = ntohl(rtpheader->ssrc);
-	RTPPacket::packet = packetbytes;
-	RTPPacket::payload = packetbytes+payloadoffset;
-	RTPPacket::packetlength = packetlen;
-	RTPPacket::payloadlength = payloadlength;
+	SetFromView(view,rawpack.GetData());
+	RTPPacket::pooledbuffer = rawpack.IsDataPooled();
 
 	// 我们将原始数据包的数据清零，因为我们现在正在使用它！
 	rawpack.ZeroData();
@@ -167,6 +172,29 @@ int RTPPacket::ParseRawPacket(RTPRawPacket &rawpack)
 	return 0;
 }
 
+void RTPPacket::SetFromView(const RTPPacketView &view,uint8_t *packetbytes)
+{
+	// 字段直接取自视图，偏移量对应 packetbytes 指向的缓冲区
+	RTPPacket::hasextension = view.HasExtension();
+	if (hasextension)
+	{
+		RTPPacket::extid = view.GetExtensionID();
+		RTPPacket::extensionlength = view.GetExtensionLength();
+		RTPPacket::extension = packetbytes+(view.GetExtensionData()-view.GetPacketData());
+	}
+
+	RTPPacket::hasmarker = view.HasMarker();
+	RTPPacket::numcsrcs = view.GetCSRCCount();
+	RTPPacket::payloadtype = view.GetPayloadType();
+	RTPPacket::extseqnr = view.GetExtendedSequenceNumber();
+	RTPPacket::timestamp = view.GetTimestamp();
+	RTPPacket::ssrc = view.GetSSRC();
+	RTPPacket::packet = packetbytes;
+	RTPPacket::payload = packetbytes+(view.GetPayloadData()-view.GetPacketData());
+	RTPPacket::packetlength = view.GetPacketLength();
+	RTPPacket::payloadlength = view.GetPayloadLength();
+}
+
 uint32_t RTPPacket::GetCSRC(int num) const
 {
 	if (num >= numcsrcs)
@@ -275,10 +303,12 @@ int RTPPacket::BuildPacket(uint8_t payloadtype,const void *payloaddata,size_t pa
 		
 		payload += sizeof(RTPExtensionHeader);
 		memcpy(payload,extensiondata,RTPPacket::extensionlength);
+		RTPPacket::extension = payload;
 		
 		payload += RTPPacket::extensionlength;
 	}
-	memcpy(payload,payloaddata,payloadlen);
+	if (payloaddata != 0) // 否则载荷由调用者另行填充或发送
+		memcpy(payload,payloaddata,payloadlen);
 	return 0;
 }
 
@@ -326,6 +356,8 @@ void RTPPacketBuilder::Destroy()
 	if (!init)
 		return;
 	delete [] buffer;
+	std::vector<uint8_t>().swap(batchbuffer);
+	batchpackets.clear();
 	init = false;
 }
 
@@ -438,7 +470,7 @@ int RTPPacketBuilder::BuildPacket(const void *data,size_t len)
 		return MEDIA_RTP_ERR_PROTOCOL_ERROR;
 	if (!deftsset)
 		return MEDIA_RTP_ERR_PROTOCOL_ERROR;
-	return PrivateBuildPacket(data,len,defaultpayloadtype,defaultmark,defaulttimestampinc,false);
+	return PrivateBuildPacket(data,len,false,defaultpayloadtype,defaultmark,defaulttimestampinc,false);
 }
 
 int RTPPacketBuilder::BuildPacket(const void *data,size_t len,
@@ -446,7 +478,7 @@ int RTPPacketBuilder::BuildPacket(const void *data,size_t len,
 {
 	if (!init)
 		return MEDIA_RTP_ERR_INVALID_STATE;
-	return PrivateBuildPacket(data,len,pt,mark,timestampinc,false);
+	return PrivateBuildPacket(data,len,false,pt,mark,timestampinc,false);
 }
 
 int RTPPacketBuilder::BuildPacketEx(const void *data,size_t len,
@@ -460,7 +492,7 @@ int RTPPacketBuilder::BuildPacketEx(const void *data,size_t len,
 		return MEDIA_RTP_ERR_PROTOCOL_ERROR;
 	if (!deftsset)
 		return MEDIA_RTP_ERR_PROTOCOL_ERROR;
-	return PrivateBuildPacket(data,len,defaultpayloadtype,defaultmark,defaulttimestampinc,true,hdrextID,hdrextdata,numhdrextwords);
+	return PrivateBuildPacket(data,len,false,defaultpayloadtype,defaultmark,defaulttimestampinc,true,hdrextID,hdrextdata,numhdrextwords);
 }
 
 int RTPPacketBuilder::BuildPacketEx(const void *data,size_t len,
@@ -469,21 +501,130 @@ int RTPPacketBuilder::BuildPacketEx(const void *data,size_t len,
 {
 	if (!init)
 		return MEDIA_RTP_ERR_INVALID_STATE;
-	return PrivateBuildPacket(data,len,pt,mark,timestampinc,true,hdrextID,hdrextdata,numhdrextwords);
+	return PrivateBuildPacket(data,len,false,pt,mark,timestampinc,true,hdrextID,hdrextdata,numhdrextwords);
+
+}
+
+int RTPPacketBuilder::BuildPacketHeader(size_t len)
+{
+	if (!init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	if (!defptset)
+		return MEDIA_RTP_ERR_PROTOCOL_ERROR;
+	if (!defmarkset)
+		return MEDIA_RTP_ERR_PROTOCOL_ERROR;
+	if (!deftsset)
+		return MEDIA_RTP_ERR_PROTOCOL_ERROR;
+	return PrivateBuildPacket(0,len,true,defaultpayloadtype,defaultmark,defaulttimestampinc,false);
+}
+
+int RTPPacketBuilder::BuildPacketHeader(size_t len,
+                uint8_t pt,bool mark,uint32_t timestampinc)
+{
+	if (!init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	return PrivateBuildPacket(0,len,true,pt,mark,timestampinc,false);
+}
+
+int RTPPacketBuilder::BuildPacketHeaderEx(size_t len,
+                  uint16_t hdrextID,const void *hdrextdata,size_t numhdrextwords)
+{
+	if (!init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	if (!defptset)
+		return MEDIA_RTP_ERR_PROTOCOL_ERROR;
+	if (!defmarkset)
+		return MEDIA_RTP_ERR_PROTOCOL_ERROR;
+	if (!deftsset)
+		return MEDIA_RTP_ERR_PROTOCOL_ERROR;
+	return PrivateBuildPacket(0,len,true,defaultpayloadtype,defaultmark,defaulttimestampinc,true,hdrextID,hdrextdata,numhdrextwords);
+}
+
+int RTPPacketBuilder::BuildPacketHeaderEx(size_t len,
+                  uint8_t pt,bool mark,uint32_t timestampinc,
+		  uint16_t hdrextID,const void *hdrextdata,size_t numhdrextwords)
+{
+	if (!init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	return PrivateBuildPacket(0,len,true,pt,mark,timestampinc,true,hdrextID,hdrextdata,numhdrextwords);
+}
+
+int RTPPacketBuilder::BuildPackets(const RTPPacketDescriptor *packets,size_t count)
+{
+	if (!init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	if (packets == 0 || count == 0)
+		return MEDIA_RTP_ERR_INVALID_PARAMETER;
 
+	// 先检查所有数据包，之后的构建不会失败，序列号和时间戳不会只前进一部分
+	size_t totallength = 0;
+
+	for (size_t i = 0 ; i < count ; i++)
+	{
+		const RTPPacketDescriptor &desc = packets[i];
+		size_t len = sizeof(RTPHeader)+sizeof(uint32_t)*((size_t)numcsrcs)+desc.len;
+
+		if (desc.payloadtype > 127 || desc.payloadtype == 72 || desc.payloadtype == 73)
+			return MEDIA_RTP_ERR_INVALID_PARAMETER;
+		if (desc.hasextension)
+		{
+			if (desc.numhdrextwords > 0xffff)
+				return MEDIA_RTP_ERR_INVALID_PARAMETER;
+			len += sizeof(RTPExtensionHeader)+sizeof(uint32_t)*desc.numhdrextwords;
+		}
+		if (len > maxpacksize)
+			return MEDIA_RTP_ERR_INVALID_PARAMETER;
+		totallength += len;
+	}
+
+	batchbuffer.resize(totallength);
+	batchpackets.resize(count);
+
+	size_t offset = 0;
+
+	for (size_t i = 0 ; i < count ; i++)
+	{
+		const RTPPacketDescriptor &desc = packets[i];
+		size_t len = 0;
+		int status = BuildIntoBuffer(&batchbuffer[offset],&len,desc.data,desc.len,false,desc.payloadtype,desc.mark,
+		                             desc.timestampinc,desc.hasextension,desc.hdrextID,desc.hdrextdata,desc.numhdrextwords);
+
+		if (status < 0)
+		{
+			batchpackets.clear();
+			return status;
+		}
+		batchpackets[i].iov_base = &batchbuffer[offset];
+		batchpackets[i].iov_len = len;
+		offset += len;
+	}
+	return 0;
 }
 
-int RTPPacketBuilder::PrivateBuildPacket(const void *data,size_t len,
+int RTPPacketBuilder::PrivateBuildPacket(const void *data,size_t len,bool headeronly,
 	                  uint8_t pt,bool mark,uint32_t timestampinc,bool gotextension,
 	                  uint16_t hdrextID,const void *hdrextdata,size_t numhdrextwords)
 {
-	RTPPacket p(pt,data,len,seqnr,timestamp,ssrc,mark,numcsrcs,csrcs,gotextension,hdrextID,
-	            (uint16_t)numhdrextwords,hdrextdata,buffer,maxpacksize);
+	return BuildIntoBuffer(buffer,&packetlength,data,len,headeronly,pt,mark,timestampinc,gotextension,
+	                       hdrextID,hdrextdata,numhdrextwords);
+}
+
+// 在 dest 处构建一个数据包并更新序列号、时间戳和统计；dest 至少有 maxpacksize 字节，
+// 或者调用者已经确认数据包能够放下
+int RTPPacketBuilder::BuildIntoBuffer(uint8_t *dest,size_t *destlength,const void *data,size_t len,
+	                  bool headeronly,uint8_t pt,bool mark,uint32_t timestampinc,bool gotextension,
+	                  uint16_t hdrextID,const void *hdrextdata,size_t numhdrextwords)
+{
+	// 只构建头部时数据为零，RTPPacket 不复制载荷，但仍按完整的长度检查最大数据包大小
+	RTPPacket p(pt,(headeronly)?0:data,len,seqnr,timestamp,ssrc,mark,numcsrcs,csrcs,gotextension,hdrextID,
+	            (uint16_t)numhdrextwords,hdrextdata,dest,maxpacksize);
 	int status = p.GetCreationError();
 
 	if (status < 0)
 		return status;
-	packetlength = p.GetPacketLength();
+	*destlength = p.GetPacketLength();
+	if (headeronly)
+		*destlength -= p.GetPayloadLength();
 
 	if (numpackets == 0) // 第一个数据包
 	{
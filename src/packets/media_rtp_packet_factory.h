@@ -1,6 +1,7 @@
 /**
  * \file media_rtp_packet_factory.h
- * \brief RTP 数据包相关类型的统一头文件：RTPRawPacket 与 RTPPacketBuilder
+ * \brief RTP 数据包相关类型的统一头文件：RTPRawPacket、RTPPacketBuilder、
+ *        RTPPacketView 与 RTPPacket
  */
 
 #ifndef MEDIA_RTP_PACKET_FACTORY_H
@@ -10,12 +11,17 @@
 #include "rtpconfig.h"
 #include "media_rtp_defines.h"
 #include "media_rtp_errors.h"
+#include "media_rtp_buffer_pool.h"
 #include "media_rtp_endpoint.h"
 #include "media_rtp_structs.h"
+#include <sys/uio.h>
 #include <cstdint>
+#include <new>
+#include <vector>
 
 class RTPSources;
 class RTPRawPacket;
+class RTPPacket;
 
 /** 此类由传输组件用于存储传入的RTP和RTCP数据。 */
 class RTPRawPacket {
@@ -27,7 +33,7 @@ public:
    *  指示此数据是RTP还是RTCP数据的标志设置为 \c rtp。
    */
   RTPRawPacket(uint8_t *data, size_t datalen, RTPEndpoint *address,
-               RTPTime &recvtime, bool rtp);
+               const RTPTime &recvtime, bool rtp);
 
   /** 创建一个实例，存储来自 \c data 的数据，长度为 \c datalen。
    *  只存储指向数据的指针，不进行实际的数据复制！数据包的源地址设置为
@@ -35,11 +41,28 @@ public:
    *  在此版本中，将根据头部信息确定数据包类型。
    */
   RTPRawPacket(uint8_t *data, size_t datalen, RTPEndpoint *address,
-               RTPTime &recvtime);
+               const RTPTime &recvtime);
+
+  /** 创建一个实例，存储来自 \c data 的数据，长度为 \c datalen。
+   *  如果 \c pooleddata 为 true，数据缓冲区来自 RTPBufferPool，析构时
+   *  归还到缓冲池而不是 delete。源地址 \c address 被复制到实例内部，
+   *  不需要单独分配。
+   */
+  RTPRawPacket(uint8_t *data, size_t datalen, bool pooleddata,
+               const RTPEndpoint &address, const RTPTime &recvtime, bool rtp);
   ~RTPRawPacket();
 
+  /** 实例本身的内存也可以来自 RTPBufferPool（缓冲区大小至少为
+   *  sizeof(RTPRawPacket)），池为空且分配失败时返回零。
+   *  无论以哪种方式创建，都可以直接 delete。 */
+  static void *operator new(size_t size, RTPBufferPool *pool) noexcept;
+  static void *operator new(size_t size);
+  static void operator delete(void *p, RTPBufferPool *pool);
+  static void operator delete(void *p);
+
   /** 返回指向此数据包中包含的数据的指针。 */
   uint8_t *GetData() { return packetdata; }
+  const uint8_t *GetData() const { return packetdata; }
 
   /** 返回此实例描述的数据包的长度。 */
   size_t GetDataLength() const { return packetdatalength; }
@@ -53,10 +76,15 @@ public:
   /** 如果此数据是RTP数据则返回 \c true，如果是RTCP数据则返回 \c false。 */
   bool IsRTP() const { return isrtp; }
 
+  /** 如果数据缓冲区来自 RTPBufferPool 则返回 \c true，
+   *  接管数据的对象需要用 RTPBufferPool::Release 释放它。 */
+  bool IsDataPooled() const { return pooleddata; }
+
   /** 将存储在此数据包中的数据的指针设置为零，以避免析构时 delete。 */
   void ZeroData() {
     packetdata = 0;
     packetdatalength = 0;
+    pooleddata = false;
   }
 
   /** 为RTP或RTCP数据分配一定数量的字节。 */
@@ -73,26 +101,30 @@ private:
 
   uint8_t *packetdata;
   size_t packetdatalength;
+  bool pooleddata;
   RTPTime receivetime;
   RTPEndpoint *senderaddress;
+  RTPEndpoint senderaddressstorage; // 使用内嵌源地址时 senderaddress 指向这里
   bool isrtp;
 };
 
 inline RTPRawPacket::RTPRawPacket(uint8_t *data, size_t datalen,
-                                  RTPEndpoint *address, RTPTime &recvtime,
+                                  RTPEndpoint *address, const RTPTime &recvtime,
                                   bool rtp)
     : receivetime(recvtime) {
   packetdata = data;
   packetdatalength = datalen;
+  pooleddata = false;
   senderaddress = address;
   isrtp = rtp;
 }
 
 inline RTPRawPacket::RTPRawPacket(uint8_t *data, size_t datalen,
-                                  RTPEndpoint *address, RTPTime &recvtime)
+                                  RTPEndpoint *address, const RTPTime &recvtime)
     : receivetime(recvtime) {
   packetdata = data;
   packetdatalength = datalen;
+  pooleddata = false;
   senderaddress = address;
 
   isrtp = true;
@@ -105,15 +137,50 @@ inline RTPRawPacket::RTPRawPacket(uint8_t *data, size_t datalen,
   }
 }
 
+inline RTPRawPacket::RTPRawPacket(uint8_t *data, size_t datalen,
+                                  bool pooled, const RTPEndpoint &address,
+                                  const RTPTime &recvtime, bool rtp)
+    : receivetime(recvtime), senderaddressstorage(address) {
+  packetdata = data;
+  packetdatalength = datalen;
+  pooleddata = pooled;
+  senderaddress = &senderaddressstorage;
+  isrtp = rtp;
+}
+
 inline RTPRawPacket::~RTPRawPacket() { DeleteData(); }
 
+inline void *RTPRawPacket::operator new(size_t size,
+                                        RTPBufferPool *pool) noexcept {
+  if (size > pool->GetBufferSize())
+    return 0;
+  return pool->Allocate();
+}
+
+inline void *RTPRawPacket::operator new(size_t size) {
+  return RTPBufferPool::AllocateUnpooled(size);
+}
+
+inline void RTPRawPacket::operator delete(void *p, RTPBufferPool *) {
+  RTPBufferPool::Release(p);
+}
+
+inline void RTPRawPacket::operator delete(void *p) {
+  RTPBufferPool::Release(p);
+}
+
 inline void RTPRawPacket::DeleteData() {
-  if (packetdata)
-    delete[] packetdata;
-  if (senderaddress)
+  if (packetdata) {
+    if (pooleddata)
+      RTPBufferPool::Release(packetdata);
+    else
+      delete[] packetdata;
+  }
+  if (senderaddress && senderaddress != &senderaddressstorage)
     delete senderaddress;
 
   packetdata = 0;
+  pooleddata = false;
   senderaddress = 0;
 }
 
@@ -123,20 +190,60 @@ inline uint8_t *RTPRawPacket::AllocateBytes(bool isrtp, int recvlen) const {
 }
 
 inline void RTPRawPacket::SetData(uint8_t *data, size_t datalen) {
-  if (packetdata)
-    delete[] packetdata;
+  if (packetdata) {
+    if (pooleddata)
+      RTPBufferPool::Release(packetdata);
+    else
+      delete[] packetdata;
+  }
 
   packetdata = data;
   packetdatalength = datalen;
+  pooleddata = false;
 }
 
 inline void RTPRawPacket::SetSenderAddress(RTPEndpoint *address) {
-  if (senderaddress)
+  if (senderaddress && senderaddress != &senderaddressstorage)
     delete senderaddress;
 
   senderaddress = address;
 }
 
+/** 批量构建和发送的一个RTP数据包的描述（见 RTPPacketBuilder::BuildPackets 和
+ *  RTPSession::SendPackets）：长度为 \c len 的载荷 \c data、有效载荷类型、标记，
+ *  以及构建该数据包之后时间戳的增量。SetExtension 为数据包加上头部扩展。
+ */
+struct RTPPacketDescriptor {
+  RTPPacketDescriptor()
+      : data(0), len(0), payloadtype(0), mark(false), timestampinc(0),
+        hasextension(false), hdrextID(0), hdrextdata(0), numhdrextwords(0) {}
+
+  RTPPacketDescriptor(const void *d, size_t l, uint8_t pt, bool m,
+                      uint32_t tsinc)
+      : data(d), len(l), payloadtype(pt), mark(m), timestampinc(tsinc),
+        hasextension(false), hdrextID(0), hdrextdata(0), numhdrextwords(0) {}
+
+  /** 数据包包含标识符为\c id、数据为\c extdata的头部扩展，其长度\c numwords
+   *  以32位字的数量指定。 */
+  void SetExtension(uint16_t id, const void *extdata, size_t numwords) {
+    hasextension = true;
+    hdrextID = id;
+    hdrextdata = extdata;
+    numhdrextwords = numwords;
+  }
+
+  const void *data;
+  size_t len;
+  uint8_t payloadtype;
+  bool mark;
+  uint32_t timestampinc;
+
+  bool hasextension;
+  uint16_t hdrextID;
+  const void *hdrextdata;
+  size_t numhdrextwords;
+};
+
 /** 此类可用于构建RTP数据包，比RTPPacket类更高级：
  *  它生成SSRC标识符，跟踪时间戳和序列号等。
  */
@@ -195,6 +302,48 @@ public:
                     uint32_t timestampinc, uint16_t hdrextID,
                     const void *hdrextdata, size_t numhdrextwords);
 
+  /** 使用默认参数只构建长度为 \c len 的载荷前面的RTP头部。
+   *  载荷不会复制到构建器的缓冲区，调用者把它和头部一起发送（见
+   *  RTPTransmitter::SendRTPDataV），因此载荷可以留在应用程序的缓冲区中；
+   *  之后 GetPacketLength 返回头部的长度。序列号、时间戳和统计的更新与
+   *  BuildPacket 相同，头部和载荷的总长度同样不能超过最大数据包大小。 */
+  int BuildPacketHeader(size_t len);
+
+  /** 使用提供的 pt/mark/timestampinc 只构建RTP头部。 */
+  int BuildPacketHeader(size_t len, uint8_t pt, bool mark,
+                        uint32_t timestampinc);
+
+  /** 使用默认参数 + 扩展 只构建RTP头部。 */
+  int BuildPacketHeaderEx(size_t len, uint16_t hdrextID,
+                          const void *hdrextdata, size_t numhdrextwords);
+
+  /** 使用提供参数 + 扩展 只构建RTP头部。 */
+  int BuildPacketHeaderEx(size_t len, uint8_t pt, bool mark,
+                          uint32_t timestampinc, uint16_t hdrextID,
+                          const void *hdrextdata, size_t numhdrextwords);
+
+  /** 依次构建 \c packets 描述的 \c count 个数据包，例如一个视频帧的所有分片。
+   *  数据包使用连续的序列号，每个数据包构建之后时间戳增加其 timestampinc，
+   *  因此通常只有帧的最后一个数据包带有非零的增量。数据包连续存放在构建器的
+   *  批量缓冲区中，之后通过 GetPackets 获得，可以直接交给
+   *  RTPTransmitter::SendRTPDataBatch。构建之前检查所有数据包，任何一个无效时
+   *  不构建任何数据包，序列号和时间戳也不改变。 */
+  int BuildPackets(const RTPPacketDescriptor *packets, size_t count);
+
+  /** 返回最后一次 BuildPackets 构建的数据包，每个 iovec 是一个完整的数据包。 */
+  const struct iovec *GetPackets() const {
+    if (!init || batchpackets.empty())
+      return 0;
+    return &batchpackets[0];
+  }
+
+  /** 返回最后一次 BuildPackets 构建的数据包数量。 */
+  size_t GetNumPackets() const {
+    if (!init)
+      return 0;
+    return batchpackets.size();
+  }
+
   /** 返回指向最后构建的RTP数据包数据的指针。 */
   uint8_t *GetPacket() {
     if (!init)
@@ -269,15 +418,23 @@ public:
   void AdjustSSRC(uint32_t s) { ssrc = s; }
 
 private:
-  int PrivateBuildPacket(const void *data, size_t len, uint8_t pt, bool mark,
-                         uint32_t timestampinc, bool gotextension,
-                         uint16_t hdrextID = 0, const void *hdrextdata = 0,
-                         size_t numhdrextwords = 0);
+  int PrivateBuildPacket(const void *data, size_t len, bool headeronly,
+                         uint8_t pt, bool mark, uint32_t timestampinc,
+                         bool gotextension, uint16_t hdrextID = 0,
+                         const void *hdrextdata = 0, size_t numhdrextwords = 0);
+  int BuildIntoBuffer(uint8_t *dest, size_t *destlength, const void *data,
+                      size_t len, bool headeronly, uint8_t pt, bool mark,
+                      uint32_t timestampinc, bool gotextension,
+                      uint16_t hdrextID, const void *hdrextdata,
+                      size_t numhdrextwords);
 
   size_t maxpacksize;
   uint8_t *buffer;
   size_t packetlength;
 
+  std::vector<uint8_t> batchbuffer;
+  std::vector<struct iovec> batchpackets;
+
   uint32_t numpayloadbytes;
   uint32_t numpackets;
   bool init;
@@ -340,6 +497,131 @@ inline int RTPPacketBuilder::IncrementTimestampDefault() {
   return 0;
 }
 
+/** RTP数据包的非拥有视图。
+ *  该类直接在接收缓冲区上校验RTP数据包，并在需要时才从缓冲区中读取头部字段，
+ *  CSRC和头部扩展也只在访问时定位，因此创建视图不分配内存，也不复制数据。
+ *  校验规则与 RTPPacket(RTPRawPacket &) 相同。视图不拥有缓冲区，
+ *  只在缓冲区有效期间可以使用；需要保留数据包时，用
+ *  RTPPacket(const RTPPacketView &, RTPRawPacket &) 接管原始数据包的缓冲区。
+ *  除 GetCreationError 外，其他函数只能在视图有效时调用。
+ */
+class RTPPacketView {
+public:
+  /** 在 \c rawpack 的数据上创建视图，原始数据包不会被修改。 */
+  explicit RTPPacketView(const RTPRawPacket &rawpack);
+
+  /** 在已创建的RTPPacket实例的数据上创建视图，扩展序列号取自该实例。 */
+  explicit RTPPacketView(const RTPPacket &pack);
+
+  /** 在长度为 \c len 的缓冲区 \c data 上创建视图，接收时间为 \c receivetime。 */
+  RTPPacketView(const uint8_t *data, size_t len, const RTPTime &receivetime);
+
+  /** 如果缓冲区中不是有效的RTP数据包，此函数返回错误代码。 */
+  int GetCreationError() const { return m_error; }
+
+  /** 如果RTP数据包有头部扩展则返回\c true，否则返回\c false。 */
+  bool HasExtension() const { return (m_packet[0] & 0x10) != 0; }
+
+  /** 如果设置了标记位则返回\c true，否则返回\c false。 */
+  bool HasMarker() const { return (m_packet[1] & 0x80) != 0; }
+
+  /** 返回此数据包中包含的CSRC数量。 */
+  int GetCSRCCount() const { return m_packet[0] & 0x0f; }
+
+  /** 从缓冲区中读取第 \c num 个CSRC标识符，\c num 超出范围时返回零。 */
+  uint32_t GetCSRC(int num) const {
+    if (num < 0 || num >= GetCSRCCount())
+      return 0;
+    return Read32(m_packet + sizeof(RTPHeader) + num * sizeof(uint32_t));
+  }
+
+  /** 返回数据包的有效载荷类型。 */
+  uint8_t GetPayloadType() const { return m_packet[1] & 0x7f; }
+
+  /** 返回数据包的扩展序列号，创建视图时只有低16位被设置。 */
+  uint32_t GetExtendedSequenceNumber() const { return m_extseqnr; }
+
+  /** 返回此数据包的序列号。 */
+  uint16_t GetSequenceNumber() const {
+    return (uint16_t)(m_extseqnr & 0x0000FFFF);
+  }
+
+  /** 设置扩展序列号为 \c seq；只改变视图，不改变缓冲区中的数据。 */
+  void SetExtendedSequenceNumber(uint32_t seq) { m_extseqnr = seq; }
+
+  /** 返回此数据包的时间戳。 */
+  uint32_t GetTimestamp() const { return Read32(m_packet + 4); }
+
+  /** 返回存储在此数据包中的SSRC标识符。 */
+  uint32_t GetSSRC() const { return Read32(m_packet + 8); }
+
+  /** 返回指向整个数据包数据的指针。 */
+  const uint8_t *GetPacketData() const { return m_packet; }
+
+  /** 返回指向实际有效载荷数据的指针。 */
+  const uint8_t *GetPayloadData() const { return m_packet + m_payloadOffset; }
+
+  /** 返回整个数据包的长度。 */
+  size_t GetPacketLength() const { return m_packetLength; }
+
+  /** 返回有效载荷长度。 */
+  size_t GetPayloadLength() const { return m_payloadLength; }
+
+  /** 如果存在头部扩展，此函数返回扩展标识符，否则返回零。 */
+  uint16_t GetExtensionID() const {
+    return HasExtension() ? Read16(GetExtensionHeader()) : 0;
+  }
+
+  /** 如果存在头部扩展，返回指向头部扩展数据的指针，否则返回零。 */
+  const uint8_t *GetExtensionData() const {
+    return HasExtension() ? GetExtensionHeader() + sizeof(RTPExtensionHeader)
+                          : 0;
+  }
+
+  /** 返回头部扩展数据的长度。 */
+  size_t GetExtensionLength() const {
+    return HasExtension()
+               ? ((size_t)Read16(GetExtensionHeader() + 2)) * sizeof(uint32_t)
+               : 0;
+  }
+
+  /** 返回接收此数据包的时间。 */
+  RTPTime GetReceiveTime() const { return m_receiveTime; }
+
+private:
+  int Parse(const uint8_t *data, size_t len);
+  const uint8_t *GetExtensionHeader() const {
+    return m_packet + sizeof(RTPHeader) + GetCSRCCount() * sizeof(uint32_t);
+  }
+  static uint16_t Read16(const uint8_t *p) {
+    return (uint16_t)((((uint16_t)p[0]) << 8) | ((uint16_t)p[1]));
+  }
+  static uint32_t Read32(const uint8_t *p) {
+    return (((uint32_t)p[0]) << 24) | (((uint32_t)p[1]) << 16) |
+           (((uint32_t)p[2]) << 8) | ((uint32_t)p[3]);
+  }
+
+  int m_error;
+  const uint8_t *m_packet;
+  size_t m_packetLength;
+  size_t m_payloadOffset, m_payloadLength;
+  uint32_t m_extseqnr;
+  RTPTime m_receiveTime;
+};
+
+inline RTPPacketView::RTPPacketView(const RTPRawPacket &rawpack)
+    : m_receiveTime(rawpack.GetReceiveTime()) {
+  m_error = Parse(rawpack.GetData(), rawpack.GetDataLength());
+  if (!rawpack.IsRTP()) // 如果我们没有在 RTP 端口上收到它，我们将忽略它
+    m_error = MEDIA_RTP_ERR_PROTOCOL_ERROR;
+}
+
+inline RTPPacketView::RTPPacketView(const uint8_t *data, size_t len,
+                                    const RTPTime &receivetime)
+    : m_receiveTime(receivetime) {
+  m_error = Parse(data, len);
+}
+
 /** 表示一个RTP数据包。
  *  RTPPacket类可用于解析RTPRawPacket实例（如果它表示RTP数据）。
  *  该类还可用于根据用户指定的参数创建新的RTP数据包。
@@ -353,6 +635,17 @@ public:
    */
   RTPPacket(RTPRawPacket &rawpack);
 
+  /** 基于已在 \c rawpack 的数据上创建的视图 \c view 创建RTPPacket实例，
+   *  不再重新解析，扩展序列号取自视图。如果视图有效，数据将从原始数据包
+   *  移动到RTPPacket实例；视图不是在 \c rawpack 上创建的会产生错误。
+   */
+  RTPPacket(const RTPPacketView &view, RTPRawPacket &rawpack);
+
+  /** 创建不拥有数据的实例，直接使用视图 \c view 所在的缓冲区，不分配内存也不复制数据。
+   *  实例只能在该缓冲区有效期间使用，析构时不释放数据。
+   */
+  explicit RTPPacket(const RTPPacketView &view);
+
   /** 为RTP数据包创建新缓冲区，并根据指定参数填充字段。
    *  为RTP数据包创建新缓冲区，并根据指定参数填充字段。
    *  如果\c maxpacksize不等于零，当总数据包大小超过\c maxpacksize时会产生错误。
@@ -374,8 +667,12 @@ public:
             const void *extensiondata, void *buffer, size_t buffersize);
 
   virtual ~RTPPacket() {
-    if (packet && !externalbuffer)
-      delete[] packet;
+    if (packet && !externalbuffer) {
+      if (pooledbuffer)
+        RTPBufferPool::Release(packet);
+      else
+        delete[] packet;
+    }
   }
 
   /** 如果构造函数之一发生错误，此函数返回错误代码。 */
@@ -448,6 +745,8 @@ public:
 private:
   void Clear();
   int ParseRawPacket(RTPRawPacket &rawpack);
+  int TakeRawPacket(const RTPPacketView &view, RTPRawPacket &rawpack);
+  void SetFromView(const RTPPacketView &view, uint8_t *packetbytes);
   int BuildPacket(uint8_t payloadtype, const void *payloaddata,
                   size_t payloadlen, uint16_t seqnr, uint32_t timestamp,
                   uint32_t ssrc, bool gotmarker, uint8_t numcsrcs,
@@ -470,6 +769,7 @@ private:
   size_t extensionlength;
 
   bool externalbuffer;
+  bool pooledbuffer; // 数据来自 RTPBufferPool，析构时归还
 
   RTPTime receivetime;
 };
@@ -0,0 +1,1498 @@
+#include "media_rtp_iouring_transmitter.h"
+
+#ifdef RTP_HAVE_IO_URING
+
+#include "media_rtp_packet_factory.h"
+#include "media_rtp_utils.h"
+#include "media_rtp_defines.h"
+#include "media_rtp_structs.h"
+#include "media_rtp_errors.h"
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <ifaddrs.h>
+#include <stdio.h>
+#include <errno.h>
+#include <assert.h>
+
+#define RTPIOURINGTRANS_MAXPACKSIZE							65535
+#define RTPIOURINGTRANS_MAXRECVBUFFERCOUNT						32768
+#define RTPIOURINGTRANS_BUFFERGROUP							0
+#define RTPIOURINGTRANS_CANCELATTEMPTS							100
+#define RTPIOURINGTRANS_POOLIDLEBYTES							(1024*1024)
+#define RTPIOURINGTRANS_POOLMINIDLE							64
+#define RTPIOURINGTRANS_RAWPACKETPOOLIDLE						1024
+
+// user_data 的最高字节标识请求类型，发送请求的低位保存目标的索引
+#define RTPIOURINGTRANS_TAG_RTPRECV							((uint64_t)1)
+#define RTPIOURINGTRANS_TAG_RTCPRECV							((uint64_t)2)
+#define RTPIOURINGTRANS_TAG_SEND							((uint64_t)3)
+#define RTPIOURINGTRANS_TAG_CANCEL							((uint64_t)4)
+#define RTPIOURINGTRANS_USERDATA(tag,index)						(((tag)<<56)|((uint64_t)(index)))
+#define RTPIOURINGTRANS_USERDATA_TAG(x)							((x)>>56)
+#define RTPIOURINGTRANS_USERDATA_INDEX(x)						((size_t)((x)&0x00FFFFFFFFFFFFFFULL))
+
+	#define MAINMUTEX_LOCK 		{ if (threadsafe) mainmutex.lock(); }
+	#define MAINMUTEX_UNLOCK	{ if (threadsafe) mainmutex.unlock(); }
+	#define WAITMUTEX_LOCK		{ if (threadsafe) waitmutex.lock(); }
+	#define WAITMUTEX_UNLOCK	{ if (threadsafe) waitmutex.unlock(); }
+
+#define CLOSESOCKETS do { \
+	if (rtpsock != rtcpsock) \
+		RTPCLOSE(rtcpsock); \
+	RTPCLOSE(rtpsock); \
+} while(0)
+
+// 定义于 media_rtp_udpv4_transmitter.cpp
+int GetAutoSockets(uint32_t bindIP, bool allowOdd, bool rtcpMux,
+                   int *pRtpSock, int *pRtcpSock,
+                   uint16_t *pRtpPort, uint16_t *pRtcpPort);
+
+// 系统头文件只提供 io_uring 的结构定义，系统调用本身需要自行封装
+
+static int IOUringSetup(unsigned int entries, struct io_uring_params *p)
+{
+	return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int IOUringEnter(int fd, unsigned int tosubmit, unsigned int mincomplete, unsigned int flags)
+{
+	return (int)syscall(__NR_io_uring_enter, fd, tosubmit, mincomplete, flags, (void *)0, (size_t)0);
+}
+
+static int IOUringRegister(int fd, unsigned int opcode, void *arg, unsigned int nrargs)
+{
+	return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nrargs);
+}
+
+RTPIOUringTransmitter::RTPIOUringTransmitter() : RTPTransmitter()
+{
+	created = false;
+	init = false;
+}
+
+RTPIOUringTransmitter::~RTPIOUringTransmitter()
+{
+	Destroy();
+}
+
+int RTPIOUringTransmitter::Init(bool tsafe)
+{
+	if (init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	threadsafe = tsafe;
+
+	init = true;
+	return 0;
+}
+
+int RTPIOUringTransmitter::Create(size_t maximumpacketsize,const RTPTransmissionParams *transparams)
+{
+	const RTPIOUringTransmissionParams *params,defaultparams;
+	int status;
+
+	if (!init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	MAINMUTEX_LOCK
+
+	if (created)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	}
+
+	// 获取传输参数
+
+	if (transparams == 0)
+		params = &defaultparams;
+	else
+	{
+		if (transparams->GetTransmissionProtocol() != RTPTransmitter::IOUringUDPProto)
+		{
+			MAINMUTEX_UNLOCK
+			return MEDIA_RTP_ERR_INVALID_PARAMETER;
+		}
+		params = (const RTPIOUringTransmissionParams *)transparams;
+	}
+
+	// 存储空间保留到下一次 Create 或析构，Destroy 之后无锁的 GetNextPacket 仍可安全调用
+	if ((status = rawpacketqueue.Init(params->GetReceiveQueueMaximumPackets(),params->GetReceiveQueueMaximumBytes())) < 0)
+	{
+		MAINMUTEX_UNLOCK
+		return status;
+	}
+
+	if (maximumpacketsize > RTPIOURINGTRANS_MAXPACKSIZE)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_RESOURCE_ERROR;
+	}
+
+	if ((status = CreateSockets(params)) < 0)
+	{
+		MAINMUTEX_UNLOCK
+		return status;
+	}
+
+	// 尝试获取本地 IP 地址
+
+	localIPs = params->GetLocalIPList();
+	if (localIPs.empty()) // 用户未提供本地 IP 地址列表，计算它们
+	{
+		if ((status = CreateLocalIPList()) < 0)
+		{
+			CLOSESOCKETS;
+			MAINMUTEX_UNLOCK
+			return status;
+		}
+	}
+
+	if ((status = SetupRing(params)) < 0)
+	{
+		CLOSESOCKETS;
+		MAINMUTEX_UNLOCK
+		return status;
+	}
+
+	if (!params->GetCreatedAbortDescriptors())
+	{
+		if ((status = m_abortDesc.Init()) < 0)
+		{
+			DestroyRing();
+			CLOSESOCKETS;
+			MAINMUTEX_UNLOCK
+			return status;
+		}
+		m_pAbortDesc = &m_abortDesc;
+	}
+	else
+	{
+		m_pAbortDesc = params->GetCreatedAbortDescriptors();
+		if (!m_pAbortDesc->IsInitialized())
+		{
+			DestroyRing();
+			CLOSESOCKETS;
+			MAINMUTEX_UNLOCK
+			return MEDIA_RTP_ERR_INVALID_STATE;
+		}
+	}
+
+	// 完成队列有事件时 io_uring 描述符变为可读，因此只需监视它和中止描述符
+	if ((status = m_socketWaiter.Init()) >= 0)
+	{
+		if ((status = m_socketWaiter.AddSocket(ringfd)) >= 0)
+			status = m_socketWaiter.AddSocket(m_pAbortDesc->GetAbortSocket());
+	}
+	if (status < 0)
+	{
+		m_socketWaiter.Destroy();
+		m_abortDesc.Destroy(); // 如果未初始化，则不执行任何操作
+		DestroyRing();
+		CLOSESOCKETS;
+		MAINMUTEX_UNLOCK
+		return status;
+	}
+
+	maxpacksize = maximumpacketsize;
+	receivemode = RTPTransmitter::AcceptAll;
+	localhostname.clear();
+	sendsoutstanding = 0;
+
+	// 立即提交接收请求，数据包到达时内核就会把它们放入缓冲区环
+	multishot = true;
+	rtpreceivearmed = false;
+	rtcpreceivearmed = false;
+	ArmReceive(true);
+	if (rtpsock != rtcpsock)
+		ArmReceive(false);
+	SubmitAndWait(0);
+
+	waitingfordata = false;
+	created = true;
+	MAINMUTEX_UNLOCK
+	return 0;
+}
+
+void RTPIOUringTransmitter::Destroy()
+{
+	if (!init)
+		return;
+
+	MAINMUTEX_LOCK
+	if (!created)
+	{
+		MAINMUTEX_UNLOCK;
+		return;
+	}
+
+	DestroyRing();
+	CLOSESOCKETS;
+	localhostname.clear();
+	destinations.clear();
+	RebuildDestinationList();
+	FlushPackets();
+	acceptignoreset.clear();
+	localIPs.clear();
+	std::vector<struct msghdr>().swap(sendmsgs);
+	created = false;
+
+	if (waitingfordata)
+	{
+		m_pAbortDesc->SendAbortSignal();
+		MAINMUTEX_UNLOCK
+		WAITMUTEX_LOCK // 确保 WaitForIncomingData 函数已结束
+		WAITMUTEX_UNLOCK
+		MAINMUTEX_LOCK
+	}
+	// 等待结束后才能关闭中止描述符，关闭的描述符会从 epoll 集合中移除而不再唤醒等待
+	m_socketWaiter.Destroy();
+	m_abortDesc.Destroy(); // 如果未初始化，则不执行任何操作
+
+	MAINMUTEX_UNLOCK
+}
+
+RTPTransmissionInfo *RTPIOUringTransmitter::GetTransmissionInfo()
+{
+	if (!init)
+		return 0;
+
+	MAINMUTEX_LOCK
+	RTPTransmissionInfo *tinf = new RTPIOUringTransmissionInfo(localIPs,ringfd,rtpsock,rtcpsock,m_rtpPort,m_rtcpPort);
+	MAINMUTEX_UNLOCK
+	return tinf;
+}
+
+void RTPIOUringTransmitter::DeleteTransmissionInfo(RTPTransmissionInfo *i)
+{
+	if (!init)
+		return;
+
+	delete i;
+}
+
+int RTPIOUringTransmitter::GetLocalHostName(uint8_t *buffer,size_t *bufferlength)
+{
+	if (!init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	MAINMUTEX_LOCK
+	if (!created)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	}
+
+	if (localhostname.empty())
+	{
+		char name[1024];
+
+		// 优先使用主机名，获取失败时使用第一个本地 IP 地址
+		if (gethostname(name,1023) != 0 || name[0] == 0)
+		{
+			if (localIPs.empty())
+			{
+				MAINMUTEX_UNLOCK
+				return MEDIA_RTP_ERR_OPERATION_FAILED;
+			}
+
+			uint32_t ip = localIPs.front();
+			snprintf(name,1024,"%d.%d.%d.%d",(int)((ip>>24)&0xFF),(int)((ip>>16)&0xFF),(int)((ip>>8)&0xFF),(int)(ip&0xFF));
+		}
+		name[1023] = 0;
+		localhostname.assign((const uint8_t *)name,(const uint8_t *)name+strlen(name));
+	}
+
+	if ((*bufferlength) < localhostname.size())
+	{
+		*bufferlength = localhostname.size(); // 告诉应用程序所需的缓冲区大小
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_RESOURCE_ERROR;
+	}
+
+	memcpy(buffer,&localhostname[0],localhostname.size());
+	*bufferlength = localhostname.size();
+
+	MAINMUTEX_UNLOCK
+	return 0;
+}
+
+bool RTPIOUringTransmitter::ComesFromThisTransmitter(const RTPEndpoint *addr)
+{
+	if (!init)
+		return false;
+
+	if (addr == 0)
+		return false;
+
+	MAINMUTEX_LOCK
+
+	bool v = false;
+
+	if (created && addr->GetType() == RTPEndpoint::IPv4)
+	{
+		std::list<uint32_t>::const_iterator it;
+
+		for (it = localIPs.begin() ; !v && it != localIPs.end() ; ++it)
+		{
+			if (addr->GetIPv4() == *it)
+				v = (addr->GetRtpPort() == m_rtpPort || addr->GetRtpPort() == m_rtcpPort); // 检查 RTP 端口和 RTCP 端口
+		}
+	}
+
+	MAINMUTEX_UNLOCK
+	return v;
+}
+
+int RTPIOUringTransmitter::Poll()
+{
+	if (!init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	int status;
+
+	MAINMUTEX_LOCK
+	if (!created)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	}
+
+	// 先收取已完成的请求，再重新提交已终止的接收请求，然后不等待地进入内核。
+	// 多次触发模式下请求一直有效，一次即可；单次模式下每个请求只接收一个数据包，
+	// 因此重复进行直到接收请求在内核中挂起，即套接字中已没有数据
+	status = ProcessCompletions(0);
+	for (unsigned int i = 0 ; status >= 0 && i < recvbuffercount ; i++)
+	{
+		bool rearm = !rtpreceivearmed || (rtpsock != rtcpsock && !rtcpreceivearmed);
+
+		ArmReceive(true);
+		if (rtpsock != rtcpsock) // 多路复用时只有一个接收请求
+			ArmReceive(false);
+		status = SubmitAndWait(0);
+		if (status >= 0)
+			status = ProcessCompletions(0);
+		if (!rearm)
+			break;
+	}
+	MAINMUTEX_UNLOCK
+	return status;
+}
+
+int RTPIOUringTransmitter::WaitForIncomingData(const RTPTime &delay,bool *dataavailable)
+{
+	if (!init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	MAINMUTEX_LOCK
+
+	if (!created)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	}
+	if (waitingfordata)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	}
+
+	// 确保接收请求处于活动状态，完成队列中有事件时 io_uring 描述符即变为可读
+	ArmReceive(true);
+	if (rtpsock != rtcpsock)
+		ArmReceive(false);
+	SubmitAndWait(0);
+
+	int abortSocket = m_pAbortDesc->GetAbortSocket();
+	int readysocks[2];
+
+	waitingfordata = true;
+
+	WAITMUTEX_LOCK
+	MAINMUTEX_UNLOCK
+
+	int status = m_socketWaiter.Wait(delay, readysocks, 2);
+	if (status < 0)
+	{
+		MAINMUTEX_LOCK
+		waitingfordata = false;
+		MAINMUTEX_UNLOCK
+		WAITMUTEX_UNLOCK
+		return status;
+	}
+
+	MAINMUTEX_LOCK
+	waitingfordata = false;
+	if (!created) // 调用销毁
+	{
+		MAINMUTEX_UNLOCK;
+		WAITMUTEX_UNLOCK
+		return 0;
+	}
+
+	bool avail = false;
+
+	for (int i = 0 ; i < status ; i++)
+	{
+		// 如果中止，则从中止缓冲区读取
+		if (readysocks[i] == abortSocket)
+			m_pAbortDesc->ReadSignallingByte();
+		else
+			avail = true;
+	}
+
+	if (dataavailable != 0)
+		*dataavailable = avail;
+
+	MAINMUTEX_UNLOCK
+	WAITMUTEX_UNLOCK
+	return 0;
+}
+
+int RTPIOUringTransmitter::AbortWait()
+{
+	if (!init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	MAINMUTEX_LOCK
+	if (!created)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	}
+	if (!waitingfordata)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	}
+
+	m_pAbortDesc->SendAbortSignal();
+
+	MAINMUTEX_UNLOCK
+	return 0;
+}
+
+int RTPIOUringTransmitter::SendRTPData(const void *data,size_t len)
+{
+	if (!init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	MAINMUTEX_LOCK
+
+	if (!created)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	}
+	if (len > maxpacksize)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_RESOURCE_ERROR;
+	}
+
+	struct iovec packet;
+	std::vector<std::pair<RTPEndpoint,int> > senderrors;
+
+	packet.iov_base = const_cast<void *>(data);
+	packet.iov_len = len;
+	int status = SendToDestinations(true,&packet,1,senderrors);
+
+	MAINMUTEX_UNLOCK
+
+	for (size_t i = 0 ; i < senderrors.size() ; i++)
+		OnSendError(senderrors[i].first,true,senderrors[i].second);
+	return status;
+}
+
+int RTPIOUringTransmitter::SendRTCPData(const void *data,size_t len)
+{
+	if (!init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	MAINMUTEX_LOCK
+
+	if (!created)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	}
+	if (len > maxpacksize)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_RESOURCE_ERROR;
+	}
+
+	struct iovec packet;
+	std::vector<std::pair<RTPEndpoint,int> > senderrors;
+
+	packet.iov_base = const_cast<void *>(data);
+	packet.iov_len = len;
+	int status = SendToDestinations(false,&packet,1,senderrors);
+
+	MAINMUTEX_UNLOCK
+
+	for (size_t i = 0 ; i < senderrors.size() ; i++)
+		OnSendError(senderrors[i].first,false,senderrors[i].second);
+	return status;
+}
+
+int RTPIOUringTransmitter::SendRTPDataBatch(const struct iovec *packets,size_t count)
+{
+	if (!init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	MAINMUTEX_LOCK
+
+	if (!created)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	}
+	for (size_t i = 0 ; i < count ; i++)
+	{
+		if (packets[i].iov_len > maxpacksize)
+		{
+			MAINMUTEX_UNLOCK
+			return MEDIA_RTP_ERR_RESOURCE_ERROR;
+		}
+	}
+
+	std::vector<std::pair<RTPEndpoint,int> > senderrors;
+	int status = SendToDestinations(true,packets,count,senderrors);
+
+	MAINMUTEX_UNLOCK
+
+	for (size_t i = 0 ; i < senderrors.size() ; i++)
+		OnSendError(senderrors[i].first,true,senderrors[i].second);
+	return status;
+}
+
+int RTPIOUringTransmitter::AddDestination(const RTPEndpoint &addr)
+{
+	if (!init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	MAINMUTEX_LOCK
+
+	if (!created)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	}
+
+	if (addr.GetType() != RTPEndpoint::IPv4)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_PARAMETER;
+	}
+
+	auto result = destinations.insert(addr);
+	int status = result.second ? 0 : MEDIA_RTP_ERR_INVALID_STATE;
+	if (result.second)
+		RebuildDestinationList();
+
+	MAINMUTEX_UNLOCK
+	return status;
+}
+
+int RTPIOUringTransmitter::DeleteDestination(const RTPEndpoint &addr)
+{
+	if (!init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	MAINMUTEX_LOCK
+
+	if (!created)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	}
+	if (addr.GetType() != RTPEndpoint::IPv4)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_PARAMETER;
+	}
+
+	size_t erased = destinations.erase(addr);
+	int status = erased > 0 ? 0 : MEDIA_RTP_ERR_INVALID_STATE;
+	if (erased > 0)
+		RebuildDestinationList();
+
+	MAINMUTEX_UNLOCK
+	return status;
+}
+
+void RTPIOUringTransmitter::ClearDestinations()
+{
+	if (!init)
+		return;
+
+	MAINMUTEX_LOCK
+	if (created)
+	{
+		destinations.clear();
+		RebuildDestinationList();
+	}
+	MAINMUTEX_UNLOCK
+}
+
+bool RTPIOUringTransmitter::SupportsMulticasting()
+{
+	return false;
+}
+
+int RTPIOUringTransmitter::JoinMulticastGroup(const RTPEndpoint &)
+{
+	return MEDIA_RTP_ERR_OPERATION_FAILED;
+}
+
+int RTPIOUringTransmitter::LeaveMulticastGroup(const RTPEndpoint &)
+{
+	return MEDIA_RTP_ERR_OPERATION_FAILED;
+}
+
+void RTPIOUringTransmitter::LeaveAllMulticastGroups()
+{
+}
+
+int RTPIOUringTransmitter::SetReceiveMode(RTPTransmitter::ReceiveMode m)
+{
+	if (!init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	MAINMUTEX_LOCK
+	if (!created)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	}
+	if (m != receivemode)
+	{
+		receivemode = m;
+		acceptignoreset.clear();
+	}
+	MAINMUTEX_UNLOCK
+	return 0;
+}
+
+int RTPIOUringTransmitter::AddToIgnoreList(const RTPEndpoint &addr)
+{
+	if (!init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	MAINMUTEX_LOCK
+
+	if (!created)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	}
+	if (addr.GetType() != RTPEndpoint::IPv4)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_PARAMETER;
+	}
+	if (receivemode != RTPTransmitter::IgnoreSome)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_OPERATION_FAILED;
+	}
+
+	auto result = acceptignoreset.insert((((uint64_t)addr.GetIPv4())<<16)|(uint64_t)addr.GetRtpPort());
+	int status = result.second ? 0 : MEDIA_RTP_ERR_INVALID_STATE;
+
+	MAINMUTEX_UNLOCK
+	return status;
+}
+
+int RTPIOUringTransmitter::DeleteFromIgnoreList(const RTPEndpoint &addr)
+{
+	if (!init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	MAINMUTEX_LOCK
+
+	if (!created)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	}
+	if (addr.GetType() != RTPEndpoint::IPv4)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_PARAMETER;
+	}
+	if (receivemode != RTPTransmitter::IgnoreSome)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_OPERATION_FAILED;
+	}
+
+	size_t erased = acceptignoreset.erase((((uint64_t)addr.GetIPv4())<<16)|(uint64_t)addr.GetRtpPort());
+	int status = erased > 0 ? 0 : MEDIA_RTP_ERR_INVALID_STATE;
+
+	MAINMUTEX_UNLOCK
+	return status;
+}
+
+void RTPIOUringTransmitter::ClearIgnoreList()
+{
+	if (!init)
+		return;
+
+	MAINMUTEX_LOCK
+	if (created && receivemode == RTPTransmitter::IgnoreSome)
+		acceptignoreset.clear();
+	MAINMUTEX_UNLOCK
+}
+
+int RTPIOUringTransmitter::AddToAcceptList(const RTPEndpoint &addr)
+{
+	if (!init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	MAINMUTEX_LOCK
+
+	if (!created)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	}
+	if (addr.GetType() != RTPEndpoint::IPv4)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_PARAMETER;
+	}
+	if (receivemode != RTPTransmitter::AcceptSome)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_OPERATION_FAILED;
+	}
+
+	auto result = acceptignoreset.insert((((uint64_t)addr.GetIPv4())<<16)|(uint64_t)addr.GetRtpPort());
+	int status = result.second ? 0 : MEDIA_RTP_ERR_INVALID_STATE;
+
+	MAINMUTEX_UNLOCK
+	return status;
+}
+
+int RTPIOUringTransmitter::DeleteFromAcceptList(const RTPEndpoint &addr)
+{
+	if (!init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	MAINMUTEX_LOCK
+
+	if (!created)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	}
+	if (addr.GetType() != RTPEndpoint::IPv4)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_PARAMETER;
+	}
+	if (receivemode != RTPTransmitter::AcceptSome)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_OPERATION_FAILED;
+	}
+
+	size_t erased = acceptignoreset.erase((((uint64_t)addr.GetIPv4())<<16)|(uint64_t)addr.GetRtpPort());
+	int status = erased > 0 ? 0 : MEDIA_RTP_ERR_INVALID_STATE;
+
+	MAINMUTEX_UNLOCK
+	return status;
+}
+
+void RTPIOUringTransmitter::ClearAcceptList()
+{
+	if (!init)
+		return;
+
+	MAINMUTEX_LOCK
+	if (created && receivemode == RTPTransmitter::AcceptSome)
+		acceptignoreset.clear();
+	MAINMUTEX_UNLOCK
+}
+
+int RTPIOUringTransmitter::SetMaximumPacketSize(size_t s)
+{
+	if (!init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	MAINMUTEX_LOCK
+	if (!created)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	}
+	if (s > RTPIOURINGTRANS_MAXPACKSIZE)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_RESOURCE_ERROR;
+	}
+	maxpacksize = s;
+	MAINMUTEX_UNLOCK
+	return 0;
+}
+
+bool RTPIOUringTransmitter::NewDataAvailable()
+{
+	if (!init)
+		return false;
+	return !rawpacketqueue.IsEmpty();
+}
+
+RTPRawPacket *RTPIOUringTransmitter::GetNextPacket()
+{
+	if (!init)
+		return 0;
+
+	// 不需要主锁：轮询时只在队尾加入数据包，这里只从队首取出。
+	// Destroy 清空队列时也是消费者，调用者保证两者不会并发（见 RTPTransmitter::Destroy），
+	// 因此这里不必检查 created
+	return rawpacketqueue.Pop();
+}
+
+// 私有函数从这里开始...
+
+int RTPIOUringTransmitter::CreateSockets(const RTPIOUringTransmissionParams *params)
+{
+	struct sockaddr_in addr;
+	int size;
+
+	if (params->GetPortbase() == 0)
+	{
+		int status = GetAutoSockets(params->GetBindIP(), false, params->GetRTCPMultiplexing(),
+		                            &rtpsock, &rtcpsock, &m_rtpPort, &m_rtcpPort);
+		if (status < 0)
+			return status;
+	}
+	else
+	{
+		// 检查端口基数是否为偶数
+		if (params->GetPortbase()%2 != 0)
+			return MEDIA_RTP_ERR_OPERATION_FAILED;
+
+		rtpsock = socket(PF_INET,SOCK_DGRAM,0);
+		if (rtpsock == RTPSOCKERR)
+			return MEDIA_RTP_ERR_OPERATION_FAILED;
+
+		// 如果我们进行多路复用，我们只需将 RTCP 套接字设置为等于 RTP 套接字
+		if (params->GetRTCPMultiplexing())
+			rtcpsock = rtpsock;
+		else
+		{
+			rtcpsock = socket(PF_INET,SOCK_DGRAM,0);
+			if (rtcpsock == RTPSOCKERR)
+			{
+				RTPCLOSE(rtpsock);
+				return MEDIA_RTP_ERR_OPERATION_FAILED;
+			}
+		}
+
+		m_rtpPort = params->GetPortbase();
+		m_rtcpPort = (rtpsock != rtcpsock)?(m_rtpPort+1):m_rtpPort;
+
+		memset(&addr,0,sizeof(struct sockaddr_in));
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(m_rtpPort);
+		addr.sin_addr.s_addr = htonl(params->GetBindIP());
+		if (bind(rtpsock,(struct sockaddr *)&addr,sizeof(struct sockaddr_in)) != 0)
+		{
+			CLOSESOCKETS;
+			return MEDIA_RTP_ERR_OPERATION_FAILED;
+		}
+
+		if (rtpsock != rtcpsock) // 多路复用时无需绑定同一个套接字两次
+		{
+			addr.sin_port = htons(m_rtcpPort);
+			if (bind(rtcpsock,(struct sockaddr *)&addr,sizeof(struct sockaddr_in)) != 0)
+			{
+				CLOSESOCKETS;
+				return MEDIA_RTP_ERR_OPERATION_FAILED;
+			}
+		}
+	}
+
+	// 设置套接字缓冲区大小
+
+	size = params->GetRTPReceiveBuffer();
+	if (setsockopt(rtpsock,SOL_SOCKET,SO_RCVBUF,(const char *)&size,sizeof(int)) != 0)
+	{
+		CLOSESOCKETS;
+		return MEDIA_RTP_ERR_OPERATION_FAILED;
+	}
+	size = params->GetRTPSendBuffer();
+	if (setsockopt(rtpsock,SOL_SOCKET,SO_SNDBUF,(const char *)&size,sizeof(int)) != 0)
+	{
+		CLOSESOCKETS;
+		return MEDIA_RTP_ERR_OPERATION_FAILED;
+	}
+
+	if (rtpsock != rtcpsock) // 多路复用时无需设置 RTCP 标志
+	{
+		size = params->GetRTCPReceiveBuffer();
+		if (setsockopt(rtcpsock,SOL_SOCKET,SO_RCVBUF,(const char *)&size,sizeof(int)) != 0)
+		{
+			CLOSESOCKETS;
+			return MEDIA_RTP_ERR_OPERATION_FAILED;
+		}
+		size = params->GetRTCPSendBuffer();
+		if (setsockopt(rtcpsock,SOL_SOCKET,SO_SNDBUF,(const char *)&size,sizeof(int)) != 0)
+		{
+			CLOSESOCKETS;
+			return MEDIA_RTP_ERR_OPERATION_FAILED;
+		}
+	}
+	return 0;
+}
+
+int RTPIOUringTransmitter::CreateLocalIPList()
+{
+#ifdef RTP_SUPPORT_IFADDRS
+	struct ifaddrs *addrs,*tmp;
+
+	if (getifaddrs(&addrs) == 0)
+	{
+		for (tmp = addrs ; tmp != 0 ; tmp = tmp->ifa_next)
+		{
+			if (tmp->ifa_addr != 0 && tmp->ifa_addr->sa_family == AF_INET)
+			{
+				struct sockaddr_in *inaddr = (struct sockaddr_in *)tmp->ifa_addr;
+				localIPs.push_back(ntohl(inaddr->sin_addr.s_addr));
+			}
+		}
+		freeifaddrs(addrs);
+	}
+#endif // RTP_SUPPORT_IFADDRS
+
+	uint32_t loopbackaddr = (((uint32_t)127)<<24)|((uint32_t)1);
+	std::list<uint32_t>::const_iterator it;
+	bool found = false;
+
+	for (it = localIPs.begin() ; !found && it != localIPs.end() ; it++)
+	{
+		if (*it == loopbackaddr)
+			found = true;
+	}
+
+	if (!found)
+		localIPs.push_back(loopbackaddr);
+	return 0;
+}
+
+int RTPIOUringTransmitter::SetupRing(const RTPIOUringTransmissionParams *params)
+{
+	struct io_uring_params p;
+	unsigned int depth = params->GetQueueDepth();
+
+	recvbuffercount = params->GetReceiveBufferCount();
+	recvbuffersize = params->GetReceiveBufferSize();
+
+	// 缓冲区环的大小必须是2的幂，每个缓冲区至少要能放下消息头、源地址和一个 RTCP 头部
+	if (depth == 0 || recvbuffercount == 0 || recvbuffercount > RTPIOURINGTRANS_MAXRECVBUFFERCOUNT ||
+	    (recvbuffercount&(recvbuffercount-1)) != 0)
+		return MEDIA_RTP_ERR_INVALID_PARAMETER;
+	if (recvbuffersize < sizeof(struct io_uring_recvmsg_out)+sizeof(struct sockaddr_in)+sizeof(RTCPCommonHeader) ||
+	    recvbuffersize > 0xFFFFFFFF)
+		return MEDIA_RTP_ERR_INVALID_PARAMETER;
+
+	memset(&p,0,sizeof(struct io_uring_params));
+	p.flags = IORING_SETUP_CQSIZE;
+	p.cq_entries = depth*4;
+
+	ringfd = IOUringSetup(depth,&p);
+	if (ringfd < 0)
+		return MEDIA_RTP_ERR_OPERATION_FAILED;
+
+	sqentries = p.sq_entries;
+	sqringsize = p.sq_off.array + p.sq_entries*sizeof(unsigned int);
+	cqringsize = p.cq_off.cqes + p.cq_entries*sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		if (cqringsize > sqringsize)
+			sqringsize = cqringsize;
+		cqringsize = sqringsize;
+	}
+	sqessize = p.sq_entries*sizeof(struct io_uring_sqe);
+
+	sqringptr = MAP_FAILED;
+	cqringptr = MAP_FAILED;
+	sqes = (struct io_uring_sqe *)MAP_FAILED;
+	bufring = (struct io_uring_buf_ring *)MAP_FAILED;
+	recvbuffers = 0;
+	recvbufferpool = 0;
+	rawpacketpool = 0;
+
+	sqringptr = mmap(0,sqringsize,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,ringfd,IORING_OFF_SQ_RING);
+	if (sqringptr == MAP_FAILED)
+	{
+		DestroyRing();
+		return MEDIA_RTP_ERR_RESOURCE_ERROR;
+	}
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		cqringptr = sqringptr;
+	else
+	{
+		cqringptr = mmap(0,cqringsize,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,ringfd,IORING_OFF_CQ_RING);
+		if (cqringptr == MAP_FAILED)
+		{
+			DestroyRing();
+			return MEDIA_RTP_ERR_RESOURCE_ERROR;
+		}
+	}
+	sqes = (struct io_uring_sqe *)mmap(0,sqessize,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,ringfd,IORING_OFF_SQES);
+	if (sqes == MAP_FAILED)
+	{
+		DestroyRing();
+		return MEDIA_RTP_ERR_RESOURCE_ERROR;
+	}
+
+	sqhead = (unsigned int *)((uint8_t *)sqringptr + p.sq_off.head);
+	sqtail = (unsigned int *)((uint8_t *)sqringptr + p.sq_off.tail);
+	sqmask = (unsigned int *)((uint8_t *)sqringptr + p.sq_off.ring_mask);
+	sqflags = (unsigned int *)((uint8_t *)sqringptr + p.sq_off.flags);
+	sqarray = (unsigned int *)((uint8_t *)sqringptr + p.sq_off.array);
+	cqhead = (unsigned int *)((uint8_t *)cqringptr + p.cq_off.head);
+	cqtail = (unsigned int *)((uint8_t *)cqringptr + p.cq_off.tail);
+	cqmask = (unsigned int *)((uint8_t *)cqringptr + p.cq_off.ring_mask);
+	cqes = (struct io_uring_cqe *)((uint8_t *)cqringptr + p.cq_off.cqes);
+	sqlocaltail = *sqtail;
+	sqtosubmit = 0;
+
+	// 缓冲区环本身由内核读取，必须按页对齐，因此使用匿名映射
+	bufringsize = recvbuffercount*sizeof(struct io_uring_buf);
+	bufring = (struct io_uring_buf_ring *)mmap(0,bufringsize,PROT_READ|PROT_WRITE,MAP_ANONYMOUS|MAP_PRIVATE,-1,0);
+	if (bufring == MAP_FAILED)
+	{
+		DestroyRing();
+		return MEDIA_RTP_ERR_RESOURCE_ERROR;
+	}
+	recvbuffers = new uint8_t[recvbuffercount*recvbuffersize];
+	if (recvbuffers == 0)
+	{
+		DestroyRing();
+		return MEDIA_RTP_ERR_RESOURCE_ERROR;
+	}
+
+	struct io_uring_buf_reg reg;
+
+	memset(&reg,0,sizeof(struct io_uring_buf_reg));
+	reg.ring_addr = (uint64_t)(uintptr_t)bufring;
+	reg.ring_entries = recvbuffercount;
+	reg.bgid = RTPIOURINGTRANS_BUFFERGROUP;
+	if (IOUringRegister(ringfd,IORING_REGISTER_PBUF_RING,&reg,1) != 0)
+	{
+		DestroyRing();
+		return MEDIA_RTP_ERR_OPERATION_FAILED;
+	}
+
+	bufringtail = 0;
+	for (unsigned int i = 0 ; i < recvbuffercount ; i++)
+		RecycleReceiveBuffer((uint16_t)i);
+
+	// 每个接收到的数据包都能放进一个池缓冲区，稳定状态下接收不需要分配内存
+	size_t maxidle = RTPIOURINGTRANS_POOLIDLEBYTES/recvbuffersize;
+
+	if (maxidle < RTPIOURINGTRANS_POOLMINIDLE)
+		maxidle = RTPIOURINGTRANS_POOLMINIDLE;
+	recvbufferpool = RTPBufferPool::Create(recvbuffersize,maxidle);
+	rawpacketpool = RTPBufferPool::Create(sizeof(RTPRawPacket),RTPIOURINGTRANS_RAWPACKETPOOLIDLE);
+	if (recvbufferpool == 0 || rawpacketpool == 0)
+	{
+		DestroyRing();
+		return MEDIA_RTP_ERR_RESOURCE_ERROR;
+	}
+	return 0;
+}
+
+void RTPIOUringTransmitter::DestroyRing()
+{
+	if (created)
+	{
+		// 先取消仍在进行的接收请求，避免关闭后内核继续写入即将释放的缓冲区
+		int attempts = 0;
+
+		if (rtpreceivearmed)
+		{
+			struct io_uring_sqe *sqe = GetSQE();
+			if (sqe != 0)
+			{
+				sqe->opcode = IORING_OP_ASYNC_CANCEL;
+				sqe->fd = -1;
+				sqe->addr = RTPIOURINGTRANS_USERDATA(RTPIOURINGTRANS_TAG_RTPRECV,0);
+				sqe->user_data = RTPIOURINGTRANS_USERDATA(RTPIOURINGTRANS_TAG_CANCEL,0);
+			}
+		}
+		if (rtcpreceivearmed)
+		{
+			struct io_uring_sqe *sqe = GetSQE();
+			if (sqe != 0)
+			{
+				sqe->opcode = IORING_OP_ASYNC_CANCEL;
+				sqe->fd = -1;
+				sqe->addr = RTPIOURINGTRANS_USERDATA(RTPIOURINGTRANS_TAG_RTCPRECV,0);
+				sqe->user_data = RTPIOURINGTRANS_USERDATA(RTPIOURINGTRANS_TAG_CANCEL,0);
+			}
+		}
+		while ((rtpreceivearmed || rtcpreceivearmed || sendsoutstanding > 0) && attempts++ < RTPIOURINGTRANS_CANCELATTEMPTS)
+		{
+			SubmitAndWait(0);
+			ProcessCompletions(0);
+			if (rtpreceivearmed || rtcpreceivearmed || sendsoutstanding > 0)
+				RTPTime::Wait(RTPTime(0,1000));
+		}
+	}
+
+	if (ringfd >= 0)
+		close(ringfd);
+	ringfd = -1;
+	if (sqes != MAP_FAILED)
+		munmap(sqes,sqessize);
+	if (cqringptr != MAP_FAILED && cqringptr != sqringptr)
+		munmap(cqringptr,cqringsize);
+	if (sqringptr != MAP_FAILED)
+		munmap(sqringptr,sqringsize);
+	if (bufring != MAP_FAILED)
+		munmap(bufring,bufringsize);
+	if (recvbuffers)
+		delete [] recvbuffers;
+
+	// 应用程序仍持有的数据包可以继续使用，缓冲池在最后一个缓冲区归还时删除
+	if (recvbufferpool)
+		recvbufferpool->Destroy();
+	if (rawpacketpool)
+		rawpacketpool->Destroy();
+
+	sqringptr = MAP_FAILED;
+	cqringptr = MAP_FAILED;
+	sqes = (struct io_uring_sqe *)MAP_FAILED;
+	bufring = (struct io_uring_buf_ring *)MAP_FAILED;
+	recvbuffers = 0;
+	recvbufferpool = 0;
+	rawpacketpool = 0;
+}
+
+struct io_uring_sqe *RTPIOUringTransmitter::GetSQE()
+{
+	unsigned int head = __atomic_load_n(sqhead,__ATOMIC_ACQUIRE);
+
+	if (sqlocaltail - head >= sqentries)
+		return 0;
+
+	unsigned int index = sqlocaltail & (*sqmask);
+	struct io_uring_sqe *sqe = &sqes[index];
+
+	memset(sqe,0,sizeof(struct io_uring_sqe));
+	sqarray[index] = index;
+	sqlocaltail++;
+	sqtosubmit++;
+	return sqe;
+}
+
+int RTPIOUringTransmitter::SubmitAndWait(unsigned int waitnr)
+{
+	unsigned int flags = 0;
+
+	// 发布新的提交队列尾部，内核在 io_uring_enter 中读取它
+	__atomic_store_n(sqtail,sqlocaltail,__ATOMIC_RELEASE);
+
+	if (waitnr > 0 || (__atomic_load_n(sqflags,__ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW))
+		flags |= IORING_ENTER_GETEVENTS;
+	if (sqtosubmit == 0 && flags == 0)
+		return 0;
+
+	int ret;
+
+	while ((ret = IOUringEnter(ringfd,sqtosubmit,waitnr,flags)) < 0)
+	{
+		if (errno == EINTR)
+			continue;
+		// 资源暂时不足或完成队列溢出时，由调用者收取完成事件后重试
+		if (errno == EAGAIN || errno == EBUSY)
+			return 0;
+		return MEDIA_RTP_ERR_OPERATION_FAILED;
+	}
+	sqtosubmit -= ((unsigned int)ret < sqtosubmit)?(unsigned int)ret:sqtosubmit;
+	return 0;
+}
+
+void RTPIOUringTransmitter::ArmReceive(bool rtp)
+{
+	bool &armed = (rtp)?rtpreceivearmed:rtcpreceivearmed;
+	struct msghdr &msg = (rtp)?rtprecvmsg:rtcprecvmsg;
+
+	if (armed)
+		return;
+
+	struct io_uring_sqe *sqe = GetSQE();
+	if (sqe == 0)
+		return; // 下一次轮询时再试
+
+	// 不提供 iovec，数据由内核从缓冲区组中选择的缓冲区接收；多次触发模式下
+	// 源地址写在缓冲区开头的消息头之后，单次模式下写入 msg_name
+	memset(&msg,0,sizeof(struct msghdr));
+	msg.msg_name = (rtp)?&rtprecvaddr:&rtcprecvaddr;
+	msg.msg_namelen = sizeof(struct sockaddr_in);
+
+	sqe->opcode = IORING_OP_RECVMSG;
+	sqe->fd = (rtp)?rtpsock:rtcpsock;
+	sqe->addr = (uint64_t)(uintptr_t)&msg;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = RTPIOURINGTRANS_BUFFERGROUP;
+	if (multishot)
+		sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->user_data = RTPIOURINGTRANS_USERDATA((rtp)?RTPIOURINGTRANS_TAG_RTPRECV:RTPIOURINGTRANS_TAG_RTCPRECV,0);
+	armed = true;
+}
+
+int RTPIOUringTransmitter::ProcessCompletions(std::vector<std::pair<RTPEndpoint,int> > *senderrors)
+{
+	unsigned int head = *cqhead;
+	unsigned int tail = __atomic_load_n(cqtail,__ATOMIC_ACQUIRE);
+	RTPTime curtime = RTPTime::CurrentTime();
+	int status = 0;
+
+	while (head != tail)
+	{
+		const struct io_uring_cqe *cqe = &cqes[head & (*cqmask)];
+		uint64_t tag = RTPIOURINGTRANS_USERDATA_TAG(cqe->user_data);
+
+		if (tag == RTPIOURINGTRANS_TAG_RTPRECV || tag == RTPIOURINGTRANS_TAG_RTCPRECV)
+		{
+			int s = ProcessReceiveCompletion(tag == RTPIOURINGTRANS_TAG_RTPRECV,cqe,curtime);
+			if (s < 0)
+				status = s;
+		}
+		else if (tag == RTPIOURINGTRANS_TAG_SEND)
+		{
+			size_t index = RTPIOURINGTRANS_USERDATA_INDEX(cqe->user_data);
+
+			if (sendsoutstanding > 0)
+				sendsoutstanding--;
+			// 链中某个请求失败后，同一目标后续的请求会以 ECANCELED 结束，只报告最初的错误
+			if (cqe->res < 0 && cqe->res != -ECANCELED && senderrors != 0 && index < destinationlist.size())
+				senderrors->push_back(std::make_pair(*destinationlist[index],-cqe->res));
+		}
+		head++;
+	}
+
+	__atomic_store_n(cqhead,head,__ATOMIC_RELEASE);
+	return status;
+}
+
+int RTPIOUringTransmitter::ProcessReceiveCompletion(bool rtp,const struct io_uring_cqe *cqe,const RTPTime &receivetime)
+{
+	// 没有 IORING_CQE_F_MORE 标志说明请求已终止（例如缓冲区暂时用完），需要重新提交
+	if (!(cqe->flags & IORING_CQE_F_MORE))
+	{
+		if (rtp)
+			rtpreceivearmed = false;
+		else
+			rtcpreceivearmed = false;
+	}
+
+	if (cqe->res < 0)
+	{
+		// 旧内核不支持多次触发的 recvmsg，退回到每次接收一个数据包
+		if (cqe->res == -EINVAL && multishot)
+			multishot = false;
+		return 0;
+	}
+	if (!(cqe->flags & IORING_CQE_F_BUFFER))
+		return 0;
+
+	uint16_t bufferid = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+	const uint8_t *buffer = recvbuffers + (size_t)bufferid*recvbuffersize;
+	int status = 0;
+
+	if (multishot)
+	{
+		// 缓冲区依次包含 io_uring_recvmsg_out、源地址（长度固定为 msg_namelen）和数据
+		const struct io_uring_recvmsg_out *out = (const struct io_uring_recvmsg_out *)buffer;
+		size_t offset = sizeof(struct io_uring_recvmsg_out) + sizeof(struct sockaddr_in);
+
+		if ((size_t)cqe->res >= offset && out->namelen >= sizeof(struct sockaddr_in) && !(out->flags & MSG_TRUNC))
+		{
+			struct sockaddr_in srcaddr;
+			size_t len = (size_t)cqe->res - offset;
+
+			if (len > out->payloadlen)
+				len = out->payloadlen;
+			memcpy(&srcaddr,buffer+sizeof(struct io_uring_recvmsg_out),sizeof(struct sockaddr_in));
+			if (len > 0)
+				status = QueueReceivedPacket(buffer+offset,len,srcaddr,receivetime,rtp);
+		}
+	}
+	else
+	{
+		if (cqe->res > 0)
+			status = QueueReceivedPacket(buffer,(size_t)cqe->res,(rtp)?rtprecvaddr:rtcprecvaddr,receivetime,rtp);
+	}
+
+	RecycleReceiveBuffer(bufferid);
+	return status;
+}
+
+void RTPIOUringTransmitter::RecycleReceiveBuffer(uint16_t bufferid)
+{
+	// 内核头文件中的柔性数组在 C++ 下会被偏移，因此直接按 io_uring_buf 数组寻址；
+	// 环的尾部与第一个条目的保留字段重叠，写入条目时不能触碰该字段
+	struct io_uring_buf *buf = ((struct io_uring_buf *)bufring) + (bufringtail & (recvbuffercount-1));
+
+	buf->addr = (uint64_t)(uintptr_t)(recvbuffers + (size_t)bufferid*recvbuffersize);
+	buf->len = (uint32_t)recvbuffersize;
+	buf->bid = bufferid;
+	bufringtail++;
+	__atomic_store_n(&bufring->tail,bufringtail,__ATOMIC_RELEASE);
+}
+
+int RTPIOUringTransmitter::QueueReceivedPacket(const uint8_t *data, size_t len, const struct sockaddr_in &srcaddr,
+                                               const RTPTime &receivetime, bool rtp)
+{
+	bool acceptdata;
+
+	// 获取到数据，处理它
+	if (receivemode == RTPTransmitter::AcceptAll)
+		acceptdata = true;
+	else
+		acceptdata = ShouldAcceptData(ntohl(srcaddr.sin_addr.s_addr),ntohs(srcaddr.sin_port));
+
+	if (!acceptdata)
+		return 0;
+
+	// 缓冲区环中的缓冲区要立即归还给内核，因此把数据复制到池缓冲区中
+	uint8_t *datacopy = recvbufferpool->Allocate();
+	if (datacopy == 0)
+		return MEDIA_RTP_ERR_RESOURCE_ERROR;
+	memcpy(datacopy,data,len);
+
+	bool isrtp = rtp;
+	if (rtpsock == rtcpsock) // 多路复用时检查负载类型
+	{
+		isrtp = true;
+
+		if (len > sizeof(RTCPCommonHeader))
+		{
+			RTCPCommonHeader *rtcpheader = (RTCPCommonHeader *)datacopy;
+			uint8_t packettype = rtcpheader->packettype;
+
+			if (packettype >= 200 && packettype <= 204)
+				isrtp = false;
+		}
+	}
+
+	// 源地址保存在数据包内部，数据包对象本身也来自缓冲池
+	RTPRawPacket *pack = new (rawpacketpool) RTPRawPacket(datacopy,len,true,
+	                                                      RTPEndpoint(ntohl(srcaddr.sin_addr.s_addr),ntohs(srcaddr.sin_port)),
+	                                                      receivetime,isrtp);
+	if (pack == 0)
+	{
+		RTPBufferPool::Release(datacopy);
+		return MEDIA_RTP_ERR_RESOURCE_ERROR;
+	}
+	// 队列已满（数据包的处理跟不上接收）时丢弃数据包，数据已经由内核写入缓冲区环，
+	// 无法留在套接字中
+	if (!rawpacketqueue.Push(pack))
+		delete pack;
+	return 0;
+}
+
+int RTPIOUringTransmitter::SendToDestinations(bool rtp, const struct iovec *packets, size_t count,
+                                              std::vector<std::pair<RTPEndpoint,int> > &senderrors)
+{
+	int sock = (rtp)?rtpsock:rtcpsock;
+	size_t num = destinationlist.size();
+	int status = 0;
+
+	if (num == 0 || count == 0)
+		return 0;
+
+	// 每个 (目标, 数据包) 组合对应一个消息头，在所有请求完成前它们必须保持有效
+	sendmsgs.resize(num*count);
+
+	for (size_t d = 0 ; d < num && status >= 0 ; d++)
+	{
+		const RTPEndpoint *dest = destinationlist[d];
+		struct io_uring_sqe *prev = 0;
+
+		for (size_t p = 0 ; p < count && status >= 0 ; p++)
+		{
+			struct msghdr &msg = sendmsgs[d*count+p];
+			struct io_uring_sqe *sqe = GetSQE();
+
+			if (sqe == 0)
+			{
+				// 提交队列已满：先完成已提交的全部请求，保证同一目标的数据包仍按顺序发送
+				while (status >= 0 && (sqtosubmit > 0 || sendsoutstanding > 0))
+				{
+					status = SubmitAndWait((sendsoutstanding > 0)?1:0);
+					if (status >= 0)
+						status = ProcessCompletions(&senderrors);
+				}
+				if (status < 0 || (sqe = GetSQE()) == 0)
+				{
+					status = (status < 0)?status:MEDIA_RTP_ERR_RESOURCE_ERROR;
+					break;
+				}
+				prev = 0;
+			}
+
+			memset(&msg,0,sizeof(struct msghdr));
+			msg.msg_name = const_cast<struct sockaddr *>((rtp)?dest->GetRtpSockAddr():dest->GetRtcpSockAddr());
+			msg.msg_namelen = dest->GetSockAddrLen();
+			msg.msg_iov = const_cast<struct iovec *>(&packets[p]);
+			msg.msg_iovlen = 1;
+
+			sqe->opcode = IORING_OP_SENDMSG;
+			sqe->fd = sock;
+			sqe->addr = (uint64_t)(uintptr_t)&msg;
+			sqe->len = 1;
+			sqe->user_data = RTPIOURINGTRANS_USERDATA(RTPIOURINGTRANS_TAG_SEND,d);
+			sendsoutstanding++;
+
+			// 链接同一目标的前一个请求，使内核按顺序执行它们
+			if (prev != 0)
+				prev->flags |= IOSQE_IO_LINK;
+			prev = sqe;
+		}
+	}
+
+	// 数据只在本次调用期间有效，因此要等到所有发送请求都已完成
+	while (status >= 0 && (sqtosubmit > 0 || sendsoutstanding > 0))
+	{
+		status = SubmitAndWait((sendsoutstanding > 0)?1:0);
+		if (status >= 0)
+			status = ProcessCompletions(&senderrors);
+	}
+	return status;
+}
+
+void RTPIOUringTransmitter::RebuildDestinationList()
+{
+	destinationlist.clear();
+	for (const auto& dest : destinations)
+		destinationlist.push_back(&dest);
+}
+
+void RTPIOUringTransmitter::FlushPackets()
+{
+	rawpacketqueue.Flush();
+}
+
+bool RTPIOUringTransmitter::ShouldAcceptData(uint32_t srcip,uint16_t srcport)
+{
+	uint64_t key = ((uint64_t)srcip)<<16;
+	bool found = (acceptignoreset.find(key|(uint64_t)srcport) != acceptignoreset.end() ||
+	              acceptignoreset.find(key) != acceptignoreset.end());
+
+	if (receivemode == RTPTransmitter::AcceptSome)
+		return found;
+	return !found; // IgnoreSome
+}
+
+#endif // RTP_HAVE_IO_URING
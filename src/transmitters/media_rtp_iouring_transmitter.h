@@ -0,0 +1,344 @@
+#pragma once
+
+#include "rtpconfig.h"
+
+#ifdef RTP_HAVE_IO_URING
+
+#include "media_rtp_abort_descriptors.h"
+#include "media_rtp_buffer_pool.h"
+#include "media_rtp_socket_waiter.h"
+#include "media_rtp_raw_packet_queue.h"
+#include "media_rtp_endpoint.h"
+#include "media_rtp_transmitter.h"
+#include <list>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <mutex>
+
+#define RTPIOURINGTRANS_DEFAULTPORTBASE 5000
+
+#define RTPIOURINGTRANS_RTPRECEIVEBUFFER 32768
+#define RTPIOURINGTRANS_RTCPRECEIVEBUFFER 32768
+#define RTPIOURINGTRANS_RTPTRANSMITBUFFER 32768
+#define RTPIOURINGTRANS_RTCPTRANSMITBUFFER 32768
+
+#define RTPIOURINGTRANS_DEFAULTQUEUEDEPTH 256
+#define RTPIOURINGTRANS_DEFAULTRECVBUFFERCOUNT 256
+#define RTPIOURINGTRANS_DEFAULTRECVBUFFERSIZE 2048
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct io_uring_buf_ring;
+
+/** 基于 io_uring 的 UDP over IPv4 传输器的参数。 */
+class RTPIOUringTransmissionParams : public RTPTransmissionParams {
+public:
+  RTPIOUringTransmissionParams();
+
+  /** 设置用于绑定套接字的IP地址为 \c ip。 */
+  void SetBindIP(uint32_t ip) { bindIP = ip; }
+
+  /** 设置RTP端口基数为 \c pbase，该值必须是偶数；
+   *  端口号为零将导致自动选择端口。 */
+  void SetPortbase(uint16_t pbase) { portbase = pbase; }
+
+  /** 传递将用作本地IP地址的IP地址列表。 */
+  void SetLocalIPList(std::list<uint32_t> &iplist) { localIPs = iplist; }
+
+  /** 清除本地IP地址列表。空列表将使传输组件自身确定本地IP地址。 */
+  void ClearLocalIPList() { localIPs.clear(); }
+
+  /** 设置RTP套接字的发送缓冲区大小。 */
+  void SetRTPSendBuffer(int s) { rtpsendbuf = s; }
+
+  /** 设置RTP套接字的接收缓冲区大小。 */
+  void SetRTPReceiveBuffer(int s) { rtprecvbuf = s; }
+
+  /** 设置RTCP套接字的发送缓冲区大小。 */
+  void SetRTCPSendBuffer(int s) { rtcpsendbuf = s; }
+
+  /** 设置RTCP套接字的接收缓冲区大小。 */
+  void SetRTCPReceiveBuffer(int s) { rtcprecvbuf = s; }
+
+  /** 启用或禁用通过RTP通道复用RTCP流量，以便只使用单个端口。 */
+  void SetRTCPMultiplexing(bool f) { rtcpmux = f; }
+
+  /** 设置提交队列的条目数，内核会将其向上取整为2的幂；
+   *  完成队列的大小为它的四倍。 */
+  void SetQueueDepth(unsigned int n) { queuedepth = n; }
+
+  /** 设置注册到内核的接收缓冲区数量，必须是2的幂且不超过32768。 */
+  void SetReceiveBufferCount(unsigned int n) { recvbuffercount = n; }
+
+  /** 设置每个接收缓冲区的大小；缓冲区中还需容纳 io_uring 的消息头和源地址，
+   *  超出剩余空间的数据报将被丢弃。 */
+  void SetReceiveBufferSize(size_t s) { recvbuffersize = s; }
+
+  /** 如果非空，将使用指定的中止描述符来取消
+   *  等待数据包到达的函数；设置为null（默认值）
+   *  让传输器创建自己的实例。 */
+  void SetCreatedAbortDescriptors(RTPAbortDescriptors *desc) {
+    m_pAbortDesc = desc;
+  }
+
+  /** 返回将用于绑定套接字的IP地址。 */
+  uint32_t GetBindIP() const { return bindIP; }
+
+  /** 返回将使用的RTP端口基数（默认为5000）。 */
+  uint16_t GetPortbase() const { return portbase; }
+
+  /** 返回本地IP地址列表。 */
+  const std::list<uint32_t> &GetLocalIPList() const { return localIPs; }
+
+  /** 返回RTP套接字的发送缓冲区大小。 */
+  int GetRTPSendBuffer() const { return rtpsendbuf; }
+
+  /** 返回RTP套接字的接收缓冲区大小。 */
+  int GetRTPReceiveBuffer() const { return rtprecvbuf; }
+
+  /** 返回RTCP套接字的发送缓冲区大小。 */
+  int GetRTCPSendBuffer() const { return rtcpsendbuf; }
+
+  /** 返回RTCP套接字的接收缓冲区大小。 */
+  int GetRTCPReceiveBuffer() const { return rtcprecvbuf; }
+
+  /** 返回一个标志，指示RTCP流量是否将通过RTP通道复用。 */
+  bool GetRTCPMultiplexing() const { return rtcpmux; }
+
+  /** 返回提交队列的条目数。 */
+  unsigned int GetQueueDepth() const { return queuedepth; }
+
+  /** 返回接收缓冲区的数量。 */
+  unsigned int GetReceiveBufferCount() const { return recvbuffercount; }
+
+  /** 返回每个接收缓冲区的大小。 */
+  size_t GetReceiveBufferSize() const { return recvbuffersize; }
+
+  /** 如果非空，将在内部使用此RTPAbortDescriptors实例，
+   *  这在为多个会话创建自己的轮询线程时很有用。 */
+  RTPAbortDescriptors *GetCreatedAbortDescriptors() const {
+    return m_pAbortDesc;
+  }
+
+private:
+  uint16_t portbase;
+  uint32_t bindIP;
+  std::list<uint32_t> localIPs;
+  int rtpsendbuf, rtprecvbuf;
+  int rtcpsendbuf, rtcprecvbuf;
+  bool rtcpmux;
+  unsigned int queuedepth;
+  unsigned int recvbuffercount;
+  size_t recvbuffersize;
+
+  RTPAbortDescriptors *m_pAbortDesc;
+};
+
+inline RTPIOUringTransmissionParams::RTPIOUringTransmissionParams()
+    : RTPTransmissionParams(RTPTransmitter::IOUringUDPProto) {
+  portbase = RTPIOURINGTRANS_DEFAULTPORTBASE;
+  bindIP = 0;
+  rtpsendbuf = RTPIOURINGTRANS_RTPTRANSMITBUFFER;
+  rtprecvbuf = RTPIOURINGTRANS_RTPRECEIVEBUFFER;
+  rtcpsendbuf = RTPIOURINGTRANS_RTCPTRANSMITBUFFER;
+  rtcprecvbuf = RTPIOURINGTRANS_RTCPRECEIVEBUFFER;
+  rtcpmux = false;
+  queuedepth = RTPIOURINGTRANS_DEFAULTQUEUEDEPTH;
+  recvbuffercount = RTPIOURINGTRANS_DEFAULTRECVBUFFERCOUNT;
+  recvbuffersize = RTPIOURINGTRANS_DEFAULTRECVBUFFERSIZE;
+  m_pAbortDesc = 0;
+}
+
+/** 基于 io_uring 的 UDP 传输器的附加信息。 */
+class RTPIOUringTransmissionInfo : public RTPTransmissionInfo {
+public:
+  RTPIOUringTransmissionInfo(std::list<uint32_t> iplist, int ringfd,
+                             int rtpsock, int rtcpsock, uint16_t rtpport,
+                             uint16_t rtcpport)
+      : RTPTransmissionInfo(RTPTransmitter::IOUringUDPProto) {
+    localIPlist = iplist;
+    ringfiledesc = ringfd;
+    rtpsocket = rtpsock;
+    rtcpsocket = rtcpsock;
+    m_rtpPort = rtpport;
+    m_rtcpPort = rtcpport;
+  }
+
+  ~RTPIOUringTransmissionInfo() {}
+
+  /** 返回传输器认为是本地IP地址的IPv4地址列表。 */
+  std::list<uint32_t> GetLocalIPList() const { return localIPlist; }
+
+  /** 返回 io_uring 实例的文件描述符。 */
+  int GetRingDescriptor() const { return ringfiledesc; }
+
+  /** 返回用于接收和传输RTP数据包的套接字描述符。 */
+  int GetRTPSocket() const { return rtpsocket; }
+
+  /** 返回用于接收和传输RTCP数据包的套接字描述符。 */
+  int GetRTCPSocket() const { return rtcpsocket; }
+
+  /** 返回RTP套接字接收数据包的端口号。 */
+  uint16_t GetRTPPort() const { return m_rtpPort; }
+
+  /** 返回RTCP套接字接收数据包的端口号。 */
+  uint16_t GetRTCPPort() const { return m_rtcpPort; }
+
+private:
+  std::list<uint32_t> localIPlist;
+  int ringfiledesc;
+  int rtpsocket, rtcpsocket;
+  uint16_t m_rtpPort, m_rtcpPort;
+};
+
+#define RTPIOURINGTRANS_HEADERSIZE (20 + 8)
+
+/** 基于 io_uring 的 UDP over IPv4 传输组件。
+ *  此类继承RTPTransmitter接口，收发方式与RTPUDPv4Transmitter相同，但所有
+ *  套接字操作都通过 io_uring 完成：接收使用注册到内核的缓冲区环和多次触发
+ *  （multishot）的 recvmsg，一个请求即可持续接收数据；发送时为每个目标准备
+ *  sendmsg 请求，同一目标的一批数据包用 IOSQE_IO_LINK 链接以保持顺序，
+ *  所有请求通过一次 io_uring_enter 提交。组件的参数由类
+ *  RTPIOUringTransmissionParams描述，具有RTPEndpoint参数的函数需要IPv4类型的
+ *  地址。该传输器不支持多播。
+ *
+ *  使用 RTPSession::Create(const RTPSessionParams &, RTPTransmitter *)
+ *  时，需要先自行调用 Init 和 Create。
+ */
+class RTPIOUringTransmitter : public RTPTransmitter {
+  MEDIA_RTP_NO_COPY(RTPIOUringTransmitter)
+public:
+  RTPIOUringTransmitter();
+  ~RTPIOUringTransmitter();
+
+  int Init(bool treadsafe);
+  int Create(size_t maxpacksize, const RTPTransmissionParams *transparams);
+  void Destroy();
+  RTPTransmissionInfo *GetTransmissionInfo();
+  void DeleteTransmissionInfo(RTPTransmissionInfo *inf);
+
+  int GetLocalHostName(uint8_t *buffer, size_t *bufferlength);
+  bool ComesFromThisTransmitter(const RTPEndpoint *addr);
+  size_t GetHeaderOverhead() { return RTPIOURINGTRANS_HEADERSIZE; }
+
+  int Poll();
+  int WaitForIncomingData(const RTPTime &delay, bool *dataavailable = 0);
+  int AbortWait();
+
+  int SendRTPData(const void *data, size_t len);
+  int SendRTCPData(const void *data, size_t len);
+  int SendRTPDataBatch(const struct iovec *packets, size_t count);
+
+  int AddDestination(const RTPEndpoint &addr);
+  int DeleteDestination(const RTPEndpoint &addr);
+  void ClearDestinations();
+
+  bool SupportsMulticasting();
+  int JoinMulticastGroup(const RTPEndpoint &addr);
+  int LeaveMulticastGroup(const RTPEndpoint &addr);
+  void LeaveAllMulticastGroups();
+
+  int SetReceiveMode(RTPTransmitter::ReceiveMode m);
+  int AddToIgnoreList(const RTPEndpoint &addr);
+  int DeleteFromIgnoreList(const RTPEndpoint &addr);
+  void ClearIgnoreList();
+  int AddToAcceptList(const RTPEndpoint &addr);
+  int DeleteFromAcceptList(const RTPEndpoint &addr);
+  void ClearAcceptList();
+  int SetMaximumPacketSize(size_t s);
+
+  bool NewDataAvailable();
+  RTPRawPacket *GetNextPacket();
+  uint64_t GetNumDroppedPackets() { return rawpacketqueue.GetNumDroppedPackets(); }
+  uint64_t GetNumDroppedBytes() { return rawpacketqueue.GetNumDroppedBytes(); }
+
+protected:
+  /** 通过重写此函数，可以在向 \c addr 发送RTP数据（\c rtp 为true）或
+   *  RTCP数据失败时得到通知，\c errcode 为对应的 errno 值。
+   *  调用此函数时不持有传输器的内部锁。 */
+  virtual void OnSendError(const RTPEndpoint &addr, bool rtp, int errcode);
+
+private:
+  int CreateSockets(const RTPIOUringTransmissionParams *params);
+  int CreateLocalIPList();
+  int SetupRing(const RTPIOUringTransmissionParams *params);
+  void DestroyRing();
+  struct io_uring_sqe *GetSQE();
+  int SubmitAndWait(unsigned int waitnr);
+  void ArmReceive(bool rtp);
+  int ProcessCompletions(std::vector<std::pair<RTPEndpoint, int> > *senderrors);
+  int ProcessReceiveCompletion(bool rtp, const struct io_uring_cqe *cqe,
+                               const RTPTime &receivetime);
+  void RecycleReceiveBuffer(uint16_t bufferid);
+  int QueueReceivedPacket(const uint8_t *data, size_t len,
+                          const struct sockaddr_in &srcaddr,
+                          const RTPTime &receivetime, bool rtp);
+  int SendToDestinations(bool rtp, const struct iovec *packets, size_t count,
+                         std::vector<std::pair<RTPEndpoint, int> > &senderrors);
+  void RebuildDestinationList();
+  void FlushPackets();
+  bool ShouldAcceptData(uint32_t srcip, uint16_t srcport);
+
+  bool init;
+  bool created;
+  bool waitingfordata;
+  int rtpsock, rtcpsock;
+  uint16_t m_rtpPort, m_rtcpPort;
+  std::list<uint32_t> localIPs;
+  RTPTransmitter::ReceiveMode receivemode;
+  std::vector<uint8_t> localhostname;
+
+  std::unordered_set<RTPEndpoint> destinations;
+  std::vector<const RTPEndpoint *> destinationlist;
+  RTPRawPacketQueue rawpacketqueue; // 轮询时在队尾加入，GetNextPacket 无锁取出
+  // 接受或忽略列表中的 (IP, 端口) 组合，端口为零表示该IP的所有端口
+  std::unordered_set<uint64_t> acceptignoreset;
+
+  size_t maxpacksize;
+
+  // io_uring 实例及共享的提交/完成队列
+  int ringfd;
+  void *sqringptr, *cqringptr;
+  size_t sqringsize, cqringsize;
+  struct io_uring_sqe *sqes;
+  size_t sqessize;
+  unsigned int *sqhead, *sqtail, *sqmask, *sqflags, *sqarray;
+  unsigned int *cqhead, *cqtail, *cqmask;
+  struct io_uring_cqe *cqes;
+  unsigned int sqentries;
+  unsigned int sqlocaltail, sqtosubmit;
+
+  // 注册到内核的接收缓冲区环
+  struct io_uring_buf_ring *bufring;
+  size_t bufringsize;
+  uint8_t *recvbuffers;
+  size_t recvbuffersize;
+  unsigned int recvbuffercount;
+  uint16_t bufringtail;
+
+  // 缓冲区环中的数据复制到 recvbufferpool 的缓冲区中（缓冲区大小与环中的缓冲区相同），
+  // 环中的缓冲区随即归还给内核；RTPRawPacket 实例来自 rawpacketpool
+  RTPBufferPool *recvbufferpool;
+  RTPBufferPool *rawpacketpool;
+
+  struct msghdr rtprecvmsg, rtcprecvmsg;
+  struct sockaddr_in rtprecvaddr, rtcprecvaddr; // 仅用于单次接收模式
+  bool rtpreceivearmed, rtcpreceivearmed;
+  bool multishot;
+
+  std::vector<struct msghdr> sendmsgs;
+  size_t sendsoutstanding;
+
+  RTPAbortDescriptors m_abortDesc;
+  RTPAbortDescriptors *m_pAbortDesc; // 如果指定了外部描述符
+  RTPSocketWaiter m_socketWaiter; // 持久注册了 io_uring 描述符和中止描述符
+
+  std::mutex mainmutex, waitmutex;
+  int threadsafe;
+};
+
+inline void RTPIOUringTransmitter::OnSendError(const RTPEndpoint &, bool, int) {}
+
+#endif // RTP_HAVE_IO_URING
@@ -0,0 +1,130 @@
+/**
+ * \file media_rtp_raw_packet_queue.h
+ */
+
+#ifndef MEDIA_RTP_RAW_PACKET_QUEUE_H
+
+#define MEDIA_RTP_RAW_PACKET_QUEUE_H
+
+#include "rtpconfig.h"
+#include "media_rtp_packet_factory.h"
+#include "media_rtp_spsc_ring.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * 传输器的接收队列：轮询套接字的线程在队尾加入原始数据包，GetNextPacket 从队首取出。
+ *
+ * 队列同时限制数据包数量和字节数。数据包处理跟不上接收时，传输器先停止从套接字读取
+ * （见 IsFull 和 GetFreeSpace），把数据留给内核缓冲区或 TCP 流量控制；仍然放不下的
+ * 数据包（例如一次 GRO 交付中多余的分段）由 Push 拒绝，调用者删除它们，丢弃的数量
+ * 和字节数被记录下来。队列是单生产者单消费者的，生产者一侧不能移除队首的数据包，
+ * 因此这一层总是丢弃最新的数据包；按源的队列（见 RTPSources::SetPacketQueueLimits）
+ * 支持其他丢弃策略。
+ */
+class RTPRawPacketQueue {
+  MEDIA_RTP_NO_COPY(RTPRawPacketQueue)
+public:
+  RTPRawPacketQueue()
+      : m_maxBytes(0), m_bytes(0), m_numDropped(0), m_numDroppedBytes(0) {}
+  ~RTPRawPacketQueue() { Flush(); }
+
+  /** 设置队列最多容纳 \c maxpackets 个数据包（向上取整为2的幂）和 \c maxbytes
+   *  字节的数据，\c maxbytes 为零时不限制字节数。同时清零丢弃计数。
+   *  队列必须为空，调用时不能有其他线程访问队列。 */
+  int Init(size_t maxpackets, size_t maxbytes);
+
+  /** 由生产者调用：在队尾加入 \c pack。队列已满时返回 false 并记为丢弃，
+   *  数据包仍归调用者所有。 */
+  bool Push(RTPRawPacket *pack);
+
+  /** 由生产者调用：返回队列是否已满，即数据包数量或字节数达到了上限。 */
+  bool IsFull() { return GetFreeSpace() == 0; }
+
+  /** 由生产者调用：返回至少还能加入多少个数据包，字节数达到上限时为零。 */
+  size_t GetFreeSpace();
+
+  /** 由消费者调用：取出队首的数据包，队列为空时返回 0。 */
+  RTPRawPacket *Pop();
+
+  /** 返回队列是否为空，可以在任何线程中调用。 */
+  bool IsEmpty() const { return m_ring.IsEmpty(); }
+
+  /** 由消费者调用：删除队列中的所有数据包。 */
+  void Flush();
+
+  /** 返回队列中数据包的总字节数。 */
+  size_t GetNumBytes() const { return m_bytes.load(std::memory_order_relaxed); }
+
+  /** 返回因队列已满而被丢弃的数据包数量。 */
+  uint64_t GetNumDroppedPackets() const {
+    return m_numDropped.load(std::memory_order_relaxed);
+  }
+
+  /** 返回因队列已满而被丢弃的数据包的总字节数。 */
+  uint64_t GetNumDroppedBytes() const {
+    return m_numDroppedBytes.load(std::memory_order_relaxed);
+  }
+
+private:
+  RTPSPSCRing<RTPRawPacket *> m_ring;
+  size_t m_maxBytes;
+  std::atomic<size_t> m_bytes;
+  // 只由生产者修改，其他线程可以随时读取
+  std::atomic<uint64_t> m_numDropped, m_numDroppedBytes;
+};
+
+inline int RTPRawPacketQueue::Init(size_t maxpackets, size_t maxbytes) {
+  int status = m_ring.Init(maxpackets);
+  if (status < 0)
+    return status;
+
+  m_maxBytes = maxbytes;
+  m_bytes.store(0, std::memory_order_relaxed);
+  m_numDropped.store(0, std::memory_order_relaxed);
+  m_numDroppedBytes.store(0, std::memory_order_relaxed);
+  return 0;
+}
+
+inline bool RTPRawPacketQueue::Push(RTPRawPacket *pack) {
+  size_t len = pack->GetDataLength();
+
+  // 字节数在加入之前增加，消费者取出数据包后再减去，计数因此不会下溢。
+  // 队列为空时总是接受，否则比上限还大的数据包永远无法交付
+  size_t prevbytes = m_bytes.fetch_add(len, std::memory_order_relaxed);
+  if ((m_maxBytes != 0 && prevbytes != 0 && prevbytes + len > m_maxBytes) ||
+      !m_ring.Push(pack)) {
+    m_bytes.fetch_sub(len, std::memory_order_relaxed);
+    m_numDropped.store(m_numDropped.load(std::memory_order_relaxed) + 1,
+                       std::memory_order_relaxed);
+    m_numDroppedBytes.store(m_numDroppedBytes.load(std::memory_order_relaxed) + len,
+                            std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+inline size_t RTPRawPacketQueue::GetFreeSpace() {
+  if (m_maxBytes != 0 && m_bytes.load(std::memory_order_relaxed) >= m_maxBytes)
+    return 0;
+  return m_ring.GetFreeSpace();
+}
+
+inline RTPRawPacket *RTPRawPacketQueue::Pop() {
+  RTPRawPacket *pack;
+
+  if (!m_ring.Pop(&pack))
+    return 0;
+  m_bytes.fetch_sub(pack->GetDataLength(), std::memory_order_relaxed);
+  return pack;
+}
+
+inline void RTPRawPacketQueue::Flush() {
+  RTPRawPacket *pack;
+
+  while ((pack = Pop()) != 0)
+    delete pack;
+}
+
+#endif // MEDIA_RTP_RAW_PACKET_QUEUE_H
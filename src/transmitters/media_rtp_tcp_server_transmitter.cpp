@@ -0,0 +1,1124 @@
+#include "media_rtp_tcp_server_transmitter.h"
+#include "media_rtp_packet_factory.h"
+#include "media_rtp_endpoint.h"
+#include "media_rtp_spsc_ring.h"
+#include "media_rtp_utils.h"
+#include "media_rtp_errors.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <errno.h>
+#include <new>
+#include <unordered_set>
+
+#define RTPTCPSERVERTRANS_MAXPACKSIZE							65535
+#define RTPTCPSERVERTRANS_FRAMEBUFFERSIZE						2048
+#define RTPTCPSERVERTRANS_FRAMEPOOLIDLE							256
+#define RTPTCPSERVERTRANS_FRAMERINGSIZE							1024
+#define RTPTCPSERVERTRANS_WAITSECONDS							1
+#define RTPTCPSERVERTRANS_BACKOFFMICROSECONDS						1000
+
+	#define MAINMUTEX_LOCK 		{ if (m_threadsafe) m_mainMutex.lock(); }
+	#define MAINMUTEX_UNLOCK	{ if (m_threadsafe) m_mainMutex.unlock(); }
+	#define WAITMUTEX_LOCK		{ if (m_threadsafe) m_waitMutex.lock(); }
+	#define WAITMUTEX_UNLOCK	{ if (m_threadsafe) m_waitMutex.unlock(); }
+
+// 交给反应器发送的帧，数据紧跟在后面；最后一个用完它的反应器将其归还
+struct RTPTCPServerTransmitter::SharedFrame
+{
+	std::atomic<size_t> m_refCount;
+	size_t m_length;
+
+	uint8_t *GetData()											{ return reinterpret_cast<uint8_t *>(this+1); }
+};
+
+// 一个反应器：在自己的线程中等待和轮询的边沿触发 TCP 传输器。连接的集合由接受线程、
+// 会话线程和反应器线程共享，其余的状态只在反应器线程中访问
+class RTPTCPServerTransmitter::Reactor : public RTPTCPTransmitter
+{
+public:
+	Reactor(RTPTCPServerTransmitter &server);
+	~Reactor();
+
+	int Start(size_t maxpacksize, const RTPTCPTransmissionParams &connparams, size_t maxpackets, size_t maxbytes);
+	void Stop();
+
+	int AddConnection(int sock);
+	bool RequestClose(int sock);
+	void RequestCloseAll();
+	bool PushFrame(SharedFrame *frame);
+	size_t GetNumConnections() const							{ return m_numConnections.load(std::memory_order_relaxed); }
+protected:
+	// 只会在反应器线程中调用：Poll 和发送都在这个线程中进行
+	void OnSendError(int sock)									{ m_failedSockets.push_back(sock); }
+	void OnReceiveError(int sock)								{ m_failedSockets.push_back(sock); }
+private:
+	void Run();
+	void Wake();
+	void SendFrames();
+	void CloseConnections();
+	bool ReleaseConnection(int sock);
+
+	RTPTCPServerTransmitter &m_server;
+	RTPAbortDescriptors m_abortDesc;
+	RTPSPSCRing<SharedFrame *> m_frames; // 由会话线程在主锁内加入
+	std::atomic<bool> m_stop, m_signalled;
+	std::thread m_thread;
+
+	std::mutex m_connectionMutex;
+	std::unordered_set<int> m_sockets; // 属于这个反应器、尚未关闭的连接
+	std::vector<int> m_closeRequests;
+	std::atomic<size_t> m_numConnections;
+
+	std::vector<int> m_failedSockets;
+	std::vector<int> m_closingSockets;
+};
+
+RTPTCPServerTransmitter::Reactor::Reactor(RTPTCPServerTransmitter &server) : RTPTCPTransmitter(), m_server(server)
+{
+	m_stop = false;
+	m_signalled = false;
+	m_numConnections = 0;
+}
+
+RTPTCPServerTransmitter::Reactor::~Reactor()
+{
+	Stop();
+}
+
+int RTPTCPServerTransmitter::Reactor::Start(size_t maxpacksize, const RTPTCPTransmissionParams &connparams, size_t maxpackets, size_t maxbytes)
+{
+	RTPTCPTransmissionParams params = connparams;
+	int status;
+
+	if ((status = m_abortDesc.Init()) < 0)
+		return status;
+	if ((status = m_frames.Init(RTPTCPSERVERTRANS_FRAMERINGSIZE)) < 0)
+	{
+		m_abortDesc.Destroy();
+		return status;
+	}
+
+	// 接受线程和会话线程会添加或移除连接，因此需要线程安全
+	params.SetCreatedAbortDescriptors(&m_abortDesc);
+	params.SetEdgeTriggered(true);
+	params.SetReceiveQueueLimits(maxpackets, maxbytes);
+	if ((status = Init(true)) < 0 || (status = Create(maxpacksize, &params)) < 0)
+	{
+		m_frames.Destroy();
+		m_abortDesc.Destroy();
+		return status;
+	}
+
+	m_stop = false;
+	m_signalled = false;
+	try {
+		m_thread = std::thread(&RTPTCPServerTransmitter::Reactor::Run, this);
+	} catch (...) {
+		Destroy();
+		m_frames.Destroy();
+		m_abortDesc.Destroy();
+		return MEDIA_RTP_ERR_OPERATION_FAILED;
+	}
+	return 0;
+}
+
+void RTPTCPServerTransmitter::Reactor::Stop()
+{
+	if (!m_thread.joinable())
+		return;
+
+	m_stop = true;
+	m_abortDesc.SendAbortSignal();
+	m_thread.join();
+
+	SharedFrame *frame;
+	while (m_frames.Pop(&frame))
+		ReleaseFrame(frame);
+	m_frames.Destroy();
+
+	// 先从传输器中移除再关闭，关闭后描述符的编号可能立即被重新使用
+	Destroy();
+	for (std::unordered_set<int>::const_iterator it = m_sockets.begin() ; it != m_sockets.end() ; ++it)
+		RTPCLOSE(*it);
+	m_sockets.clear();
+	m_closeRequests.clear();
+	m_failedSockets.clear();
+	m_numConnections = 0;
+	m_abortDesc.Destroy();
+}
+
+// 连接由反应器接管；失败时连接仍归调用者所有
+int RTPTCPServerTransmitter::Reactor::AddConnection(int sock)
+{
+	// 加入集合和注册到传输器在同一个临界区中完成：否则关闭请求可能在两者之间被
+	// 反应器线程处理，之后注册的是已经关闭（甚至已被重新使用）的描述符。
+	// AddDestination 获取传输器自己的锁，反应器线程从不在持有它时获取本锁
+	std::lock_guard<std::mutex> lock(m_connectionMutex);
+	if (m_sockets.find(sock) != m_sockets.end())
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	// 注册后的事件立即由反应器线程的 epoll 等待接收，不需要唤醒它
+	int status = AddDestination(RTPEndpoint(sock));
+	if (status < 0)
+		return status;
+	m_sockets.insert(sock);
+	m_numConnections++;
+	return 0;
+}
+
+bool RTPTCPServerTransmitter::Reactor::RequestClose(int sock)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_connectionMutex);
+		if (m_sockets.find(sock) == m_sockets.end())
+			return false;
+		m_closeRequests.push_back(sock);
+	}
+	Wake();
+	return true;
+}
+
+void RTPTCPServerTransmitter::Reactor::RequestCloseAll()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_connectionMutex);
+		m_closeRequests.insert(m_closeRequests.end(), m_sockets.begin(), m_sockets.end());
+	}
+	Wake();
+}
+
+// 由会话线程在主锁内调用；环已满说明反应器来不及发送，返回 false
+bool RTPTCPServerTransmitter::Reactor::PushFrame(SharedFrame *frame)
+{
+	if (!m_frames.Push(frame))
+		return false;
+	Wake();
+	return true;
+}
+
+void RTPTCPServerTransmitter::Reactor::Wake()
+{
+	// 反应器线程醒来后才清除标志，在此之前不需要再写入中止描述符
+	if (!m_signalled.exchange(true))
+		m_abortDesc.SendAbortSignal();
+}
+
+void RTPTCPServerTransmitter::Reactor::Run()
+{
+	while (!m_stop)
+	{
+		// 会话来不及取走数据包时接收队列是满的，就绪的套接字留在列表中，等待不会阻塞；
+		// 稍作休眠而不是空转，数据留在内核中由 TCP 流量控制减慢对端
+		if (IsReceiveQueueFull())
+			RTPTime::Wait(RTPTime(0, RTPTCPSERVERTRANS_BACKOFFMICROSECONDS));
+
+		WaitForIncomingData(RTPTime(RTPTCPSERVERTRANS_WAITSECONDS, 0));
+		m_signalled = false;
+
+		SendFrames();
+		Poll();
+		CloseConnections();
+
+		if (NewDataAvailable())
+			m_server.NotifyDataAvailable();
+	}
+}
+
+void RTPTCPServerTransmitter::Reactor::SendFrames()
+{
+	SharedFrame *frame;
+
+	while (m_frames.Pop(&frame))
+	{
+		SendRTPData(frame->GetData(), frame->m_length);
+		ReleaseFrame(frame);
+	}
+}
+
+// 关闭出错的连接和被请求关闭的连接；一个连接可能出现多次，只关闭一次
+void RTPTCPServerTransmitter::Reactor::CloseConnections()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_connectionMutex);
+		m_closingSockets.swap(m_closeRequests);
+	}
+	m_closingSockets.insert(m_closingSockets.end(), m_failedSockets.begin(), m_failedSockets.end());
+	m_failedSockets.clear();
+
+	for (size_t i = 0 ; i < m_closingSockets.size() ; i++)
+	{
+		int sock = m_closingSockets[i];
+
+		if (!ReleaseConnection(sock))
+			continue;
+		DeleteDestination(RTPEndpoint(sock)); // Disconnect 策略时已被移除
+		RTPCLOSE(sock);
+		m_server.OnConnectionClosed(sock);
+	}
+	m_closingSockets.clear();
+}
+
+// 连接仍属于这个反应器时将其移除并返回 true，调用者负责关闭它
+bool RTPTCPServerTransmitter::Reactor::ReleaseConnection(int sock)
+{
+	std::lock_guard<std::mutex> lock(m_connectionMutex);
+	if (m_sockets.erase(sock) == 0)
+		return false;
+	m_numConnections--;
+	return true;
+}
+
+RTPTCPServerTransmitter::RTPTCPServerTransmitter() : RTPTransmitter()
+{
+	m_created = false;
+	m_init = false;
+	m_waitingForData = false;
+	m_listenSock = RTPSOCKERR;
+	m_port = 0;
+	m_nextReactor = 0;
+	m_pFramePool = 0;
+	m_numDroppedSendPackets = 0;
+	m_numDroppedSendBytes = 0;
+	m_stopAccept = false;
+	m_dataSignalled = false;
+}
+
+RTPTCPServerTransmitter::~RTPTCPServerTransmitter()
+{
+	Destroy();
+	DeleteReactors();
+}
+
+int RTPTCPServerTransmitter::Init(bool tsafe)
+{
+	if (m_init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	m_threadsafe = tsafe;
+
+	m_maxPackSize = RTPTCPSERVERTRANS_MAXPACKSIZE;
+	m_init = true;
+	return 0;
+}
+
+int RTPTCPServerTransmitter::Create(size_t maximumpacketsize, const RTPTransmissionParams *transparams)
+{
+	const RTPTCPServerTransmissionParams *params,defaultparams;
+	int status;
+
+	if (!m_init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	MAINMUTEX_LOCK
+
+	if (m_created)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	}
+
+	// 获取传输参数
+
+	if (transparams == 0)
+		params = &defaultparams;
+	else
+	{
+		if (transparams->GetTransmissionProtocol() != RTPTransmitter::TCPServerProto)
+		{
+			MAINMUTEX_UNLOCK
+			return MEDIA_RTP_ERR_INVALID_PARAMETER;
+		}
+		params = static_cast<const RTPTCPServerTransmissionParams *>(transparams);
+	}
+
+	if (!params->GetCreatedAbortDescriptors())
+	{
+		if ((status = m_abortDesc.Init()) < 0)
+		{
+			MAINMUTEX_UNLOCK
+			return status;
+		}
+		m_pAbortDesc = &m_abortDesc;
+	}
+	else
+	{
+		m_pAbortDesc = params->GetCreatedAbortDescriptors();
+		if (!m_pAbortDesc->IsInitialized())
+		{
+			MAINMUTEX_UNLOCK
+			return MEDIA_RTP_ERR_INVALID_STATE;
+		}
+	}
+
+	// 会话等待中止描述符和反应器的通知
+	if ((status = m_notifyDesc.Init()) < 0 ||
+	    (status = m_socketWaiter.Init()) < 0 ||
+	    (status = m_socketWaiter.AddSocket(m_pAbortDesc->GetAbortSocket())) < 0 ||
+	    (status = m_socketWaiter.AddSocket(m_notifyDesc.GetAbortSocket())) < 0)
+	{
+		DestroyResources();
+		MAINMUTEX_UNLOCK
+		return status;
+	}
+	m_dataSignalled = false;
+
+	m_pFramePool = RTPBufferPool::Create(sizeof(SharedFrame)+RTPTCPSERVERTRANS_FRAMEBUFFERSIZE, RTPTCPSERVERTRANS_FRAMEPOOLIDLE);
+	if (m_pFramePool == 0)
+	{
+		DestroyResources();
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_RESOURCE_ERROR;
+	}
+
+	if ((status = CreateListenSocket(params)) < 0)
+	{
+		DestroyResources();
+		MAINMUTEX_UNLOCK
+		return status;
+	}
+
+	// 上一次 Create 的反应器保留到现在，之前无锁的 GetNextPacket 可能还在使用它们
+	DeleteReactors();
+	if ((status = CreateReactors(maximumpacketsize, params)) < 0)
+	{
+		StopThreads();
+		DestroyResources();
+		MAINMUTEX_UNLOCK
+		return status;
+	}
+
+	m_stopAccept = false;
+	try {
+		m_acceptThread = std::thread(&RTPTCPServerTransmitter::AcceptThread, this);
+	} catch (...) {
+		StopThreads();
+		DestroyResources();
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_OPERATION_FAILED;
+	}
+
+	m_numDroppedSendPackets = 0;
+	m_numDroppedSendBytes = 0;
+	m_waitingForData = false;
+	m_created = true;
+	MAINMUTEX_UNLOCK
+	return 0;
+}
+
+void RTPTCPServerTransmitter::Destroy()
+{
+	if (!m_init)
+		return;
+
+	MAINMUTEX_LOCK
+	if (!m_created)
+	{
+		MAINMUTEX_UNLOCK;
+		return;
+	}
+
+	m_created = false;
+
+	if (m_waitingForData)
+	{
+		m_pAbortDesc->SendAbortSignal();
+		MAINMUTEX_UNLOCK
+		WAITMUTEX_LOCK // 确保 WaitForIncomingData 函数已结束
+		WAITMUTEX_UNLOCK
+		MAINMUTEX_LOCK
+	}
+
+	// 反应器线程调用 OnConnectionClosed 时不持有主锁，应用程序可能在其中调用传输器的
+	// 函数，因此等待线程结束时不能持有主锁
+	MAINMUTEX_UNLOCK
+	StopThreads();
+	MAINMUTEX_LOCK
+
+	DestroyResources();
+	MAINMUTEX_UNLOCK
+}
+
+RTPTransmissionInfo *RTPTCPServerTransmitter::GetTransmissionInfo()
+{
+	if (!m_init)
+		return 0;
+
+	MAINMUTEX_LOCK
+	RTPTransmissionInfo *tinf = new RTPTCPServerTransmissionInfo(m_listenSock, m_port, m_reactors.size());
+	MAINMUTEX_UNLOCK
+	return tinf;
+}
+
+void RTPTCPServerTransmitter::DeleteTransmissionInfo(RTPTransmissionInfo *i)
+{
+	if (!m_init)
+		return;
+
+	delete i;
+}
+
+int RTPTCPServerTransmitter::GetLocalHostName(uint8_t *buffer,size_t *bufferlength)
+{
+	if (!m_init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	MAINMUTEX_LOCK
+	if (!m_created)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	}
+
+	if (m_localHostname.size() == 0)
+	{
+		//
+		// 主机名解析未实现，使用默认值
+		//
+		m_localHostname.resize(9);
+		memcpy(&m_localHostname[0], "localhost", m_localHostname.size());
+	}
+
+	if ((*bufferlength) < m_localHostname.size())
+	{
+		*bufferlength = m_localHostname.size(); // 告诉应用程序所需的缓冲区大小
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_RESOURCE_ERROR;
+	}
+
+	memcpy(buffer,&m_localHostname[0], m_localHostname.size());
+	*bufferlength = m_localHostname.size();
+
+	MAINMUTEX_UNLOCK
+	return 0;
+}
+
+bool RTPTCPServerTransmitter::ComesFromThisTransmitter(const RTPEndpoint *addr)
+{
+	// 与 RTPTCPTransmitter 相同，假设不会向同一传输器发送
+	MEDIA_RTP_UNUSED(addr);
+	return false;
+}
+
+int RTPTCPServerTransmitter::Poll()
+{
+	if (!m_init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	MAINMUTEX_LOCK
+	if (!m_created)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	}
+	MAINMUTEX_UNLOCK
+
+	// 套接字由反应器线程轮询，收到的数据包已经在它们的队列中
+	return 0;
+}
+
+int RTPTCPServerTransmitter::WaitForIncomingData(const RTPTime &delay,bool *dataavailable)
+{
+	if (!m_init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	MAINMUTEX_LOCK
+
+	if (!m_created)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	}
+	if (m_waitingForData)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	}
+
+	// 队列中已有数据包时反应器可能不会再通知，不能等待
+	RTPTime timeout = delay;
+	if (NewDataAvailable())
+		timeout = RTPTime(0,0);
+
+	int abortSocket = m_pAbortDesc->GetAbortSocket();
+	int notifySocket = m_notifyDesc.GetAbortSocket();
+	int socks[2];
+
+	m_waitingForData = true;
+
+	WAITMUTEX_LOCK
+	MAINMUTEX_UNLOCK
+
+	int status = m_socketWaiter.Wait(timeout, socks, 2);
+	if (status < 0)
+	{
+		MAINMUTEX_LOCK
+		m_waitingForData = false;
+		MAINMUTEX_UNLOCK
+		WAITMUTEX_UNLOCK
+		return status;
+	}
+
+	MAINMUTEX_LOCK
+	m_waitingForData = false;
+	if (!m_created) // 调用销毁
+	{
+		MAINMUTEX_UNLOCK;
+		WAITMUTEX_UNLOCK
+		return 0;
+	}
+
+	for (int i = 0 ; i < status ; i++)
+	{
+		if (socks[i] == abortSocket)
+			m_pAbortDesc->ReadSignallingByte();
+		else if (socks[i] == notifySocket)
+		{
+			// 先读取再清除标志，之后加入的数据包会再次通知
+			m_notifyDesc.ReadSignallingByte();
+			m_dataSignalled = false;
+		}
+	}
+
+	if (dataavailable != 0)
+		*dataavailable = NewDataAvailable();
+
+	MAINMUTEX_UNLOCK
+	WAITMUTEX_UNLOCK
+	return 0;
+}
+
+int RTPTCPServerTransmitter::AbortWait()
+{
+	if (!m_init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	MAINMUTEX_LOCK
+	if (!m_created)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	}
+	if (!m_waitingForData)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	}
+
+	m_pAbortDesc->SendAbortSignal();
+
+	MAINMUTEX_UNLOCK
+	return 0;
+}
+
+int RTPTCPServerTransmitter::SendRTPData(const void *data,size_t len)
+{
+	struct iovec iov;
+
+	iov.iov_base = const_cast<void *>(data);
+	iov.iov_len = len;
+	return SendToReactors(&iov, 1);
+}
+
+int RTPTCPServerTransmitter::SendRTCPData(const void *data,size_t len)
+{
+	struct iovec iov;
+
+	iov.iov_base = const_cast<void *>(data);
+	iov.iov_len = len;
+	return SendToReactors(&iov, 1);
+}
+
+int RTPTCPServerTransmitter::SendRTPDataV(const struct iovec *iov, size_t iovcount)
+{
+	if (iovcount > RTPTRANS_MAXSENDIOV)
+		return MEDIA_RTP_ERR_INVALID_PARAMETER;
+	return SendToReactors(iov, iovcount);
+}
+
+// 把已建立的连接交给连接最少的反应器
+int RTPTCPServerTransmitter::AddDestination(const RTPEndpoint &addr)
+{
+	if (!m_init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	MAINMUTEX_LOCK
+
+	if (!m_created)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	}
+
+	if (addr.GetType() != RTPEndpoint::TCP || addr.GetSocket() == 0)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_PARAMETER;
+	}
+
+	int status = AssignConnection(addr.GetSocket());
+
+	MAINMUTEX_UNLOCK
+	return status;
+}
+
+// 连接在它的反应器线程中被移除并关闭
+int RTPTCPServerTransmitter::DeleteDestination(const RTPEndpoint &addr)
+{
+	if (!m_init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	MAINMUTEX_LOCK
+
+	if (!m_created)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	}
+
+	if (addr.GetType() != RTPEndpoint::TCP || addr.GetSocket() == 0)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_PARAMETER;
+	}
+
+	for (size_t i = 0 ; i < m_reactors.size() ; i++)
+	{
+		if (m_reactors[i]->RequestClose(addr.GetSocket()))
+		{
+			MAINMUTEX_UNLOCK
+			return 0;
+		}
+	}
+
+	MAINMUTEX_UNLOCK
+	return MEDIA_RTP_ERR_INVALID_STATE;
+}
+
+void RTPTCPServerTransmitter::ClearDestinations()
+{
+	if (!m_init)
+		return;
+
+	MAINMUTEX_LOCK
+	if (m_created)
+	{
+		for (size_t i = 0 ; i < m_reactors.size() ; i++)
+			m_reactors[i]->RequestCloseAll();
+	}
+	MAINMUTEX_UNLOCK
+}
+
+bool RTPTCPServerTransmitter::SupportsMulticasting()
+{
+	return false;
+}
+
+int RTPTCPServerTransmitter::JoinMulticastGroup(const RTPEndpoint &)
+{
+	return MEDIA_RTP_ERR_OPERATION_FAILED;
+}
+
+int RTPTCPServerTransmitter::LeaveMulticastGroup(const RTPEndpoint &)
+{
+	return MEDIA_RTP_ERR_OPERATION_FAILED;
+}
+
+void RTPTCPServerTransmitter::LeaveAllMulticastGroups()
+{
+}
+
+int RTPTCPServerTransmitter::SetReceiveMode(RTPTransmitter::ReceiveMode m)
+{
+	if (m != RTPTransmitter::AcceptAll)
+		return MEDIA_RTP_ERR_OPERATION_FAILED;
+	return 0;
+}
+
+int RTPTCPServerTransmitter::AddToIgnoreList(const RTPEndpoint &)
+{
+	return MEDIA_RTP_ERR_OPERATION_FAILED;
+}
+
+int RTPTCPServerTransmitter::DeleteFromIgnoreList(const RTPEndpoint &)
+{
+	return MEDIA_RTP_ERR_OPERATION_FAILED;
+}
+
+void RTPTCPServerTransmitter::ClearIgnoreList()
+{
+}
+
+int RTPTCPServerTransmitter::AddToAcceptList(const RTPEndpoint &)
+{
+	return MEDIA_RTP_ERR_OPERATION_FAILED;
+}
+
+int RTPTCPServerTransmitter::DeleteFromAcceptList(const RTPEndpoint &)
+{
+	return MEDIA_RTP_ERR_OPERATION_FAILED;
+}
+
+void RTPTCPServerTransmitter::ClearAcceptList()
+{
+}
+
+int RTPTCPServerTransmitter::SetMaximumPacketSize(size_t s)
+{
+	if (!m_init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	MAINMUTEX_LOCK
+	if (!m_created)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	}
+	if (s > RTPTCPSERVERTRANS_MAXPACKSIZE)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_RESOURCE_ERROR;
+	}
+	m_maxPackSize = s;
+	MAINMUTEX_UNLOCK
+	return 0;
+}
+
+bool RTPTCPServerTransmitter::NewDataAvailable()
+{
+	if (!m_init)
+		return false;
+
+	for (size_t i = 0 ; i < m_reactors.size() ; i++)
+	{
+		if (m_reactors[i]->NewDataAvailable())
+			return true;
+	}
+	return false;
+}
+
+RTPRawPacket *RTPTCPServerTransmitter::GetNextPacket()
+{
+	if (!m_init)
+		return 0;
+
+	// 不需要主锁：每个反应器的队列都是无锁的，这里是它们唯一的消费者。
+	// 每次从下一个反应器开始，一个繁忙的反应器不会使其他反应器的数据包一直等待
+	size_t num = m_reactors.size();
+	for (size_t i = 0 ; i < num ; i++)
+	{
+		Reactor *reactor = m_reactors[m_nextReactor];
+		if (++m_nextReactor >= num)
+			m_nextReactor = 0;
+
+		RTPRawPacket *pack = reactor->GetNextPacket();
+		if (pack != 0)
+			return pack;
+	}
+	return 0;
+}
+
+uint64_t RTPTCPServerTransmitter::GetNumDroppedPackets()
+{
+	uint64_t num = 0;
+	for (size_t i = 0 ; i < m_reactors.size() ; i++)
+		num += m_reactors[i]->GetNumDroppedPackets();
+	return num;
+}
+
+uint64_t RTPTCPServerTransmitter::GetNumDroppedBytes()
+{
+	uint64_t num = 0;
+	for (size_t i = 0 ; i < m_reactors.size() ; i++)
+		num += m_reactors[i]->GetNumDroppedBytes();
+	return num;
+}
+
+size_t RTPTCPServerTransmitter::GetNumConnections()
+{
+	size_t num = 0;
+	for (size_t i = 0 ; i < m_reactors.size() ; i++)
+		num += m_reactors[i]->GetNumConnections();
+	return num;
+}
+
+uint64_t RTPTCPServerTransmitter::GetNumDroppedSendPackets()
+{
+	uint64_t num = m_numDroppedSendPackets.load(std::memory_order_relaxed);
+	for (size_t i = 0 ; i < m_reactors.size() ; i++)
+		num += m_reactors[i]->GetNumDroppedSendPackets();
+	return num;
+}
+
+uint64_t RTPTCPServerTransmitter::GetNumDroppedSendBytes()
+{
+	uint64_t num = m_numDroppedSendBytes.load(std::memory_order_relaxed);
+	for (size_t i = 0 ; i < m_reactors.size() ; i++)
+		num += m_reactors[i]->GetNumDroppedSendBytes();
+	return num;
+}
+
+// 私有函数从这里开始...
+
+int RTPTCPServerTransmitter::CreateListenSocket(const RTPTCPServerTransmissionParams *params)
+{
+	int sock = socket(AF_INET, SOCK_STREAM|SOCK_NONBLOCK|SOCK_CLOEXEC, 0);
+	if (sock == RTPSOCKERR)
+		return MEDIA_RTP_ERR_RESOURCE_ERROR;
+
+	int reuse = 1;
+	setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const char *)&reuse, sizeof(int));
+
+	struct sockaddr_in addr;
+	socklen_t addrlen = sizeof(addr);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(params->GetPort());
+	addr.sin_addr.s_addr = htonl(params->GetBindIP());
+	if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+	    listen(sock, params->GetListenBacklog()) != 0 ||
+	    getsockname(sock, (struct sockaddr *)&addr, &addrlen) != 0)
+	{
+		RTPCLOSE(sock);
+		return MEDIA_RTP_ERR_OPERATION_FAILED;
+	}
+
+	// 接受线程等待新的连接，或者停止时的中止信号
+	int status;
+	if ((status = m_acceptAbortDesc.Init()) < 0 ||
+	    (status = m_acceptWaiter.Init()) < 0 ||
+	    (status = m_acceptWaiter.AddSocket(sock)) < 0 ||
+	    (status = m_acceptWaiter.AddSocket(m_acceptAbortDesc.GetAbortSocket())) < 0)
+	{
+		m_acceptWaiter.Destroy();
+		m_acceptAbortDesc.Destroy();
+		RTPCLOSE(sock);
+		return status;
+	}
+
+	m_listenSock = sock;
+	m_port = ntohs(addr.sin_port);
+	return 0;
+}
+
+int RTPTCPServerTransmitter::CreateReactors(size_t maxpacksize, const RTPTCPServerTransmissionParams *params)
+{
+	size_t num = params->GetNumReactors();
+	if (num == 0)
+		num = std::thread::hardware_concurrency();
+	if (num == 0)
+		num = 1;
+
+	m_nextReactor = 0;
+	for (size_t i = 0 ; i < num ; i++)
+	{
+		Reactor *reactor = new Reactor(*this);
+		m_reactors.push_back(reactor);
+
+		int status = reactor->Start(maxpacksize, params->GetConnectionParams(), params->GetReceiveQueueMaximumPackets(),
+		                            params->GetReceiveQueueMaximumBytes());
+		if (status < 0)
+			return status;
+	}
+	return 0;
+}
+
+void RTPTCPServerTransmitter::StopThreads()
+{
+	if (m_acceptThread.joinable())
+	{
+		m_stopAccept = true;
+		m_acceptAbortDesc.SendAbortSignal();
+		m_acceptThread.join();
+	}
+
+	// 反应器的线程结束后它的连接被关闭，队列被清空
+	for (size_t i = 0 ; i < m_reactors.size() ; i++)
+		m_reactors[i]->Stop();
+}
+
+void RTPTCPServerTransmitter::DestroyResources()
+{
+	m_acceptWaiter.Destroy();
+	m_acceptAbortDesc.Destroy();
+	if (m_listenSock != RTPSOCKERR)
+	{
+		RTPCLOSE(m_listenSock);
+		m_listenSock = RTPSOCKERR;
+	}
+
+	if (m_pFramePool != 0)
+	{
+		m_pFramePool->Destroy();
+		m_pFramePool = 0;
+	}
+
+	// 等待结束后才能关闭描述符，关闭的描述符会从 epoll 集合中移除而不再唤醒等待
+	m_socketWaiter.Destroy();
+	m_notifyDesc.Destroy();
+	m_abortDesc.Destroy(); // 如果未初始化，则不执行任何操作
+}
+
+void RTPTCPServerTransmitter::DeleteReactors()
+{
+	for (size_t i = 0 ; i < m_reactors.size() ; i++)
+		delete m_reactors[i];
+	m_reactors.clear();
+	m_nextReactor = 0;
+}
+
+void RTPTCPServerTransmitter::AcceptThread()
+{
+	int abortSocket = m_acceptAbortDesc.GetAbortSocket();
+	int socks[2];
+
+	while (!m_stopAccept)
+	{
+		int status = m_acceptWaiter.Wait(RTPTime(RTPTCPSERVERTRANS_WAITSECONDS, 0), socks, 2);
+		if (status < 0)
+		{
+			RTPTime::Wait(RTPTime(0, RTPTCPSERVERTRANS_BACKOFFMICROSECONDS));
+			continue;
+		}
+
+		for (int i = 0 ; i < status ; i++)
+		{
+			if (socks[i] == abortSocket)
+				m_acceptAbortDesc.ReadSignallingByte();
+		}
+		if (!m_stopAccept)
+			AcceptConnections();
+	}
+}
+
+// 监听套接字是非阻塞的，接受所有排队的连接直到 EAGAIN
+void RTPTCPServerTransmitter::AcceptConnections()
+{
+	for (;;)
+	{
+		int sock = accept4(m_listenSock, 0, 0, SOCK_CLOEXEC);
+		if (sock == RTPSOCKERR)
+		{
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			// 描述符或内存用完时连接留在积压队列中，监听套接字仍然可读，稍后再试
+			if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM)
+				RTPTime::Wait(RTPTime(0, RTPTCPSERVERTRANS_BACKOFFMICROSECONDS));
+			return;
+		}
+
+		// 帧通常很小，不应等待更多数据凑成一个报文段
+		int nodelay = 1;
+		setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char *)&nodelay, sizeof(int));
+
+		OnNewConnection(sock);
+		if (AssignConnection(sock) < 0)
+		{
+			RTPCLOSE(sock);
+			OnConnectionClosed(sock);
+		}
+	}
+}
+
+// 选择连接最少的反应器；可以在接受线程和会话线程中调用
+int RTPTCPServerTransmitter::AssignConnection(int sock)
+{
+	Reactor *best = m_reactors[0];
+
+	for (size_t i = 1 ; i < m_reactors.size() ; i++)
+	{
+		if (m_reactors[i]->GetNumConnections() < best->GetNumConnections())
+			best = m_reactors[i];
+	}
+	return best->AddConnection(sock);
+}
+
+// 帧的各个数据块只复制一次，由所有有连接的反应器共享
+int RTPTCPServerTransmitter::SendToReactors(const struct iovec *iov, size_t iovcount)
+{
+	if (!m_init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	MAINMUTEX_LOCK
+
+	if (!m_created)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	}
+
+	size_t len = RTPGetIOVecLength(iov, iovcount);
+	if (len > RTPTCPSERVERTRANS_MAXPACKSIZE)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_RESOURCE_ERROR;
+	}
+	if (GetNumConnections() == 0)
+	{
+		MAINMUTEX_UNLOCK
+		return 0;
+	}
+
+	uint8_t *buffer;
+	if (sizeof(SharedFrame)+len <= m_pFramePool->GetBufferSize())
+		buffer = m_pFramePool->Allocate();
+	else
+		buffer = RTPBufferPool::AllocateUnpooled(sizeof(SharedFrame)+len);
+	if (buffer == 0)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_RESOURCE_ERROR;
+	}
+
+	// 每个反应器一个引用，再加上这里持有的一个，循环中帧不会被提前归还
+	SharedFrame *frame = new (buffer) SharedFrame;
+	frame->m_refCount = m_reactors.size()+1;
+	frame->m_length = len;
+	RTPCopyIOVec(iov, iovcount, 0, frame->GetData());
+
+	uint64_t numDropped = 0;
+	for (size_t i = 0 ; i < m_reactors.size() ; i++)
+	{
+		Reactor *reactor = m_reactors[i];
+		size_t numConnections = reactor->GetNumConnections();
+
+		if (numConnections == 0)
+			ReleaseFrame(frame);
+		else if (!reactor->PushFrame(frame))
+		{
+			numDropped += numConnections;
+			ReleaseFrame(frame);
+		}
+	}
+	ReleaseFrame(frame);
+
+	if (numDropped != 0)
+	{
+		m_numDroppedSendPackets += numDropped;
+		m_numDroppedSendBytes += numDropped*len;
+	}
+
+	MAINMUTEX_UNLOCK
+
+	// 不要返回错误代码：来不及处理的反应器不应使轮询线程退出
+	return 0;
+}
+
+// 由反应器线程在它的队列不为空时调用
+void RTPTCPServerTransmitter::NotifyDataAvailable()
+{
+	if (!m_dataSignalled.exchange(true))
+		m_notifyDesc.SendAbortSignal();
+}
+
+void RTPTCPServerTransmitter::ReleaseFrame(SharedFrame *frame)
+{
+	if (frame->m_refCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+	{
+		frame->~SharedFrame();
+		RTPBufferPool::Release(frame);
+	}
+}
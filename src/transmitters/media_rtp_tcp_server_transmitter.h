@@ -0,0 +1,257 @@
+#pragma once
+
+#include "rtpconfig.h"
+#include "media_rtp_abort_descriptors.h"
+#include "media_rtp_socket_waiter.h"
+#include "media_rtp_buffer_pool.h"
+#include "media_rtp_transmitter.h"
+#include "media_rtp_tcp_transmitter.h"
+#include <vector>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#define RTPTCPSERVERTRANS_DEFAULTPORT 5000
+#define RTPTCPSERVERTRANS_DEFAULTBACKLOG 1024
+
+/** TCP 服务器传输器的参数。 */
+class RTPTCPServerTransmissionParams : public RTPTransmissionParams {
+public:
+  RTPTCPServerTransmissionParams();
+
+  /** 设置监听套接字绑定的IP地址为 \c ip，为零时监听所有地址。 */
+  void SetBindIP(uint32_t ip) { m_bindIP = ip; }
+
+  /** 设置监听的端口号为 \c port；端口号为零将导致自动选择端口，
+   *  实际的端口可以通过 RTPTCPServerTransmissionInfo 获得。 */
+  void SetPort(uint16_t port) { m_port = port; }
+
+  /** 设置监听套接字的积压队列长度（默认为 RTPTCPSERVERTRANS_DEFAULTBACKLOG）。 */
+  void SetListenBacklog(int backlog) { m_backlog = backlog; }
+
+  /** 设置反应器线程的数量，每个线程用自己的 epoll 集合处理分配给它的连接；
+   *  为零（默认值）时使用处理器的数量。 */
+  void SetNumReactors(size_t n) { m_numReactors = n; }
+
+  /** 设置每个反应器处理连接时使用的参数，例如接收缓冲区大小和发送队列的限制。
+   *  其中的中止描述符被忽略，反应器总是使用边沿触发；接收队列的上限取自本对象
+   *  （见 RTPTransmissionParams::SetReceiveQueueLimits），对每个反应器分别生效。 */
+  void SetConnectionParams(const RTPTCPTransmissionParams &params) {
+    m_connectionParams = params;
+  }
+
+  /** 如果非空，将使用指定的中止描述符来取消
+   *  等待数据包到达的函数；设置为null（默认值）
+   *  让传输器创建自己的实例。 */
+  void SetCreatedAbortDescriptors(RTPAbortDescriptors *desc) {
+    m_pAbortDesc = desc;
+  }
+
+  /** 返回监听套接字绑定的IP地址。 */
+  uint32_t GetBindIP() const { return m_bindIP; }
+
+  /** 返回监听的端口号（默认为 RTPTCPSERVERTRANS_DEFAULTPORT）。 */
+  uint16_t GetPort() const { return m_port; }
+
+  /** 返回监听套接字的积压队列长度。 */
+  int GetListenBacklog() const { return m_backlog; }
+
+  /** 返回反应器线程的数量，零表示使用处理器的数量。 */
+  size_t GetNumReactors() const { return m_numReactors; }
+
+  /** 返回每个反应器处理连接时使用的参数。 */
+  const RTPTCPTransmissionParams &GetConnectionParams() const {
+    return m_connectionParams;
+  }
+
+  /** 返回每个反应器处理连接时使用的参数，可以直接修改。 */
+  RTPTCPTransmissionParams &GetConnectionParams() { return m_connectionParams; }
+
+  /** 如果非空，将在内部使用此RTPAbortDescriptors实例，
+   *  这在为多个会话创建自己的轮询线程时很有用。 */
+  RTPAbortDescriptors *GetCreatedAbortDescriptors() const {
+    return m_pAbortDesc;
+  }
+
+private:
+  uint32_t m_bindIP;
+  uint16_t m_port;
+  int m_backlog;
+  size_t m_numReactors;
+  RTPTCPTransmissionParams m_connectionParams;
+
+  RTPAbortDescriptors *m_pAbortDesc;
+};
+
+inline RTPTCPServerTransmissionParams::RTPTCPServerTransmissionParams()
+    : RTPTransmissionParams(RTPTransmitter::TCPServerProto) {
+  m_bindIP = 0;
+  m_port = RTPTCPSERVERTRANS_DEFAULTPORT;
+  m_backlog = RTPTCPSERVERTRANS_DEFAULTBACKLOG;
+  m_numReactors = 0;
+  m_pAbortDesc = 0;
+}
+
+/** TCP 服务器传输器的附加信息。 */
+class RTPTCPServerTransmissionInfo : public RTPTransmissionInfo {
+public:
+  RTPTCPServerTransmissionInfo(int listensock, uint16_t port, size_t numreactors)
+      : RTPTransmissionInfo(RTPTransmitter::TCPServerProto) {
+    m_listenSocket = listensock;
+    m_port = port;
+    m_numReactors = numreactors;
+  }
+
+  ~RTPTCPServerTransmissionInfo() {}
+
+  /** 返回监听套接字的描述符。 */
+  int GetListenSocket() const { return m_listenSocket; }
+
+  /** 返回监听的端口号。 */
+  uint16_t GetPort() const { return m_port; }
+
+  /** 返回反应器线程的数量。 */
+  size_t GetNumReactors() const { return m_numReactors; }
+
+private:
+  int m_listenSocket;
+  uint16_t m_port;
+  size_t m_numReactors;
+};
+
+/** 接受 TCP 连接的多反应器传输组件。
+ *  此类继承RTPTransmitter接口，自己监听一个端口：接受线程接受新的连接，
+ *  并把每个连接交给当前连接最少的反应器线程。每个反应器是一个使用边沿触发的
+ *  RTPTCPTransmitter，在自己的线程中等待和轮询，连接的读取、RFC 4571 分帧和
+ *  非阻塞发送都与该传输器相同。反应器收到的数据包放在各自的无锁队列中，
+ *  GetNextPacket 轮流从这些队列中取出，因此数据包照常经过 RTPSession 的处理；
+ *  数据包的来源地址包含接收它的套接字描述符。
+ *
+ *  发送的数据只复制一次，由所有反应器共享，各反应器在自己的线程中把它发送给
+ *  自己的连接。反应器来不及处理时，数据不再交给它，计入
+ *  GetNumDroppedSendPackets。
+ *
+ *  连接由传输器拥有：对端关闭或出错的连接被移除并关闭，DeleteDestination
+ *  也会关闭指定的连接，Destroy 关闭所有连接。AddDestination 可以把已建立的
+ *  连接交给传输器，之后同样由传输器关闭。该传输器不支持多播，
+ *  也不支持接受列表和忽略列表。
+ */
+class RTPTCPServerTransmitter : public RTPTransmitter {
+  MEDIA_RTP_NO_COPY(RTPTCPServerTransmitter)
+public:
+  RTPTCPServerTransmitter();
+  ~RTPTCPServerTransmitter();
+
+  int Init(bool treadsafe);
+  int Create(size_t maxpacksize, const RTPTransmissionParams *transparams);
+  void Destroy();
+  RTPTransmissionInfo *GetTransmissionInfo();
+  void DeleteTransmissionInfo(RTPTransmissionInfo *inf);
+
+  int GetLocalHostName(uint8_t *buffer, size_t *bufferlength);
+  bool ComesFromThisTransmitter(const RTPEndpoint *addr);
+  size_t GetHeaderOverhead() { return RTPTCPTRANS_HEADERSIZE; }
+
+  int Poll();
+  int WaitForIncomingData(const RTPTime &delay, bool *dataavailable = 0);
+  int AbortWait();
+
+  int SendRTPData(const void *data, size_t len);
+  int SendRTCPData(const void *data, size_t len);
+  int SendRTPDataV(const struct iovec *iov, size_t iovcount);
+
+  int AddDestination(const RTPEndpoint &addr);
+  int DeleteDestination(const RTPEndpoint &addr);
+  void ClearDestinations();
+
+  bool SupportsMulticasting();
+  int JoinMulticastGroup(const RTPEndpoint &addr);
+  int LeaveMulticastGroup(const RTPEndpoint &addr);
+  void LeaveAllMulticastGroups();
+
+  int SetReceiveMode(RTPTransmitter::ReceiveMode m);
+  int AddToIgnoreList(const RTPEndpoint &addr);
+  int DeleteFromIgnoreList(const RTPEndpoint &addr);
+  void ClearIgnoreList();
+  int AddToAcceptList(const RTPEndpoint &addr);
+  int DeleteFromAcceptList(const RTPEndpoint &addr);
+  void ClearAcceptList();
+  int SetMaximumPacketSize(size_t s);
+
+  bool NewDataAvailable();
+  RTPRawPacket *GetNextPacket();
+  uint64_t GetNumDroppedPackets();
+  uint64_t GetNumDroppedBytes();
+
+  /** 返回当前的连接数量。 */
+  size_t GetNumConnections();
+
+  /** 返回没有发送给某个连接的帧的数量，包括连接的发送队列已满的帧和反应器
+   *  来不及处理的帧；一个帧对多个连接丢弃时按连接分别计数。 */
+  uint64_t GetNumDroppedSendPackets();
+
+  /** 返回 GetNumDroppedSendPackets 计数的帧的总字节数。 */
+  uint64_t GetNumDroppedSendBytes();
+
+protected:
+  /** 通过重写此函数，可以在接受新的连接 \c sock 后、把它交给反应器之前
+   *  得到通知，例如设置套接字选项。此函数在接受线程中调用。 */
+  virtual void OnNewConnection(int sock);
+
+  /** 通过重写此函数，可以在连接 \c sock 因对端关闭、出错或 DeleteDestination
+   *  而被关闭后得到通知；Destroy 关闭连接时不调用。此函数在反应器线程中调用，
+   *  调用时不持有传输器的内部锁。 */
+  virtual void OnConnectionClosed(int sock);
+
+private:
+  class Reactor;
+  struct SharedFrame;
+
+  int CreateListenSocket(const RTPTCPServerTransmissionParams *params);
+  int CreateReactors(size_t maxpacksize,
+                     const RTPTCPServerTransmissionParams *params);
+  void StopThreads();
+  void DestroyResources();
+  void DeleteReactors();
+  void AcceptThread();
+  void AcceptConnections();
+  int AssignConnection(int sock);
+  int SendToReactors(const struct iovec *iov, size_t iovcount);
+  void NotifyDataAvailable();
+  static void ReleaseFrame(SharedFrame *frame);
+
+  bool m_init;
+  bool m_created;
+  bool m_waitingForData;
+  bool m_threadsafe;
+
+  int m_listenSock;
+  uint16_t m_port;
+  std::vector<uint8_t> m_localHostname;
+  size_t m_maxPackSize;
+
+  // 只在 Create 和析构时改变，Destroy 之后无锁的 GetNextPacket 仍可安全调用
+  std::vector<Reactor *> m_reactors;
+  size_t m_nextReactor; // GetNextPacket 下一次首先检查的反应器
+  RTPBufferPool *m_pFramePool; // 发送给反应器的共享帧，更大的帧单独分配
+  std::atomic<uint64_t> m_numDroppedSendPackets, m_numDroppedSendBytes;
+
+  std::thread m_acceptThread;
+  std::atomic<bool> m_stopAccept;
+  RTPAbortDescriptors m_acceptAbortDesc;
+  RTPSocketWaiter m_acceptWaiter; // 监听套接字和接受线程的中止描述符
+
+  // 反应器的接收队列不再为空时通过它唤醒等待，m_dataSignalled 避免重复写入
+  RTPAbortDescriptors m_notifyDesc;
+  std::atomic<bool> m_dataSignalled;
+
+  RTPAbortDescriptors m_abortDesc;
+  RTPAbortDescriptors *m_pAbortDesc; // 如果指定了外部描述符
+  RTPSocketWaiter m_socketWaiter; // 中止描述符和通知描述符
+
+  std::mutex m_mainMutex, m_waitMutex;
+};
+
+inline void RTPTCPServerTransmitter::OnNewConnection(int) {}
+inline void RTPTCPServerTransmitter::OnConnectionClosed(int) {}
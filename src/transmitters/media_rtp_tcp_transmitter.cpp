@@ -6,6 +6,7 @@
 #include "media_rtp_structs.h"
 #include "media_rtp_errors.h"
 #include <stdio.h>
+#include <errno.h>
 #include <assert.h>
 #include <vector>
 
@@ -14,6 +15,20 @@
 using namespace std;
 
 #define RTPTCPTRANS_MAXPACKSIZE							65535
+#define RTPTCPTRANS_MAXREADYBATCH							64
+#define RTPTCPTRANS_POOLIDLEBYTES							(1024*1024)
+#define RTPTCPTRANS_POOLMINIDLE							16
+#define RTPTCPTRANS_FRAMEBUFFERSIZE							2048
+#define RTPTCPTRANS_RAWPACKETPOOLIDLE							1024
+#define RTPTCPTRANS_MAXSENDIOV							64
+#define RTPTCPTRANS_QUEUEFULLBACKOFFMICROSECONDS							10000
+
+// 发送从不阻塞，套接字由应用程序创建，可能是阻塞的
+#ifdef RTP_HAVE_MSG_NOSIGNAL
+	#define RTPTCPTRANS_SENDFLAGS							(MSG_DONTWAIT|MSG_NOSIGNAL)
+#else
+	#define RTPTCPTRANS_SENDFLAGS							MSG_DONTWAIT
+#endif // RTP_HAVE_MSG_NOSIGNAL
 
 	#define MAINMUTEX_LOCK 		{ if (m_threadsafe) m_mainMutex.lock(); }
 	#define MAINMUTEX_UNLOCK	{ if (m_threadsafe) m_mainMutex.unlock(); }
@@ -24,6 +39,11 @@ RTPTCPTransmitter::RTPTCPTransmitter() : RTPTransmitter()
 {
 	m_created = false;
 	m_init = false;
+	m_pRecvBufferPool = 0;
+	m_pFrameBufferPool = 0;
+	m_pRawPacketPool = 0;
+	m_numDroppedSendPackets = 0;
+	m_numDroppedSendBytes = 0;
 }
 
 RTPTCPTransmitter::~RTPTCPTransmitter()
@@ -74,6 +94,23 @@ int RTPTCPTransmitter::Create(size_t maximumpacketsize, const RTPTransmissionPar
 		params = static_cast<const RTPTCPTransmissionParams *>(transparams);
 	}
 
+	// 接收缓冲区的大小取2的幂，读写位置可以直接用掩码回绕
+	if (params->GetReceiveBufferSize() < RTPTCPTRANS_MINRECEIVEBUFFER)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_PARAMETER;
+	}
+	size_t recvBufferSize = 1;
+	while (recvBufferSize < params->GetReceiveBufferSize())
+		recvBufferSize <<= 1;
+
+	// 存储空间保留到下一次 Create 或析构，Destroy 之后无锁的 GetNextPacket 仍可安全调用
+	if ((status = m_rawPacketQueue.Init(params->GetReceiveQueueMaximumPackets(),params->GetReceiveQueueMaximumBytes())) < 0)
+	{
+		MAINMUTEX_UNLOCK
+		return status;
+	}
+
 	if (!params->GetCreatedAbortDescriptors())
 	{
 		if ((status = m_abortDesc.Init()) < 0)
@@ -93,6 +130,40 @@ int RTPTCPTransmitter::Create(size_t maximumpacketsize, const RTPTransmissionPar
 		}
 	}
 
+	// 目标套接字在添加时注册，这里只需注册中止描述符
+	if ((status = m_socketWaiter.Init()) >= 0)
+		status = m_socketWaiter.AddSocket(m_pAbortDesc->GetAbortSocket());
+	if (status < 0)
+	{
+		m_socketWaiter.Destroy();
+		m_abortDesc.Destroy(); // 如果未初始化，则不执行任何操作
+		MAINMUTEX_UNLOCK
+		return status;
+	}
+
+	size_t recvBufferIdle = RTPTCPTRANS_POOLIDLEBYTES/recvBufferSize;
+	if (recvBufferIdle < RTPTCPTRANS_POOLMINIDLE)
+		recvBufferIdle = RTPTCPTRANS_POOLMINIDLE;
+
+	m_pRecvBufferPool = RTPBufferPool::Create(recvBufferSize, recvBufferIdle);
+	m_pFrameBufferPool = RTPBufferPool::Create(RTPTCPTRANS_FRAMEBUFFERSIZE, RTPTCPTRANS_POOLIDLEBYTES/RTPTCPTRANS_FRAMEBUFFERSIZE);
+	m_pRawPacketPool = RTPBufferPool::Create(sizeof(RTPRawPacket), RTPTCPTRANS_RAWPACKETPOOLIDLE);
+	if (m_pRecvBufferPool == 0 || m_pFrameBufferPool == 0 || m_pRawPacketPool == 0)
+	{
+		DestroyBufferPools();
+		m_socketWaiter.Destroy();
+		m_abortDesc.Destroy(); // 如果未初始化，则不执行任何操作
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_RESOURCE_ERROR;
+	}
+
+	m_edgeTriggered = params->GetEdgeTriggered();
+	m_readySockets.clear();
+	m_outputSockets.clear();
+	m_sendQueueLimit = params->GetSendQueueLimit();
+	m_sendQueuePolicy = params->GetSendQueuePolicy();
+	m_numDroppedSendPackets = 0;
+	m_numDroppedSendBytes = 0;
 	m_waitingForData = false;
 	m_created = true;
 	MAINMUTEX_UNLOCK 
@@ -113,18 +184,20 @@ void RTPTCPTransmitter::Destroy()
 
 	ClearDestSockets();
 	FlushPackets();
+	DestroyBufferPools();
 	m_created = false;
 	
 	if (m_waitingForData)
 	{
 		m_pAbortDesc->SendAbortSignal();
-		m_abortDesc.Destroy(); // 如果未初始化，则不执行任何操作
 		MAINMUTEX_UNLOCK
 		WAITMUTEX_LOCK // 确保 WaitForIncomingData 函数已结束
 		WAITMUTEX_UNLOCK
+		MAINMUTEX_LOCK
 	}
-	else
-		m_abortDesc.Destroy(); // 如果未初始化，则不执行任何操作
+	// 等待结束后才能关闭中止描述符，关闭的描述符会从 epoll 集合中移除而不再唤醒等待
+	m_socketWaiter.Destroy();
+	m_abortDesc.Destroy(); // 如果未初始化，则不执行任何操作
 
 	MAINMUTEX_UNLOCK
 }
@@ -224,34 +297,54 @@ int RTPTCPTransmitter::Poll()
 		return MEDIA_RTP_ERR_INVALID_STATE;
 	}
 
-	std::map<int, SocketData>::iterator it = m_destSockets.begin();
-	std::map<int, SocketData>::iterator end = m_destSockets.end();
 	int status = 0;
+	vector<int> errSockets, sendErrSockets;
 
-	vector<int> errSockets;
+	// 先发送之前未能发送的数据，套接字可写时等待会返回，随后调用的就是这里
+	FlushPendingOutput(sendErrSockets);
 
-	while (it != end)
+	if (m_edgeTriggered)
+		status = PollReadySockets(errSockets);
+	else
 	{
-		int sock = it->first;
-		status = PollSocket(sock, it->second);
-		if (status < 0)
+		std::map<int, SocketData>::iterator it = m_destSockets.begin();
+		std::map<int, SocketData>::iterator end = m_destSockets.end();
+
+		// 队列已满时缓冲区中可能留下完整的帧，套接字却不再可读；记下这些套接字，
+		// 下一次等待时不阻塞
+		m_readySockets.clear();
+		while (it != end)
 		{
-			// 内存不足时立即停止
-			if (status == MEDIA_RTP_ERR_RESOURCE_ERROR)
-				break;
-			else
+			int sock = it->first;
+			bool drained = false;
+			it->second.m_ready = false;
+			status = PollSocket(sock, it->second, drained);
+			if (status < 0)
 			{
-				errSockets.push_back(sock);
-				// 不要将此计为错误（例如由于连接关闭），
-				// 否则轮询线程（如果使用）将因此停止。由于可能存在多个连接，
-				// 因此通常不希望这样做。
-				status = 0; 
+				// 内存不足时立即停止
+				if (status == MEDIA_RTP_ERR_RESOURCE_ERROR)
+					break;
+				else
+				{
+					errSockets.push_back(sock);
+					// 不要将此计为错误（例如由于连接关闭），
+					// 否则轮询线程（如果使用）将因此停止。由于可能存在多个连接，
+					// 因此通常不希望这样做。
+					status = 0; 
+				}
 			}
+			else if (!drained)
+			{
+				it->second.m_ready = true;
+				m_readySockets.push_back(sock);
+			}
+			++it;
 		}
-		++it;
 	}
 	MAINMUTEX_UNLOCK
 
+	for (size_t i = 0 ; i < sendErrSockets.size() ; i++)
+		OnSendError(sendErrSockets[i]);
 	for (size_t i = 0 ; i < errSockets.size() ; i++)
 		OnReceiveError(errSockets[i]);
 
@@ -275,33 +368,37 @@ int RTPTCPTransmitter::WaitForIncomingData(const RTPTime &delay,bool *dataavaila
 		MAINMUTEX_UNLOCK
 		return MEDIA_RTP_ERR_INVALID_STATE;
 	}
+
+	// 接收队列已满时 Poll 不会读取任何套接字，这时等待套接字只会立即返回（剩余的帧
+	// 仍留在 m_readySockets 中，水平触发时套接字也仍然可读）；改为短暂休眠，
+	// 等应用程序取走数据包后再检查
+	if (m_rawPacketQueue.IsFull())
+	{
+		RTPTime backoff(0, RTPTCPTRANS_QUEUEFULLBACKOFFMICROSECONDS);
+
+		MAINMUTEX_UNLOCK
+		RTPTime::Wait((delay < backoff)?delay:backoff);
+		if (dataavailable != 0)
+			*dataavailable = false;
+		return 0;
+	}
 	
+	// 套接字已在添加目标时注册，这里只需准备接收结果的数组
 	m_tmpSocks.resize(m_destSockets.size()+1);
-	m_tmpFlags.resize(m_tmpSocks.size());
 	int abortSocket = m_pAbortDesc->GetAbortSocket();
 
-	std::map<int, SocketData>::iterator it = m_destSockets.begin();
-	std::map<int, SocketData>::iterator end = m_destSockets.end();
-	int idx = 0;
-
-	while (it != end)
-	{
-		m_tmpSocks[idx] = it->first;
-		m_tmpFlags[idx] = 0;
-		++it;
-		idx++;
-	}
-	m_tmpSocks[idx] = abortSocket;
-	m_tmpFlags[idx] = 0;
-	int idxAbort = idx;
+	// 还有未读完的套接字就不能等待：边沿触发时它们不会再产生事件，
+	// 缓冲区中未交付的帧也不会使套接字可读
+	RTPTime timeout = delay;
+	if (!m_readySockets.empty())
+		timeout = RTPTime(0,0);
 
 	m_waitingForData = true;
 	
 	WAITMUTEX_LOCK
 	MAINMUTEX_UNLOCK
 
-	//cout << "Waiting for " << delay.GetDouble() << " seconds for data on " << m_tmpSocks.size() << " sockets" << endl;
-	int status = RTPSelect(&m_tmpSocks[0], &m_tmpFlags[0], m_tmpSocks.size(), delay);
+	int status = m_socketWaiter.Wait(timeout, &m_tmpSocks[0], m_tmpSocks.size());
 	if (status < 0)
 	{
 		MAINMUTEX_LOCK
@@ -320,29 +417,27 @@ int RTPTCPTransmitter::WaitForIncomingData(const RTPTime &delay,bool *dataavaila
 		return 0;
 	}
 		
-	// 如果中止，则从中止缓冲区读取
-	if (m_tmpFlags[idxAbort])
-		m_pAbortDesc->ReadSignallingByte();
+	bool avail = false;
 
-	if (dataavailable != 0)
+	for (int i = 0 ; i < status ; i++)
 	{
-		bool avail = false;
+		// 如果中止，则从中止缓冲区读取
+		if (m_tmpSocks[i] == abortSocket)
+			m_pAbortDesc->ReadSignallingByte();
+		else
+			avail = true;
+	}
 
-		for (size_t i = 0 ; i < m_tmpFlags.size() ; i++)
-		{
-			if (m_tmpFlags[i])
-			{
-				avail = true;
-				//cout << "Data available!" << endl;
-				break;
-			}
-		}
+	if (m_edgeTriggered)
+	{
+		// 事件只会返回一次，必须记下来留给 Poll 处理
+		MarkReadySockets(&m_tmpSocks[0], status);
+		if (!m_readySockets.empty())
+			avail = true;
+	}
 
-		if (avail)
-			*dataavailable = true;
-		else
-			*dataavailable = false;
-	}	
+	if (dataavailable != 0)
+		*dataavailable = avail;
 	
 	MAINMUTEX_UNLOCK
 	WAITMUTEX_UNLOCK
@@ -374,12 +469,27 @@ int RTPTCPTransmitter::AbortWait()
 
 int RTPTCPTransmitter::SendRTPData(const void *data,size_t len)	
 {
-	return SendRTPRTCPData(data, len);
+	struct iovec iov;
+
+	iov.iov_base = const_cast<void *>(data);
+	iov.iov_len = len;
+	return SendRTPRTCPData(&iov, 1);
 }
 
 int RTPTCPTransmitter::SendRTCPData(const void *data,size_t len)
 {
-	return SendRTPRTCPData(data, len);
+	struct iovec iov;
+
+	iov.iov_base = const_cast<void *>(data);
+	iov.iov_len = len;
+	return SendRTPRTCPData(&iov, 1);
+}
+
+int RTPTCPTransmitter::SendRTPDataV(const struct iovec *iov, size_t iovcount)
+{
+	if (iovcount > RTPTRANS_MAXSENDIOV)
+		return MEDIA_RTP_ERR_INVALID_PARAMETER;
+	return SendRTPRTCPData(iov, iovcount);
 }
 
 int RTPTCPTransmitter::AddDestination(const RTPEndpoint &addr)
@@ -429,9 +539,24 @@ int RTPTCPTransmitter::AddDestination(const RTPEndpoint &addr)
 	}
 	m_destSockets[s] = SocketData();
 
+	status = m_socketWaiter.AddSocket(s, m_edgeTriggered);
+	if (status < 0)
+	{
+		m_destSockets.erase(s);
+		MAINMUTEX_UNLOCK
+		return status;
+	}
+
+	// 注册之前可能已有数据到达，边沿触发时先把套接字当作就绪的
+	if (m_edgeTriggered)
+		MarkReadySockets(&s, 1);
+
+#ifndef RTP_HAVE_EPOLL
 	// 由于套接字也用于传入数据，我们将中止可能正在进行的等待，
-	// 否则可能需要几秒钟才能监视新套接字的传入数据
+	// 否则可能需要几秒钟才能监视新套接字的传入数据；
+	// epoll 则会立即监视新注册的套接字
 	m_pAbortDesc->SendAbortSignal();
+#endif // RTP_HAVE_EPOLL
 
 	MAINMUTEX_UNLOCK
 	return 0;
@@ -476,12 +601,11 @@ int RTPTCPTransmitter::DeleteDestination(const RTPEndpoint &addr)
 		return MEDIA_RTP_ERR_INVALID_STATE;
 	}
 
-	// 清理可能分配的内存
-	uint8_t *pBuf = it->second.ExtractDataBuffer();
-	if (pBuf)
-		delete [] pBuf;
+	// 归还可能借用的缓冲区
+	it->second.ReleaseBuffers();
 
 	m_destSockets.erase(it);
+	m_socketWaiter.RemoveSocket(s);
 
 	MAINMUTEX_UNLOCK
 	return 0;
@@ -577,130 +701,324 @@ bool RTPTCPTransmitter::NewDataAvailable()
 {
 	if (!m_init)
 		return false;
-	
-	MAINMUTEX_LOCK
-	
-	bool v;
-		
-	if (!m_created)
-		v = false;
-	else
-	{
-		if (m_rawpacketlist.empty())
-			v = false;
-		else
-			v = true;
-	}
-	
-	MAINMUTEX_UNLOCK
-	return v;
+	return !m_rawPacketQueue.IsEmpty();
 }
 
 RTPRawPacket *RTPTCPTransmitter::GetNextPacket()
 {
 	if (!m_init)
 		return 0;
-	
-	MAINMUTEX_LOCK
-	
-	RTPRawPacket *p;
-	
-	if (!m_created)
+
+	// 不需要主锁：轮询时只在队尾加入数据包，这里只从队首取出。
+	// Destroy 清空队列时也是消费者，调用者保证两者不会并发（见 RTPTransmitter::Destroy），
+	// 因此这里不必检查 m_created
+	return m_rawPacketQueue.Pop();
+}
+
+// 私有函数从这里开始...
+
+void RTPTCPTransmitter::FlushPackets()
+{
+	m_rawPacketQueue.Flush();
+}
+
+// 交付缓冲的帧并一直读到 EAGAIN；读完且所有完整的帧都已交付时设置 drained
+int RTPTCPTransmitter::PollSocket(int sock, SocketData &sdata, bool &drained)
+{
+	RTPTime curtime = RTPTime::CurrentTime();
+	int status;
+
+	for (;;)
 	{
-		MAINMUTEX_UNLOCK
-		return 0;
+		if ((status = ProcessBufferedFrames(sock, sdata, curtime)) < 0)
+			break;
+
+		// 队列已满时（数据包的处理跟不上接收）把剩余的数据留在缓冲区和套接字中，由 TCP 流量控制减慢发送方
+		if (m_rawPacketQueue.IsFull())
+			break;
+
+		bool wouldBlock = false;
+		if ((status = ReadSocket(sock, sdata, wouldBlock)) < 0)
+			break;
+		if (wouldBlock)
+		{
+			drained = true;
+			break;
+		}
+		curtime = RTPTime::CurrentTime();
 	}
-	if (m_rawpacketlist.empty())
+
+	// 缓冲区为空时归还，空闲的连接不占用接收缓冲区
+	if (sdata.m_pRecvBuffer != 0 && sdata.m_recvHead == sdata.m_recvTail)
 	{
-		MAINMUTEX_UNLOCK
-		return 0;
+		RTPBufferPool::Release(sdata.m_pRecvBuffer);
+		sdata.m_pRecvBuffer = 0;
+		sdata.m_recvHead = 0;
+		sdata.m_recvTail = 0;
 	}
+	return status;
+}
 
-	p = *(m_rawpacketlist.begin());
-	m_rawpacketlist.pop_front();
+// 用一次调用读取尽可能多的数据：读入接收缓冲区的全部空闲空间，或者读入大帧剩余的部分
+int RTPTCPTransmitter::ReadSocket(int sock, SocketData &sdata, bool &wouldBlock)
+{
+	struct iovec iov[2];
+	size_t numIov = 1;
 
-	MAINMUTEX_UNLOCK
-	return p;
+	if (sdata.m_pDataBuffer != 0)
+	{
+		iov[0].iov_base = sdata.m_pDataBuffer+sdata.m_dataBufferOffset;
+		iov[0].iov_len = sdata.m_dataLength-sdata.m_dataBufferOffset;
+	}
+	else
+	{
+		if (sdata.m_pRecvBuffer == 0 && (sdata.m_pRecvBuffer = m_pRecvBufferPool->Allocate()) == 0)
+			return MEDIA_RTP_ERR_RESOURCE_ERROR;
+
+		// 空闲空间最多分成两段：写位置到缓冲区末尾，以及缓冲区开头到读位置。
+		// 缓冲区中只剩下未完整的帧，且只有能放进缓冲区的帧才留在里面，因此总有空闲空间
+		size_t size = m_pRecvBufferPool->GetBufferSize();
+		size_t tailPos = sdata.m_recvTail&(size-1);
+		size_t freeLen = size-(sdata.m_recvTail-sdata.m_recvHead);
+		size_t firstLen = size-tailPos;
+
+		assert(freeLen > 0);
+		if (firstLen > freeLen)
+			firstLen = freeLen;
+		iov[0].iov_base = sdata.m_pRecvBuffer+tailPos;
+		iov[0].iov_len = firstLen;
+		if (firstLen < freeLen)
+		{
+			iov[1].iov_base = sdata.m_pRecvBuffer;
+			iov[1].iov_len = freeLen-firstLen;
+			numIov = 2;
+		}
+	}
+
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = numIov;
+
+	// 套接字由应用程序创建，可能是阻塞的
+	ssize_t r = recvmsg(sock, &msg, MSG_DONTWAIT);
+	if (r < 0)
+	{
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+		{
+			wouldBlock = true;
+			return 0;
+		}
+		if (errno == EINTR)
+			return 0;
+		return MEDIA_RTP_ERR_OPERATION_FAILED;
+	}
+	// 对端关闭了连接。边沿触发时这只会产生一次事件，必须在这里报告
+	if (r == 0)
+		return MEDIA_RTP_ERR_OPERATION_FAILED;
+
+	if (sdata.m_pDataBuffer != 0)
+		sdata.m_dataBufferOffset += (int)r;
+	else
+		sdata.m_recvTail += (size_t)r;
+	return 0;
 }
 
-// 私有函数从这里开始...
+// 从接收缓冲区中解析出所有完整的帧，每个帧复制到缓冲池的缓冲区中交付
+int RTPTCPTransmitter::ProcessBufferedFrames(int sock, SocketData &sdata, const RTPTime &receivetime)
+{
+	if (sdata.m_pDataBuffer != 0)
+	{
+		if (sdata.m_dataBufferOffset < sdata.m_dataLength || m_rawPacketQueue.IsFull())
+			return 0;
 
-void RTPTCPTransmitter::FlushPackets()
+		// 大帧已经完整，之后的数据重新读入接收缓冲区
+		uint8_t *pBuf = sdata.m_pDataBuffer;
+		size_t len = (size_t)sdata.m_dataLength;
+
+		sdata.m_pDataBuffer = 0;
+		sdata.m_dataLength = 0;
+		sdata.m_dataBufferOffset = 0;
+		return QueueFrame(sock, pBuf, len, receivetime);
+	}
+
+	if (sdata.m_pRecvBuffer == 0)
+		return 0;
+
+	const uint8_t *pRecvBuf = sdata.m_pRecvBuffer;
+	size_t size = m_pRecvBufferPool->GetBufferSize();
+	size_t mask = size-1;
+
+	while (!m_rawPacketQueue.IsFull())
+	{
+		size_t avail = sdata.m_recvTail-sdata.m_recvHead;
+		if (avail < 2)
+			break;
+
+		size_t head = sdata.m_recvHead;
+		size_t len = (((size_t)pRecvBuf[head&mask]) << 8)|((size_t)pRecvBuf[(head+1)&mask]);
+		size_t frameLen = len;
+
+		// 放不进接收缓冲区的帧：缓冲区中的其余数据都属于这个帧，移到帧自己的缓冲区后直接读取剩余部分
+		bool large = (len+2 > size);
+		if (!large && avail < len+2)
+			break;
+		if (large)
+			frameLen = avail-2;
+
+		uint8_t *pBuf = AllocateFrameBuffer(len);
+		if (pBuf == 0)
+			return MEDIA_RTP_ERR_RESOURCE_ERROR;
+
+		// 帧可能跨越缓冲区的末尾
+		size_t pos = (head+2)&mask;
+		size_t firstLen = size-pos;
+		if (firstLen > frameLen)
+			firstLen = frameLen;
+		memcpy(pBuf, pRecvBuf+pos, firstLen);
+		memcpy(pBuf+firstLen, pRecvBuf, frameLen-firstLen);
+		sdata.m_recvHead += frameLen+2;
+
+		if (large)
+		{
+			sdata.m_pDataBuffer = pBuf;
+			sdata.m_dataLength = (int)len;
+			sdata.m_dataBufferOffset = (int)frameLen;
+			break;
+		}
+
+		int status = QueueFrame(sock, pBuf, len, receivetime);
+		if (status < 0)
+			return status;
+	}
+	return 0;
+}
+
+// 常见大小的帧来自缓冲池，更大的帧单独分配；两者都用 RTPBufferPool::Release 释放
+uint8_t *RTPTCPTransmitter::AllocateFrameBuffer(size_t len)
+{
+	if (len <= m_pFrameBufferPool->GetBufferSize())
+		return m_pFrameBufferPool->Allocate();
+	return RTPBufferPool::AllocateUnpooled(len);
+}
+
+int RTPTCPTransmitter::QueueFrame(int sock, uint8_t *data, size_t len, const RTPTime &receivetime)
 {
-	std::list<RTPRawPacket*>::const_iterator it;
+	// 我们还不知道它是 RTP 还是 RTCP 包，根据负载类型判断
+	bool isrtp = true;
+	if (len > sizeof(RTCPCommonHeader))
+	{
+		RTCPCommonHeader *rtcpheader = (RTCPCommonHeader *)data;
+		uint8_t packettype = rtcpheader->packettype;
 
-	for (it = m_rawpacketlist.begin() ; it != m_rawpacketlist.end() ; ++it)
-		delete *it;
-	m_rawpacketlist.clear();
+		if (packettype >= 200 && packettype <= 204)
+			isrtp = false;
+	}
+
+	// 地址保存在数据包内部，数据包对象本身也来自缓冲池
+	RTPRawPacket *pPack = new (m_pRawPacketPool) RTPRawPacket(data, len, true, RTPEndpoint(sock), receivetime, isrtp);
+	if (pPack == 0)
+	{
+		RTPBufferPool::Release(data);
+		return MEDIA_RTP_ERR_RESOURCE_ERROR;
+	}
+	if (!m_rawPacketQueue.Push(pPack))
+		delete pPack;
+	return 0;
 }
 
-int RTPTCPTransmitter::PollSocket(int sock, SocketData &sdata)
+void RTPTCPTransmitter::DestroyBufferPools()
 {
-	size_t len;
-	bool dataavailable;
-	
+	// 应用程序仍持有的数据包可以继续使用，缓冲池在最后一个缓冲区归还时删除
+	if (m_pRecvBufferPool)
+		m_pRecvBufferPool->Destroy();
+	if (m_pFrameBufferPool)
+		m_pFrameBufferPool->Destroy();
+	if (m_pRawPacketPool)
+		m_pRawPacketPool->Destroy();
+	m_pRecvBufferPool = 0;
+	m_pFrameBufferPool = 0;
+	m_pRawPacketPool = 0;
+}
+
+// 只处理 m_readySockets 中的套接字，每次唤醒的开销与活跃连接的数量成正比
+int RTPTCPTransmitter::PollReadySockets(vector<int> &errSockets)
+{
+	// 先取出已经发生的事件，这样不经过 WaitForIncomingData 直接调用 Poll 时也能收到数据。
+	// 没有新的就绪套接字时停止，否则在水平触发的中止描述符上会一直循环
+	int readySocks[RTPTCPTRANS_MAXREADYBATCH];
+	int num;
 	do
 	{
-		len = 0;
-		RTPIOCTL(sock, FIONREAD, &len);
+		num = m_socketWaiter.Wait(RTPTime(0,0), readySocks, RTPTCPTRANS_MAXREADYBATCH);
+		if (num < 0)
+			return num;
+	} while (MarkReadySockets(readySocks, num) > 0);
 
-		if (len <= 0) 
-			dataavailable = false;
-		else
-			dataavailable = true;
-		
-		if (dataavailable)
+	int status = 0;
+	size_t numKept = 0;
+
+	for (size_t i = 0 ; i < m_readySockets.size() ; i++)
+	{
+		int sock = m_readySockets[i];
+		std::map<int, SocketData>::iterator it = m_destSockets.find(sock);
+		if (it == m_destSockets.end() || !it->second.m_ready) // 目标已被删除
+			continue;
+
+		// 队列已满或内存不足时，剩余的套接字留到下一次 Poll
+		if (status < 0 || m_rawPacketQueue.IsFull())
 		{
-			RTPTime curtime = RTPTime::CurrentTime();
-			int relevantLen = RTPTCPTRANS_MAXPACKSIZE+2;
-			
-			if ((int)len < relevantLen)
-				relevantLen = (int)len;
-
-			bool complete = false;
-			int status = sdata.ProcessAvailableBytes(sock, relevantLen, complete);
-			if (status < 0)
-				return status;
-			
-			if (complete)
+			m_readySockets[numKept++] = sock;
+			continue;
+		}
+
+		bool drained = false;
+		int pollStatus = PollSocket(sock, it->second, drained);
+		if (pollStatus < 0)
+		{
+			if (pollStatus == MEDIA_RTP_ERR_RESOURCE_ERROR)
 			{
-				uint8_t *pBuf = sdata.ExtractDataBuffer();
-				if (pBuf)
-				{
-					int dataLength = sdata.m_dataLength;
-					sdata.Reset();
-
-					RTPEndpoint *pAddr = new RTPEndpoint(sock);
-					if (pAddr == 0)
-						return MEDIA_RTP_ERR_RESOURCE_ERROR;
-
-					bool isrtp = true;
-					if (dataLength > (int)sizeof(RTCPCommonHeader))
-					{
-						RTCPCommonHeader *rtcpheader = (RTCPCommonHeader *)pBuf;
-						uint8_t packettype = rtcpheader->packettype;
-
-						if (packettype >= 200 && packettype <= 204)
-							isrtp = false;
-					}
-						
-					RTPRawPacket *pPack = new RTPRawPacket(pBuf, dataLength, pAddr, curtime, isrtp);
-					if (pPack == 0)
-					{
-						delete pAddr;
-						delete [] pBuf;
-						return MEDIA_RTP_ERR_RESOURCE_ERROR;
-					}
-					m_rawpacketlist.push_back(pPack);	
-				}
+				status = pollStatus;
+				m_readySockets[numKept++] = sock;
+				continue;
 			}
+			// 与水平触发时一样，连接错误不作为 Poll 的错误返回
+			errSockets.push_back(sock);
+			drained = true;
 		}
-	} while (dataavailable);
 
-	return 0;
+		if (drained)
+			it->second.m_ready = false;
+		else
+			m_readySockets[numKept++] = sock;
+	}
+	m_readySockets.resize(numKept);
+	return status;
 }
 
-int RTPTCPTransmitter::SendRTPRTCPData(const void *data, size_t len)
+// 把 socks 中的目标套接字加入 m_readySockets，返回新加入的数量
+int RTPTCPTransmitter::MarkReadySockets(const int *socks, int num)
+{
+	int abortSocket = m_pAbortDesc->GetAbortSocket();
+	int numNew = 0;
+
+	for (int i = 0 ; i < num ; i++)
+	{
+		if (socks[i] == abortSocket)
+			continue;
+
+		std::map<int, SocketData>::iterator it = m_destSockets.find(socks[i]);
+		if (it == m_destSockets.end() || it->second.m_ready)
+			continue;
+
+		it->second.m_ready = true;
+		m_readySockets.push_back(socks[i]);
+		numNew++;
+	}
+	return numNew;
+}
+
+int RTPTCPTransmitter::SendRTPRTCPData(const struct iovec *iov, size_t iovcount)
 {
 	if (!m_init)
 		return MEDIA_RTP_ERR_INVALID_STATE;
@@ -712,6 +1030,8 @@ int RTPTCPTransmitter::SendRTPRTCPData(const void *data, size_t len)
 		MAINMUTEX_UNLOCK
 		return MEDIA_RTP_ERR_INVALID_STATE;
 	}
+
+	size_t len = RTPGetIOVecLength(iov, iovcount);
 	if (len > RTPTCPTRANS_MAXPACKSIZE)
 	{
 		MAINMUTEX_UNLOCK
@@ -722,19 +1042,34 @@ int RTPTCPTransmitter::SendRTPRTCPData(const void *data, size_t len)
 	std::map<int, SocketData>::iterator end = m_destSockets.end();
 
 	vector<int> errSockets;
-	int flags = 0;
-#ifdef RTP_HAVE_MSG_NOSIGNAL
-	flags = MSG_NOSIGNAL;
-#endif // RTP_HAVE_MSG_NOSIGNAL
+	uint8_t lengthBytes[2] = { (uint8_t)((len >> 8)&0xff), (uint8_t)(len&0xff) };
+
+	// 帧的第一个数据块是长度字段，后面是数据包的各个数据块
+	struct iovec frame[RTPTRANS_MAXSENDIOV+1];
+
+	frame[0].iov_base = lengthBytes;
+	frame[0].iov_len = 2;
+	memcpy(frame+1, iov, iovcount*sizeof(struct iovec));
 
 	while (it != end)
 	{
-		uint8_t lengthBytes[2] = { (uint8_t)((len >> 8)&0xff), (uint8_t)(len&0xff) };
 		int sock = it->first;
+		bool disconnect = false;
+		bool failed = (SendFrame(sock, it->second, frame, iovcount+1, len+2, disconnect) < 0);
 
-		if (send(sock,(const char *)lengthBytes,2,flags) < 0 ||
-			send(sock,(const char *)data,len,flags) < 0)
+		if (failed || disconnect)
 			errSockets.push_back(sock);
+		if (disconnect)
+		{
+			// 发送队列已满（Disconnect 策略），或者排队失败使字节流不再完整：不再使用这个连接
+			it->second.ReleaseBuffers();
+			m_socketWaiter.RemoveSocket(sock);
+			m_destSockets.erase(it++);
+			continue;
+		}
+		if (failed)
+			it->second.ReleaseOutputQueue(); // 出错的连接上排队的数据无法再发送
+		UpdateOutputState(sock, it->second);
 		++it;
 	}
 	
@@ -751,114 +1086,237 @@ int RTPTCPTransmitter::SendRTPRTCPData(const void *data, size_t len)
 	return 0;
 }
 
-int RTPTCPTransmitter::ValidateSocket(int)
+// 不阻塞地发送由 iovcount 个数据块组成、总长度为 frameLen 的帧：发送队列为空时直接发送，
+// 长度和数据在同一次调用中；套接字没有接受的部分加入发送队列。需要断开连接时设置 disconnect
+int RTPTCPTransmitter::SendFrame(int sock, SocketData &sdata, const struct iovec *frame, size_t iovcount, size_t frameLen, bool &disconnect)
 {
-	// TCP套接字验证暂未实现 
-	return 0;
-}
+	size_t sent = 0;
+	int status;
 
-void RTPTCPTransmitter::ClearDestSockets()
-{
-	std::map<int, SocketData>::iterator it = m_destSockets.begin();
-	std::map<int, SocketData>::iterator end = m_destSockets.end();
+	// 先尝试发送已经排队的数据，帧必须按顺序发送
+	if (!sdata.m_outputQueue.empty() && (status = FlushOutputQueue(sock, sdata)) < 0)
+		return status;
 
-	while (it != end)
+	if (sdata.m_outputQueue.empty())
 	{
-		uint8_t *pBuf = it->second.ExtractDataBuffer();
-		if (pBuf)
-			delete [] pBuf;
+		struct msghdr msg;
 
-		++it;
-	}
-	m_destSockets.clear();
-}
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = const_cast<struct iovec *>(frame);
+		msg.msg_iovlen = iovcount;
 
-RTPTCPTransmitter::SocketData::SocketData()
-{
-	Reset();
-}
+		ssize_t r;
+		do
+		{
+			r = sendmsg(sock, &msg, RTPTCPTRANS_SENDFLAGS);
+		} while (r < 0 && errno == EINTR);
 
-void RTPTCPTransmitter::SocketData::Reset()
-{
-	m_lengthBufferOffset = 0;
-	m_dataLength = 0; 
-	m_dataBufferOffset = 0;
-	m_pDataBuffer = 0;
-}
+		if (r < 0)
+		{
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				return MEDIA_RTP_ERR_OPERATION_FAILED;
+			r = 0;
+		}
+		sent = (size_t)r;
+		if (sent == frameLen)
+			return 0;
+	}
+	else if (sdata.m_outputBytes+frameLen > m_sendQueueLimit)
+	{
+		// 队列为空时总是接受，否则比上限还大的帧永远无法发送；已经发送了一部分的帧
+		// 也必须排队，否则字节流中的帧边界会错乱，因此只有在这里检查上限
+		if (m_sendQueuePolicy == RTPTCPTransmissionParams::Disconnect)
+			disconnect = true;
+		else
+		{
+			m_numDroppedSendPackets.store(m_numDroppedSendPackets.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			m_numDroppedSendBytes.store(m_numDroppedSendBytes.load(std::memory_order_relaxed) + frameLen-2, std::memory_order_relaxed);
+		}
+		return 0;
+	}
 
-RTPTCPTransmitter::SocketData::~SocketData()
-{
-	assert(m_pDataBuffer == 0); // 应在外部删除，以避免在类中存储内存管理器
+	// 只保存尚未发送的部分
+	size_t queuedLen = frameLen-sent;
+	uint8_t *pBuf = AllocateFrameBuffer(queuedLen);
+	if (pBuf == 0)
+	{
+		if (sent > 0)
+			disconnect = true;
+		return MEDIA_RTP_ERR_RESOURCE_ERROR;
+	}
+	RTPCopyIOVec(frame, iovcount, sent, pBuf);
+
+	OutputFrame outputFrame;
+	outputFrame.m_pData = pBuf;
+	outputFrame.m_length = queuedLen;
+	sdata.m_outputQueue.push_back(outputFrame);
+	sdata.m_outputBytes += queuedLen;
+	return 0;
 }
 
-int RTPTCPTransmitter::SocketData::ProcessAvailableBytes(int sock, int availLen, bool &complete)
+// 用尽可能少的调用发送排队的帧，直到队列为空或者套接字不再接受数据
+int RTPTCPTransmitter::FlushOutputQueue(int sock, SocketData &sdata)
 {
-
-	const int numLengthBuffer = 2;
-	if (m_lengthBufferOffset < numLengthBuffer) // 首先我们需要获取长度
+	while (!sdata.m_outputQueue.empty())
 	{
-		assert(m_pDataBuffer == 0);
-		int num = numLengthBuffer-m_lengthBufferOffset;
-		if (num > availLen)
-			num = availLen;
+		struct iovec iov[RTPTCPTRANS_MAXSENDIOV];
+		struct msghdr msg;
+		size_t numIov = 0;
+		size_t total = 0;
 
-		int r = 0;
-		if (num > 0)
+		for (std::deque<OutputFrame>::const_iterator it = sdata.m_outputQueue.begin() ;
+		     it != sdata.m_outputQueue.end() && numIov < RTPTCPTRANS_MAXSENDIOV ; ++it, ++numIov)
 		{
-			r = (int)recv(sock, (char *)(m_lengthBuffer+m_lengthBufferOffset), num, 0);
-			if (r < 0)
-				return MEDIA_RTP_ERR_OPERATION_FAILED;
+			size_t offset = (numIov == 0)?sdata.m_outputOffset:0;
+
+			iov[numIov].iov_base = it->m_pData+offset;
+			iov[numIov].iov_len = it->m_length-offset;
+			total += iov[numIov].iov_len;
 		}
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = iov;
+		msg.msg_iovlen = numIov;
 
-		m_lengthBufferOffset += r;
-		availLen -= r;
+		ssize_t r = sendmsg(sock, &msg, RTPTCPTRANS_SENDFLAGS);
+		if (r < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			return MEDIA_RTP_ERR_OPERATION_FAILED;
+		}
 
-		assert(m_lengthBufferOffset <= numLengthBuffer);
-		if (m_lengthBufferOffset == numLengthBuffer) // 我们可以构造一个长度
+		size_t num = (size_t)r;
+		while (num > 0)
 		{
-			int l = 0;
-			for (int i = numLengthBuffer-1, shift = 0 ; i >= 0 ; i--, shift += 8)
-				l |= ((int)m_lengthBuffer[i]) << shift;
+			OutputFrame &frame = sdata.m_outputQueue.front();
+			size_t remaining = frame.m_length-sdata.m_outputOffset;
 
-			m_dataLength = l;
-			m_dataBufferOffset = 0;
+			if (num < remaining)
+			{
+				sdata.m_outputOffset += num;
+				break;
+			}
+			num -= remaining;
+			sdata.m_outputBytes -= frame.m_length;
+			sdata.m_outputOffset = 0;
+			RTPBufferPool::Release(frame.m_pData);
+			sdata.m_outputQueue.pop_front();
+		}
 
-			//cout << "Expecting " << m_dataLength << " bytes" << endl;
+		if ((size_t)r < total) // 套接字的发送缓冲区已满
+			break;
+	}
+	return 0;
+}
 
-			// 避免分配长度为 0
-			if (l == 0)
-				l = 1;
+// 发送队列不为空时等待同时监视套接字是否可写，并把套接字记在 m_outputSockets 中
+void RTPTCPTransmitter::UpdateOutputState(int sock, SocketData &sdata)
+{
+	bool pending = !sdata.m_outputQueue.empty();
 
-			// 我们还不知道它是 RTP 还是 RTCP 包，所以我们暂时当做 RTP 处理
-			m_pDataBuffer = new uint8_t[l];
-			if (m_pDataBuffer == 0)
-				return MEDIA_RTP_ERR_RESOURCE_ERROR;
-		}
+	if (pending != sdata.m_writeWatched)
+	{
+		// 失败时数据仍会在下一次 Poll 或发送时发送，只是等待不会因套接字可写而返回
+		m_socketWaiter.ModifySocket(sock, m_edgeTriggered, pending);
+		sdata.m_writeWatched = pending;
 	}
-
-	if (m_lengthBufferOffset == numLengthBuffer && m_pDataBuffer) // 最后一个是为了确保我们没有耗尽内存
+	if (pending && !sdata.m_outputListed)
 	{
-		if (m_dataBufferOffset < m_dataLength)
-		{
-			int num = m_dataLength-m_dataBufferOffset;
-			if (num > availLen)
-				num = availLen;
+		sdata.m_outputListed = true;
+		m_outputSockets.push_back(sock);
+	}
+}
 
-			int r = 0;
-			if (num > 0)
-			{
-				r = (int)recv(sock, (char *)(m_pDataBuffer+m_dataBufferOffset), num, 0);
-				if (r < 0)
-					return MEDIA_RTP_ERR_OPERATION_FAILED;
-			}
+// 只处理 m_outputSockets 中的套接字，没有待发送数据的连接不增加开销
+void RTPTCPTransmitter::FlushPendingOutput(vector<int> &errSockets)
+{
+	size_t numKept = 0;
 
-			m_dataBufferOffset += r;
-			availLen -= r;
+	for (size_t i = 0 ; i < m_outputSockets.size() ; i++)
+	{
+		int sock = m_outputSockets[i];
+		std::map<int, SocketData>::iterator it = m_destSockets.find(sock);
+		if (it == m_destSockets.end() || !it->second.m_outputListed) // 目标已被删除
+			continue;
+
+		SocketData &sdata = it->second;
+		if (FlushOutputQueue(sock, sdata) < 0)
+		{
+			errSockets.push_back(sock);
+			sdata.ReleaseOutputQueue();
 		}
+		UpdateOutputState(sock, sdata);
 
-		if (m_dataBufferOffset == m_dataLength)
-			complete = true;
+		if (sdata.m_outputQueue.empty())
+			sdata.m_outputListed = false;
+		else
+			m_outputSockets[numKept++] = sock;
 	}
+	m_outputSockets.resize(numKept);
+}
+
+int RTPTCPTransmitter::ValidateSocket(int)
+{
+	// TCP套接字验证暂未实现 
 	return 0;
 }
 
+void RTPTCPTransmitter::ClearDestSockets()
+{
+	std::map<int, SocketData>::iterator it = m_destSockets.begin();
+	std::map<int, SocketData>::iterator end = m_destSockets.end();
+
+	while (it != end)
+	{
+		it->second.ReleaseBuffers();
+		m_socketWaiter.RemoveSocket(it->first);
+		++it;
+	}
+	m_destSockets.clear();
+	m_readySockets.clear();
+	m_outputSockets.clear();
+}
+
+RTPTCPTransmitter::SocketData::SocketData()
+{
+	m_pRecvBuffer = 0;
+	m_recvHead = 0;
+	m_recvTail = 0;
+	m_pDataBuffer = 0;
+	m_dataLength = 0;
+	m_dataBufferOffset = 0;
+	m_ready = false;
+	m_outputOffset = 0;
+	m_outputBytes = 0;
+	m_outputListed = false;
+	m_writeWatched = false;
+}
+
+RTPTCPTransmitter::SocketData::~SocketData()
+{
+	assert(m_pRecvBuffer == 0 && m_pDataBuffer == 0 && m_outputQueue.empty()); // 应在外部释放，复制到 map 中的实例不拥有缓冲区
+}
+
+void RTPTCPTransmitter::SocketData::ReleaseBuffers()
+{
+	RTPBufferPool::Release(m_pRecvBuffer);
+	RTPBufferPool::Release(m_pDataBuffer);
+	m_pRecvBuffer = 0;
+	m_recvHead = 0;
+	m_recvTail = 0;
+	m_pDataBuffer = 0;
+	m_dataLength = 0;
+	m_dataBufferOffset = 0;
+	ReleaseOutputQueue();
+}
+
+void RTPTCPTransmitter::SocketData::ReleaseOutputQueue()
+{
+	for (std::deque<OutputFrame>::iterator it = m_outputQueue.begin() ; it != m_outputQueue.end() ; ++it)
+		RTPBufferPool::Release(it->m_pData);
+	m_outputQueue.clear();
+	m_outputOffset = 0;
+	m_outputBytes = 0;
+}
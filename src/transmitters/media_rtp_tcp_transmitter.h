@@ -3,16 +3,33 @@
 #include "rtpconfig.h"
 #include "media_rtp_transmitter.h"
 #include "media_rtp_abort_descriptors.h"
+#include "media_rtp_socket_waiter.h"
+#include "media_rtp_raw_packet_queue.h"
+#include "media_rtp_buffer_pool.h"
 #include <map>
 #include <list>
+#include <deque>
 #include <vector>
 
+#include <atomic>
 #include <mutex>
 
+#define RTPTCPTRANS_DEFAULTRECEIVEBUFFER			8192
+#define RTPTCPTRANS_MINRECEIVEBUFFER				16
+#define RTPTCPTRANS_DEFAULTSENDQUEUEBYTES			(512*1024)
+
 /** Parameters for the TCP transmitter. */
 class RTPTCPTransmissionParams : public RTPTransmissionParams
 {
 public:
+	/** What to do with a frame that does not fit in a connection's send queue. */
+	enum SendQueuePolicy
+	{
+		DropFrames,		/**< The frame is not sent to that connection and counted as dropped. */
+		Disconnect		/**< The connection is removed from the destinations and reported through
+						 *   RTPTCPTransmitter::OnSendError; the application should close it. */
+	};
+
 	RTPTCPTransmissionParams();
 
 	/** If non null, the specified abort descriptors will be used to cancel
@@ -24,13 +41,60 @@ public:
 	 *  which can be useful when creating your own poll thread for multiple
 	 *  sessions. */
 	RTPAbortDescriptors *GetCreatedAbortDescriptors() const		{ return m_pAbortDesc; }
+
+	/** If enabled, the destination sockets are registered edge-triggered (EPOLLET) and
+	 *  the transmitter keeps its own list of sockets that still have unread data. Poll
+	 *  then only visits those sockets, so the cost of a wakeup depends on the number of
+	 *  active connections rather than on the total number of connections. A connection
+	 *  that is closed by the peer is reported through RTPTCPTransmitter::OnReceiveError.
+	 *  Disabled by default. */
+	void SetEdgeTriggered(bool f)								{ m_edgeTriggered = f; }
+
+	/** Returns whether edge-triggered polling is used. */
+	bool GetEdgeTriggered() const								{ return m_edgeTriggered; }
+
+	/** Sets the size of the per-connection receive buffer (rounded up to a power of two).
+	 *  Incoming data is read into this buffer with as few calls as possible and complete
+	 *  RFC 4571 frames are parsed out of it. The buffer is borrowed from a pool while a
+	 *  connection has unparsed data, so idle connections do not hold one. Frames that do
+	 *  not fit in the buffer are read directly into their own storage. The default is
+	 *  RTPTCPTRANS_DEFAULTRECEIVEBUFFER bytes. */
+	void SetReceiveBufferSize(size_t s)							{ m_receiveBufferSize = s; }
+
+	/** Returns the size of the per-connection receive buffer. */
+	size_t GetReceiveBufferSize() const							{ return m_receiveBufferSize; }
+
+	/** Sets the maximum number of bytes that may be queued for a single connection.
+	 *  Sending never blocks: data that the socket does not accept right away is queued
+	 *  and written once the socket becomes writable again, during Poll or the next send.
+	 *  A frame that would make the queue exceed this limit is handled according to the
+	 *  policy set with SetSendQueuePolicy, so one slow peer cannot stall the others. The
+	 *  default is RTPTCPTRANS_DEFAULTSENDQUEUEBYTES bytes. */
+	void SetSendQueueLimit(size_t maxbytes)						{ m_sendQueueLimit = maxbytes; }
+
+	/** Returns the maximum number of bytes queued for a single connection. */
+	size_t GetSendQueueLimit() const							{ return m_sendQueueLimit; }
+
+	/** Sets what happens when a connection's send queue is full; the default is DropFrames. */
+	void SetSendQueuePolicy(SendQueuePolicy p)					{ m_sendQueuePolicy = p; }
+
+	/** Returns what happens when a connection's send queue is full. */
+	SendQueuePolicy GetSendQueuePolicy() const					{ return m_sendQueuePolicy; }
 private:
 	RTPAbortDescriptors *m_pAbortDesc;
+	bool m_edgeTriggered;
+	size_t m_receiveBufferSize;
+	size_t m_sendQueueLimit;
+	SendQueuePolicy m_sendQueuePolicy;
 };
 
 inline RTPTCPTransmissionParams::RTPTCPTransmissionParams() : RTPTransmissionParams(RTPTransmitter::TCPProto)	
 { 
 	m_pAbortDesc = 0;
+	m_edgeTriggered = false;
+	m_receiveBufferSize = RTPTCPTRANS_DEFAULTRECEIVEBUFFER;
+	m_sendQueueLimit = RTPTCPTRANS_DEFAULTSENDQUEUEBYTES;
+	m_sendQueuePolicy = DropFrames;
 }
 
 /** Additional information about the TCP transmitter. */
@@ -88,6 +152,7 @@ public:
 	
 	int SendRTPData(const void *data,size_t len);	
 	int SendRTCPData(const void *data,size_t len);
+	int SendRTPDataV(const struct iovec *iov, size_t iovcount);
 
 	int AddDestination(const RTPEndpoint &addr);
 	int DeleteDestination(const RTPEndpoint &addr);
@@ -109,50 +174,100 @@ public:
 	
 	bool NewDataAvailable();
 	RTPRawPacket *GetNextPacket();
+	uint64_t GetNumDroppedPackets() { return m_rawPacketQueue.GetNumDroppedPackets(); }
+	uint64_t GetNumDroppedBytes() { return m_rawPacketQueue.GetNumDroppedBytes(); }
+
+	/** Returns the number of outgoing frames that were not sent to a connection because
+	 *  its send queue was full; a frame dropped for several connections is counted once
+	 *  for each of them. */
+	uint64_t GetNumDroppedSendPackets() const					{ return m_numDroppedSendPackets.load(std::memory_order_relaxed); }
+
+	/** Returns the total size of the outgoing frames counted by GetNumDroppedSendPackets. */
+	uint64_t GetNumDroppedSendBytes() const						{ return m_numDroppedSendBytes.load(std::memory_order_relaxed); }
 
 protected:
 	/** By overriding this function you can be notified of an error when sending over a socket. */
 	virtual void OnSendError(int sock);
 	/** By overriding this function you can be notified of an error when receiving from a socket. */
 	virtual void OnReceiveError(int sock);
+
+	/** Returns true if the receive queue is full, so that Poll leaves data in the sockets.
+	 *  Must be called from the thread that calls Poll. */
+	bool IsReceiveQueueFull()									{ return m_rawPacketQueue.IsFull(); }
 private:
+	// 发送队列中的一个帧，两字节的长度和数据放在同一个缓冲区中
+	struct OutputFrame
+	{
+		uint8_t *m_pData;
+		size_t m_length;
+	};
+
 	class SocketData
 	{
 	public:
 		SocketData();
 		~SocketData();
-		void Reset();
+		void ReleaseBuffers();
+		void ReleaseOutputQueue();
 
-		uint8_t m_lengthBuffer[2];
-		int m_lengthBufferOffset;
+		// 接收环形缓冲区，有未解析的数据时从缓冲池借用；读写位置单调递增，相减得到缓冲的字节数
+		uint8_t *m_pRecvBuffer;
+		size_t m_recvHead;
+		size_t m_recvTail;
+		// 放不进接收缓冲区的帧直接读入自己的缓冲区
+		uint8_t *m_pDataBuffer;
 		int m_dataLength;
 		int m_dataBufferOffset;
-		uint8_t *m_pDataBuffer;
+		bool m_ready; // 套接字在 m_readySockets 中，可能还有未读的数据或未交付的帧
 
-		uint8_t *ExtractDataBuffer() { uint8_t *pTmp = m_pDataBuffer; m_pDataBuffer = 0; return pTmp; }
-		int ProcessAvailableBytes(int sock, int availLen, bool &complete);
+		// 未能立即发送的帧，第一个帧的前 m_outputOffset 字节已经发送
+		std::deque<OutputFrame> m_outputQueue;
+		size_t m_outputOffset;
+		size_t m_outputBytes;
+		bool m_outputListed; // 套接字在 m_outputSockets 中
+		bool m_writeWatched; // 等待时同时监视套接字是否可写
 	};
 
-	int SendRTPRTCPData(const void *data,size_t len);	
+	int SendRTPRTCPData(const struct iovec *iov, size_t iovcount);
 	void FlushPackets();
-	int PollSocket(int sock, SocketData &sdata);
+	int PollSocket(int sock, SocketData &sdata, bool &drained);
+	int ReadSocket(int sock, SocketData &sdata, bool &wouldBlock);
+	int ProcessBufferedFrames(int sock, SocketData &sdata, const RTPTime &receivetime);
+	uint8_t *AllocateFrameBuffer(size_t len);
+	int QueueFrame(int sock, uint8_t *data, size_t len, const RTPTime &receivetime);
+	void DestroyBufferPools();
+	int PollReadySockets(std::vector<int> &errSockets);
+	int SendFrame(int sock, SocketData &sdata, const struct iovec *frame, size_t iovcount, size_t frameLen, bool &disconnect);
+	int FlushOutputQueue(int sock, SocketData &sdata);
+	void UpdateOutputState(int sock, SocketData &sdata);
+	void FlushPendingOutput(std::vector<int> &errSockets);
+	int MarkReadySockets(const int *socks, int num);
 	void ClearDestSockets();
 	int ValidateSocket(int s);
 
 	bool m_init;
 	bool m_created;
 	bool m_waitingForData;
+	bool m_edgeTriggered;
 
 	std::map<int, SocketData> m_destSockets;
 	std::vector<int> m_tmpSocks;
-	std::vector<int8_t> m_tmpFlags;
+	std::vector<int> m_readySockets; // 可能还有未读数据或未交付的帧的套接字
+	std::vector<int> m_outputSockets; // 发送队列不为空的套接字
+	size_t m_sendQueueLimit;
+	RTPTCPTransmissionParams::SendQueuePolicy m_sendQueuePolicy;
+	std::atomic<uint64_t> m_numDroppedSendPackets, m_numDroppedSendBytes;
 	std::vector<uint8_t> m_localHostname;
 	size_t m_maxPackSize;
 	
-	std::list<RTPRawPacket*> m_rawpacketlist;
+	RTPRawPacketQueue m_rawPacketQueue; // 轮询时在队尾加入，GetNextPacket 无锁取出
+	RTPBufferPool *m_pRecvBufferPool; // 各连接的接收环形缓冲区
+	RTPBufferPool *m_pFrameBufferPool; // 解析出的帧，更大的帧单独分配
+	RTPBufferPool *m_pRawPacketPool; // RTPRawPacket 实例
 
 	RTPAbortDescriptors m_abortDesc;
 	RTPAbortDescriptors *m_pAbortDesc; // in case an external one was specified
+	RTPSocketWaiter m_socketWaiter; // 持久注册了所有目标套接字和中止描述符
 
 	std::mutex m_mainMutex, m_waitMutex;
 	bool m_threadsafe;
@@ -7,8 +7,11 @@
 #define RTPTRANSMITTER_H
 
 #include "media_rtp_utils.h"
+#include "media_rtp_errors.h"
 #include "rtpconfig.h"
 #include <cstdint>
+#include <string.h>
+#include <sys/uio.h>
 
 class RTPRawPacket;
 class RTPEndpoint;
@@ -16,10 +19,43 @@ class RTPTransmissionParams;
 class RTPTime;
 class RTPTransmissionInfo;
 
+/** 传输器接收队列默认最多容纳的数据包数量。 */
+#define RTPTRANS_DEFAULTRECEIVEQUEUEPACKETS 8192
+
+/** RTPTransmitter::SendRTPDataV 组成一个数据包的数据块的最大数量。 */
+#define RTPTRANS_MAXSENDIOV 16
+
+/** 返回 \c iov 中 \c iovcount 个数据块的总长度。 */
+inline size_t RTPGetIOVecLength(const struct iovec *iov, size_t iovcount) {
+  size_t len = 0;
+  for (size_t i = 0; i < iovcount; i++)
+    len += iov[i].iov_len;
+  return len;
+}
+
+/** 跳过开头的 \c offset 个字节，把 \c iov 中的数据依次复制到 \c dest，
+ *  返回复制的字节数。 */
+inline size_t RTPCopyIOVec(const struct iovec *iov, size_t iovcount,
+                           size_t offset, uint8_t *dest) {
+  size_t pos = 0;
+  for (size_t i = 0; i < iovcount; i++) {
+    size_t len = iov[i].iov_len;
+    if (offset >= len) {
+      offset -= len;
+      continue;
+    }
+    memcpy(dest + pos, (const uint8_t *)iov[i].iov_base + offset, len - offset);
+    pos += len - offset;
+    offset = 0;
+  }
+  return pos;
+}
+
 /** 实际传输组件应该继承的抽象类。
  *  实际传输组件应该继承的抽象类。
  *  抽象类 RTPTransmitter 指定了实际传输组件的接口。
- *  目前存在三种实现：IPv4 UDP 传输器、IPv6 UDP 传输器和 TCP 传输器。
+ *  目前存在四种实现：IPv4 UDP 传输器、IPv6 UDP 传输器、TCP 传输器和基于
+ *  io_uring 的 IPv4 UDP 传输器。
  */
 class RTPTransmitter {
 public:
@@ -30,7 +66,11 @@ public:
   enum TransmissionProtocol {
     IPv4UDPProto, /**< 指定内部 IPv4 UDP 传输器。 */
     IPv6UDPProto, /**< 指定内部 IPv6 UDP 传输器。 */
-    TCPProto      /**< 指定内部 TCP 传输器。 */
+    TCPProto,     /**< 指定内部 TCP 传输器。 */
+    IOUringUDPProto, /**< 指定基于 io_uring 的 IPv4 UDP 传输器，需通过
+                       RTPSession::Create(const RTPSessionParams &, RTPTransmitter *)
+                       使用。 */
+    TCPServerProto  /**< 指定监听端口并接受 TCP 连接的多反应器传输器。 */
   };
 
   /** 可以指定三种接收模式。 */
@@ -65,7 +105,10 @@ public:
 
   /** 通过调用此函数，缓冲区被清除，组件不能再使用。
    *  通过调用此函数，缓冲区被清除，组件不能再使用。
-   *  只有当再次调用 Create 函数时，组件才能再次使用。 */
+   *  只有当再次调用 Create 函数时，组件才能再次使用。
+   *  接收队列中剩余的数据包在这里被删除，这与 GetNextPacket 一样从队首取出，而接收
+   *  队列只允许一个消费者：调用前必须先停止调用 GetNextPacket 的线程（RTPSession
+   *  在销毁传输器之前停止轮询线程）。 */
   virtual void Destroy() = 0;
 
   /** 返回关于传输器的附加信息。
@@ -119,6 +162,27 @@ public:
    * 地址。 */
   virtual int SendRTCPData(const void *data, size_t len) = 0;
 
+  /** 将 \c packets 描述的 \c count 个RTP数据包依次发送到当前目标列表的所有 RTP 地址。
+   *  支持批量发送的传输器（例如启用了 UDP GSO 的 UDP 传输器）会重写此函数，
+   *  将整批数据包一次交给内核；默认实现对每个数据包调用 SendRTPData。
+   */
+  virtual int SendRTPDataBatch(const struct iovec *packets, size_t count);
+
+  /** 把 \c iov 中的 \c iovcount 个数据块依次拼接成一个RTP数据包，发送到当前目标
+   *  列表的所有 RTP 地址，例如单独构建的RTP头部和仍在应用程序缓冲区中的载荷。
+   *  UDP 和 TCP 传输器用 sendmsg 直接发送这些数据块，不会先把它们复制到连续的
+   *  缓冲区；默认实现把数据块复制到临时缓冲区后调用 SendRTPData。
+   *  \c iovcount 不能超过 RTPTRANS_MAXSENDIOV。
+   */
+  virtual int SendRTPDataV(const struct iovec *iov, size_t iovcount);
+
+  /** 等待直到内核不再引用 \c data 开始、长度为 \c len 的发送缓冲区。
+   *  使用零拷贝发送（例如 MSG_ZEROCOPY）的传输器在发送函数返回后仍会读取
+   *  调用者的缓冲区，调用者必须在修改或释放该缓冲区之前调用此函数；
+   *  默认实现总是复制数据，因此立即返回。
+   */
+  virtual int WaitForSendCompletion(const void *data, size_t len);
+
   /** 将 \c addr 指定的地址添加到目标列表。 */
   virtual int AddDestination(const RTPEndpoint &addr) = 0;
 
@@ -172,10 +236,50 @@ public:
   virtual bool NewDataAvailable() = 0;
 
   /** 在 RTPRawPacket 实例中返回接收到的 RTP 数据包的原始数据
-   *  （在 Poll 函数期间接收）。 */
+   *  （在 Poll 函数期间接收）。不需要与 Poll 串行化，但同一时间只能有一个线程
+   *  调用此函数，且不能与 Destroy 并发。 */
   virtual RTPRawPacket *GetNextPacket() = 0;
+
+  /** 返回因接收队列已满而被丢弃的数据包数量（见
+   *  RTPTransmissionParams::SetReceiveQueueLimits）。默认实现不限制队列，返回零。 */
+  virtual uint64_t GetNumDroppedPackets() { return 0; }
+
+  /** 返回因接收队列已满而被丢弃的数据包的总字节数。 */
+  virtual uint64_t GetNumDroppedBytes() { return 0; }
 };
 
+inline int RTPTransmitter::SendRTPDataBatch(const struct iovec *packets,
+                                            size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    int status = SendRTPData(packets[i].iov_base, packets[i].iov_len);
+    if (status < 0)
+      return status;
+  }
+  return 0;
+}
+
+inline int RTPTransmitter::SendRTPDataV(const struct iovec *iov,
+                                        size_t iovcount) {
+  if (iovcount > RTPTRANS_MAXSENDIOV)
+    return MEDIA_RTP_ERR_INVALID_PARAMETER;
+  if (iovcount == 1)
+    return SendRTPData(iov[0].iov_base, iov[0].iov_len);
+
+  size_t len = RTPGetIOVecLength(iov, iovcount);
+  uint8_t *buffer = new uint8_t[len];
+  if (buffer == 0)
+    return MEDIA_RTP_ERR_RESOURCE_ERROR;
+  RTPCopyIOVec(iov, iovcount, 0, buffer);
+
+  int status = SendRTPData(buffer, len);
+  delete[] buffer;
+  return status;
+}
+
+inline int RTPTransmitter::WaitForSendCompletion(const void *, size_t) {
+  return 0;
+}
+
 /** 传输参数的基类。
  *  此类是一个抽象类，对于特定类型的传输组件将有特定的实现。
  *  所有实际实现都继承 GetTransmissionProtocol 函数，该函数标识这些参数
@@ -185,6 +289,8 @@ class RTPTransmissionParams {
 protected:
   RTPTransmissionParams(RTPTransmitter::TransmissionProtocol p) {
     protocol = p;
+    maxqueuepackets = RTPTRANS_DEFAULTRECEIVEQUEUEPACKETS;
+    maxqueuebytes = 0;
   }
 
 public:
@@ -195,8 +301,25 @@ public:
     return protocol;
   }
 
+  /** 设置接收队列的上限：最多 \c maxpackets 个数据包（向上取整为2的幂），
+   *  以及最多 \c maxbytes 字节的数据，\c maxbytes 为零时不限制字节数。
+   *  队列满时传输器停止从套接字读取，由内核接收缓冲区（TCP 时由流量控制）承受突发，
+   *  仍然放不下的数据包被丢弃并计入 RTPTransmitter::GetNumDroppedPackets。 */
+  void SetReceiveQueueLimits(size_t maxpackets, size_t maxbytes) {
+    maxqueuepackets = maxpackets;
+    maxqueuebytes = maxbytes;
+  }
+
+  /** 返回接收队列最多容纳的数据包数量（默认为 RTPTRANS_DEFAULTRECEIVEQUEUEPACKETS）。 */
+  size_t GetReceiveQueueMaximumPackets() const { return maxqueuepackets; }
+
+  /** 返回接收队列最多容纳的字节数，零表示不限制（默认）。 */
+  size_t GetReceiveQueueMaximumBytes() const { return maxqueuebytes; }
+
 private:
   RTPTransmitter::TransmissionProtocol protocol;
+  size_t maxqueuepackets;
+  size_t maxqueuebytes;
 };
 
 /** 关于传输器的附加信息的基类。
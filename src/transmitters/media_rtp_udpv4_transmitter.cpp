@@ -4,14 +4,40 @@
 #include "media_rtp_defines.h"
 #include "media_rtp_structs.h"
 #include "media_rtp_errors.h"
+#include "media_rtp_received_message.h"
 #include <stdio.h>
+#include <errno.h>
+#if defined(RTP_HAVE_UDP_SEGMENT) || defined(RTP_HAVE_UDP_GRO)
+	#include <netinet/udp.h>
+#endif // RTP_HAVE_UDP_SEGMENT || RTP_HAVE_UDP_GRO
+#if defined(RTP_HAVE_MSG_ZEROCOPY) || defined(RTP_HAVE_SO_TIMESTAMPING)
+	#include <linux/errqueue.h>
+#endif // RTP_HAVE_MSG_ZEROCOPY || RTP_HAVE_SO_TIMESTAMPING
+#ifdef RTP_HAVE_MSG_ZEROCOPY
+	#include <poll.h>
+#endif // RTP_HAVE_MSG_ZEROCOPY
+#ifdef RTP_HAVE_SO_TIMESTAMPING
+	#include <linux/net_tstamp.h>
+#endif // RTP_HAVE_SO_TIMESTAMPING
+#ifdef RTP_HAVE_SO_REUSEPORT_CBPF
+	#include <linux/filter.h>
+#endif // RTP_HAVE_SO_REUSEPORT_CBPF
 #include <assert.h>
 #include <vector>
 
 #include <iostream>
 
 #define RTPUDPV4TRANS_MAXPACKSIZE							65535
+#define RTPUDPV4TRANS_MAXSENDBATCH							1024
+#define RTPUDPV4TRANS_MAXGSOSEGMENTS							64
+#define RTPUDPV4TRANS_RECVCONTROLSIZE							256
+#define RTPUDPV4TRANS_MAXGSOBYTES							(65535-RTPUDPV4TRANS_HEADERSIZE)
 #define RTPUDPV4TRANS_IFREQBUFSIZE							8192
+#define RTPUDPV4TRANS_ZEROCOPYPOLLMS							100
+#define RTPUDPV4TRANS_MAXTXTIMESTAMPREPORTS							256
+#define RTPUDPV4TRANS_POOLIDLEBYTES							(1024*1024)
+#define RTPUDPV4TRANS_POOLMINIDLE							64
+#define RTPUDPV4TRANS_RAWPACKETPOOLIDLE							1024
 
 #define RTPUDPV4TRANS_IS_MCASTADDR(x)							(((x)&0xF0000000) == 0xE0000000)
 
@@ -41,6 +67,8 @@ RTPUDPv4Transmitter::RTPUDPv4Transmitter() : RTPTransmitter()
 {
 	created = false;
 	init = false;
+	recvbufferpool = 0;
+	rawpacketpool = 0;
 }
 
 RTPUDPv4Transmitter::~RTPUDPv4Transmitter()
@@ -90,6 +118,20 @@ static int GetIPv4SocketPort(int s, uint16_t *pPort)
 	return 0;
 }
 
+static int EnableReusePort(int s)
+{
+#ifdef RTP_HAVE_SO_REUSEPORT_CBPF
+	int enable = 1;
+
+	if (setsockopt(s,SOL_SOCKET,SO_REUSEPORT,(const char *)&enable,sizeof(int)) != 0)
+		return MEDIA_RTP_ERR_OPERATION_FAILED;
+	return 0;
+#else
+	MEDIA_RTP_UNUSED(s);
+	return MEDIA_RTP_ERR_OPERATION_FAILED;
+#endif // RTP_HAVE_SO_REUSEPORT_CBPF
+}
+
 int GetAutoSockets(uint32_t bindIP, bool allowOdd, bool rtcpMux,
                    int *pRtpSock, int *pRtcpSock, 
                    uint16_t *pRtpPort, uint16_t *pRtcpPort)
@@ -252,9 +294,17 @@ int RTPUDPv4Transmitter::Create(size_t maximumpacketsize,const RTPTransmissionPa
 		params = (const RTPUDPv4TransmissionParams *)transparams;
 	}
 
+	// 存储空间保留到下一次 Create 或析构，Destroy 之后无锁的 GetNextPacket 仍可安全调用
+	if ((status = rawpacketqueue.Init(params->GetReceiveQueueMaximumPackets(),params->GetReceiveQueueMaximumBytes())) < 0)
+	{
+		MAINMUTEX_UNLOCK
+		return status;
+	}
+
 	if (params->GetUseExistingSockets(rtpsock, rtcpsock))
 	{
 		closesocketswhendone = false;
+		recvdontwait = params->GetNonBlockingReceive();
 
 		// 确定端口号
 		int status = GetIPv4SocketPort(rtpsock, &m_rtpPort);
@@ -273,6 +323,7 @@ int RTPUDPv4Transmitter::Create(size_t maximumpacketsize,const RTPTransmissionPa
 	else
 	{
 		closesocketswhendone = true;
+		recvdontwait = true;
 
 		if (params->GetPortbase() == 0)
 		{
@@ -316,6 +367,22 @@ int RTPUDPv4Transmitter::Create(size_t maximumpacketsize,const RTPTransmissionPa
 				}
 			}
 
+			// 套接字组中的每个套接字都必须在绑定之前设置 SO_REUSEPORT
+
+			uint16_t reusegroupsize = params->GetReusePortGroupSize();
+			if (reusegroupsize > 0)
+			{
+				status = EnableReusePort(rtpsock);
+				if (status >= 0 && rtpsock != rtcpsock)
+					status = EnableReusePort(rtcpsock);
+				if (status < 0)
+				{
+					CLOSESOCKETS;
+					MAINMUTEX_UNLOCK
+					return status;
+				}
+			}
+
 			// 绑定套接字
 
 			uint32_t bindIP = params->GetBindIP();
@@ -360,6 +427,19 @@ int RTPUDPv4Transmitter::Create(size_t maximumpacketsize,const RTPTransmissionPa
 			}
 			else
 				m_rtcpPort = m_rtpPort;
+
+			if (reusegroupsize > 1)
+			{
+				status = AttachSSRCSteeringFilter(rtpsock, reusegroupsize);
+				if (status >= 0 && rtpsock != rtcpsock)
+					status = AttachSSRCSteeringFilter(rtcpsock, reusegroupsize);
+				if (status < 0)
+				{
+					CLOSESOCKETS;
+					MAINMUTEX_UNLOCK
+					return status;
+				}
+			}
 		}
 
 		// 设置套接字缓冲区大小
@@ -451,11 +531,174 @@ int RTPUDPv4Transmitter::Create(size_t maximumpacketsize,const RTPTransmissionPa
 		}
 	}
 
+	// 接收套接字和中止描述符只在这里注册一次，之后每次等待都复用这些注册
+	if ((status = m_socketWaiter.Init()) >= 0)
+	{
+		status = m_socketWaiter.AddSocket(rtpsock);
+		if (status >= 0 && rtpsock != rtcpsock)
+			status = m_socketWaiter.AddSocket(rtcpsock);
+		if (status >= 0)
+			status = m_socketWaiter.AddSocket(m_pAbortDesc->GetAbortSocket());
+	}
+	if (status < 0)
+	{
+		m_socketWaiter.Destroy();
+		m_abortDesc.Destroy(); // 如果未初始化，则不执行任何操作
+		CLOSESOCKETS;
+		MAINMUTEX_UNLOCK
+		return status;
+	}
+
 	maxpacksize = maximumpacketsize;
+
+	rawpacketpool = RTPBufferPool::Create(sizeof(RTPRawPacket),RTPUDPV4TRANS_RAWPACKETPOOLIDLE);
+	if (rawpacketpool == 0 || (status = CreateReceiveBufferPool()) < 0)
+	{
+		DestroyReceiveBufferPools();
+		m_socketWaiter.Destroy();
+		m_abortDesc.Destroy(); // 如果未初始化，则不执行任何操作
+		CLOSESOCKETS;
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_RESOURCE_ERROR;
+	}
+
 	multicastTTL = params->GetMulticastTTL();
 	mcastifaceIP = params->GetMulticastInterfaceIP();
 	receivemode = RTPTransmitter::AcceptAll;
 
+#ifdef RTP_HAVE_UDP_GRO
+	usegro = false;
+	if (params->GetUDPGenericReceiveOffload())
+	{
+		int enable = 1;
+		if (setsockopt(rtpsock,SOL_UDP,UDP_GRO,(const char *)&enable,sizeof(int)) == 0)
+			usegro = true;
+	}
+#endif // RTP_HAVE_UDP_GRO
+
+#ifdef RTP_HAVE_SO_TIMESTAMPING
+	// 两个套接字都启用接收时间戳，RTCP 报告的接收时间同样用于计算往返时间
+	userxtimestamps = false;
+	if (params->GetKernelReceiveTimestamps())
+	{
+		int enable = 1;
+		if (setsockopt(rtpsock,SOL_SOCKET,SO_TIMESTAMPNS,(const char *)&enable,sizeof(int)) == 0 &&
+		    (rtcpsock == rtpsock || setsockopt(rtcpsock,SOL_SOCKET,SO_TIMESTAMPNS,(const char *)&enable,sizeof(int)) == 0))
+			userxtimestamps = true;
+	}
+
+	usetxtimestamps = false;
+	txtimestampreports.clear();
+	txtimestamplist.clear();
+	txtimestampnextid = 0;
+#ifdef RTP_HAVE_SENDMMSG
+	// 套接字选项只设置报告方式，发送时间戳由RTCP消息头上的控制消息逐个请求，
+	// 因此与RTCP多路复用的RTP数据包不会产生时间戳。内核只为请求了时间戳的数据报
+	// 分配编号，启用 OPT_ID 时编号从零开始
+	if (params->GetKernelTransmitTimestamps())
+	{
+		int flags = SOF_TIMESTAMPING_SOFTWARE|SOF_TIMESTAMPING_OPT_TSONLY|SOF_TIMESTAMPING_OPT_ID;
+		if (setsockopt(rtcpsock,SOL_SOCKET,SO_TIMESTAMPING,(const char *)&flags,sizeof(int)) == 0)
+		{
+			struct cmsghdr *cmsg = (struct cmsghdr *)txtimestampcontrol;
+			uint32_t txflags = SOF_TIMESTAMPING_TX_SOFTWARE;
+
+			memset(txtimestampcontrol,0,sizeof(txtimestampcontrol));
+			cmsg->cmsg_level = SOL_SOCKET;
+			cmsg->cmsg_type = SO_TIMESTAMPING;
+			cmsg->cmsg_len = CMSG_LEN(sizeof(uint32_t));
+			memcpy(CMSG_DATA(cmsg),&txflags,sizeof(uint32_t));
+			usetxtimestamps = true;
+		}
+	}
+#endif // RTP_HAVE_SENDMMSG
+#endif // RTP_HAVE_SO_TIMESTAMPING
+
+#if defined(RTP_HAVE_UDP_GRO) || defined(RTP_HAVE_SO_TIMESTAMPING)
+	recvcontrol = false;
+#ifdef RTP_HAVE_UDP_GRO
+	if (usegro)
+		recvcontrol = true;
+#endif // RTP_HAVE_UDP_GRO
+#ifdef RTP_HAVE_SO_TIMESTAMPING
+	if (userxtimestamps)
+		recvcontrol = true;
+#endif // RTP_HAVE_SO_TIMESTAMPING
+#endif // RTP_HAVE_UDP_GRO || RTP_HAVE_SO_TIMESTAMPING
+
+#ifdef RTP_HAVE_SO_ATTACH_FILTER
+	usekernelfilter = params->GetKernelPacketFilter();
+	kernelfilterdirty = false;
+	kernelfiltergeneration = 0;
+	kernelfiltercomplete = true;
+	if (usekernelfilter)
+	{
+		RTPSocketFilter filter(AF_INET);
+		std::vector<RTPAcceptIgnoreSet<uint32_t>::Entry> entries;
+
+		CompileKernelFilter(filter,receivemode,entries);
+		AttachKernelFilter(filter);
+	}
+#endif // RTP_HAVE_SO_ATTACH_FILTER
+
+#ifdef RTP_HAVE_RECVMMSG
+	// 预先建立 recvmmsg 所需的消息头数组，每个槽位对应一个最大长度的接收缓冲区
+	recvbatchsize = params->GetReceiveBatchSize();
+	if (recvbatchsize > RTPUDPV4TRANS_MAXRECEIVEBATCH)
+		recvbatchsize = RTPUDPV4TRANS_MAXRECEIVEBATCH;
+	if (recvbatchsize > 1)
+	{
+		recvbatchbuffer.resize(recvbatchsize*RTPUDPV4TRANS_MAXPACKSIZE);
+		recvbatchmsgs.resize(recvbatchsize);
+		recvbatchiovecs.resize(recvbatchsize*2);
+		recvbatchpoolbuffers.resize(recvbatchsize,0);
+		recvbatchaddrs.resize(recvbatchsize);
+		recvbatchcontrol.resize(recvbatchsize*RTPUDPV4TRANS_RECVCONTROLSIZE);
+
+		// 第一个 iovec 指向池缓冲区，在每次 recvmmsg 之前补齐；
+		// 第二个 iovec 是固定的溢出缓冲区，只接收超过池缓冲区大小的部分
+		for (size_t i = 0 ; i < recvbatchsize ; i++)
+		{
+			recvbatchiovecs[i*2].iov_base = 0;
+			recvbatchiovecs[i*2].iov_len = 0;
+			recvbatchiovecs[i*2+1].iov_base = &recvbatchbuffer[i*RTPUDPV4TRANS_MAXPACKSIZE];
+			recvbatchiovecs[i*2+1].iov_len = RTPUDPV4TRANS_MAXPACKSIZE;
+
+			memset(&recvbatchmsgs[i],0,sizeof(struct mmsghdr));
+			recvbatchmsgs[i].msg_hdr.msg_name = &recvbatchaddrs[i];
+			recvbatchmsgs[i].msg_hdr.msg_iov = &recvbatchiovecs[i*2];
+			recvbatchmsgs[i].msg_hdr.msg_iovlen = 2;
+		}
+	}
+#endif // RTP_HAVE_RECVMMSG
+
+#ifdef RTP_HAVE_UDP_SEGMENT
+	// 先尝试设置一次零分段大小，以确认内核支持 UDP GSO；
+	// 不支持的内核会忽略 UDP_SEGMENT 控制消息而发送一个超大数据报，因此必须事先检查
+	usegso = false;
+	if (params->GetUDPSegmentationOffload())
+	{
+		int gsosize = 0;
+		if (setsockopt(rtpsock,SOL_UDP,UDP_SEGMENT,(const char *)&gsosize,sizeof(int)) == 0)
+			usegso = true;
+	}
+#endif // RTP_HAVE_UDP_SEGMENT
+
+#ifdef RTP_HAVE_MSG_ZEROCOPY
+	// 零拷贝发送需要先在套接字上启用 SO_ZEROCOPY，内核不支持时回退为普通发送；
+	// 只有新套接字的通知编号才确定从零开始，已有的套接字可能已经用过一些编号
+	zerocopythreshold = 0;
+	zerocopytimeout = params->GetZeroCopyTimeout().GetDouble();
+	zerocopypending.clear();
+	zerocopyfirstid = 0;
+	if (params->GetZeroCopyThreshold() > 0 && closesocketswhendone)
+	{
+		int enable = 1;
+		if (setsockopt(rtpsock,SOL_SOCKET,SO_ZEROCOPY,(const char *)&enable,sizeof(int)) == 0)
+			zerocopythreshold = params->GetZeroCopyThreshold();
+	}
+#endif // RTP_HAVE_MSG_ZEROCOPY
+
 	localhostname = 0;
 	localhostnamelength = 0;
 
@@ -486,24 +729,42 @@ void RTPUDPv4Transmitter::Destroy()
 	
 	CLOSESOCKETS;
 	destinations.clear();
+	RebuildDestinationArrays();
 #ifdef RTP_SUPPORT_IPV4MULTICAST
 	multicastgroups.clear();
 #endif // RTP_SUPPORT_IPV4MULTICAST
 	FlushPackets();
+#ifdef RTP_HAVE_MSG_ZEROCOPY
+	zerocopypending.clear();
+#endif // RTP_HAVE_MSG_ZEROCOPY
+#ifdef RTP_HAVE_SO_TIMESTAMPING
+	txtimestampreports.clear();
+	txtimestamplist.clear();
+#endif // RTP_HAVE_SO_TIMESTAMPING
+	DestroyReceiveBufferPools();
 	ClearAcceptIgnoreInfo();
 	localIPs.clear();
+#ifdef RTP_HAVE_RECVMMSG
+	std::vector<uint8_t>().swap(recvbatchbuffer);
+	std::vector<struct mmsghdr>().swap(recvbatchmsgs);
+	std::vector<struct iovec>().swap(recvbatchiovecs);
+	std::vector<uint8_t *>().swap(recvbatchpoolbuffers);
+	std::vector<struct sockaddr_in>().swap(recvbatchaddrs);
+	std::vector<uint8_t>().swap(recvbatchcontrol);
+#endif // RTP_HAVE_RECVMMSG
 	created = false;
 	
 	if (waitingfordata)
 	{
 		m_pAbortDesc->SendAbortSignal();
-		m_abortDesc.Destroy(); // 如果未初始化，则不执行任何操作
 		MAINMUTEX_UNLOCK
 		WAITMUTEX_LOCK // 确保 WaitForIncomingData 函数已结束
 		WAITMUTEX_UNLOCK
+		MAINMUTEX_LOCK
 	}
-	else
-		m_abortDesc.Destroy(); // 如果未初始化，则不执行任何操作
+	// 等待结束后才能关闭中止描述符，关闭的描述符会从 epoll 集合中移除而不再唤醒等待
+	m_socketWaiter.Destroy();
+	m_abortDesc.Destroy(); // 如果未初始化，则不执行任何操作
 
 	MAINMUTEX_UNLOCK
 }
@@ -710,6 +971,9 @@ int RTPUDPv4Transmitter::Poll()
 	if (!init)
 		return MEDIA_RTP_ERR_INVALID_STATE;
 
+	// 接受和忽略列表变化后，先在锁外重新生成内核中的过滤程序
+	FlushKernelFilter();
+
 	int status;
 	
 	MAINMUTEX_LOCK
@@ -718,13 +982,26 @@ int RTPUDPv4Transmitter::Poll()
 		MAINMUTEX_UNLOCK
 		return MEDIA_RTP_ERR_INVALID_STATE;
 	}
+#if defined(RTP_HAVE_MSG_ZEROCOPY) || defined(RTP_HAVE_SO_TIMESTAMPING)
+	// 错误队列中的通知会让套接字一直报告错误事件，在这里读出它们，避免等待函数被反复唤醒
+	ProcessErrorQueues();
+#endif // RTP_HAVE_MSG_ZEROCOPY || RTP_HAVE_SO_TIMESTAMPING
 	status = PollSocket(true); // 轮询 RTP 套接字
 	if (rtpsock != rtcpsock) // 多路复用时无需轮询两次
 	{
 		if (status >= 0)
 			status = PollSocket(false); // 轮询 RTCP 套接字
 	}
+#ifdef RTP_HAVE_SO_TIMESTAMPING
+	std::vector<std::pair<RTPNTPTime,RTPTime> > timestamps;
+	timestamps.swap(txtimestamplist);
+#endif // RTP_HAVE_SO_TIMESTAMPING
 	MAINMUTEX_UNLOCK
+
+#ifdef RTP_HAVE_SO_TIMESTAMPING
+	for (size_t i = 0 ; i < timestamps.size() ; i++)
+		OnRTCPTransmitTimestamp(timestamps[i].first,timestamps[i].second);
+#endif // RTP_HAVE_SO_TIMESTAMPING
 	return status;
 }
 
@@ -732,6 +1009,8 @@ int RTPUDPv4Transmitter::WaitForIncomingData(const RTPTime &delay,bool *dataavai
 {
 	if (!init)
 		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	FlushKernelFilter();
 	
 	MAINMUTEX_LOCK
 	
@@ -747,19 +1026,19 @@ int RTPUDPv4Transmitter::WaitForIncomingData(const RTPTime &delay,bool *dataavai
 	}
 	
 	int abortSocket = m_pAbortDesc->GetAbortSocket();
-
-	int socks[3] = { rtpsock, rtcpsock, abortSocket };
-	int8_t readflags[3] = { 0, 0, 0 };
-	const int idxRTP = 0;
-	const int idxRTCP = 1;
-	const int idxAbort = 2;
+	int readysocks[3];
 	
 	waitingfordata = true;
+#ifdef RTP_HAVE_SO_ATTACH_FILTER
+	// 刷新之后列表又有变化时立即返回，由接下来的 Poll 重新生成程序
+	if (kernelfilterdirty)
+		m_pAbortDesc->SendAbortSignal();
+#endif // RTP_HAVE_SO_ATTACH_FILTER
 	
 	WAITMUTEX_LOCK
 	MAINMUTEX_UNLOCK
 
-	int status = RTPSelect(socks, readflags, 3, delay);
+	int status = m_socketWaiter.Wait(delay, readysocks, 3);
 	if (status < 0)
 	{
 		MAINMUTEX_LOCK
@@ -778,17 +1057,19 @@ int RTPUDPv4Transmitter::WaitForIncomingData(const RTPTime &delay,bool *dataavai
 		return 0;
 	}
 		
-	// 如果中止，则从中止缓冲区读取
-	if (readflags[idxAbort])
-		m_pAbortDesc->ReadSignallingByte();
+	bool avail = false;
 
-	if (dataavailable != 0)
+	for (int i = 0 ; i < status ; i++)
 	{
-		if (readflags[idxRTP] || readflags[idxRTCP])
-			*dataavailable = true;
+		// 如果中止，则从中止缓冲区读取
+		if (readysocks[i] == abortSocket)
+			m_pAbortDesc->ReadSignallingByte();
 		else
-			*dataavailable = false;
-	}	
+			avail = true;
+	}
+
+	if (dataavailable != 0)
+		*dataavailable = avail;
 	
 	MAINMUTEX_UNLOCK
 	WAITMUTEX_UNLOCK
@@ -836,12 +1117,17 @@ int RTPUDPv4Transmitter::SendRTPData(const void *data,size_t len)
 		return MEDIA_RTP_ERR_RESOURCE_ERROR;
 	}
 	
-	for (const auto& dest : destinations)
-	{
-		sendto(rtpsock,(const char *)data,len,0,dest.GetRtpSockAddr(),dest.GetSockAddrLen());
-	}
+	std::vector<std::pair<RTPEndpoint,int> > senderrors;
+	struct iovec iov;
+
+	iov.iov_base = const_cast<void *>(data);
+	iov.iov_len = len;
+	SendToDestinations(true,&iov,1,senderrors);
 	
 	MAINMUTEX_UNLOCK
+
+	for (size_t i = 0 ; i < senderrors.size() ; i++)
+		OnSendError(senderrors[i].first,true,senderrors[i].second);
 	return 0;
 }
 
@@ -863,12 +1149,96 @@ int RTPUDPv4Transmitter::SendRTCPData(const void *data,size_t len)
 		return MEDIA_RTP_ERR_RESOURCE_ERROR;
 	}
 	
-	for (const auto& dest : destinations)
+	std::vector<std::pair<RTPEndpoint,int> > senderrors;
+	struct iovec iov;
+
+	iov.iov_base = const_cast<void *>(data);
+	iov.iov_len = len;
+	SendToDestinations(false,&iov,1,senderrors);
+	
+	MAINMUTEX_UNLOCK
+
+	for (size_t i = 0 ; i < senderrors.size() ; i++)
+		OnSendError(senderrors[i].first,false,senderrors[i].second);
+	return 0;
+}
+
+int RTPUDPv4Transmitter::SendRTPDataBatch(const struct iovec *packets,size_t count)
+{
+	if (!init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	MAINMUTEX_LOCK
+	
+	if (!created)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	}
+	for (size_t i = 0 ; i < count ; i++)
+	{
+		if (packets[i].iov_len > maxpacksize)
+		{
+			MAINMUTEX_UNLOCK
+			return MEDIA_RTP_ERR_RESOURCE_ERROR;
+		}
+	}
+
+	std::vector<std::pair<RTPEndpoint,int> > senderrors;
+	size_t pos = 0;
+
+	while (pos < count)
+	{
+#ifdef RTP_HAVE_UDP_SEGMENT
+		if (usegso)
+		{
+			size_t num = GetSegmentGroupLength(packets+pos,count-pos);
+			if (num > 1)
+			{
+				SendSegmentsToDestinations(packets+pos,num,senderrors);
+				pos += num;
+				continue;
+			}
+		}
+#endif // RTP_HAVE_UDP_SEGMENT
+		SendToDestinations(true,packets+pos,1,senderrors);
+		pos++;
+	}
+
+	MAINMUTEX_UNLOCK
+
+	for (size_t i = 0 ; i < senderrors.size() ; i++)
+		OnSendError(senderrors[i].first,true,senderrors[i].second);
+	return 0;
+}
+
+int RTPUDPv4Transmitter::SendRTPDataV(const struct iovec *iov,size_t iovcount)
+{
+	if (!init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	if (iovcount > RTPTRANS_MAXSENDIOV)
+		return MEDIA_RTP_ERR_INVALID_PARAMETER;
+
+	MAINMUTEX_LOCK
+	
+	if (!created)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	}
+	if (RTPGetIOVecLength(iov,iovcount) > maxpacksize)
 	{
-		sendto(rtcpsock,(const char *)data,len,0,dest.GetRtcpSockAddr(),dest.GetSockAddrLen());
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_RESOURCE_ERROR;
 	}
 	
+	std::vector<std::pair<RTPEndpoint,int> > senderrors;
+	SendToDestinations(true,iov,iovcount,senderrors);
+	
 	MAINMUTEX_UNLOCK
+
+	for (size_t i = 0 ; i < senderrors.size() ; i++)
+		OnSendError(senderrors[i].first,true,senderrors[i].second);
 	return 0;
 }
 
@@ -893,6 +1263,8 @@ int RTPUDPv4Transmitter::AddDestination(const RTPEndpoint &addr)
 	
 	auto result = destinations.insert(addr);
 	int status = result.second ? 0 : MEDIA_RTP_ERR_INVALID_STATE;
+	if (result.second)
+		RebuildDestinationArrays();
 
 	MAINMUTEX_UNLOCK
 	return status;
@@ -918,6 +1290,8 @@ int RTPUDPv4Transmitter::DeleteDestination(const RTPEndpoint &addr)
 	
 	size_t erased = destinations.erase(addr);
 	int status = erased > 0 ? 0 : MEDIA_RTP_ERR_INVALID_STATE;
+	if (erased > 0)
+		RebuildDestinationArrays();
 	
 	MAINMUTEX_UNLOCK
 	return status;
@@ -930,7 +1304,10 @@ void RTPUDPv4Transmitter::ClearDestinations()
 	
 	MAINMUTEX_LOCK
 	if (created)
+	{
 		destinations.clear();
+		RebuildDestinationArrays();
+	}
 	MAINMUTEX_UNLOCK
 }
 
@@ -1107,7 +1484,8 @@ int RTPUDPv4Transmitter::SetReceiveMode(RTPTransmitter::ReceiveMode m)
 	if (m != receivemode)
 	{
 		receivemode = m;
-		acceptignoreinfo.clear();
+		ClearAcceptIgnoreInfo();
+		KernelFilterChanged();
 	}
 	MAINMUTEX_UNLOCK
 	return 0;
@@ -1182,7 +1560,10 @@ void RTPUDPv4Transmitter::ClearIgnoreList()
 	
 	MAINMUTEX_LOCK
 	if (created && receivemode == RTPTransmitter::IgnoreSome)
+	{
 		ClearAcceptIgnoreInfo();
+		KernelFilterChanged();
+	}
 	MAINMUTEX_UNLOCK
 }
 
@@ -1255,7 +1636,10 @@ void RTPUDPv4Transmitter::ClearAcceptList()
 	
 	MAINMUTEX_LOCK
 	if (created && receivemode == RTPTransmitter::AcceptSome)
+	{
 		ClearAcceptIgnoreInfo();
+		KernelFilterChanged();
+	}
 	MAINMUTEX_UNLOCK
 }
 
@@ -1276,58 +1660,29 @@ int RTPUDPv4Transmitter::SetMaximumPacketSize(size_t s)
 		return MEDIA_RTP_ERR_RESOURCE_ERROR;
 	}
 	maxpacksize = s;
+
+	// 接收缓冲区的大小跟随最大数据包大小，仍在使用中的旧缓冲区归还时会被释放
+	int status = CreateReceiveBufferPool();
 	MAINMUTEX_UNLOCK
-	return 0;
+	return status;
 }
 
 bool RTPUDPv4Transmitter::NewDataAvailable()
 {
 	if (!init)
 		return false;
-	
-	MAINMUTEX_LOCK
-	
-	bool v;
-		
-	if (!created)
-		v = false;
-	else
-	{
-		if (rawpacketlist.empty())
-			v = false;
-		else
-			v = true;
-	}
-	
-	MAINMUTEX_UNLOCK
-	return v;
+	return !rawpacketqueue.IsEmpty();
 }
 
 RTPRawPacket *RTPUDPv4Transmitter::GetNextPacket()
 {
 	if (!init)
 		return 0;
-	
-	MAINMUTEX_LOCK
-	
-	RTPRawPacket *p;
-	
-	if (!created)
-	{
-		MAINMUTEX_UNLOCK
-		return 0;
-	}
-	if (rawpacketlist.empty())
-	{
-		MAINMUTEX_UNLOCK
-		return 0;
-	}
 
-	p = *(rawpacketlist.begin());
-	rawpacketlist.pop_front();
-
-	MAINMUTEX_UNLOCK
-	return p;
+	// 不需要主锁：轮询时只在队尾加入数据包，这里只从队首取出。
+	// Destroy 清空队列时也是消费者，调用者保证两者不会并发（见 RTPTransmitter::Destroy），
+	// 因此这里不必检查 created
+	return rawpacketqueue.Pop();
 }
 
 // 私有函数从这里开始...
@@ -1352,300 +1707,962 @@ bool RTPUDPv4Transmitter::SetMulticastTTL(uint8_t ttl)
 }
 #endif // RTP_SUPPORT_IPV4MULTICAST
 
-void RTPUDPv4Transmitter::FlushPackets()
+void RTPUDPv4Transmitter::RebuildDestinationArrays()
 {
-	std::list<RTPRawPacket*>::const_iterator it;
-
-	for (it = rawpacketlist.begin() ; it != rawpacketlist.end() ; ++it)
-		delete *it;
-	rawpacketlist.clear();
+	destinationlist.clear();
+	for (const auto& dest : destinations)
+		destinationlist.push_back(&dest);
+
+#ifdef RTP_HAVE_SENDMMSG
+	// 预先建立每个目标的消息头，它们都指向同一组 iovec，
+	// 因此发送时只需设置一次数据指针和长度
+	size_t num = destinationlist.size();
+
+	rtpsendmsgs.resize(num);
+	rtcpsendmsgs.resize(num);
+	for (size_t i = 0 ; i < num ; i++)
+	{
+		const RTPEndpoint *dest = destinationlist[i];
+
+		memset(&rtpsendmsgs[i],0,sizeof(struct mmsghdr));
+		rtpsendmsgs[i].msg_hdr.msg_name = const_cast<struct sockaddr *>(dest->GetRtpSockAddr());
+		rtpsendmsgs[i].msg_hdr.msg_namelen = dest->GetSockAddrLen();
+		rtpsendmsgs[i].msg_hdr.msg_iov = sendiovecs;
+		rtpsendmsgs[i].msg_hdr.msg_iovlen = 1;
+
+		memset(&rtcpsendmsgs[i],0,sizeof(struct mmsghdr));
+		rtcpsendmsgs[i].msg_hdr.msg_name = const_cast<struct sockaddr *>(dest->GetRtcpSockAddr());
+		rtcpsendmsgs[i].msg_hdr.msg_namelen = dest->GetSockAddrLen();
+		rtcpsendmsgs[i].msg_hdr.msg_iov = sendiovecs;
+		rtcpsendmsgs[i].msg_hdr.msg_iovlen = 1;
+#ifdef RTP_HAVE_SO_TIMESTAMPING
+		if (usetxtimestamps)
+		{
+			rtcpsendmsgs[i].msg_hdr.msg_control = txtimestampcontrol;
+			rtcpsendmsgs[i].msg_hdr.msg_controllen = CMSG_SPACE(sizeof(uint32_t));
+		}
+#endif // RTP_HAVE_SO_TIMESTAMPING
+	}
+#endif // RTP_HAVE_SENDMMSG
 }
 
-int RTPUDPv4Transmitter::PollSocket(bool rtp)
+// 由 iovcount 个数据块组成的数据包发送给所有目标
+void RTPUDPv4Transmitter::SendToDestinations(bool rtp, const struct iovec *iov, size_t iovcount,
+                                          std::vector<std::pair<RTPEndpoint,int> > &senderrors)
 {
-	RTPSOCKLENTYPE fromlen;
-	int recvlen;
-	char packetbuffer[RTPUDPV4TRANS_MAXPACKSIZE];
-	size_t len;
-	int sock;
-	struct sockaddr_in srcaddr;
-	bool dataavailable;
-	
-	if (rtp)
-		sock = rtpsock;
-	else
-		sock = rtcpsock;
-	
-	do
+	int sock = (rtp)?rtpsock:rtcpsock;
+	int flags = 0;
+	size_t numsent = 0;
+	const void *data = iov[0].iov_base;
+	size_t len = iov[0].iov_len;
+
+#ifdef RTP_HAVE_MSG_ZEROCOPY
+	// 完成通知按缓冲区记录，因此只有连续的数据才使用零拷贝发送
+	if (rtp && iovcount == 1 && zerocopythreshold > 0 && len >= zerocopythreshold)
 	{
-		len = 0;
-		RTPIOCTL(sock,FIONREAD,&len);
+		// 先读出已有的完成通知，未读的通知占用套接字内存，会限制同时进行的零拷贝发送
+		if (!zerocopypending.empty())
+			ProcessErrorQueue(rtpsock);
+		flags = MSG_ZEROCOPY;
+	}
+#endif // RTP_HAVE_MSG_ZEROCOPY
 
-		if (len <= 0) // 确保长度为零的数据包不会排队
-		{
-			// 另一种解决方法是只使用非阻塞套接字。
-			// 但是，由于用户可以访问套接字，我不知道这会如何影响其他人的代码，
-			// 所以我选择在 ioctl 返回长度为零的情况下使用额外的 select 调用来解决此问题。
-			
-			int8_t isset = 0;
-			int status = RTPSelect(&sock, &isset, 1, RTPTime(0));
-			if (status < 0)
-				return status;
+#ifdef RTP_HAVE_SENDMMSG
+	std::vector<struct mmsghdr> &msgs = (rtp)?rtpsendmsgs:rtcpsendmsgs;
+	size_t num = msgs.size();
+	size_t offset = 0;
 
-			if (isset)
-				dataavailable = true;
-			else
-				dataavailable = false;
+	memcpy(sendiovecs,iov,iovcount*sizeof(struct iovec));
+	if (iovcount != 1) // 消息头默认只使用一个数据块
+	{
+		for (size_t i = 0 ; i < num ; i++)
+			msgs[i].msg_hdr.msg_iovlen = iovcount;
+	}
+
+	while (offset < num)
+	{
+		size_t count = num-offset;
+		if (count > RTPUDPV4TRANS_MAXSENDBATCH)
+			count = RTPUDPV4TRANS_MAXSENDBATCH;
+
+		int sent = sendmmsg(sock,&msgs[offset],(unsigned int)count,flags);
+		if (sent > 0)
+		{
+			offset += (size_t)sent;
+			numsent += (size_t)sent;
 		}
 		else
-			dataavailable = true;
-		
-		if (dataavailable)
 		{
-			RTPTime curtime = RTPTime::CurrentTime();
-			fromlen = sizeof(struct sockaddr_in);
-			recvlen = recvfrom(sock,packetbuffer,RTPUDPV4TRANS_MAXPACKSIZE,0,(struct sockaddr *)&srcaddr,&fromlen);
-			if (recvlen > 0)
-			{
-				bool acceptdata;
-
-				// 获取到数据，处理它
-				if (receivemode == RTPTransmitter::AcceptAll)
-					acceptdata = true;
-				else
-					acceptdata = ShouldAcceptData(ntohl(srcaddr.sin_addr.s_addr),ntohs(srcaddr.sin_port));
-				
-				if (acceptdata)
-				{
-					RTPRawPacket *pack;
-					RTPEndpoint *addr;
-					uint8_t *datacopy;
+			// sendmmsg 只在第一条消息失败时返回错误，记录该目标后从下一个目标继续；
+			// 部分发送时，失败的那条消息会在下一次调用中作为第一条消息报告
+			if (sent < 0 && errno == EINTR)
+				continue;
+			senderrors.push_back(std::make_pair(*destinationlist[offset],(sent < 0)?errno:0));
+			offset++;
+		}
+	}
 
-					addr = new RTPEndpoint(ntohl(srcaddr.sin_addr.s_addr),ntohs(srcaddr.sin_port));
-					if (addr == 0)
-						return MEDIA_RTP_ERR_RESOURCE_ERROR;
-					datacopy = new uint8_t[recvlen];
-					if (datacopy == 0)
-					{
-						delete addr;
-						return MEDIA_RTP_ERR_RESOURCE_ERROR;
-					}
-					memcpy(datacopy,packetbuffer,recvlen);
-					
-					bool isrtp = rtp;
-					if (rtpsock == rtcpsock) // 多路复用时检查负载类型
-					{
-						isrtp = true;
+	if (iovcount != 1)
+	{
+		for (size_t i = 0 ; i < num ; i++)
+			msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+#else
+	for (size_t i = 0 ; i < destinationlist.size() ; i++)
+	{
+		const RTPEndpoint *dest = destinationlist[i];
+		const struct sockaddr *sockaddr = (rtp)?dest->GetRtpSockAddr():dest->GetRtcpSockAddr();
 
-						if ((size_t)recvlen > sizeof(RTCPCommonHeader))
-						{
-							RTCPCommonHeader *rtcpheader = (RTCPCommonHeader *)datacopy;
-							uint8_t packettype = rtcpheader->packettype;
+		struct msghdr msg;
 
-    						if (packettype >= 200 && packettype <= 204)
-								isrtp = false;
-						}
-					}
-						
-					pack = new RTPRawPacket(datacopy,recvlen,addr,curtime,isrtp);
-					if (pack == 0)
-					{
-						delete addr;
-						delete [] datacopy;
-						return MEDIA_RTP_ERR_RESOURCE_ERROR;
-					}
-					rawpacketlist.push_back(pack);	
-				}
-			}
-		}
-	} while (dataavailable);
+		memset(&msg,0,sizeof(struct msghdr));
+		msg.msg_name = const_cast<struct sockaddr *>(sockaddr);
+		msg.msg_namelen = dest->GetSockAddrLen();
+		msg.msg_iov = const_cast<struct iovec *>(iov);
+		msg.msg_iovlen = iovcount;
+		if (sendmsg(sock,&msg,flags) < 0)
+			senderrors.push_back(std::make_pair(*dest,errno));
+		else
+			numsent++;
+	}
+#endif // RTP_HAVE_SENDMMSG
 
-	return 0;
-}
+#ifdef RTP_HAVE_MSG_ZEROCOPY
+	// 内核为每次成功的零拷贝发送分配一个连续递增的通知编号
+	if (flags & MSG_ZEROCOPY)
+	{
+		for (size_t i = 0 ; i < numsent ; i++)
+			zerocopypending.push_back(ZeroCopySend((const uint8_t *)data,len));
+	}
+#endif // RTP_HAVE_MSG_ZEROCOPY
 
-int RTPUDPv4Transmitter::ProcessAddAcceptIgnoreEntry(uint32_t ip,uint16_t port)
-{
-	auto it = acceptignoreinfo.find(ip);
-	if (it != acceptignoreinfo.end()) // 该 IP 地址的条目已存在
+#ifdef RTP_HAVE_SO_TIMESTAMPING
+	// 每个成功发送的RTCP数据包产生一个发送时间戳，按顺序记下其中的发送方报告时间
+	if (!rtp && usetxtimestamps && numsent > 0)
 	{
-		PortInfo *portinf = it->second;
-		
-		if (port == 0) // 选择所有端口
+		const uint8_t *packet = (const uint8_t *)data;
+		RTPNTPTime srntptime(0,0);
+
+		if (len >= 16 && packet[1] == RTP_RTCPTYPE_SR)
 		{
-			portinf->all = true;
-			portinf->portlist.clear();
+			uint32_t msw,lsw;
+
+			memcpy(&msw,packet+8,sizeof(uint32_t));
+			memcpy(&lsw,packet+12,sizeof(uint32_t));
+			srntptime = RTPNTPTime(ntohl(msw),ntohl(lsw));
 		}
-		else if (!portinf->all)
-		{
-			std::list<uint16_t>::const_iterator it,begin,end;
+		for (size_t i = 0 ; i < numsent ; i++)
+			txtimestampreports.push_back(std::make_pair(txtimestampnextid++,srntptime));
 
-			begin = portinf->portlist.begin();
-			end = portinf->portlist.end();
-			for (it = begin ; it != end ; it++)
-			{
-				if (*it == port) // 已在列表中
-					return 0;
-			}
-			portinf->portlist.push_front(port);
-		}
+		// 丢失的时间戳对应的条目在收到更新的时间戳时删除，这里再限制一次总数
+		while (txtimestampreports.size() > RTPUDPV4TRANS_MAXTXTIMESTAMPREPORTS)
+			txtimestampreports.pop_front();
 	}
-	else // 需要为此 IP 地址创建条目
+#endif // RTP_HAVE_SO_TIMESTAMPING
+
+#if !defined(RTP_HAVE_MSG_ZEROCOPY) && !defined(RTP_HAVE_SO_TIMESTAMPING)
+	MEDIA_RTP_UNUSED(numsent);
+	MEDIA_RTP_UNUSED(data);
+	MEDIA_RTP_UNUSED(len);
+#endif // !RTP_HAVE_MSG_ZEROCOPY && !RTP_HAVE_SO_TIMESTAMPING
+}
+
+int RTPUDPv4Transmitter::WaitForSendCompletion(const void *data,size_t len)
+{
+	if (!init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	MAINMUTEX_LOCK
+	if (!created)
 	{
-		PortInfo *portinf;
-		
-		portinf = new PortInfo();
-		if (port == 0) // 选择所有端口
-			portinf->all = true;
-		else
-			portinf->portlist.push_front(port);
-		
-		auto result = acceptignoreinfo.emplace(ip, portinf);
-		int status = result.second ? 0 : MEDIA_RTP_ERR_INVALID_STATE;
-		if (status < 0)
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	}
+
+#ifdef RTP_HAVE_MSG_ZEROCOPY
+	if (!zerocopypending.empty())
+		ProcessErrorQueue(rtpsock);
+
+	double starttime = RTPTime::CurrentTime().GetDouble();
+
+	while (IsZeroCopyBufferInUse((const uint8_t *)data,len))
+	{
+		if (RTPTime::CurrentTime().GetDouble()-starttime > zerocopytimeout)
 		{
-			delete portinf;
-			return status;
+			MAINMUTEX_UNLOCK
+			return MEDIA_RTP_ERR_OPERATION_FAILED;
+		}
+
+		// 完成通知到达时套接字报告 POLLERR；等待期间释放锁，以免阻塞接收和其他发送
+		struct pollfd fd;
+
+		fd.fd = rtpsock;
+		fd.events = 0;
+		fd.revents = 0;
+
+		MAINMUTEX_UNLOCK
+		poll(&fd,1,RTPUDPV4TRANS_ZEROCOPYPOLLMS);
+		MAINMUTEX_LOCK
+
+		if (!created)
+		{
+			MAINMUTEX_UNLOCK
+			return MEDIA_RTP_ERR_INVALID_STATE;
 		}
+		ProcessErrorQueue(rtpsock);
 	}
+#else
+	MEDIA_RTP_UNUSED(data);
+	MEDIA_RTP_UNUSED(len);
+#endif // RTP_HAVE_MSG_ZEROCOPY
 
+	MAINMUTEX_UNLOCK
 	return 0;
 }
 
-void RTPUDPv4Transmitter::ClearAcceptIgnoreInfo()
+size_t RTPUDPv4Transmitter::GetNumPendingZeroCopySends()
+{
+	size_t num = 0;
+
+	if (!init)
+		return 0;
+
+	MAINMUTEX_LOCK
+#ifdef RTP_HAVE_MSG_ZEROCOPY
+	if (created)
+		num = zerocopypending.size();
+#endif // RTP_HAVE_MSG_ZEROCOPY
+	MAINMUTEX_UNLOCK
+	return num;
+}
+
+bool RTPUDPv4Transmitter::IsKernelFilterComplete()
 {
-	for (auto& pair : acceptignoreinfo)
+	bool complete = true;
+
+	if (!init)
+		return true;
+
+	MAINMUTEX_LOCK
+#ifdef RTP_HAVE_SO_ATTACH_FILTER
+	if (created && usekernelfilter)
+		complete = kernelfiltercomplete;
+#endif // RTP_HAVE_SO_ATTACH_FILTER
+	MAINMUTEX_UNLOCK
+	return complete;
+}
+
+#if defined(RTP_HAVE_MSG_ZEROCOPY) || defined(RTP_HAVE_SO_TIMESTAMPING)
+void RTPUDPv4Transmitter::ProcessErrorQueues()
+{
+	bool rtpqueue = false;
+	bool rtcpqueue = false;
+
+#ifdef RTP_HAVE_MSG_ZEROCOPY
+	if (zerocopythreshold > 0)
+		rtpqueue = true;
+#endif // RTP_HAVE_MSG_ZEROCOPY
+#ifdef RTP_HAVE_SO_TIMESTAMPING
+	if (usetxtimestamps)
+		rtcpqueue = true;
+#endif // RTP_HAVE_SO_TIMESTAMPING
+
+	if (rtpqueue)
+		ProcessErrorQueue(rtpsock);
+	if (rtcpqueue && !(rtpqueue && rtcpsock == rtpsock))
+		ProcessErrorQueue(rtcpsock);
+}
+
+void RTPUDPv4Transmitter::ProcessErrorQueue(int sock)
+{
+	union
+	{
+		char buf[RTPUDPV4TRANS_RECVCONTROLSIZE];
+		struct cmsghdr align;
+	} control;
+	struct msghdr msg;
+
+	// 零拷贝完成通知和发送时间戳都在套接字的错误队列中，每次读出一条
+	while (true)
 	{
-		PortInfo *inf = pair.second;
-		delete inf;
+		memset(&msg,0,sizeof(struct msghdr));
+		msg.msg_control = control.buf;
+		msg.msg_controllen = sizeof(control.buf);
+		if (recvmsg(sock,&msg,MSG_ERRQUEUE|MSG_DONTWAIT) < 0)
+			break;
+
+#ifdef RTP_HAVE_SO_TIMESTAMPING
+		bool istxtimestamp = false;
+		uint32_t txtimestampid = 0;
+		RTPTime txtime(0.0);
+#endif // RTP_HAVE_SO_TIMESTAMPING
+
+		for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg) ; cmsg != 0 ; cmsg = CMSG_NXTHDR(&msg,cmsg))
+		{
+#ifdef RTP_HAVE_SO_TIMESTAMPING
+			if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPING)
+			{
+				struct scm_timestamping ts;
+
+				// 第一个是软件时间戳，后两个用于硬件时间戳
+				memcpy(&ts,CMSG_DATA(cmsg),sizeof(struct scm_timestamping));
+				txtime = RTPTime((int64_t)ts.ts[0].tv_sec,(uint32_t)(ts.ts[0].tv_nsec/1000));
+				continue;
+			}
+#endif // RTP_HAVE_SO_TIMESTAMPING
+
+			if (!((cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) ||
+			      (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)))
+				continue;
+
+			struct sock_extended_err serr;
+
+			memcpy(&serr,CMSG_DATA(cmsg),sizeof(struct sock_extended_err));
+#ifdef RTP_HAVE_MSG_ZEROCOPY
+			if (serr.ee_errno == 0 && serr.ee_origin == SO_EE_ORIGIN_ZEROCOPY)
+			{
+				// ee_info 到 ee_data（包含两端）是已完成的编号，编号按32位回绕
+				uint32_t first = serr.ee_info-zerocopyfirstid;
+				uint32_t last = serr.ee_data-zerocopyfirstid;
+
+				for (uint32_t idx = first ; idx <= last && idx < zerocopypending.size() ; idx++)
+					zerocopypending[idx].done = true;
+			}
+#endif // RTP_HAVE_MSG_ZEROCOPY
+#ifdef RTP_HAVE_SO_TIMESTAMPING
+			if (serr.ee_origin == SO_EE_ORIGIN_TIMESTAMPING && serr.ee_info == SCM_TSTAMP_SND)
+			{
+				istxtimestamp = true;
+				txtimestampid = serr.ee_data;
+			}
+#endif // RTP_HAVE_SO_TIMESTAMPING
+		}
+
+#ifdef RTP_HAVE_SO_TIMESTAMPING
+		// 按编号找到对应的发送方报告时间；编号更小的条目的时间戳已经丢失（例如错误队列
+		// 溢出），一并删除。编号按32位回绕
+		if (istxtimestamp)
+		{
+			while (!txtimestampreports.empty() && (int32_t)(txtimestampreports.front().first-txtimestampid) < 0)
+				txtimestampreports.pop_front();
+
+			if (!txtimestampreports.empty() && txtimestampreports.front().first == txtimestampid)
+			{
+				if (!txtime.IsZero())
+					txtimestamplist.push_back(std::make_pair(txtimestampreports.front().second,txtime));
+				txtimestampreports.pop_front();
+			}
+		}
+#endif // RTP_HAVE_SO_TIMESTAMPING
 	}
-	acceptignoreinfo.clear();
+
+#ifdef RTP_HAVE_MSG_ZEROCOPY
+	while (!zerocopypending.empty() && zerocopypending.front().done)
+	{
+		zerocopypending.pop_front();
+		zerocopyfirstid++;
+	}
+#endif // RTP_HAVE_MSG_ZEROCOPY
 }
-	
-int RTPUDPv4Transmitter::ProcessDeleteAcceptIgnoreEntry(uint32_t ip,uint16_t port)
+#endif // RTP_HAVE_MSG_ZEROCOPY || RTP_HAVE_SO_TIMESTAMPING
+
+#ifdef RTP_HAVE_MSG_ZEROCOPY
+
+bool RTPUDPv4Transmitter::IsZeroCopyBufferInUse(const uint8_t *data,size_t len) const
 {
-	auto it = acceptignoreinfo.find(ip);
-	if (it == acceptignoreinfo.end())
-		return MEDIA_RTP_ERR_OPERATION_FAILED;
-	
-	PortInfo *inf = it->second;
-	if (port == 0) // 删除所有条目
+	std::deque<ZeroCopySend>::const_iterator it;
+
+	for (it = zerocopypending.begin() ; it != zerocopypending.end() ; ++it)
 	{
-		inf->all = false;
-		inf->portlist.clear();
+		if (!it->done && it->data < data+len && data < it->data+it->len)
+			return true;
 	}
-	else // 选择了一个特定的端口
+	return false;
+}
+#endif // RTP_HAVE_MSG_ZEROCOPY
+
+#ifdef RTP_HAVE_UDP_SEGMENT
+size_t RTPUDPv4Transmitter::GetSegmentGroupLength(const struct iovec *packets,size_t count) const
+{
+	// 一个 GSO 缓冲区中除最后一个分段外所有分段的长度必须相同，最后一个分段不能更长
+	size_t segmentsize = packets[0].iov_len;
+	size_t totalsize = 0;
+	size_t num = 0;
+
+	while (num < count && num < RTPUDPV4TRANS_MAXGSOSEGMENTS)
+	{
+		size_t len = packets[num].iov_len;
+
+		if (len == 0 || len > segmentsize || totalsize+len > RTPUDPV4TRANS_MAXGSOBYTES)
+			break;
+		totalsize += len;
+		num++;
+		if (len < segmentsize)
+			break;
+	}
+	return num;
+}
+
+void RTPUDPv4Transmitter::SendSegmentsToDestinations(const struct iovec *packets,size_t count,
+                                                     std::vector<std::pair<RTPEndpoint,int> > &senderrors)
+{
+	union
 	{
-		if (inf->all) // 当前已选择所有端口。将要删除的端口添加到列表中
+		char buf[CMSG_SPACE(sizeof(uint16_t))];
+		struct cmsghdr align;
+	} control;
+	uint16_t segmentsize = (uint16_t)packets[0].iov_len;
+
+	memset(&control,0,sizeof(control));
+	struct cmsghdr *cmsg = &control.align;
+	cmsg->cmsg_level = SOL_UDP;
+	cmsg->cmsg_type = UDP_SEGMENT;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+	memcpy(CMSG_DATA(cmsg),&segmentsize,sizeof(uint16_t));
+
+	for (size_t i = 0 ; i < destinationlist.size() ; i++)
+	{
+		const RTPEndpoint *dest = destinationlist[i];
+
+		if (usegso)
 		{
-			// 我们必须检查列表中是否已包含该端口
-			std::list<uint16_t>::const_iterator it,begin,end;
+			struct msghdr msg;
+
+			memset(&msg,0,sizeof(struct msghdr));
+			msg.msg_name = const_cast<struct sockaddr *>(dest->GetRtpSockAddr());
+			msg.msg_namelen = dest->GetSockAddrLen();
+			msg.msg_iov = const_cast<struct iovec *>(packets);
+			msg.msg_iovlen = count;
+			msg.msg_control = control.buf;
+			msg.msg_controllen = sizeof(control.buf);
+
+			if (sendmsg(rtpsock,&msg,0) >= 0)
+				continue;
 
-			begin = inf->portlist.begin();
-			end = inf->portlist.end();
-			for (it = begin ; it != end ; it++)
+			int err = errno;
+			if (err != EIO && err != EINVAL && err != EOPNOTSUPP)
 			{
-				if (*it == port) // 已在列表中: this means we already deleted the entry
-					return MEDIA_RTP_ERR_OPERATION_FAILED;
+				senderrors.push_back(std::make_pair(*dest,err));
+				continue;
 			}
-			inf->portlist.push_front(port);
+
+			// 网卡无法进行校验和卸载或分段超过路径 MTU 时内核会拒绝 GSO，
+			// 此时改为逐个发送，并在之后不再尝试
+			usegso = false;
 		}
-		else // 检查我们是否可以在列表中找到该端口
+
+		for (size_t j = 0 ; j < count ; j++)
 		{
-			std::list<uint16_t>::iterator it,begin,end;
-			
-			begin = inf->portlist.begin();
-			end = inf->portlist.end();
-			for (it = begin ; it != end ; ++it)
-			{
-				if (*it == port) // 找到了！
-				{
-					inf->portlist.erase(it);
-					return 0;
-				}
-			}
-			// 没找到
-			return MEDIA_RTP_ERR_OPERATION_FAILED;
+			if (sendto(rtpsock,(const char *)packets[j].iov_base,packets[j].iov_len,0,dest->GetRtpSockAddr(),dest->GetSockAddrLen()) < 0)
+				senderrors.push_back(std::make_pair(*dest,errno));
 		}
 	}
+}
+#endif // RTP_HAVE_UDP_SEGMENT
+
+void RTPUDPv4Transmitter::FlushPackets()
+{
+	rawpacketqueue.Flush();
+}
+
+int RTPUDPv4Transmitter::AttachSSRCSteeringFilter(int sock, uint16_t groupsize)
+{
+	if (groupsize == 0)
+		return MEDIA_RTP_ERR_INVALID_PARAMETER;
+
+#ifdef RTP_HAVE_SO_REUSEPORT_CBPF
+	// 程序作用于 UDP 载荷，返回值是组内套接字的编号。第二个字节在 192 到 223 之间的是
+	// RTCP 数据包（RFC 5761），发送方 SSRC 位于偏移 4，否则按 RTP 处理，SSRC 位于偏移 8。
+	// 数据包太短时加载失败，程序返回 0，数据包交给组内第一个套接字
+	struct sock_filter code[] = {
+		BPF_STMT(BPF_LD|BPF_B|BPF_ABS, 1),
+		BPF_JUMP(BPF_JMP|BPF_JGE|BPF_K, 192, 0, 3),
+		BPF_JUMP(BPF_JMP|BPF_JGT|BPF_K, 223, 2, 0),
+		BPF_STMT(BPF_LD|BPF_W|BPF_ABS, 4),
+		BPF_STMT(BPF_JMP|BPF_JA, 1),
+		BPF_STMT(BPF_LD|BPF_W|BPF_ABS, 8),
+		BPF_STMT(BPF_ALU|BPF_MOD|BPF_K, groupsize),
+		BPF_STMT(BPF_RET|BPF_A, 0),
+	};
+	struct sock_fprog prog;
+
+	prog.len = sizeof(code)/sizeof(struct sock_filter);
+	prog.filter = code;
+	if (setsockopt(sock,SOL_SOCKET,SO_ATTACH_REUSEPORT_CBPF,(const char *)&prog,sizeof(struct sock_fprog)) != 0)
+		return MEDIA_RTP_ERR_OPERATION_FAILED;
 	return 0;
+#else
+	MEDIA_RTP_UNUSED(sock);
+	return MEDIA_RTP_ERR_OPERATION_FAILED;
+#endif // RTP_HAVE_SO_REUSEPORT_CBPF
 }
 
-bool RTPUDPv4Transmitter::ShouldAcceptData(uint32_t srcip,uint16_t srcport)
+RTPTime RTPUDPv4Transmitter::GetPollTime() const
 {
-	if (receivemode == RTPTransmitter::AcceptSome)
+#ifdef RTP_HAVE_SO_TIMESTAMPING
+	// 使用内核时间戳时，接收时间取自每个数据报的控制消息，不必读取时钟
+	if (userxtimestamps)
+		return RTPTime(0.0);
+#endif // RTP_HAVE_SO_TIMESTAMPING
+	return RTPTime::CurrentTime();
+}
+
+int RTPUDPv4Transmitter::PollSocket(bool rtp)
+{
+	int recvlen;
+	char packetbuffer[RTPUDPV4TRANS_MAXPACKSIZE];
+#if defined(RTP_HAVE_UDP_GRO) || defined(RTP_HAVE_SO_TIMESTAMPING)
+	union
 	{
-		PortInfo *inf;
+		char buf[RTPUDPV4TRANS_RECVCONTROLSIZE];
+		struct cmsghdr align;
+	} control;
+#endif // RTP_HAVE_UDP_GRO || RTP_HAVE_SO_TIMESTAMPING
+	size_t len;
+	int sock;
+	struct sockaddr_in srcaddr;
+	bool dataavailable;
+	
+#ifdef RTP_HAVE_RECVMMSG
+	if (recvbatchsize > 1)
+		return PollSocketBatch(rtp);
+#endif // RTP_HAVE_RECVMMSG
 
-		auto it = acceptignoreinfo.find(srcip);
-		if (it == acceptignoreinfo.end())
-			return false;
-		
-		inf = it->second;
-		if (!inf->all) // 只接受列表中的
+	if (rtp)
+		sock = rtpsock;
+	else
+		sock = rtcpsock;
+
+	// 池缓冲区在处理后可能被数据包接管，此时才需要取出新的缓冲区
+	uint8_t *poolbuffer = 0;
+
+	do
+	{
+		// 队列已满时（数据包的处理跟不上接收）把剩余的数据报留在套接字中
+		if (rawpacketqueue.IsFull())
+			break;
+
+		if (recvdontwait)
 		{
-			std::list<uint16_t>::const_iterator it,begin,end;
+			// 直接用 MSG_DONTWAIT 接收，读到 EAGAIN 时结束，每个数据报只需要一次系统调用
+			dataavailable = true;
+		}
+		else
+		{
+			len = 0;
+			RTPIOCTL(sock,FIONREAD,&len);
 
-			begin = inf->portlist.begin();
-			end = inf->portlist.end();
-			for (it = begin ; it != end ; it++)
+			if (len <= 0) // 确保长度为零的数据包不会排队
 			{
-				if (*it == srcport)
-					return true;
+				// 用户提供的套接字默认不依赖非阻塞接收（见 SetNonBlockingReceive），
+				// 所以在 ioctl 返回长度为零的情况下使用额外的 select 调用来解决此问题。
+				int8_t isset = 0;
+				int status = RTPSelect(&sock, &isset, 1, RTPTime(0));
+				if (status < 0)
+				{
+					RTPBufferPool::Release(poolbuffer);
+					return status;
+				}
+
+				if (isset)
+					dataavailable = true;
+				else
+					dataavailable = false;
 			}
-			return false;
+			else
+				dataavailable = true;
 		}
-		else // 全部接受，列表中的除外
+		
+		if (dataavailable)
 		{
-			std::list<uint16_t>::const_iterator it,begin,end;
+			RTPTime curtime = GetPollTime();
+			struct msghdr msg;
+			struct iovec iov[2];
 
-			begin = inf->portlist.begin();
-			end = inf->portlist.end();
-			for (it = begin ; it != end ; it++)
+			if (poolbuffer == 0 && (poolbuffer = recvbufferpool->Allocate()) == 0)
+				return MEDIA_RTP_ERR_RESOURCE_ERROR;
+
+			// 数据报直接接收到池缓冲区中，超出的部分进入栈上的溢出缓冲区
+			iov[0].iov_base = poolbuffer;
+			iov[0].iov_len = recvbufferpool->GetBufferSize();
+			iov[1].iov_base = packetbuffer;
+			iov[1].iov_len = RTPUDPV4TRANS_MAXPACKSIZE;
+			memset(&msg,0,sizeof(struct msghdr));
+			msg.msg_name = &srcaddr;
+			msg.msg_namelen = sizeof(struct sockaddr_in);
+			msg.msg_iov = iov;
+			msg.msg_iovlen = 2;
+#if defined(RTP_HAVE_UDP_GRO) || defined(RTP_HAVE_SO_TIMESTAMPING)
+			if (recvcontrol)
 			{
-				if (*it == srcport)
-					return false;
+				msg.msg_control = control.buf;
+				msg.msg_controllen = sizeof(control.buf);
+			}
+#endif // RTP_HAVE_UDP_GRO || RTP_HAVE_SO_TIMESTAMPING
+			// 套接字也可能只是报告了错误事件（例如零拷贝完成通知），因此不能阻塞
+			recvlen = recvmsg(sock,&msg,MSG_DONTWAIT);
+			if (recvlen > 0)
+			{
+				int status = ProcessReceivedMessage(&msg,(size_t)recvlen,curtime,rtp,&poolbuffer);
+				if (status < 0)
+				{
+					RTPBufferPool::Release(poolbuffer);
+					return status;
+				}
+			}
+			else if (recvlen < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+				dataavailable = false;
+			else if (recvlen < 0 && recvdontwait && errno != EINTR)
+			{
+				// 其他错误（例如 ICMP 报告的 ECONNREFUSED）同样结束本次读取，
+				// 剩余的数据报由下一次轮询读取
+				dataavailable = false;
 			}
-			return true;
 		}
-	}
-	else // 忽略一些
+	} while (dataavailable);
+
+	RTPBufferPool::Release(poolbuffer);
+	return 0;
+}
+
+#ifdef RTP_HAVE_RECVMMSG
+int RTPUDPv4Transmitter::PollSocketBatch(bool rtp)
+{
+	int sock;
+	bool moredata = true;
+	bool usecontrol = false;
+
+#if defined(RTP_HAVE_UDP_GRO) || defined(RTP_HAVE_SO_TIMESTAMPING)
+	if (recvcontrol)
+		usecontrol = true;
+#endif // RTP_HAVE_UDP_GRO || RTP_HAVE_SO_TIMESTAMPING
+
+	if (rtp)
+		sock = rtpsock;
+	else
+		sock = rtcpsock;
+
+	while (moredata)
 	{
-		PortInfo *inf;
+		// 只接收队列还能容纳的数据报，其余的留在套接字中
+		size_t count = rawpacketqueue.GetFreeSpace();
+		if (count == 0)
+			break;
+		if (count > recvbatchsize)
+			count = recvbatchsize;
 
-		auto it = acceptignoreinfo.find(srcip);
-		if (it == acceptignoreinfo.end())
-			return true;
-		
-		inf = it->second;
-		if (!inf->all) // 忽略列表中的端口
+		for (size_t i = 0 ; i < count ; i++)
 		{
-			std::list<uint16_t>::const_iterator it,begin,end;
+			// 补齐上一轮被数据包接管的池缓冲区
+			if (recvbatchpoolbuffers[i] == 0)
+			{
+				if ((recvbatchpoolbuffers[i] = recvbufferpool->Allocate()) == 0)
+					return MEDIA_RTP_ERR_RESOURCE_ERROR;
+			}
+			recvbatchiovecs[i*2].iov_base = recvbatchpoolbuffers[i];
+			recvbatchiovecs[i*2].iov_len = recvbufferpool->GetBufferSize();
 
-			begin = inf->portlist.begin();
-			end = inf->portlist.end();
-			for (it = begin ; it != end ; it++)
+			recvbatchmsgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+			recvbatchmsgs[i].msg_hdr.msg_flags = 0;
+			recvbatchmsgs[i].msg_len = 0;
+			if (usecontrol)
 			{
-				if (*it == srcport)
-					return false;
+				recvbatchmsgs[i].msg_hdr.msg_control = &recvbatchcontrol[i*RTPUDPV4TRANS_RECVCONTROLSIZE];
+				recvbatchmsgs[i].msg_hdr.msg_controllen = RTPUDPV4TRANS_RECVCONTROLSIZE;
 			}
-			return true;
 		}
-		else // 全部忽略，列表中的除外
+
+		// MSG_DONTWAIT 只作用于本次调用，不会改变（可能由用户提供的）套接字的阻塞模式，
+		// 因此这里不需要 FIONREAD 和 select 的组合来避免阻塞
+		int num = recvmmsg(sock,&recvbatchmsgs[0],(unsigned int)count,MSG_DONTWAIT,0);
+		if (num <= 0) // EAGAIN 表示已读完，其他错误与逐个接收时一样忽略
+			break;
+
+		RTPTime curtime = GetPollTime();
+		for (int i = 0 ; i < num ; i++)
 		{
-			std::list<uint16_t>::const_iterator it,begin,end;
+			if (recvbatchmsgs[i].msg_len == 0) // 确保长度为零的数据包不会排队
+				continue;
 
-			begin = inf->portlist.begin();
-			end = inf->portlist.end();
-			for (it = begin ; it != end ; it++)
-			{
-				if (*it == srcport)
-					return true;
-			}
-			return false;
+			int status = ProcessReceivedMessage(&recvbatchmsgs[i].msg_hdr,recvbatchmsgs[i].msg_len,curtime,rtp,&recvbatchpoolbuffers[i]);
+			if (status < 0)
+				return status;
 		}
+
+		// 返回的数据报少于请求的数量时，套接字已被读空
+		if ((size_t)num < count)
+			moredata = false;
+	}
+	return 0;
+}
+#endif // RTP_HAVE_RECVMMSG
+
+int RTPUDPv4Transmitter::ProcessReceivedMessage(const struct msghdr *msg,size_t len,const RTPTime &receivetime,bool rtp,
+                                                uint8_t **poolbuffer)
+{
+	const struct sockaddr_in &srcaddr = *((const struct sockaddr_in *)msg->msg_name);
+	size_t poolbuffersize = msg->msg_iov[0].iov_len;
+
+	// 获取到数据，处理它
+	if (receivemode != RTPTransmitter::AcceptAll)
+	{
+		if (!ShouldAcceptData(ntohl(srcaddr.sin_addr.s_addr),ntohs(srcaddr.sin_port)))
+			return 0;
+	}
+
+	bool parsecontrol = false;
+
+#if defined(RTP_HAVE_UDP_GRO) || defined(RTP_HAVE_SO_TIMESTAMPING)
+	if (recvcontrol)
+		parsecontrol = true;
+#endif // RTP_HAVE_UDP_GRO || RTP_HAVE_SO_TIMESTAMPING
+
+	RTPReceivedMessage message(msg,len,parsecontrol);
+	RTPTime packettime = message.GetTimestamp();
+
+	// 没有读取时钟（见 GetPollTime）而内核也没有提供时间戳时，在这里补上
+	if (packettime.IsZero())
+		packettime = receivetime;
+	if (packettime.IsZero())
+		packettime = RTPTime::CurrentTime();
+
+	// 常见情况：单个数据报完整地位于池缓冲区中，直接把缓冲区交给数据包
+	size_t numsegments = message.GetNumSegments();
+	if (numsegments == 1 && len <= poolbuffersize)
+	{
+		uint8_t *data = *poolbuffer;
+
+		*poolbuffer = 0;
+		return QueueReceivedPacket(data,len,true,srcaddr,packettime,rtp);
+	}
+
+	// 合并的数据报或超出池缓冲区大小的数据报：逐段复制出来，
+	// 数据可能跨越池缓冲区和溢出缓冲区
+	for (size_t i = 0 ; i < numsegments ; i++)
+	{
+		size_t packlen = message.GetSegmentLength(i);
+		uint8_t *data;
+
+		bool pooled = (packlen <= poolbuffersize);
+		if (pooled)
+			data = recvbufferpool->Allocate();
+		else
+			data = new uint8_t[packlen];
+		if (data == 0)
+			return MEDIA_RTP_ERR_RESOURCE_ERROR;
+
+		message.CopySegment(i,data);
+
+		int status = QueueReceivedPacket(data,packlen,pooled,srcaddr,packettime,rtp);
+		if (status < 0)
+			return status;
+	}
+	return 0;
+}
+
+int RTPUDPv4Transmitter::QueueReceivedPacket(uint8_t *data, size_t len, bool pooled, const struct sockaddr_in &srcaddr,
+                                             const RTPTime &receivetime, bool rtp)
+{
+	bool isrtp = rtp;
+	if (rtpsock == rtcpsock) // 多路复用时检查负载类型
+	{
+		isrtp = true;
+
+		if (len > sizeof(RTCPCommonHeader))
+		{
+			RTCPCommonHeader *rtcpheader = (RTCPCommonHeader *)data;
+			uint8_t packettype = rtcpheader->packettype;
+
+			if (packettype >= 200 && packettype <= 204)
+				isrtp = false;
+		}
+	}
+
+	// 源地址保存在数据包内部，数据包对象本身也来自缓冲池，稳定状态下不需要分配内存
+	RTPRawPacket *pack = new (rawpacketpool) RTPRawPacket(data,len,pooled,
+	                                                      RTPEndpoint(ntohl(srcaddr.sin_addr.s_addr),ntohs(srcaddr.sin_port)),
+	                                                      receivetime,isrtp);
+	if (pack == 0)
+	{
+		if (pooled)
+			RTPBufferPool::Release(data);
+		else
+			delete [] data;
+		return MEDIA_RTP_ERR_RESOURCE_ERROR;
+	}
+	// 队列已满（数据包的处理跟不上接收）时丢弃数据包。PollSocket 在队列满时停止读取套接字，
+	// 所以只有同一个 GRO 数据报拆分出的分段会在这里被丢弃
+	if (!rawpacketqueue.Push(pack))
+		delete pack;
+	return 0;
+}
+
+int RTPUDPv4Transmitter::CreateReceiveBufferPool()
+{
+	size_t buffersize = maxpacksize;
+	size_t maxidle = RTPUDPV4TRANS_POOLIDLEBYTES/((buffersize > 0)?buffersize:1);
+
+	if (maxidle < RTPUDPV4TRANS_POOLMINIDLE)
+		maxidle = RTPUDPV4TRANS_POOLMINIDLE;
+
+	RTPBufferPool *pool = RTPBufferPool::Create(buffersize,maxidle);
+	if (pool == 0)
+		return MEDIA_RTP_ERR_RESOURCE_ERROR;
+
+#ifdef RTP_HAVE_RECVMMSG
+	// 槽位中旧大小的缓冲区在下一次接收前重新分配
+	for (size_t i = 0 ; i < recvbatchpoolbuffers.size() ; i++)
+	{
+		RTPBufferPool::Release(recvbatchpoolbuffers[i]);
+		recvbatchpoolbuffers[i] = 0;
+	}
+#endif // RTP_HAVE_RECVMMSG
+
+	if (recvbufferpool)
+		recvbufferpool->Destroy();
+	recvbufferpool = pool;
+	return 0;
+}
+
+void RTPUDPv4Transmitter::DestroyReceiveBufferPools()
+{
+#ifdef RTP_HAVE_RECVMMSG
+	for (size_t i = 0 ; i < recvbatchpoolbuffers.size() ; i++)
+	{
+		RTPBufferPool::Release(recvbatchpoolbuffers[i]);
+		recvbatchpoolbuffers[i] = 0;
+	}
+#endif // RTP_HAVE_RECVMMSG
+
+	// 应用程序仍持有的数据包可以继续使用，缓冲池在最后一个缓冲区归还时删除
+	if (recvbufferpool)
+		recvbufferpool->Destroy();
+	if (rawpacketpool)
+		rawpacketpool->Destroy();
+	recvbufferpool = 0;
+	rawpacketpool = 0;
+}
+
+int RTPUDPv4Transmitter::ProcessAddAcceptIgnoreEntry(uint32_t ip,uint16_t port)
+{
+	int status = acceptignoreinfo.Add(ip,port);
+	if (status < 0)
+		return status;
+	KernelFilterChanged();
+	return 0;
+}
+
+void RTPUDPv4Transmitter::ClearAcceptIgnoreInfo()
+{
+	acceptignoreinfo.Clear();
+}
+	
+int RTPUDPv4Transmitter::ProcessDeleteAcceptIgnoreEntry(uint32_t ip,uint16_t port)
+{
+	int status = acceptignoreinfo.Delete(ip,port);
+	if (status < 0)
+		return status;
+	KernelFilterChanged();
+	return 0;
+}
+
+bool RTPUDPv4Transmitter::ShouldAcceptData(uint32_t srcip,uint16_t srcport)
+{
+	// 集合中选择的地址和端口在 AcceptSome 模式下被接受，在 IgnoreSome 模式下被忽略
+	bool selected = acceptignoreinfo.IsSelected(srcip,srcport);
+
+	if (receivemode == RTPTransmitter::AcceptSome)
+		return selected;
+	return !selected;
+}
+
+void RTPUDPv4Transmitter::KernelFilterChanged()
+{
+#ifdef RTP_HAVE_SO_ATTACH_FILTER
+	if (!usekernelfilter)
+		return;
+
+	// 重新生成程序需要整个列表，每次增删都生成会使添加 N 个条目的代价为 O(N^2)。
+	// 这里只作标记，由下一次 Poll 在锁外生成一次；等待中的线程被唤醒，
+	// 新接受的来源因此不必等到等待超时才能通过内核中的程序
+	kernelfiltergeneration++;
+	if (!kernelfilterdirty)
+	{
+		kernelfilterdirty = true;
+		if (waitingfordata)
+			m_pAbortDesc->SendAbortSignal();
+	}
+#endif // RTP_HAVE_SO_ATTACH_FILTER
+}
+
+// 调用时不持有锁
+void RTPUDPv4Transmitter::FlushKernelFilter()
+{
+#ifdef RTP_HAVE_SO_ATTACH_FILTER
+	std::vector<RTPAcceptIgnoreSet<uint32_t>::Entry> entries;
+	RTPTransmitter::ReceiveMode mode;
+	uint32_t generation;
+
+	MAINMUTEX_LOCK
+	if (!created || !kernelfilterdirty)
+	{
+		MAINMUTEX_UNLOCK
+		return;
+	}
+	mode = receivemode;
+	generation = kernelfiltergeneration;
+	if (mode != RTPTransmitter::AcceptAll)
+		acceptignoreinfo.GetEntries(entries);
+	MAINMUTEX_UNLOCK
+
+	// 生成程序时不持有锁，接收和发送照常进行
+	RTPSocketFilter filter(AF_INET);
+	CompileKernelFilter(filter,mode,entries);
+
+	MAINMUTEX_LOCK
+	// 生成期间列表又有变化时丢弃这个程序，标记仍然保留，下一次 Poll 使用新的列表
+	if (created && generation == kernelfiltergeneration)
+	{
+		AttachKernelFilter(filter);
+		kernelfilterdirty = false;
+	}
+	MAINMUTEX_UNLOCK
+#endif // RTP_HAVE_SO_ATTACH_FILTER
+}
+
+#ifdef RTP_HAVE_SO_ATTACH_FILTER
+void RTPUDPv4Transmitter::CompileKernelFilter(RTPSocketFilter &filter,RTPTransmitter::ReceiveMode mode,
+                                             const std::vector<RTPAcceptIgnoreSet<uint32_t>::Entry> &entries) const
+{
+	filter.Clear();
+	if (mode != RTPTransmitter::AcceptAll)
+	{
+		for (size_t i = 0 ; i < entries.size() ; i++)
+		{
+			uint32_t ip = htonl(entries[i].ip);
+			filter.AddEntry((const uint8_t *)&ip,entries[i].port,entries[i].all);
+		}
+	}
+	filter.Compile(mode == RTPTransmitter::AcceptSome);
+}
+
+void RTPUDPv4Transmitter::AttachKernelFilter(const RTPSocketFilter &filter)
+{
+	kernelfiltercomplete = filter.IsComplete();
+
+	// 附加失败时删除原有的程序，以免它丢弃现在应该接受的数据报，列表仍然在用户空间检查
+	if (filter.Attach(rtpsock) < 0)
+	{
+		RTPSocketFilter::Detach(rtpsock);
+		kernelfiltercomplete = false;
+	}
+	if (rtcpsock != rtpsock && filter.Attach(rtcpsock) < 0)
+	{
+		RTPSocketFilter::Detach(rtcpsock);
+		kernelfiltercomplete = false;
 	}
-	return true;
 }
+#endif // RTP_HAVE_SO_ATTACH_FILTER
 
 int RTPUDPv4Transmitter::CreateLocalIPList()
 {
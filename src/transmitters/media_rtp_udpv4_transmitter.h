@@ -1,12 +1,18 @@
 #pragma once
 
 #include "media_rtp_abort_descriptors.h"
+#include "media_rtp_accept_ignore_set.h"
+#include "media_rtp_socket_filter.h"
+#include "media_rtp_buffer_pool.h"
+#include "media_rtp_socket_waiter.h"
+#include "media_rtp_raw_packet_queue.h"
 #include "rtpconfig.h"
 #include "media_rtp_endpoint.h"
 #include "media_rtp_transmitter.h"
+#include <deque>
 #include <list>
-#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include <mutex>
 
@@ -17,6 +23,10 @@
 #define RTPUDPV4TRANS_RTPTRANSMITBUFFER 32768
 #define RTPUDPV4TRANS_RTCPTRANSMITBUFFER 32768
 
+#define RTPUDPV4TRANS_DEFAULTRECEIVEBATCH 1
+#define RTPUDPV4TRANS_MAXRECEIVEBATCH 64
+#define RTPUDPV4TRANS_DEFAULTZEROCOPYTIMEOUT 1.0
+
 /** UDP over IPv4 传输器的参数。 */
 class RTPUDPv4TransmissionParams : public RTPTransmissionParams {
 public:
@@ -90,6 +100,22 @@ public:
     useexistingsockets = true;
   }
 
+  /** 设置是否对 SetUseExistingSockets 提供的套接字使用非阻塞接收，默认关闭。
+   *  启用后，传输器以 MSG_DONTWAIT 逐个读取数据报直到 EAGAIN，每个数据报只需要
+   *  一次系统调用；否则每次读取之前都用 FIONREAD 和零超时的 select 检查是否有数据。
+   *  MSG_DONTWAIT 不会改变套接字本身的阻塞模式。传输器自己创建的套接字总是使用
+   *  非阻塞接收。 */
+  void SetNonBlockingReceive(bool f) { nonblockingrecv = f; }
+
+  /** 返回是否对已有的套接字使用非阻塞接收。 */
+  bool GetNonBlockingReceive() const { return nonblockingrecv; }
+
+  /** 设置每次 recvmmsg 调用最多接收的数据报数量，
+   *  大于 RTPUDPV4TRANS_MAXRECEIVEBATCH 的值会被截断；
+   *  小于等于1（默认值）时逐个接收数据报。
+   *  每个批量槽位会预先分配一个64KB的接收缓冲区。 */
+  void SetReceiveBatchSize(size_t n) { recvbatchsize = n; }
+
   /** 如果非空，将使用指定的中止描述符来取消
    *  等待数据包到达的函数；设置为null（默认值）
    *  让传输器创建自己的实例。 */
@@ -128,6 +154,81 @@ public:
     return true;
   }
 
+  /** 返回每次 recvmmsg 调用最多接收的数据报数量。 */
+  size_t GetReceiveBatchSize() const { return recvbatchsize; }
+
+  /** 启用后，SendRTPDataBatch 会把连续的等长RTP数据包作为一个 UDP GSO
+   *  （UDP_SEGMENT）超级缓冲区交给内核，由内核完成分段；
+   *  内核不支持时自动回退为逐个发送。默认禁用。 */
+  void SetUDPSegmentationOffload(bool f) { udpsegmentation = f; }
+
+  /** 返回是否启用了 UDP GSO 批量发送。 */
+  bool GetUDPSegmentationOffload() const { return udpsegmentation; }
+
+  /** 启用后，会在RTP套接字上打开 UDP GRO，内核可以把同一数据流的多个数据报
+   *  合并后一次交付，传输器再按分段大小把它拆分为单独的数据包。默认禁用。 */
+  void SetUDPGenericReceiveOffload(bool f) { udpgro = f; }
+
+  /** 返回是否在RTP套接字上启用了 UDP GRO。 */
+  bool GetUDPGenericReceiveOffload() const { return udpgro; }
+
+  /** 设置使用 MSG_ZEROCOPY 发送RTP数据包的最小长度，为零（默认值）时禁用零拷贝发送。
+   *  零拷贝发送省去了把数据复制到内核的开销，但发送函数返回后内核仍会读取调用者的
+   *  缓冲区，直到套接字错误队列中出现完成通知为止，因此修改或释放缓冲区之前必须调用
+   *  WaitForSendCompletion（RTPSession 在重用其数据包构建器的缓冲区之前自动调用，
+   *  不会在每次发送之后等待）。
+   *  通常只有较大的数据包（约10KB以上）才能获益；套接字不支持时自动回退为普通发送。
+   *  完成通知的编号由套接字计数，传输器无法知道已有套接字之前的计数，因此使用
+   *  RTPUDPv4TransmissionParams::SetUseExistingSockets 时忽略此设置。 */
+  void SetZeroCopyThreshold(size_t len) { zerocopythreshold = len; }
+
+  /** 返回使用 MSG_ZEROCOPY 发送的最小数据包长度，零表示禁用。 */
+  size_t GetZeroCopyThreshold() const { return zerocopythreshold; }
+
+  /** 设置 WaitForSendCompletion 等待零拷贝发送完成的最长时间，默认为一秒。
+   *  超时时该函数返回错误，缓冲区仍不能修改；已经发出的数据包不受影响。 */
+  void SetZeroCopyTimeout(const RTPTime &t) { zerocopytimeout = t; }
+
+  /** 返回等待零拷贝发送完成的最长时间。 */
+  RTPTime GetZeroCopyTimeout() const { return zerocopytimeout; }
+
+  /** 设置是否用内核在数据报到达时记录的时间戳（SO_TIMESTAMPNS）作为数据包的接收时间，
+   *  默认关闭。内核时间戳不包含本进程的调度延迟，抖动和往返时间的计算因此更准确，
+   *  同时也省去了每次接收时的时钟读取。 */
+  void SetKernelReceiveTimestamps(bool f) { rxtimestamps = f; }
+
+  /** 返回是否使用内核接收时间戳。 */
+  bool GetKernelReceiveTimestamps() const { return rxtimestamps; }
+
+  /** 设置是否为发送的RTCP数据包请求内核发送时间戳（SO_TIMESTAMPING），默认关闭。
+   *  时间戳通过 RTPUDPv4Transmitter::OnRTCPTransmitTimestamp 报告。 */
+  void SetKernelTransmitTimestamps(bool f) { txtimestamps = f; }
+
+  /** 返回是否请求内核发送时间戳。 */
+  bool GetKernelTransmitTimestamps() const { return txtimestamps; }
+
+  /** 设置是否在接收套接字上附加内核过滤程序（SO_ATTACH_FILTER），默认关闭。
+   *  程序在内核中丢弃载荷太短或RTP版本字段不为2的数据报，以及被接受列表或忽略列表
+   *  排除的数据报。修改接收模式或列表后，程序在下一次 Poll 时重新生成，连续的多次修改
+   *  只生成一次；正在等待数据的线程会被唤醒。数据报被大量发送到本端口时，这些数据报
+   *  不会被复制到用户空间。 */
+  void SetKernelPacketFilter(bool f) { kernelfilter = f; }
+
+  /** 返回是否附加内核过滤程序。 */
+  bool GetKernelPacketFilter() const { return kernelfilter; }
+
+  /** 设置 SO_REUSEPORT 套接字组的大小，用于让多个传输器（每个通常对应一个工作线程
+   *  及其轮询线程）共享同一个端口基数。为零（默认值）时不使用 SO_REUSEPORT；
+   *  为1时只设置 SO_REUSEPORT，由内核按地址四元组分配数据报；大于1时还会附加一个
+   *  按 SSRC 取模的 BPF 程序（见 RTPUDPv4Transmitter::AttachSSRCSteeringFilter），
+   *  同一数据流的 RTP 和 RTCP 数据包总是交给同一个套接字。组内套接字按创建顺序编号，
+   *  因此组中所有传输器都应使用相同的值，并在数据到达之前依次创建。
+   *  仅在指定了非零端口基数时有效。 */
+  void SetReusePortGroupSize(uint16_t n) { reuseportgroupsize = n; }
+
+  /** 返回 SO_REUSEPORT 套接字组的大小。 */
+  uint16_t GetReusePortGroupSize() const { return reuseportgroupsize; }
+
   /** 如果非空，将在内部使用此RTPAbortDescriptors实例，
    *  这在为多个会话创建自己的轮询线程时很有用。 */
   RTPAbortDescriptors *GetCreatedAbortDescriptors() const {
@@ -147,6 +248,16 @@ private:
 
   int rtpsock, rtcpsock;
   bool useexistingsockets;
+  bool nonblockingrecv;
+  size_t recvbatchsize;
+  bool udpsegmentation;
+  bool udpgro;
+  size_t zerocopythreshold;
+  RTPTime zerocopytimeout;
+  bool rxtimestamps;
+  bool txtimestamps;
+  bool kernelfilter;
+  uint16_t reuseportgroupsize;
 
   RTPAbortDescriptors *m_pAbortDesc;
 };
@@ -165,8 +276,18 @@ inline RTPUDPv4TransmissionParams::RTPUDPv4TransmissionParams()
   allowoddportbase = false;
   forcedrtcpport = 0;
   useexistingsockets = false;
+  nonblockingrecv = false;
   rtpsock = 0;
   rtcpsock = 0;
+  recvbatchsize = RTPUDPV4TRANS_DEFAULTRECEIVEBATCH;
+  udpsegmentation = false;
+  udpgro = false;
+  zerocopythreshold = 0;
+  zerocopytimeout = RTPTime(RTPUDPV4TRANS_DEFAULTZEROCOPYTIMEOUT);
+  rxtimestamps = false;
+  txtimestamps = false;
+  kernelfilter = false;
+  reuseportgroupsize = 0;
   m_pAbortDesc = 0;
 }
 
@@ -237,6 +358,9 @@ public:
 
   int SendRTPData(const void *data, size_t len);
   int SendRTCPData(const void *data, size_t len);
+  int SendRTPDataBatch(const struct iovec *packets, size_t count);
+  int SendRTPDataV(const struct iovec *iov, size_t iovcount);
+  int WaitForSendCompletion(const void *data, size_t len);
 
   int AddDestination(const RTPEndpoint &addr);
   int DeleteDestination(const RTPEndpoint &addr);
@@ -258,6 +382,37 @@ public:
 
   bool NewDataAvailable();
   RTPRawPacket *GetNextPacket();
+  uint64_t GetNumDroppedPackets() { return rawpacketqueue.GetNumDroppedPackets(); }
+  uint64_t GetNumDroppedBytes() { return rawpacketqueue.GetNumDroppedBytes(); }
+
+  /** 返回内核尚未报告完成的零拷贝发送次数，每个目标各算一次；未启用零拷贝发送时为零。
+   *  完成通知在发送、轮询和 WaitForSendCompletion 时读出。 */
+  size_t GetNumPendingZeroCopySends();
+
+  /** 返回附加到接收套接字上的内核过滤程序是否包含了接受列表或忽略列表的所有条目。
+   *  列表太长、超过内核的程序长度限制时返回 false：程序此时只检查数据报格式，地址和
+   *  端口仍在用户空间检查，结果不变，只是这些数据报不再在内核中丢弃。程序无法附加到
+   *  套接字上时也返回 false。未启用内核过滤程序时返回 true。列表变化后，结果在下一次 Poll 时更新。 */
+  bool IsKernelFilterComplete();
+
+  /** 在已绑定且设置了 SO_REUSEPORT 的套接字 \c sock 上附加 SSRC 分流程序：
+   *  RTP 数据包按 SSRC、RTCP 数据包按发送方 SSRC 对 \c groupsize 取模，
+   *  结果即为接收该数据包的套接字在组内的编号。程序作用于整个套接字组，
+   *  对使用 RTPUDPv4TransmissionParams::SetUseExistingSockets 自行创建的
+   *  套接字，可以直接调用此函数。 */
+  static int AttachSSRCSteeringFilter(int sock, uint16_t groupsize);
+
+protected:
+  /** 通过重写此函数，可以在向 \c addr 发送RTP数据（\c rtp 为true）或
+   *  RTCP数据失败时得到通知，\c errcode 为对应的 errno 值。
+   *  调用此函数时不持有传输器的内部锁。 */
+  virtual void OnSendError(const RTPEndpoint &addr, bool rtp, int errcode);
+
+  /** 启用内核发送时间戳后，通过重写此函数可以得到每个RTCP数据包实际交给网络设备的
+   *  时间 \c txtime，每个目标报告一次，顺序与发送顺序相同。如果该复合包以发送方报告
+   *  开头，\c srntptime 是报告中的NTP时间戳，否则为零；两者之差是本地发送路径的延迟，
+   *  可以从按 LSR/DLSR 计算出的往返时间中扣除。调用此函数时不持有传输器的内部锁。 */
+  virtual void OnRTCPTransmitTimestamp(const RTPNTPTime &srntptime, const RTPTime &txtime);
 
 private:
   int CreateLocalIPList();
@@ -265,7 +420,34 @@ private:
   void GetLocalIPList_DNS();
   void AddLoopbackAddress();
   void FlushPackets();
+  void RebuildDestinationArrays();
+  void SendToDestinations(bool rtp, const struct iovec *iov, size_t iovcount,
+                          std::vector<std::pair<RTPEndpoint, int> > &senderrors);
+#ifdef RTP_HAVE_UDP_SEGMENT
+  size_t GetSegmentGroupLength(const struct iovec *packets, size_t count) const;
+  void SendSegmentsToDestinations(const struct iovec *packets, size_t count,
+                                  std::vector<std::pair<RTPEndpoint, int> > &senderrors);
+#endif // RTP_HAVE_UDP_SEGMENT
+  int CreateReceiveBufferPool();
+  void DestroyReceiveBufferPools();
+#if defined(RTP_HAVE_MSG_ZEROCOPY) || defined(RTP_HAVE_SO_TIMESTAMPING)
+  void ProcessErrorQueues();
+  void ProcessErrorQueue(int sock);
+#endif // RTP_HAVE_MSG_ZEROCOPY || RTP_HAVE_SO_TIMESTAMPING
+#ifdef RTP_HAVE_MSG_ZEROCOPY
+  bool IsZeroCopyBufferInUse(const uint8_t *data, size_t len) const;
+#endif // RTP_HAVE_MSG_ZEROCOPY
+  RTPTime GetPollTime() const;
   int PollSocket(bool rtp);
+#ifdef RTP_HAVE_RECVMMSG
+  int PollSocketBatch(bool rtp);
+#endif // RTP_HAVE_RECVMMSG
+  int ProcessReceivedMessage(const struct msghdr *msg, size_t len,
+                             const RTPTime &receivetime, bool rtp,
+                             uint8_t **poolbuffer);
+  int QueueReceivedPacket(uint8_t *data, size_t len, bool pooled,
+                          const struct sockaddr_in &srcaddr,
+                          const RTPTime &receivetime, bool rtp);
   int ProcessAddAcceptIgnoreEntry(uint32_t ip, uint16_t port);
   int ProcessDeleteAcceptIgnoreEntry(uint32_t ip, uint16_t port);
 #ifdef RTP_SUPPORT_IPV4MULTICAST
@@ -273,6 +455,13 @@ private:
 #endif // RTP_SUPPORT_IPV4MULTICAST
   bool ShouldAcceptData(uint32_t srcip, uint16_t srcport);
   void ClearAcceptIgnoreInfo();
+  void KernelFilterChanged();
+  void FlushKernelFilter();
+#ifdef RTP_HAVE_SO_ATTACH_FILTER
+  void CompileKernelFilter(RTPSocketFilter &filter, RTPTransmitter::ReceiveMode mode,
+                           const std::vector<RTPAcceptIgnoreSet<uint32_t>::Entry> &entries) const;
+  void AttachKernelFilter(const RTPSocketFilter &filter);
+#endif // RTP_HAVE_SO_ATTACH_FILTER
 
   bool init;
   bool created;
@@ -288,28 +477,91 @@ private:
   size_t localhostnamelength;
 
   std::unordered_set<RTPEndpoint> destinations;
+  // destinations 中元素的连续视图，在添加或删除目标时重建
+  std::vector<const RTPEndpoint *> destinationlist;
+#ifdef RTP_HAVE_SENDMMSG
+  std::vector<struct mmsghdr> rtpsendmsgs, rtcpsendmsgs;
+  struct iovec sendiovecs[RTPTRANS_MAXSENDIOV]; // 所有消息头都指向这里
+#endif // RTP_HAVE_SENDMMSG
+#ifdef RTP_HAVE_UDP_SEGMENT
+  bool usegso;
+#endif // RTP_HAVE_UDP_SEGMENT
+#ifdef RTP_HAVE_UDP_GRO
+  bool usegro;
+#endif // RTP_HAVE_UDP_GRO
+#ifdef RTP_HAVE_SO_TIMESTAMPING
+  bool userxtimestamps, usetxtimestamps;
+  // 附加到每个RTCP消息头上的控制消息，只为这些数据包请求发送时间戳；
+  // 用 uint64_t 存放以满足 cmsghdr 的对齐要求
+  uint64_t txtimestampcontrol[(CMSG_SPACE(sizeof(uint32_t))+7)/8];
+  // 已发送但尚未收到发送时间戳的RTCP数据包中的发送方报告时间，按内核分配的
+  // 时间戳编号（SOF_TIMESTAMPING_OPT_ID）排列，下一个数据包的编号为 txtimestampnextid
+  std::deque<std::pair<uint32_t, RTPNTPTime> > txtimestampreports;
+  uint32_t txtimestampnextid;
+  // 已收到的发送时间戳，在释放锁后通过 OnRTCPTransmitTimestamp 报告
+  std::vector<std::pair<RTPNTPTime, RTPTime> > txtimestamplist;
+#endif // RTP_HAVE_SO_TIMESTAMPING
+#if defined(RTP_HAVE_UDP_GRO) || defined(RTP_HAVE_SO_TIMESTAMPING)
+  bool recvcontrol; // 接收时需要读取控制消息（GRO 分段大小或接收时间戳）
+#endif // RTP_HAVE_UDP_GRO || RTP_HAVE_SO_TIMESTAMPING
+#ifdef RTP_HAVE_MSG_ZEROCOPY
+  class ZeroCopySend {
+  public:
+    ZeroCopySend(const uint8_t *d, size_t l) : data(d), len(l), done(false) {}
+
+    const uint8_t *data;
+    size_t len;
+    bool done;
+  };
+
+  size_t zerocopythreshold; // 为零时不使用零拷贝发送
+  double zerocopytimeout;
+  // 尚未完成的零拷贝发送，按内核分配的通知编号排列，第一个元素的编号为 zerocopyfirstid
+  std::deque<ZeroCopySend> zerocopypending;
+  uint32_t zerocopyfirstid;
+#endif // RTP_HAVE_MSG_ZEROCOPY
 #ifdef RTP_SUPPORT_IPV4MULTICAST
   std::unordered_set<uint32_t> multicastgroups;
 #endif // RTP_SUPPORT_IPV4MULTICAST
-  std::list<RTPRawPacket *> rawpacketlist;
+  RTPRawPacketQueue rawpacketqueue; // 轮询时在队尾加入，GetNextPacket 无锁取出
 
   bool supportsmulticasting;
   size_t maxpacksize;
 
-  class PortInfo {
-  public:
-    PortInfo() { all = false; }
-
-    bool all;
-    std::list<uint16_t> portlist;
-  };
-
-  std::unordered_map<uint32_t, PortInfo *> acceptignoreinfo;
+  // 数据报直接接收到 recvbufferpool 的缓冲区中（缓冲区大小为最大数据包大小，
+  // 更大的数据报溢出到临时缓冲区后单独分配），RTPRawPacket 实例来自 rawpacketpool
+  RTPBufferPool *recvbufferpool;
+  RTPBufferPool *rawpacketpool;
+
+#ifdef RTP_HAVE_RECVMMSG
+  size_t recvbatchsize;
+  std::vector<uint8_t> recvbatchbuffer;
+  std::vector<struct mmsghdr> recvbatchmsgs;
+  std::vector<struct iovec> recvbatchiovecs; // 每个槽位两个：池缓冲区和溢出缓冲区
+  std::vector<uint8_t *> recvbatchpoolbuffers;
+  std::vector<struct sockaddr_in> recvbatchaddrs;
+  std::vector<uint8_t> recvbatchcontrol;
+#endif // RTP_HAVE_RECVMMSG
+
+  RTPAcceptIgnoreSet<uint32_t> acceptignoreinfo;
+#ifdef RTP_HAVE_SO_ATTACH_FILTER
+  bool usekernelfilter;
+  // 列表变化后只作标记，程序由 Poll 在锁外从 acceptignoreinfo 重新生成，附加到所有
+  // 接收套接字上；每次变化都递增编号，用来发现生成期间列表又有变化
+  bool kernelfilterdirty;
+  uint32_t kernelfiltergeneration;
+  bool kernelfiltercomplete; // 附加的程序是否包含了所有条目
+#endif // RTP_HAVE_SO_ATTACH_FILTER
 
   bool closesocketswhendone;
+  bool recvdontwait; // 以 MSG_DONTWAIT 读到 EAGAIN 为止，不使用 FIONREAD 和 select
   RTPAbortDescriptors m_abortDesc;
   RTPAbortDescriptors *m_pAbortDesc; // 如果指定了外部描述符
+  RTPSocketWaiter m_socketWaiter; // 持久注册了所有接收套接字和中止描述符
 
   std::mutex mainmutex, waitmutex;
   int threadsafe;
-};
\ No newline at end of file
+};
+
+inline void RTPUDPv4Transmitter::OnSendError(const RTPEndpoint &, bool, int) {}
+inline void RTPUDPv4Transmitter::OnRTCPTransmitTimestamp(const RTPNTPTime &, const RTPTime &) {}
@@ -8,12 +8,34 @@
 #include "media_rtp_utils.h"
 #include "media_rtp_defines.h"
 #include "media_rtp_errors.h"
+#include "media_rtp_received_message.h"
 #include <stdio.h>
+#include <errno.h>
+#if defined(RTP_HAVE_UDP_SEGMENT) || defined(RTP_HAVE_UDP_GRO)
+	#include <netinet/udp.h>
+#endif // RTP_HAVE_UDP_SEGMENT || RTP_HAVE_UDP_GRO
+#if defined(RTP_HAVE_MSG_ZEROCOPY) || defined(RTP_HAVE_SO_TIMESTAMPING)
+	#include <linux/errqueue.h>
+#endif // RTP_HAVE_MSG_ZEROCOPY || RTP_HAVE_SO_TIMESTAMPING
+#ifdef RTP_HAVE_MSG_ZEROCOPY
+	#include <poll.h>
+#endif // RTP_HAVE_MSG_ZEROCOPY
+#ifdef RTP_HAVE_SO_TIMESTAMPING
+	#include <linux/net_tstamp.h>
+#endif // RTP_HAVE_SO_TIMESTAMPING
+#include <vector>
 
 #define RTPUDPV6TRANS_MAXPACKSIZE							65535
+#define RTPUDPV6TRANS_MAXSENDBATCH							1024
+#define RTPUDPV6TRANS_MAXGSOSEGMENTS							64
+#define RTPUDPV6TRANS_RECVCONTROLSIZE							256
+#define RTPUDPV6TRANS_MAXGSOBYTES							(65535-RTPUDPV6TRANS_HEADERSIZE)
 #define RTPUDPV6TRANS_IFREQBUFSIZE							8192
+#define RTPUDPV6TRANS_ZEROCOPYPOLLMS							100
+#define RTPUDPV6TRANS_MAXTXTIMESTAMPREPORTS							256
 
-#define RTPUDPV6TRANS_IS_MCASTADDR(x)							(x.s6_addr[0] == 0xFF)
+#define RTPUDPV6TRANS_IS_MCASTADDR(x)							(x.s6_addr[0] == 0xFF || \
+										(IN6_IS_ADDR_V4MAPPED(&x) && (x.s6_addr[12]&0xF0) == 0xE0))
 
 #define RTPUDPV6TRANS_MCASTMEMBERSHIP(socket,type,mcastip,status)	{\
 										struct ipv6_mreq mreq;\
@@ -82,6 +104,13 @@ int RTPUDPv6Transmitter::Create(size_t maximumpacketsize,const RTPTransmissionPa
 		params = (const RTPUDPv6TransmissionParams *)transparams;
 	}
 
+	// 存储空间保留到下一次 Create 或析构，Destroy 之后无锁的 GetNextPacket 仍可安全调用
+	if ((status = rawpacketqueue.Init(params->GetReceiveQueueMaximumPackets(),params->GetReceiveQueueMaximumBytes())) < 0)
+	{
+		MAINMUTEX_UNLOCK
+		return status;
+	}
+
 			// 检查端口基数是否为偶数
 	if (params->GetPortbase()%2 != 0)
 	{
@@ -104,6 +133,22 @@ int RTPUDPv6Transmitter::Create(size_t maximumpacketsize,const RTPTransmissionPa
 		MAINMUTEX_UNLOCK
 		return MEDIA_RTP_ERR_OPERATION_FAILED;
 	}
+
+	// 双栈模式显式关闭 IPV6_V6ONLY，不依赖系统的 bindv6only 默认值；必须在绑定之前设置
+	dualstack = params->GetDualStack();
+	if (dualstack)
+	{
+		int v6only = 0;
+
+		if (setsockopt(rtpsock,IPPROTO_IPV6,IPV6_V6ONLY,(const char *)&v6only,sizeof(int)) != 0 ||
+		    setsockopt(rtcpsock,IPPROTO_IPV6,IPV6_V6ONLY,(const char *)&v6only,sizeof(int)) != 0)
+		{
+			RTPCLOSE(rtpsock);
+			RTPCLOSE(rtcpsock);
+			MAINMUTEX_UNLOCK
+			return MEDIA_RTP_ERR_OPERATION_FAILED;
+		}
+	}
 	
 			// 设置套接字缓冲区大小
 	
@@ -225,11 +270,158 @@ int RTPUDPv6Transmitter::Create(size_t maximumpacketsize,const RTPTransmissionPa
 		}
 	}
 
+	// 接收套接字和中止描述符只在这里注册一次，之后每次等待都复用这些注册
+	if ((status = m_socketWaiter.Init()) >= 0)
+	{
+		status = m_socketWaiter.AddSocket(rtpsock);
+		if (status >= 0)
+			status = m_socketWaiter.AddSocket(rtcpsock);
+		if (status >= 0)
+			status = m_socketWaiter.AddSocket(m_pAbortDesc->GetAbortSocket());
+	}
+	if (status < 0)
+	{
+		m_socketWaiter.Destroy();
+		m_abortDesc.Destroy(); // 如果未初始化，则不执行任何操作
+		RTPCLOSE(rtpsock);
+		RTPCLOSE(rtcpsock);
+		MAINMUTEX_UNLOCK
+		return status;
+	}
+
 	maxpacksize = maximumpacketsize;
 	portbase = params->GetPortbase();
 	multicastTTL = params->GetMulticastTTL();
 	receivemode = RTPTransmitter::AcceptAll;
 
+#ifdef RTP_HAVE_UDP_GRO
+	usegro = false;
+	if (params->GetUDPGenericReceiveOffload())
+	{
+		int enable = 1;
+		if (setsockopt(rtpsock,SOL_UDP,UDP_GRO,(const char *)&enable,sizeof(int)) == 0)
+			usegro = true;
+	}
+#endif // RTP_HAVE_UDP_GRO
+
+#ifdef RTP_HAVE_SO_TIMESTAMPING
+	// 两个套接字都启用接收时间戳，RTCP 报告的接收时间同样用于计算往返时间
+	userxtimestamps = false;
+	if (params->GetKernelReceiveTimestamps())
+	{
+		int enable = 1;
+		if (setsockopt(rtpsock,SOL_SOCKET,SO_TIMESTAMPNS,(const char *)&enable,sizeof(int)) == 0 &&
+		    (rtcpsock == rtpsock || setsockopt(rtcpsock,SOL_SOCKET,SO_TIMESTAMPNS,(const char *)&enable,sizeof(int)) == 0))
+			userxtimestamps = true;
+	}
+
+	usetxtimestamps = false;
+	txtimestampreports.clear();
+	txtimestamplist.clear();
+	txtimestampnextid = 0;
+#ifdef RTP_HAVE_SENDMMSG
+	// 套接字选项只设置报告方式，发送时间戳由RTCP消息头上的控制消息逐个请求，
+	// 因此与RTCP多路复用的RTP数据包不会产生时间戳。内核只为请求了时间戳的数据报
+	// 分配编号，启用 OPT_ID 时编号从零开始
+	if (params->GetKernelTransmitTimestamps())
+	{
+		int flags = SOF_TIMESTAMPING_SOFTWARE|SOF_TIMESTAMPING_OPT_TSONLY|SOF_TIMESTAMPING_OPT_ID;
+		if (setsockopt(rtcpsock,SOL_SOCKET,SO_TIMESTAMPING,(const char *)&flags,sizeof(int)) == 0)
+		{
+			struct cmsghdr *cmsg = (struct cmsghdr *)txtimestampcontrol;
+			uint32_t txflags = SOF_TIMESTAMPING_TX_SOFTWARE;
+
+			memset(txtimestampcontrol,0,sizeof(txtimestampcontrol));
+			cmsg->cmsg_level = SOL_SOCKET;
+			cmsg->cmsg_type = SO_TIMESTAMPING;
+			cmsg->cmsg_len = CMSG_LEN(sizeof(uint32_t));
+			memcpy(CMSG_DATA(cmsg),&txflags,sizeof(uint32_t));
+			usetxtimestamps = true;
+		}
+	}
+#endif // RTP_HAVE_SENDMMSG
+#endif // RTP_HAVE_SO_TIMESTAMPING
+
+#if defined(RTP_HAVE_UDP_GRO) || defined(RTP_HAVE_SO_TIMESTAMPING)
+	recvcontrol = false;
+#ifdef RTP_HAVE_UDP_GRO
+	if (usegro)
+		recvcontrol = true;
+#endif // RTP_HAVE_UDP_GRO
+#ifdef RTP_HAVE_SO_TIMESTAMPING
+	if (userxtimestamps)
+		recvcontrol = true;
+#endif // RTP_HAVE_SO_TIMESTAMPING
+#endif // RTP_HAVE_UDP_GRO || RTP_HAVE_SO_TIMESTAMPING
+
+#ifdef RTP_HAVE_SO_ATTACH_FILTER
+	usekernelfilter = params->GetKernelPacketFilter();
+	kernelfilterdirty = false;
+	kernelfiltergeneration = 0;
+	kernelfiltercomplete = true;
+	if (usekernelfilter)
+	{
+		RTPSocketFilter filter(AF_INET6);
+		std::vector<RTPAcceptIgnoreSet<in6_addr>::Entry> entries;
+
+		CompileKernelFilter(filter,receivemode,entries);
+		AttachKernelFilter(filter);
+	}
+#endif // RTP_HAVE_SO_ATTACH_FILTER
+
+#ifdef RTP_HAVE_RECVMMSG
+	// 预先建立 recvmmsg 所需的消息头数组，每个槽位对应一个最大长度的接收缓冲区
+	recvbatchsize = params->GetReceiveBatchSize();
+	if (recvbatchsize > RTPUDPV6TRANS_MAXRECEIVEBATCH)
+		recvbatchsize = RTPUDPV6TRANS_MAXRECEIVEBATCH;
+	if (recvbatchsize > 1)
+	{
+		recvbatchbuffer.resize(recvbatchsize*RTPUDPV6TRANS_MAXPACKSIZE);
+		recvbatchmsgs.resize(recvbatchsize);
+		recvbatchiovecs.resize(recvbatchsize);
+		recvbatchaddrs.resize(recvbatchsize);
+		recvbatchcontrol.resize(recvbatchsize*RTPUDPV6TRANS_RECVCONTROLSIZE);
+
+		for (size_t i = 0 ; i < recvbatchsize ; i++)
+		{
+			recvbatchiovecs[i].iov_base = &recvbatchbuffer[i*RTPUDPV6TRANS_MAXPACKSIZE];
+			recvbatchiovecs[i].iov_len = RTPUDPV6TRANS_MAXPACKSIZE;
+
+			memset(&recvbatchmsgs[i],0,sizeof(struct mmsghdr));
+			recvbatchmsgs[i].msg_hdr.msg_name = &recvbatchaddrs[i];
+			recvbatchmsgs[i].msg_hdr.msg_iov = &recvbatchiovecs[i];
+			recvbatchmsgs[i].msg_hdr.msg_iovlen = 1;
+		}
+	}
+#endif // RTP_HAVE_RECVMMSG
+
+#ifdef RTP_HAVE_UDP_SEGMENT
+	// 先尝试设置一次零分段大小，以确认内核支持 UDP GSO；
+	// 不支持的内核会忽略 UDP_SEGMENT 控制消息而发送一个超大数据报，因此必须事先检查
+	usegso = false;
+	if (params->GetUDPSegmentationOffload())
+	{
+		int gsosize = 0;
+		if (setsockopt(rtpsock,SOL_UDP,UDP_SEGMENT,(const char *)&gsosize,sizeof(int)) == 0)
+			usegso = true;
+	}
+#endif // RTP_HAVE_UDP_SEGMENT
+
+#ifdef RTP_HAVE_MSG_ZEROCOPY
+	// 零拷贝发送需要先在套接字上启用 SO_ZEROCOPY，内核不支持时回退为普通发送；
+	// 新套接字的通知编号从零开始
+	zerocopythreshold = 0;
+	zerocopytimeout = params->GetZeroCopyTimeout().GetDouble();
+	zerocopypending.clear();
+	zerocopyfirstid = 0;
+	if (params->GetZeroCopyThreshold() > 0)
+	{
+		int enable = 1;
+		if (setsockopt(rtpsock,SOL_SOCKET,SO_ZEROCOPY,(const char *)&enable,sizeof(int)) == 0)
+			zerocopythreshold = params->GetZeroCopyThreshold();
+	}
+#endif // RTP_HAVE_MSG_ZEROCOPY
+
 	localhostname = 0;
 	localhostnamelength = 0;
 
@@ -261,24 +453,40 @@ void RTPUDPv6Transmitter::Destroy()
 	RTPCLOSE(rtpsock);
 	RTPCLOSE(rtcpsock);
 	destinations.clear();
+	RebuildDestinationArrays();
 #ifdef RTP_SUPPORT_IPV6MULTICAST
 	multicastgroups.clear();
 #endif // RTP_SUPPORT_IPV6MULTICAST
 	FlushPackets();
+#ifdef RTP_HAVE_MSG_ZEROCOPY
+	zerocopypending.clear();
+#endif // RTP_HAVE_MSG_ZEROCOPY
+#ifdef RTP_HAVE_SO_TIMESTAMPING
+	txtimestampreports.clear();
+	txtimestamplist.clear();
+#endif // RTP_HAVE_SO_TIMESTAMPING
 	ClearAcceptIgnoreInfo();
 	localIPs.clear();
+#ifdef RTP_HAVE_RECVMMSG
+	std::vector<uint8_t>().swap(recvbatchbuffer);
+	std::vector<struct mmsghdr>().swap(recvbatchmsgs);
+	std::vector<struct iovec>().swap(recvbatchiovecs);
+	std::vector<struct sockaddr_in6>().swap(recvbatchaddrs);
+	std::vector<uint8_t>().swap(recvbatchcontrol);
+#endif // RTP_HAVE_RECVMMSG
 	created = false;
 	
 	if (waitingfordata)
 	{
 		m_pAbortDesc->SendAbortSignal();
-		m_abortDesc.Destroy(); // 如果未初始化，则不执行任何操作
 		MAINMUTEX_UNLOCK
 		WAITMUTEX_LOCK // 确保 WaitForIncomingData 函数已结束
 		WAITMUTEX_UNLOCK
+		MAINMUTEX_LOCK
 	}
-	else
-		m_abortDesc.Destroy(); // 如果未初始化，则不执行任何操作
+	// 等待结束后才能关闭中止描述符，关闭的描述符会从 epoll 集合中移除而不再唤醒等待
+	m_socketWaiter.Destroy();
+	m_abortDesc.Destroy(); // 如果未初始化，则不执行任何操作
 
 	MAINMUTEX_UNLOCK
 }
@@ -451,8 +659,9 @@ bool RTPUDPv6Transmitter::ComesFromThisTransmitter(const RTPEndpoint *addr)
 	MAINMUTEX_LOCK
 	
 	bool v;
+	RTPEndpoint mapped;
 		
-	if (created && addr->GetType() == RTPEndpoint::IPv6)
+	if (created && MapEndpoint(*addr,&mapped))
 	{	
 			bool found = false;
 		std::list<in6_addr>::const_iterator it;
@@ -461,7 +670,7 @@ bool RTPUDPv6Transmitter::ComesFromThisTransmitter(const RTPEndpoint *addr)
 		while (!found && it != localIPs.end())
 		{
 			in6_addr itip = *it;
-			in6_addr addrip = addr->GetIPv6();
+			in6_addr addrip = mapped.GetIPv6();
 			if (memcmp(&addrip,&itip,sizeof(in6_addr)) == 0)
 				found = true;
 			else
@@ -492,6 +701,9 @@ int RTPUDPv6Transmitter::Poll()
 	if (!init)
 		return MEDIA_RTP_ERR_INVALID_STATE;
 
+	// 接受和忽略列表变化后，先在锁外重新生成内核中的过滤程序
+	FlushKernelFilter();
+
 	int status;
 	
 	MAINMUTEX_LOCK
@@ -500,10 +712,23 @@ int RTPUDPv6Transmitter::Poll()
 		MAINMUTEX_UNLOCK
 		return MEDIA_RTP_ERR_INVALID_STATE;
 	}
+#if defined(RTP_HAVE_MSG_ZEROCOPY) || defined(RTP_HAVE_SO_TIMESTAMPING)
+	// 错误队列中的通知会让套接字一直报告错误事件，在这里读出它们，避免等待函数被反复唤醒
+	ProcessErrorQueues();
+#endif // RTP_HAVE_MSG_ZEROCOPY || RTP_HAVE_SO_TIMESTAMPING
 	status = PollSocket(true); // 轮询 RTP 套接字
 	if (status >= 0)
 		status = PollSocket(false); // 轮询 RTCP 套接字
+#ifdef RTP_HAVE_SO_TIMESTAMPING
+	std::vector<std::pair<RTPNTPTime,RTPTime> > timestamps;
+	timestamps.swap(txtimestamplist);
+#endif // RTP_HAVE_SO_TIMESTAMPING
 	MAINMUTEX_UNLOCK
+
+#ifdef RTP_HAVE_SO_TIMESTAMPING
+	for (size_t i = 0 ; i < timestamps.size() ; i++)
+		OnRTCPTransmitTimestamp(timestamps[i].first,timestamps[i].second);
+#endif // RTP_HAVE_SO_TIMESTAMPING
 	return status;
 }
 
@@ -511,6 +736,8 @@ int RTPUDPv6Transmitter::WaitForIncomingData(const RTPTime &delay,bool *dataavai
 {
 	if (!init)
 		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	FlushKernelFilter();
 	
 	MAINMUTEX_LOCK
 		
@@ -526,18 +753,19 @@ int RTPUDPv6Transmitter::WaitForIncomingData(const RTPTime &delay,bool *dataavai
 	}
 	
 	int abortSocket = m_pAbortDesc->GetAbortSocket();
-	int socks[3] = { rtpsock, rtcpsock, abortSocket };
-	int8_t readflags[3] = { 0, 0, 0 };
-	const int idxRTP = 0;
-	const int idxRTCP = 1;
-	const int idxAbort = 2;
+	int readysocks[3];
 
 	waitingfordata = true;
+#ifdef RTP_HAVE_SO_ATTACH_FILTER
+	// 刷新之后列表又有变化时立即返回，由接下来的 Poll 重新生成程序
+	if (kernelfilterdirty)
+		m_pAbortDesc->SendAbortSignal();
+#endif // RTP_HAVE_SO_ATTACH_FILTER
 	
 	WAITMUTEX_LOCK
 	MAINMUTEX_UNLOCK
 
-	int status = RTPSelect(socks, readflags, 3, delay);
+	int status = m_socketWaiter.Wait(delay, readysocks, 3);
 	if (status < 0)
 	{
 		MAINMUTEX_LOCK
@@ -556,17 +784,19 @@ int RTPUDPv6Transmitter::WaitForIncomingData(const RTPTime &delay,bool *dataavai
 		return 0;
 	}
 		
-	// 如果中止，则从中止缓冲区读取
-	if (readflags[idxAbort])
-		m_pAbortDesc->ReadSignallingByte();
-	
-	if (dataavailable != 0)
+	bool avail = false;
+
+	for (int i = 0 ; i < status ; i++)
 	{
-		if (readflags[idxRTP] || readflags[idxRTCP])
-			*dataavailable = true;
+		// 如果中止，则从中止缓冲区读取
+		if (readysocks[i] == abortSocket)
+			m_pAbortDesc->ReadSignallingByte();
 		else
-			*dataavailable = false;
-	}	
+			avail = true;
+	}
+
+	if (dataavailable != 0)
+		*dataavailable = avail;
 
 	MAINMUTEX_UNLOCK
 	WAITMUTEX_UNLOCK
@@ -614,12 +844,17 @@ int RTPUDPv6Transmitter::SendRTPData(const void *data,size_t len)
 		return MEDIA_RTP_ERR_RESOURCE_ERROR;
 	}
 	
-	for (const auto& dest : destinations)
-	{
-		sendto(rtpsock,(const char *)data,len,0,dest.GetRtpSockAddr(),dest.GetSockAddrLen());
-	}
+	std::vector<std::pair<RTPEndpoint,int> > senderrors;
+	struct iovec iov;
+
+	iov.iov_base = const_cast<void *>(data);
+	iov.iov_len = len;
+	SendToDestinations(true,&iov,1,senderrors);
 	
 	MAINMUTEX_UNLOCK
+
+	for (size_t i = 0 ; i < senderrors.size() ; i++)
+		OnSendError(UnmapEndpoint(senderrors[i].first),true,senderrors[i].second);
 	return 0;
 }
 
@@ -641,12 +876,96 @@ int RTPUDPv6Transmitter::SendRTCPData(const void *data,size_t len)
 		return MEDIA_RTP_ERR_RESOURCE_ERROR;
 	}
 	
-	for (const auto& dest : destinations)
+	std::vector<std::pair<RTPEndpoint,int> > senderrors;
+	struct iovec iov;
+
+	iov.iov_base = const_cast<void *>(data);
+	iov.iov_len = len;
+	SendToDestinations(false,&iov,1,senderrors);
+	
+	MAINMUTEX_UNLOCK
+
+	for (size_t i = 0 ; i < senderrors.size() ; i++)
+		OnSendError(UnmapEndpoint(senderrors[i].first),false,senderrors[i].second);
+	return 0;
+}
+
+int RTPUDPv6Transmitter::SendRTPDataBatch(const struct iovec *packets,size_t count)
+{
+	if (!init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	MAINMUTEX_LOCK
+	
+	if (!created)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	}
+	for (size_t i = 0 ; i < count ; i++)
+	{
+		if (packets[i].iov_len > maxpacksize)
+		{
+			MAINMUTEX_UNLOCK
+			return MEDIA_RTP_ERR_RESOURCE_ERROR;
+		}
+	}
+
+	std::vector<std::pair<RTPEndpoint,int> > senderrors;
+	size_t pos = 0;
+
+	while (pos < count)
+	{
+#ifdef RTP_HAVE_UDP_SEGMENT
+		if (usegso)
+		{
+			size_t num = GetSegmentGroupLength(packets+pos,count-pos);
+			if (num > 1)
+			{
+				SendSegmentsToDestinations(packets+pos,num,senderrors);
+				pos += num;
+				continue;
+			}
+		}
+#endif // RTP_HAVE_UDP_SEGMENT
+		SendToDestinations(true,packets+pos,1,senderrors);
+		pos++;
+	}
+
+	MAINMUTEX_UNLOCK
+
+	for (size_t i = 0 ; i < senderrors.size() ; i++)
+		OnSendError(UnmapEndpoint(senderrors[i].first),true,senderrors[i].second);
+	return 0;
+}
+
+int RTPUDPv6Transmitter::SendRTPDataV(const struct iovec *iov,size_t iovcount)
+{
+	if (!init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	if (iovcount > RTPTRANS_MAXSENDIOV)
+		return MEDIA_RTP_ERR_INVALID_PARAMETER;
+
+	MAINMUTEX_LOCK
+	
+	if (!created)
 	{
-		sendto(rtcpsock,(const char *)data,len,0,dest.GetRtcpSockAddr(),dest.GetSockAddrLen());
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	}
+	if (RTPGetIOVecLength(iov,iovcount) > maxpacksize)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_RESOURCE_ERROR;
 	}
 	
+	std::vector<std::pair<RTPEndpoint,int> > senderrors;
+	SendToDestinations(true,iov,iovcount,senderrors);
+	
 	MAINMUTEX_UNLOCK
+
+	for (size_t i = 0 ; i < senderrors.size() ; i++)
+		OnSendError(senderrors[i].first,true,senderrors[i].second);
 	return 0;
 }
 
@@ -662,14 +981,18 @@ int RTPUDPv6Transmitter::AddDestination(const RTPEndpoint &addr)
 		MAINMUTEX_UNLOCK
 		return MEDIA_RTP_ERR_INVALID_STATE;
 	}
-	if (addr.GetType() != RTPEndpoint::IPv6)
+	RTPEndpoint mapped;
+
+	if (!MapEndpoint(addr,&mapped))
 	{
 		MAINMUTEX_UNLOCK
 		return MEDIA_RTP_ERR_INVALID_PARAMETER;
 	}
 	
-	auto result = destinations.insert(addr);
+	auto result = destinations.insert(mapped);
 	int status = result.second ? 0 : MEDIA_RTP_ERR_INVALID_STATE;
+	if (result.second)
+		RebuildDestinationArrays();
 
 	MAINMUTEX_UNLOCK
 	return status;
@@ -687,20 +1010,18 @@ int RTPUDPv6Transmitter::DeleteDestination(const RTPEndpoint &addr)
 		MAINMUTEX_UNLOCK
 		return MEDIA_RTP_ERR_INVALID_STATE;
 	}
-	if (addr.GetType() != RTPEndpoint::IPv6)
-	{
-		MAINMUTEX_UNLOCK
-		return MEDIA_RTP_ERR_INVALID_PARAMETER;
-	}
-	
-	if (addr.GetType() != RTPEndpoint::IPv6)
+	RTPEndpoint mapped;
+
+	if (!MapEndpoint(addr,&mapped))
 	{
 		MAINMUTEX_UNLOCK
 		return MEDIA_RTP_ERR_INVALID_PARAMETER;
 	}
 	
-	size_t erased = destinations.erase(addr);
+	size_t erased = destinations.erase(mapped);
 	int status = erased > 0 ? 0 : MEDIA_RTP_ERR_INVALID_STATE;
+	if (erased > 0)
+		RebuildDestinationArrays();
 	
 	MAINMUTEX_UNLOCK
 	return status;
@@ -713,7 +1034,10 @@ void RTPUDPv6Transmitter::ClearDestinations()
 	
 	MAINMUTEX_LOCK
 	if (created)
+	{
 		destinations.clear();
+		RebuildDestinationArrays();
+	}
 	MAINMUTEX_UNLOCK
 }
 
@@ -751,13 +1075,15 @@ int RTPUDPv6Transmitter::JoinMulticastGroup(const RTPEndpoint &addr)
 		MAINMUTEX_UNLOCK
 		return MEDIA_RTP_ERR_INVALID_STATE;
 	}
-	if (addr.GetType() != RTPEndpoint::IPv6)
+	RTPEndpoint mapped;
+
+	if (!MapEndpoint(addr,&mapped))
 	{
 		MAINMUTEX_UNLOCK
 		return MEDIA_RTP_ERR_INVALID_PARAMETER;
 	}
 	
-	in6_addr mcastIP = addr.GetIPv6();
+	in6_addr mcastIP = mapped.GetIPv6();
 	
 	if (!RTPUDPV6TRANS_IS_MCASTADDR(mcastIP))
 	{
@@ -769,17 +1095,17 @@ int RTPUDPv6Transmitter::JoinMulticastGroup(const RTPEndpoint &addr)
 	status = result.second ? 0 : MEDIA_RTP_ERR_INVALID_STATE;
 	if (status >= 0)
 	{
-		RTPUDPV6TRANS_MCASTMEMBERSHIP(rtpsock,IPV6_JOIN_GROUP,mcastIP,status);
+		status = UpdateMulticastMembership(rtpsock,mcastIP,true);
 		if (status != 0)
 		{
 			multicastgroups.erase(mcastIP);
 			MAINMUTEX_UNLOCK
 			return MEDIA_RTP_ERR_OPERATION_FAILED;
 		}
-		RTPUDPV6TRANS_MCASTMEMBERSHIP(rtcpsock,IPV6_JOIN_GROUP,mcastIP,status);
+		status = UpdateMulticastMembership(rtcpsock,mcastIP,true);
 		if (status != 0)
 		{
-			RTPUDPV6TRANS_MCASTMEMBERSHIP(rtpsock,IPV6_LEAVE_GROUP,mcastIP,status);
+			UpdateMulticastMembership(rtpsock,mcastIP,false);
 			multicastgroups.erase(mcastIP);
 			MAINMUTEX_UNLOCK
 			return MEDIA_RTP_ERR_OPERATION_FAILED;
@@ -803,13 +1129,15 @@ int RTPUDPv6Transmitter::LeaveMulticastGroup(const RTPEndpoint &addr)
 		MAINMUTEX_UNLOCK
 		return MEDIA_RTP_ERR_INVALID_STATE;
 	}
-	if (addr.GetType() != RTPEndpoint::IPv6)
+	RTPEndpoint mapped;
+
+	if (!MapEndpoint(addr,&mapped))
 	{
 		MAINMUTEX_UNLOCK
 		return MEDIA_RTP_ERR_INVALID_PARAMETER;
 	}
 	
-	in6_addr mcastIP = addr.GetIPv6();
+	in6_addr mcastIP = mapped.GetIPv6();
 	
 	if (!RTPUDPV6TRANS_IS_MCASTADDR(mcastIP))
 	{
@@ -821,8 +1149,8 @@ int RTPUDPv6Transmitter::LeaveMulticastGroup(const RTPEndpoint &addr)
 	status = erased > 0 ? 0 : MEDIA_RTP_ERR_INVALID_STATE;
 	if (status >= 0)
 	{	
-		RTPUDPV6TRANS_MCASTMEMBERSHIP(rtpsock,IPV6_LEAVE_GROUP,mcastIP,status);
-		RTPUDPV6TRANS_MCASTMEMBERSHIP(rtcpsock,IPV6_LEAVE_GROUP,mcastIP,status);
+		UpdateMulticastMembership(rtpsock,mcastIP,false);
+		UpdateMulticastMembership(rtcpsock,mcastIP,false);
 		status = 0;
 	}
 	
@@ -840,10 +1168,8 @@ void RTPUDPv6Transmitter::LeaveAllMulticastGroups()
 	{
 		for (const in6_addr& mcastIP : multicastgroups)
 		{
-			int status = 0;
-			RTPUDPV6TRANS_MCASTMEMBERSHIP(rtpsock,IPV6_LEAVE_GROUP,mcastIP,status);
-			RTPUDPV6TRANS_MCASTMEMBERSHIP(rtcpsock,IPV6_LEAVE_GROUP,mcastIP,status);
-			MEDIA_RTP_UNUSED(status);
+			UpdateMulticastMembership(rtpsock,mcastIP,false);
+			UpdateMulticastMembership(rtcpsock,mcastIP,false);
 		}
 		multicastgroups.clear();
 	}
@@ -882,7 +1208,8 @@ int RTPUDPv6Transmitter::SetReceiveMode(RTPTransmitter::ReceiveMode m)
 	if (m != receivemode)
 	{
 		receivemode = m;
-		acceptignoreinfo.clear();
+		ClearAcceptIgnoreInfo();
+		KernelFilterChanged();
 	}
 	MAINMUTEX_UNLOCK
 	return 0;
@@ -902,7 +1229,9 @@ int RTPUDPv6Transmitter::AddToIgnoreList(const RTPEndpoint &addr)
 		MAINMUTEX_UNLOCK
 		return MEDIA_RTP_ERR_INVALID_STATE;
 	}
-	if (addr.GetType() != RTPEndpoint::IPv6)
+	RTPEndpoint mapped;
+
+	if (!MapEndpoint(addr,&mapped))
 	{
 		MAINMUTEX_UNLOCK
 		return MEDIA_RTP_ERR_INVALID_PARAMETER;
@@ -913,7 +1242,7 @@ int RTPUDPv6Transmitter::AddToIgnoreList(const RTPEndpoint &addr)
 		return MEDIA_RTP_ERR_OPERATION_FAILED;
 	}
 	
-	status = ProcessAddAcceptIgnoreEntry(addr.GetIPv6(),addr.GetRtpPort());
+	status = ProcessAddAcceptIgnoreEntry(mapped.GetIPv6(),mapped.GetRtpPort());
 	
 	MAINMUTEX_UNLOCK
 	return status;
@@ -933,7 +1262,9 @@ int RTPUDPv6Transmitter::DeleteFromIgnoreList(const RTPEndpoint &addr)
 		MAINMUTEX_UNLOCK
 		return MEDIA_RTP_ERR_INVALID_STATE;
 	}
-	if (addr.GetType() != RTPEndpoint::IPv6)
+	RTPEndpoint mapped;
+
+	if (!MapEndpoint(addr,&mapped))
 	{
 		MAINMUTEX_UNLOCK
 		return MEDIA_RTP_ERR_INVALID_PARAMETER;
@@ -944,7 +1275,7 @@ int RTPUDPv6Transmitter::DeleteFromIgnoreList(const RTPEndpoint &addr)
 		return MEDIA_RTP_ERR_OPERATION_FAILED;
 	}
 	
-	status = ProcessDeleteAcceptIgnoreEntry(addr.GetIPv6(),addr.GetRtpPort());
+	status = ProcessDeleteAcceptIgnoreEntry(mapped.GetIPv6(),mapped.GetRtpPort());
 
 	MAINMUTEX_UNLOCK
 	return status;
@@ -957,7 +1288,10 @@ void RTPUDPv6Transmitter::ClearIgnoreList()
 	
 	MAINMUTEX_LOCK
 	if (created && receivemode == RTPTransmitter::IgnoreSome)
+	{
 		ClearAcceptIgnoreInfo();
+		KernelFilterChanged();
+	}
 	MAINMUTEX_UNLOCK
 }
 
@@ -975,7 +1309,9 @@ int RTPUDPv6Transmitter::AddToAcceptList(const RTPEndpoint &addr)
 		MAINMUTEX_UNLOCK
 		return MEDIA_RTP_ERR_INVALID_STATE;
 	}
-	if (addr.GetType() != RTPEndpoint::IPv6)
+	RTPEndpoint mapped;
+
+	if (!MapEndpoint(addr,&mapped))
 	{
 		MAINMUTEX_UNLOCK
 		return MEDIA_RTP_ERR_INVALID_PARAMETER;
@@ -986,7 +1322,7 @@ int RTPUDPv6Transmitter::AddToAcceptList(const RTPEndpoint &addr)
 		return MEDIA_RTP_ERR_OPERATION_FAILED;
 	}
 	
-	status = ProcessAddAcceptIgnoreEntry(addr.GetIPv6(),addr.GetRtpPort());
+	status = ProcessAddAcceptIgnoreEntry(mapped.GetIPv6(),mapped.GetRtpPort());
 
 	MAINMUTEX_UNLOCK
 	return status;
@@ -1006,7 +1342,9 @@ int RTPUDPv6Transmitter::DeleteFromAcceptList(const RTPEndpoint &addr)
 		MAINMUTEX_UNLOCK
 		return MEDIA_RTP_ERR_INVALID_STATE;
 	}
-	if (addr.GetType() != RTPEndpoint::IPv6)
+	RTPEndpoint mapped;
+
+	if (!MapEndpoint(addr,&mapped))
 	{
 		MAINMUTEX_UNLOCK
 		return MEDIA_RTP_ERR_INVALID_PARAMETER;
@@ -1017,7 +1355,7 @@ int RTPUDPv6Transmitter::DeleteFromAcceptList(const RTPEndpoint &addr)
 		return MEDIA_RTP_ERR_OPERATION_FAILED;
 	}
 	
-	status = ProcessDeleteAcceptIgnoreEntry(addr.GetIPv6(),addr.GetRtpPort());
+	status = ProcessDeleteAcceptIgnoreEntry(mapped.GetIPv6(),mapped.GetRtpPort());
 
 	MAINMUTEX_UNLOCK
 	return status;
@@ -1030,7 +1368,10 @@ void RTPUDPv6Transmitter::ClearAcceptList()
 	
 	MAINMUTEX_LOCK
 	if (created && receivemode == RTPTransmitter::AcceptSome)
+	{
 		ClearAcceptIgnoreInfo();
+		KernelFilterChanged();
+	}
 	MAINMUTEX_UNLOCK
 }
 
@@ -1059,50 +1400,18 @@ bool RTPUDPv6Transmitter::NewDataAvailable()
 {
 	if (!init)
 		return false;
-	
-	MAINMUTEX_LOCK
-	
-	bool v;
-		
-	if (!created)
-		v = false;
-	else
-	{
-		if (rawpacketlist.empty())
-			v = false;
-		else
-			v = true;
-	}
-	
-	MAINMUTEX_UNLOCK
-	return v;
+	return !rawpacketqueue.IsEmpty();
 }
 
 RTPRawPacket *RTPUDPv6Transmitter::GetNextPacket()
 {
 	if (!init)
 		return 0;
-	
-	MAINMUTEX_LOCK
-	
-	RTPRawPacket *p;
-	
-	if (!created)
-	{
-		MAINMUTEX_UNLOCK
-		return 0;
-	}
-	if (rawpacketlist.empty())
-	{
-		MAINMUTEX_UNLOCK
-		return 0;
-	}
 
-	p = *(rawpacketlist.begin());
-	rawpacketlist.pop_front();
-
-	MAINMUTEX_UNLOCK
-	return p;
+	// 不需要主锁：轮询时只在队尾加入数据包，这里只从队首取出。
+	// Destroy 清空队列时也是消费者，调用者保证两者不会并发（见 RTPTransmitter::Destroy），
+	// 因此这里不必检查 created
+	return rawpacketqueue.Pop();
 }
 
 // 私有函数从这里开始...
@@ -1119,299 +1428,879 @@ bool RTPUDPv6Transmitter::SetMulticastTTL(uint8_t ttl)
 	status = setsockopt(rtcpsock,IPPROTO_IPV6,IPV6_MULTICAST_HOPS,(const char *)&ttl2,sizeof(int));
 	if (status != 0)
 		return false;
+	if (dualstack) // 发往 IPv4 组播组的数据包使用 IPv4 的 TTL 设置
+	{
+		status = setsockopt(rtpsock,IPPROTO_IP,IP_MULTICAST_TTL,(const char *)&ttl2,sizeof(int));
+		if (status != 0)
+			return false;
+		status = setsockopt(rtcpsock,IPPROTO_IP,IP_MULTICAST_TTL,(const char *)&ttl2,sizeof(int));
+		if (status != 0)
+			return false;
+	}
 	return true;
 }
-#endif // RTP_SUPPORT_IPV6MULTICAST
 
-void RTPUDPv6Transmitter::FlushPackets()
+int RTPUDPv6Transmitter::UpdateMulticastMembership(int sock,const in6_addr &mcastip,bool join)
 {
-	std::list<RTPRawPacket*>::const_iterator it;
+	int status;
+
+	if (IN6_IS_ADDR_V4MAPPED(&mcastip))
+	{
+		// 双栈套接字上的 IPv4 组播组仍使用 IPv4 的套接字选项
+		struct ip_mreqn mreq;
 
-	for (it = rawpacketlist.begin() ; it != rawpacketlist.end() ; ++it)
-		delete *it;
-	rawpacketlist.clear();
+		memset(&mreq,0,sizeof(struct ip_mreqn));
+		memcpy(&mreq.imr_multiaddr.s_addr,&mcastip.s6_addr[12],sizeof(uint32_t));
+		mreq.imr_ifindex = (int)mcastifidx;
+		status = setsockopt(sock,IPPROTO_IP,(join)?IP_ADD_MEMBERSHIP:IP_DROP_MEMBERSHIP,(const char *)&mreq,sizeof(struct ip_mreqn));
+	}
+	else
+		RTPUDPV6TRANS_MCASTMEMBERSHIP(sock,(join)?IPV6_JOIN_GROUP:IPV6_LEAVE_GROUP,mcastip,status);
+	return status;
 }
+#endif // RTP_SUPPORT_IPV6MULTICAST
 
-int RTPUDPv6Transmitter::PollSocket(bool rtp)
+static in6_addr MapIPv4Address(uint32_t ip)
 {
-	RTPSOCKLENTYPE fromlen;
-	int recvlen;
-	char packetbuffer[RTPUDPV6TRANS_MAXPACKSIZE];
-	size_t len;
-	int sock;
-	struct sockaddr_in6 srcaddr;
-	bool dataavailable;
-	
-	if (rtp)
-		sock = rtpsock;
-	else
-		sock = rtcpsock;
-	
-	len = 0;
-	RTPIOCTL(sock,FIONREAD,&len);
+	in6_addr addr;
+	uint32_t ipnbo = htonl(ip);
+
+	memset(&addr,0,sizeof(in6_addr));
+	addr.s6_addr[10] = 0xFF;
+	addr.s6_addr[11] = 0xFF;
+	memcpy(&addr.s6_addr[12],&ipnbo,sizeof(uint32_t));
+	return addr;
+}
 
-	if (len <= 0) // 确保长度为零的数据包不会排队
+bool RTPUDPv6Transmitter::MapEndpoint(const RTPEndpoint &addr,RTPEndpoint *mapped) const
+{
+	if (addr.GetType() == RTPEndpoint::IPv6)
 	{
-		int8_t isset = 0;
-		int status = RTPSelect(&sock, &isset, 1, RTPTime(0));
-		if (status < 0)
-			return status;
-
-		if (isset)
-			dataavailable = true;
-		else
-			dataavailable = false;
+		*mapped = addr;
+		return true;
 	}
-	else
-		dataavailable = true;
+	if (addr.GetType() != RTPEndpoint::IPv4 || !dualstack)
+		return false;
 
-	while (dataavailable)
-	{
-		RTPTime curtime = RTPTime::CurrentTime();
-		fromlen = sizeof(struct sockaddr_in6);
-		recvlen = recvfrom(sock,packetbuffer,RTPUDPV6TRANS_MAXPACKSIZE,0,(struct sockaddr *)&srcaddr,&fromlen);
-		if (recvlen > 0)
-		{
-			bool acceptdata;
+	// 双栈套接字以 IPv4 映射地址收发 IPv4 数据，内部统一保存这种形式
+	*mapped = RTPEndpoint(MapIPv4Address(addr.GetIPv4()),addr.GetRtpPort(),addr.GetRtcpPort());
+	return true;
+}
 
-			// 获取到数据，处理它
-			if (receivemode == RTPTransmitter::AcceptAll)
-				acceptdata = true;
-			else
-				acceptdata = ShouldAcceptData(srcaddr.sin6_addr,ntohs(srcaddr.sin6_port));
-			
-			if (acceptdata)
-			{
-				RTPRawPacket *pack;
-				RTPEndpoint *addr;
-				uint8_t *datacopy;
-
-				addr = new RTPEndpoint(srcaddr.sin6_addr,ntohs(srcaddr.sin6_port));
-				if (addr == 0)
-					return MEDIA_RTP_ERR_RESOURCE_ERROR;
-				datacopy = new uint8_t[recvlen];
-				if (datacopy == 0)
-				{
-					delete addr;
-					return MEDIA_RTP_ERR_RESOURCE_ERROR;
-				}
-				memcpy(datacopy,packetbuffer,recvlen);
-				
-				pack = new RTPRawPacket(datacopy,recvlen,addr,curtime,rtp);
-				if (pack == 0)
-				{
-					delete addr;
-					delete [] datacopy;
-					return MEDIA_RTP_ERR_RESOURCE_ERROR;
-				}
-				rawpacketlist.push_back(pack);	
-			}
-		}
-		len = 0;
-		RTPIOCTL(sock,FIONREAD,&len);
+RTPEndpoint RTPUDPv6Transmitter::UnmapEndpoint(const RTPEndpoint &addr)
+{
+	if (addr.GetType() != RTPEndpoint::IPv6 || !IN6_IS_ADDR_V4MAPPED(&addr.GetIPv6()))
+		return addr;
 
-		if (len <= 0) // 确保长度为零的数据包不会排队
-		{
-			int8_t isset = 0;
-			int status = RTPSelect(&sock, &isset, 1, RTPTime(0));
-			if (status < 0)
-				return status;
+	uint32_t ip;
 
-			if (isset)
-				dataavailable = true;
-			else
-				dataavailable = false;
+	memcpy(&ip,&addr.GetIPv6().s6_addr[12],sizeof(uint32_t));
+	return RTPEndpoint(ntohl(ip),addr.GetRtpPort(),addr.GetRtcpPort());
+}
+
+void RTPUDPv6Transmitter::RebuildDestinationArrays()
+{
+	destinationlist.clear();
+	for (const auto& dest : destinations)
+		destinationlist.push_back(&dest);
+
+#ifdef RTP_HAVE_SENDMMSG
+	// 预先建立每个目标的消息头，它们都指向同一组 iovec，
+	// 因此发送时只需设置一次数据指针和长度
+	size_t num = destinationlist.size();
+
+	rtpsendmsgs.resize(num);
+	rtcpsendmsgs.resize(num);
+	for (size_t i = 0 ; i < num ; i++)
+	{
+		const RTPEndpoint *dest = destinationlist[i];
+
+		memset(&rtpsendmsgs[i],0,sizeof(struct mmsghdr));
+		rtpsendmsgs[i].msg_hdr.msg_name = const_cast<struct sockaddr *>(dest->GetRtpSockAddr());
+		rtpsendmsgs[i].msg_hdr.msg_namelen = dest->GetSockAddrLen();
+		rtpsendmsgs[i].msg_hdr.msg_iov = sendiovecs;
+		rtpsendmsgs[i].msg_hdr.msg_iovlen = 1;
+
+		memset(&rtcpsendmsgs[i],0,sizeof(struct mmsghdr));
+		rtcpsendmsgs[i].msg_hdr.msg_name = const_cast<struct sockaddr *>(dest->GetRtcpSockAddr());
+		rtcpsendmsgs[i].msg_hdr.msg_namelen = dest->GetSockAddrLen();
+		rtcpsendmsgs[i].msg_hdr.msg_iov = sendiovecs;
+		rtcpsendmsgs[i].msg_hdr.msg_iovlen = 1;
+#ifdef RTP_HAVE_SO_TIMESTAMPING
+		if (usetxtimestamps)
+		{
+			rtcpsendmsgs[i].msg_hdr.msg_control = txtimestampcontrol;
+			rtcpsendmsgs[i].msg_hdr.msg_controllen = CMSG_SPACE(sizeof(uint32_t));
 		}
-		else
-			dataavailable = true;
+#endif // RTP_HAVE_SO_TIMESTAMPING
 	}
-	return 0;
+#endif // RTP_HAVE_SENDMMSG
 }
 
-int RTPUDPv6Transmitter::ProcessAddAcceptIgnoreEntry(in6_addr ip,uint16_t port)
+// 由 iovcount 个数据块组成的数据包发送给所有目标
+void RTPUDPv6Transmitter::SendToDestinations(bool rtp, const struct iovec *iov, size_t iovcount,
+                                          std::vector<std::pair<RTPEndpoint,int> > &senderrors)
 {
-	auto it = acceptignoreinfo.find(ip);
-	if (it != acceptignoreinfo.end()) // 该 IP 地址的条目已存在
+	int sock = (rtp)?rtpsock:rtcpsock;
+	int flags = 0;
+	size_t numsent = 0;
+	const void *data = iov[0].iov_base;
+	size_t len = iov[0].iov_len;
+
+#ifdef RTP_HAVE_MSG_ZEROCOPY
+	// 完成通知按缓冲区记录，因此只有连续的数据才使用零拷贝发送
+	if (rtp && iovcount == 1 && zerocopythreshold > 0 && len >= zerocopythreshold)
 	{
-		PortInfo *portinf = it->second;
-		
-		if (port == 0) // 选择所有端口
-		{
-			portinf->all = true;
-			portinf->portlist.clear();
-		}
-		else if (!portinf->all)
-		{
-			std::list<uint16_t>::const_iterator it,begin,end;
+		// 先读出已有的完成通知，未读的通知占用套接字内存，会限制同时进行的零拷贝发送
+		if (!zerocopypending.empty())
+			ProcessErrorQueue(rtpsock);
+		flags = MSG_ZEROCOPY;
+	}
+#endif // RTP_HAVE_MSG_ZEROCOPY
 
-			begin = portinf->portlist.begin();
-			end = portinf->portlist.end();
-			for (it = begin ; it != end ; it++)
-			{
-				if (*it == port) // already in list
-					return 0;
-			}
-			portinf->portlist.push_front(port);
-		}
+#ifdef RTP_HAVE_SENDMMSG
+	std::vector<struct mmsghdr> &msgs = (rtp)?rtpsendmsgs:rtcpsendmsgs;
+	size_t num = msgs.size();
+	size_t offset = 0;
+
+	memcpy(sendiovecs,iov,iovcount*sizeof(struct iovec));
+	if (iovcount != 1) // 消息头默认只使用一个数据块
+	{
+		for (size_t i = 0 ; i < num ; i++)
+			msgs[i].msg_hdr.msg_iovlen = iovcount;
 	}
-	else // 需要为此 IP 地址创建条目
+
+	while (offset < num)
 	{
-		PortInfo *portinf;
-		int status;
-		
-		portinf = new PortInfo();
-		if (port == 0) // select all ports
-			portinf->all = true;
+		size_t count = num-offset;
+		if (count > RTPUDPV6TRANS_MAXSENDBATCH)
+			count = RTPUDPV6TRANS_MAXSENDBATCH;
+
+		int sent = sendmmsg(sock,&msgs[offset],(unsigned int)count,flags);
+		if (sent > 0)
+		{
+			offset += (size_t)sent;
+			numsent += (size_t)sent;
+		}
 		else
-			portinf->portlist.push_front(port);
-		
-		auto result = acceptignoreinfo.emplace(ip, portinf);
-		status = result.second ? 0 : MEDIA_RTP_ERR_INVALID_STATE;
-		if (status < 0)
 		{
-			delete portinf;
-			return status;
+			// sendmmsg 只在第一条消息失败时返回错误，记录该目标后从下一个目标继续；
+			// 部分发送时，失败的那条消息会在下一次调用中作为第一条消息报告
+			if (sent < 0 && errno == EINTR)
+				continue;
+			senderrors.push_back(std::make_pair(*destinationlist[offset],(sent < 0)?errno:0));
+			offset++;
 		}
 	}
-	return 0;
-}
 
-void RTPUDPv6Transmitter::ClearAcceptIgnoreInfo()
-{
-	for (auto& pair : acceptignoreinfo)
+	if (iovcount != 1)
 	{
-		PortInfo *inf = pair.second;
-		delete inf;
+		for (size_t i = 0 ; i < num ; i++)
+			msgs[i].msg_hdr.msg_iovlen = 1;
 	}
-	acceptignoreinfo.clear();
-}
-	
-int RTPUDPv6Transmitter::ProcessDeleteAcceptIgnoreEntry(in6_addr ip,uint16_t port)
-{
-	auto it = acceptignoreinfo.find(ip);
-	if (it == acceptignoreinfo.end())
-		return MEDIA_RTP_ERR_OPERATION_FAILED;
-	
-	PortInfo *inf = it->second;
-			if (port == 0) // 删除所有条目
+#else
+	for (size_t i = 0 ; i < destinationlist.size() ; i++)
 	{
-		inf->all = false;
-		inf->portlist.clear();
+		const RTPEndpoint *dest = destinationlist[i];
+		const struct sockaddr *sockaddr = (rtp)?dest->GetRtpSockAddr():dest->GetRtcpSockAddr();
+
+		struct msghdr msg;
+
+		memset(&msg,0,sizeof(struct msghdr));
+		msg.msg_name = const_cast<struct sockaddr *>(sockaddr);
+		msg.msg_namelen = dest->GetSockAddrLen();
+		msg.msg_iov = const_cast<struct iovec *>(iov);
+		msg.msg_iovlen = iovcount;
+		if (sendmsg(sock,&msg,flags) < 0)
+			senderrors.push_back(std::make_pair(*dest,errno));
+		else
+			numsent++;
 	}
-	else // 选择了一个特定的端口
+#endif // RTP_HAVE_SENDMMSG
+
+#ifdef RTP_HAVE_MSG_ZEROCOPY
+	// 内核为每次成功的零拷贝发送分配一个连续递增的通知编号
+	if (flags & MSG_ZEROCOPY)
 	{
-		if (inf->all) // 当前已选择所有端口。将要删除的端口添加到列表中
+		for (size_t i = 0 ; i < numsent ; i++)
+			zerocopypending.push_back(ZeroCopySend((const uint8_t *)data,len));
+	}
+#endif // RTP_HAVE_MSG_ZEROCOPY
+
+#ifdef RTP_HAVE_SO_TIMESTAMPING
+	// 每个成功发送的RTCP数据包产生一个发送时间戳，按顺序记下其中的发送方报告时间
+	if (!rtp && usetxtimestamps && numsent > 0)
+	{
+		const uint8_t *packet = (const uint8_t *)data;
+		RTPNTPTime srntptime(0,0);
+
+		if (len >= 16 && packet[1] == RTP_RTCPTYPE_SR)
 		{
-			// 我们必须检查列表中是否已包含该端口
-			std::list<uint16_t>::const_iterator it,begin,end;
+			uint32_t msw,lsw;
 
-			begin = inf->portlist.begin();
-			end = inf->portlist.end();
-			for (it = begin ; it != end ; it++)
-			{
-				if (*it == port) // 已在列表中：这意味着我们已经删除了该条目
-					return MEDIA_RTP_ERR_OPERATION_FAILED;
-			}
-			inf->portlist.push_front(port);
+			memcpy(&msw,packet+8,sizeof(uint32_t));
+			memcpy(&lsw,packet+12,sizeof(uint32_t));
+			srntptime = RTPNTPTime(ntohl(msw),ntohl(lsw));
 		}
-		else // 检查我们是否可以在列表中找到该端口
+		for (size_t i = 0 ; i < numsent ; i++)
+			txtimestampreports.push_back(std::make_pair(txtimestampnextid++,srntptime));
+
+		// 丢失的时间戳对应的条目在收到更新的时间戳时删除，这里再限制一次总数
+		while (txtimestampreports.size() > RTPUDPV6TRANS_MAXTXTIMESTAMPREPORTS)
+			txtimestampreports.pop_front();
+	}
+#endif // RTP_HAVE_SO_TIMESTAMPING
+
+#if !defined(RTP_HAVE_MSG_ZEROCOPY) && !defined(RTP_HAVE_SO_TIMESTAMPING)
+	MEDIA_RTP_UNUSED(numsent);
+	MEDIA_RTP_UNUSED(data);
+	MEDIA_RTP_UNUSED(len);
+#endif // !RTP_HAVE_MSG_ZEROCOPY && !RTP_HAVE_SO_TIMESTAMPING
+}
+
+int RTPUDPv6Transmitter::WaitForSendCompletion(const void *data,size_t len)
+{
+	if (!init)
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	MAINMUTEX_LOCK
+	if (!created)
+	{
+		MAINMUTEX_UNLOCK
+		return MEDIA_RTP_ERR_INVALID_STATE;
+	}
+
+#ifdef RTP_HAVE_MSG_ZEROCOPY
+	if (!zerocopypending.empty())
+		ProcessErrorQueue(rtpsock);
+
+	double starttime = RTPTime::CurrentTime().GetDouble();
+
+	while (IsZeroCopyBufferInUse((const uint8_t *)data,len))
+	{
+		if (RTPTime::CurrentTime().GetDouble()-starttime > zerocopytimeout)
 		{
-			std::list<uint16_t>::iterator it,begin,end;
-			
-			begin = inf->portlist.begin();
-			end = inf->portlist.end();
-			for (it = begin ; it != end ; ++it)
-			{
-				if (*it == port) // 找到了！
-				{
-					inf->portlist.erase(it);
-					return 0;
-				}
-			}
-			// 没找到
+			MAINMUTEX_UNLOCK
 			return MEDIA_RTP_ERR_OPERATION_FAILED;
 		}
+
+		// 完成通知到达时套接字报告 POLLERR；等待期间释放锁，以免阻塞接收和其他发送
+		struct pollfd fd;
+
+		fd.fd = rtpsock;
+		fd.events = 0;
+		fd.revents = 0;
+
+		MAINMUTEX_UNLOCK
+		poll(&fd,1,RTPUDPV6TRANS_ZEROCOPYPOLLMS);
+		MAINMUTEX_LOCK
+
+		if (!created)
+		{
+			MAINMUTEX_UNLOCK
+			return MEDIA_RTP_ERR_INVALID_STATE;
+		}
+		ProcessErrorQueue(rtpsock);
 	}
+#else
+	MEDIA_RTP_UNUSED(data);
+	MEDIA_RTP_UNUSED(len);
+#endif // RTP_HAVE_MSG_ZEROCOPY
+
+	MAINMUTEX_UNLOCK
 	return 0;
 }
 
-bool RTPUDPv6Transmitter::ShouldAcceptData(in6_addr srcip,uint16_t srcport)
+size_t RTPUDPv6Transmitter::GetNumPendingZeroCopySends()
 {
-	if (receivemode == RTPTransmitter::AcceptSome)
+	size_t num = 0;
+
+	if (!init)
+		return 0;
+
+	MAINMUTEX_LOCK
+#ifdef RTP_HAVE_MSG_ZEROCOPY
+	if (created)
+		num = zerocopypending.size();
+#endif // RTP_HAVE_MSG_ZEROCOPY
+	MAINMUTEX_UNLOCK
+	return num;
+}
+
+bool RTPUDPv6Transmitter::IsKernelFilterComplete()
+{
+	bool complete = true;
+
+	if (!init)
+		return true;
+
+	MAINMUTEX_LOCK
+#ifdef RTP_HAVE_SO_ATTACH_FILTER
+	if (created && usekernelfilter)
+		complete = kernelfiltercomplete;
+#endif // RTP_HAVE_SO_ATTACH_FILTER
+	MAINMUTEX_UNLOCK
+	return complete;
+}
+
+#if defined(RTP_HAVE_MSG_ZEROCOPY) || defined(RTP_HAVE_SO_TIMESTAMPING)
+void RTPUDPv6Transmitter::ProcessErrorQueues()
+{
+	bool rtpqueue = false;
+	bool rtcpqueue = false;
+
+#ifdef RTP_HAVE_MSG_ZEROCOPY
+	if (zerocopythreshold > 0)
+		rtpqueue = true;
+#endif // RTP_HAVE_MSG_ZEROCOPY
+#ifdef RTP_HAVE_SO_TIMESTAMPING
+	if (usetxtimestamps)
+		rtcpqueue = true;
+#endif // RTP_HAVE_SO_TIMESTAMPING
+
+	if (rtpqueue)
+		ProcessErrorQueue(rtpsock);
+	if (rtcpqueue && !(rtpqueue && rtcpsock == rtpsock))
+		ProcessErrorQueue(rtcpsock);
+}
+
+void RTPUDPv6Transmitter::ProcessErrorQueue(int sock)
+{
+	union
 	{
-		PortInfo *inf;
+		char buf[RTPUDPV6TRANS_RECVCONTROLSIZE];
+		struct cmsghdr align;
+	} control;
+	struct msghdr msg;
 
-		auto it = acceptignoreinfo.find(srcip);
-		if (it == acceptignoreinfo.end())
-			return false;
-		
-		inf = it->second;
-		if (!inf->all) // 只接受列表中的
+	// 零拷贝完成通知和发送时间戳都在套接字的错误队列中，每次读出一条
+	while (true)
+	{
+		memset(&msg,0,sizeof(struct msghdr));
+		msg.msg_control = control.buf;
+		msg.msg_controllen = sizeof(control.buf);
+		if (recvmsg(sock,&msg,MSG_ERRQUEUE|MSG_DONTWAIT) < 0)
+			break;
+
+#ifdef RTP_HAVE_SO_TIMESTAMPING
+		bool istxtimestamp = false;
+		uint32_t txtimestampid = 0;
+		RTPTime txtime(0.0);
+#endif // RTP_HAVE_SO_TIMESTAMPING
+
+		for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg) ; cmsg != 0 ; cmsg = CMSG_NXTHDR(&msg,cmsg))
 		{
-			std::list<uint16_t>::const_iterator it,begin,end;
+#ifdef RTP_HAVE_SO_TIMESTAMPING
+			if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPING)
+			{
+				struct scm_timestamping ts;
+
+				// 第一个是软件时间戳，后两个用于硬件时间戳
+				memcpy(&ts,CMSG_DATA(cmsg),sizeof(struct scm_timestamping));
+				txtime = RTPTime((int64_t)ts.ts[0].tv_sec,(uint32_t)(ts.ts[0].tv_nsec/1000));
+				continue;
+			}
+#endif // RTP_HAVE_SO_TIMESTAMPING
+
+			if (!((cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) ||
+			      (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)))
+				continue;
+
+			struct sock_extended_err serr;
 
-			begin = inf->portlist.begin();
-			end = inf->portlist.end();
-			for (it = begin ; it != end ; it++)
+			memcpy(&serr,CMSG_DATA(cmsg),sizeof(struct sock_extended_err));
+#ifdef RTP_HAVE_MSG_ZEROCOPY
+			if (serr.ee_errno == 0 && serr.ee_origin == SO_EE_ORIGIN_ZEROCOPY)
 			{
-				if (*it == srcport)
-					return true;
+				// ee_info 到 ee_data（包含两端）是已完成的编号，编号按32位回绕
+				uint32_t first = serr.ee_info-zerocopyfirstid;
+				uint32_t last = serr.ee_data-zerocopyfirstid;
+
+				for (uint32_t idx = first ; idx <= last && idx < zerocopypending.size() ; idx++)
+					zerocopypending[idx].done = true;
 			}
-			return false;
+#endif // RTP_HAVE_MSG_ZEROCOPY
+#ifdef RTP_HAVE_SO_TIMESTAMPING
+			if (serr.ee_origin == SO_EE_ORIGIN_TIMESTAMPING && serr.ee_info == SCM_TSTAMP_SND)
+			{
+				istxtimestamp = true;
+				txtimestampid = serr.ee_data;
+			}
+#endif // RTP_HAVE_SO_TIMESTAMPING
 		}
-		else // 全部接受，列表中的除外
+
+#ifdef RTP_HAVE_SO_TIMESTAMPING
+		// 按编号找到对应的发送方报告时间；编号更小的条目的时间戳已经丢失（例如错误队列
+		// 溢出），一并删除。编号按32位回绕
+		if (istxtimestamp)
 		{
-			std::list<uint16_t>::const_iterator it,begin,end;
+			while (!txtimestampreports.empty() && (int32_t)(txtimestampreports.front().first-txtimestampid) < 0)
+				txtimestampreports.pop_front();
 
-			begin = inf->portlist.begin();
-			end = inf->portlist.end();
-			for (it = begin ; it != end ; it++)
+			if (!txtimestampreports.empty() && txtimestampreports.front().first == txtimestampid)
 			{
-				if (*it == srcport)
-					return false;
+				if (!txtime.IsZero())
+					txtimestamplist.push_back(std::make_pair(txtimestampreports.front().second,txtime));
+				txtimestampreports.pop_front();
 			}
-			return true;
 		}
+#endif // RTP_HAVE_SO_TIMESTAMPING
 	}
-	else // 忽略一些
+
+#ifdef RTP_HAVE_MSG_ZEROCOPY
+	while (!zerocopypending.empty() && zerocopypending.front().done)
 	{
-		PortInfo *inf;
+		zerocopypending.pop_front();
+		zerocopyfirstid++;
+	}
+#endif // RTP_HAVE_MSG_ZEROCOPY
+}
+#endif // RTP_HAVE_MSG_ZEROCOPY || RTP_HAVE_SO_TIMESTAMPING
 
-		auto it = acceptignoreinfo.find(srcip);
-		if (it == acceptignoreinfo.end())
+#ifdef RTP_HAVE_MSG_ZEROCOPY
+
+bool RTPUDPv6Transmitter::IsZeroCopyBufferInUse(const uint8_t *data,size_t len) const
+{
+	std::deque<ZeroCopySend>::const_iterator it;
+
+	for (it = zerocopypending.begin() ; it != zerocopypending.end() ; ++it)
+	{
+		if (!it->done && it->data < data+len && data < it->data+it->len)
 			return true;
-		
-		inf = it->second;
-		if (!inf->all) // 忽略列表中的端口
+	}
+	return false;
+}
+#endif // RTP_HAVE_MSG_ZEROCOPY
+
+#ifdef RTP_HAVE_UDP_SEGMENT
+size_t RTPUDPv6Transmitter::GetSegmentGroupLength(const struct iovec *packets,size_t count) const
+{
+	// 一个 GSO 缓冲区中除最后一个分段外所有分段的长度必须相同，最后一个分段不能更长
+	size_t segmentsize = packets[0].iov_len;
+	size_t totalsize = 0;
+	size_t num = 0;
+
+	while (num < count && num < RTPUDPV6TRANS_MAXGSOSEGMENTS)
+	{
+		size_t len = packets[num].iov_len;
+
+		if (len == 0 || len > segmentsize || totalsize+len > RTPUDPV6TRANS_MAXGSOBYTES)
+			break;
+		totalsize += len;
+		num++;
+		if (len < segmentsize)
+			break;
+	}
+	return num;
+}
+
+void RTPUDPv6Transmitter::SendSegmentsToDestinations(const struct iovec *packets,size_t count,
+                                                     std::vector<std::pair<RTPEndpoint,int> > &senderrors)
+{
+	union
+	{
+		char buf[CMSG_SPACE(sizeof(uint16_t))];
+		struct cmsghdr align;
+	} control;
+	uint16_t segmentsize = (uint16_t)packets[0].iov_len;
+
+	memset(&control,0,sizeof(control));
+	struct cmsghdr *cmsg = &control.align;
+	cmsg->cmsg_level = SOL_UDP;
+	cmsg->cmsg_type = UDP_SEGMENT;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+	memcpy(CMSG_DATA(cmsg),&segmentsize,sizeof(uint16_t));
+
+	for (size_t i = 0 ; i < destinationlist.size() ; i++)
+	{
+		const RTPEndpoint *dest = destinationlist[i];
+
+		if (usegso)
 		{
-			std::list<uint16_t>::const_iterator it,begin,end;
+			struct msghdr msg;
 
-			begin = inf->portlist.begin();
-			end = inf->portlist.end();
-			for (it = begin ; it != end ; it++)
+			memset(&msg,0,sizeof(struct msghdr));
+			msg.msg_name = const_cast<struct sockaddr *>(dest->GetRtpSockAddr());
+			msg.msg_namelen = dest->GetSockAddrLen();
+			msg.msg_iov = const_cast<struct iovec *>(packets);
+			msg.msg_iovlen = count;
+			msg.msg_control = control.buf;
+			msg.msg_controllen = sizeof(control.buf);
+
+			if (sendmsg(rtpsock,&msg,0) >= 0)
+				continue;
+
+			int err = errno;
+			if (err != EIO && err != EINVAL && err != EOPNOTSUPP)
 			{
-				if (*it == srcport)
-					return false;
+				senderrors.push_back(std::make_pair(*dest,err));
+				continue;
 			}
-			return true;
+
+			// 网卡无法进行校验和卸载或分段超过路径 MTU 时内核会拒绝 GSO，
+			// 此时改为逐个发送，并在之后不再尝试
+			usegso = false;
+		}
+
+		for (size_t j = 0 ; j < count ; j++)
+		{
+			if (sendto(rtpsock,(const char *)packets[j].iov_base,packets[j].iov_len,0,dest->GetRtpSockAddr(),dest->GetSockAddrLen()) < 0)
+				senderrors.push_back(std::make_pair(*dest,errno));
+		}
+	}
+}
+#endif // RTP_HAVE_UDP_SEGMENT
+
+void RTPUDPv6Transmitter::FlushPackets()
+{
+	rawpacketqueue.Flush();
+}
+
+RTPTime RTPUDPv6Transmitter::GetPollTime() const
+{
+#ifdef RTP_HAVE_SO_TIMESTAMPING
+	// 使用内核时间戳时，接收时间取自每个数据报的控制消息，不必读取时钟
+	if (userxtimestamps)
+		return RTPTime(0.0);
+#endif // RTP_HAVE_SO_TIMESTAMPING
+	return RTPTime::CurrentTime();
+}
+
+int RTPUDPv6Transmitter::PollSocket(bool rtp)
+{
+	int recvlen;
+	char packetbuffer[RTPUDPV6TRANS_MAXPACKSIZE];
+#if defined(RTP_HAVE_UDP_GRO) || defined(RTP_HAVE_SO_TIMESTAMPING)
+	union
+	{
+		char buf[RTPUDPV6TRANS_RECVCONTROLSIZE];
+		struct cmsghdr align;
+	} control;
+#endif // RTP_HAVE_UDP_GRO || RTP_HAVE_SO_TIMESTAMPING
+	int sock;
+	struct sockaddr_in6 srcaddr;
+	
+#ifdef RTP_HAVE_RECVMMSG
+	if (recvbatchsize > 1)
+		return PollSocketBatch(rtp);
+#endif // RTP_HAVE_RECVMMSG
+
+	if (rtp)
+		sock = rtpsock;
+	else
+		sock = rtcpsock;
+	
+	// 套接字总是由传输器自己创建，因此用 MSG_DONTWAIT 一直读到 EAGAIN 为止，
+	// 每个数据报只需要一次系统调用。MSG_DONTWAIT 只作用于本次调用，发送仍然是阻塞的
+	for (;;)
+	{
+		// 队列已满时（数据包的处理跟不上接收）把剩余的数据报留在套接字中
+		if (rawpacketqueue.IsFull())
+			break;
+
+		RTPTime curtime = GetPollTime();
+		struct msghdr msg;
+		struct iovec iov;
+
+		iov.iov_base = packetbuffer;
+		iov.iov_len = RTPUDPV6TRANS_MAXPACKSIZE;
+		memset(&msg,0,sizeof(struct msghdr));
+		msg.msg_name = &srcaddr;
+		msg.msg_namelen = sizeof(struct sockaddr_in6);
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+#if defined(RTP_HAVE_UDP_GRO) || defined(RTP_HAVE_SO_TIMESTAMPING)
+		if (recvcontrol)
+		{
+			msg.msg_control = control.buf;
+			msg.msg_controllen = sizeof(control.buf);
 		}
-		else // 全部忽略，列表中的除外
+#endif // RTP_HAVE_UDP_GRO || RTP_HAVE_SO_TIMESTAMPING
+		// 套接字也可能只是报告了错误事件（例如零拷贝完成通知），因此不能阻塞
+		recvlen = recvmsg(sock,&msg,MSG_DONTWAIT);
+		if (recvlen > 0)
 		{
-			std::list<uint16_t>::const_iterator it,begin,end;
+			int status = ProcessReceivedMessage(&msg,(size_t)recvlen,curtime,rtp);
+			if (status < 0)
+				return status;
+		}
+		else if (recvlen < 0 && errno != EINTR)
+		{
+			// EAGAIN 表示已经读空；其他错误（例如 ICMP 报告的 ECONNREFUSED）同样结束本次读取，
+			// 剩余的数据报由下一次轮询读取
+			break;
+		}
+		// 长度为零的数据报已被读出，不会排队
+	}
+	return 0;
+}
+
+#ifdef RTP_HAVE_RECVMMSG
+int RTPUDPv6Transmitter::PollSocketBatch(bool rtp)
+{
+	int sock;
+	bool moredata = true;
+	bool usecontrol = false;
+
+#if defined(RTP_HAVE_UDP_GRO) || defined(RTP_HAVE_SO_TIMESTAMPING)
+	if (recvcontrol)
+		usecontrol = true;
+#endif // RTP_HAVE_UDP_GRO || RTP_HAVE_SO_TIMESTAMPING
 
-			begin = inf->portlist.begin();
-			end = inf->portlist.end();
-			for (it = begin ; it != end ; it++)
+	if (rtp)
+		sock = rtpsock;
+	else
+		sock = rtcpsock;
+
+	while (moredata)
+	{
+		// 只接收队列还能容纳的数据报，其余的留在套接字中
+		size_t count = rawpacketqueue.GetFreeSpace();
+		if (count == 0)
+			break;
+		if (count > recvbatchsize)
+			count = recvbatchsize;
+
+		for (size_t i = 0 ; i < count ; i++)
+		{
+			recvbatchmsgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in6);
+			recvbatchmsgs[i].msg_hdr.msg_flags = 0;
+			recvbatchmsgs[i].msg_len = 0;
+			if (usecontrol)
 			{
-				if (*it == srcport)
-					return true;
+				recvbatchmsgs[i].msg_hdr.msg_control = &recvbatchcontrol[i*RTPUDPV6TRANS_RECVCONTROLSIZE];
+				recvbatchmsgs[i].msg_hdr.msg_controllen = RTPUDPV6TRANS_RECVCONTROLSIZE;
 			}
-			return false;
 		}
+
+		// MSG_DONTWAIT 只作用于本次调用，不会改变套接字的阻塞模式
+		int num = recvmmsg(sock,&recvbatchmsgs[0],(unsigned int)count,MSG_DONTWAIT,0);
+		if (num <= 0) // EAGAIN 表示已读完，其他错误与逐个接收时一样忽略
+			break;
+
+		RTPTime curtime = GetPollTime();
+		for (int i = 0 ; i < num ; i++)
+		{
+			if (recvbatchmsgs[i].msg_len == 0) // 确保长度为零的数据包不会排队
+				continue;
+
+			int status = ProcessReceivedMessage(&recvbatchmsgs[i].msg_hdr,recvbatchmsgs[i].msg_len,curtime,rtp);
+			if (status < 0)
+				return status;
+		}
+
+		// 返回的数据报少于请求的数量时，套接字已被读空
+		if ((size_t)num < count)
+			moredata = false;
 	}
-	return true;
+	return 0;
+}
+#endif // RTP_HAVE_RECVMMSG
+
+int RTPUDPv6Transmitter::ProcessReceivedMessage(const struct msghdr *msg,size_t len,const RTPTime &receivetime,bool rtp)
+{
+	const uint8_t *data = (const uint8_t *)msg->msg_iov[0].iov_base;
+	const struct sockaddr_in6 &srcaddr = *((const struct sockaddr_in6 *)msg->msg_name);
+	bool parsecontrol = false;
+
+#if defined(RTP_HAVE_UDP_GRO) || defined(RTP_HAVE_SO_TIMESTAMPING)
+	if (recvcontrol)
+		parsecontrol = true;
+#endif // RTP_HAVE_UDP_GRO || RTP_HAVE_SO_TIMESTAMPING
+
+	RTPReceivedMessage message(msg,len,parsecontrol);
+	RTPTime packettime = message.GetTimestamp();
+
+	// 没有读取时钟（见 GetPollTime）而内核也没有提供时间戳时，在这里补上
+	if (packettime.IsZero())
+		packettime = receivetime;
+	if (packettime.IsZero())
+		packettime = RTPTime::CurrentTime();
+
+	// 接收缓冲区是连续的，每个数据报直接从中复制
+	size_t numsegments = message.GetNumSegments();
+	for (size_t i = 0 ; i < numsegments ; i++)
+	{
+		int status = QueueReceivedPacket(data+message.GetSegmentOffset(i),message.GetSegmentLength(i),srcaddr,packettime,rtp);
+		if (status < 0)
+			return status;
+	}
+	return 0;
+}
+
+int RTPUDPv6Transmitter::QueueReceivedPacket(const uint8_t *data, size_t len, const struct sockaddr_in6 &srcaddr,
+                                             const RTPTime &receivetime, bool rtp)
+{
+	bool acceptdata;
+
+	// 获取到数据，处理它
+	if (receivemode == RTPTransmitter::AcceptAll)
+		acceptdata = true;
+	else
+		acceptdata = ShouldAcceptData(srcaddr.sin6_addr,ntohs(srcaddr.sin6_port));
+	
+	if (!acceptdata)
+		return 0;
+
+	RTPRawPacket *pack;
+	RTPEndpoint *addr;
+	uint8_t *datacopy;
+
+	if (dualstack && IN6_IS_ADDR_V4MAPPED(&srcaddr.sin6_addr)) // 以 IPv4 端点报告 IPv4 对端
+	{
+		uint32_t ip;
+
+		memcpy(&ip,&srcaddr.sin6_addr.s6_addr[12],sizeof(uint32_t));
+		addr = new RTPEndpoint(ntohl(ip),ntohs(srcaddr.sin6_port));
+	}
+	else
+		addr = new RTPEndpoint(srcaddr.sin6_addr,ntohs(srcaddr.sin6_port));
+	if (addr == 0)
+		return MEDIA_RTP_ERR_RESOURCE_ERROR;
+	datacopy = new uint8_t[len];
+	if (datacopy == 0)
+	{
+		delete addr;
+		return MEDIA_RTP_ERR_RESOURCE_ERROR;
+	}
+	memcpy(datacopy,data,len);
+	
+	pack = new RTPRawPacket(datacopy,len,addr,receivetime,rtp);
+	if (pack == 0)
+	{
+		delete addr;
+		delete [] datacopy;
+		return MEDIA_RTP_ERR_RESOURCE_ERROR;
+	}
+	// 队列已满（数据包的处理跟不上接收）时丢弃数据包。PollSocket 在队列满时停止读取套接字，
+	// 所以只有同一个 GRO 数据报拆分出的分段会在这里被丢弃
+	if (!rawpacketqueue.Push(pack))
+		delete pack;
+	return 0;
 }
 
+int RTPUDPv6Transmitter::ProcessAddAcceptIgnoreEntry(in6_addr ip,uint16_t port)
+{
+	int status = acceptignoreinfo.Add(ip,port);
+	if (status < 0)
+		return status;
+	KernelFilterChanged();
+	return 0;
+}
+
+void RTPUDPv6Transmitter::ClearAcceptIgnoreInfo()
+{
+	acceptignoreinfo.Clear();
+}
+	
+int RTPUDPv6Transmitter::ProcessDeleteAcceptIgnoreEntry(in6_addr ip,uint16_t port)
+{
+	int status = acceptignoreinfo.Delete(ip,port);
+	if (status < 0)
+		return status;
+	KernelFilterChanged();
+	return 0;
+}
+
+bool RTPUDPv6Transmitter::ShouldAcceptData(in6_addr srcip,uint16_t srcport)
+{
+	// 集合中选择的地址和端口在 AcceptSome 模式下被接受，在 IgnoreSome 模式下被忽略
+	bool selected = acceptignoreinfo.IsSelected(srcip,srcport);
+
+	if (receivemode == RTPTransmitter::AcceptSome)
+		return selected;
+	return !selected;
+}
+
+void RTPUDPv6Transmitter::KernelFilterChanged()
+{
+#ifdef RTP_HAVE_SO_ATTACH_FILTER
+	if (!usekernelfilter)
+		return;
+
+	// 重新生成程序需要整个列表，每次增删都生成会使添加 N 个条目的代价为 O(N^2)。
+	// 这里只作标记，由下一次 Poll 在锁外生成一次；等待中的线程被唤醒，
+	// 新接受的来源因此不必等到等待超时才能通过内核中的程序
+	kernelfiltergeneration++;
+	if (!kernelfilterdirty)
+	{
+		kernelfilterdirty = true;
+		if (waitingfordata)
+			m_pAbortDesc->SendAbortSignal();
+	}
+#endif // RTP_HAVE_SO_ATTACH_FILTER
+}
+
+// 调用时不持有锁
+void RTPUDPv6Transmitter::FlushKernelFilter()
+{
+#ifdef RTP_HAVE_SO_ATTACH_FILTER
+	std::vector<RTPAcceptIgnoreSet<in6_addr>::Entry> entries;
+	RTPTransmitter::ReceiveMode mode;
+	uint32_t generation;
+
+	MAINMUTEX_LOCK
+	if (!created || !kernelfilterdirty)
+	{
+		MAINMUTEX_UNLOCK
+		return;
+	}
+	mode = receivemode;
+	generation = kernelfiltergeneration;
+	if (mode != RTPTransmitter::AcceptAll && !dualstack)
+		acceptignoreinfo.GetEntries(entries);
+	MAINMUTEX_UNLOCK
+
+	// 生成程序时不持有锁，接收和发送照常进行
+	RTPSocketFilter filter(AF_INET6);
+	CompileKernelFilter(filter,mode,entries);
+
+	MAINMUTEX_LOCK
+	// 生成期间列表又有变化时丢弃这个程序，标记仍然保留，下一次 Poll 使用新的列表
+	if (created && generation == kernelfiltergeneration)
+	{
+		AttachKernelFilter(filter);
+		kernelfilterdirty = false;
+	}
+	MAINMUTEX_UNLOCK
+#endif // RTP_HAVE_SO_ATTACH_FILTER
+}
+
+#ifdef RTP_HAVE_SO_ATTACH_FILTER
+void RTPUDPv6Transmitter::CompileKernelFilter(RTPSocketFilter &filter,RTPTransmitter::ReceiveMode mode,
+                                             const std::vector<RTPAcceptIgnoreSet<in6_addr>::Entry> &entries) const
+{
+	// 双栈套接字上 IPv4 数据报的网络层头部是 IPv4 头部，源地址的位置不同，
+	// 因此双栈模式下程序只检查数据报格式
+	bool filteraddresses = (mode != RTPTransmitter::AcceptAll && !dualstack);
+
+	filter.Clear();
+	if (filteraddresses)
+	{
+		for (size_t i = 0 ; i < entries.size() ; i++)
+			filter.AddEntry(entries[i].ip.s6_addr,entries[i].port,entries[i].all);
+	}
+	filter.Compile(filteraddresses && mode == RTPTransmitter::AcceptSome);
+}
+
+void RTPUDPv6Transmitter::AttachKernelFilter(const RTPSocketFilter &filter)
+{
+	kernelfiltercomplete = filter.IsComplete();
+
+	// 附加失败时删除原有的程序，以免它丢弃现在应该接受的数据报，列表仍然在用户空间检查
+	if (filter.Attach(rtpsock) < 0)
+	{
+		RTPSocketFilter::Detach(rtpsock);
+		kernelfiltercomplete = false;
+	}
+	if (rtcpsock != rtpsock && filter.Attach(rtcpsock) < 0)
+	{
+		RTPSocketFilter::Detach(rtcpsock);
+		kernelfiltercomplete = false;
+	}
+}
+#endif // RTP_HAVE_SO_ATTACH_FILTER
+
 int RTPUDPv6Transmitter::CreateLocalIPList()
 {
 	 // 首先尝试从网络接口信息中获取列表
@@ -1441,6 +2330,11 @@ bool RTPUDPv6Transmitter::GetLocalIPList_Interfaces()
 			struct sockaddr_in6 *inaddr = (struct sockaddr_in6 *)tmp->ifa_addr;
 			localIPs.push_back(inaddr->sin6_addr);
 		}
+		else if (dualstack && tmp->ifa_addr != 0 && tmp->ifa_addr->sa_family == AF_INET)
+		{
+			struct sockaddr_in *inaddr = (struct sockaddr_in *)tmp->ifa_addr;
+			localIPs.push_back(MapIPv4Address(ntohl(inaddr->sin_addr.s_addr)));
+		}
 		tmp = tmp->ifa_next;
 	}
 	
@@ -1472,7 +2366,7 @@ void RTPUDPv6Transmitter::GetLocalIPList_DNS()
 	struct addrinfo *res,*tmp;
 	
 	memset(&hints,0,sizeof(struct addrinfo));
-	hints.ai_family = AF_INET6;
+	hints.ai_family = (dualstack)?AF_UNSPEC:AF_INET6;
 	hints.ai_socktype = 0;
 	hints.ai_protocol = 0;
 
@@ -1487,6 +2381,11 @@ void RTPUDPv6Transmitter::GetLocalIPList_DNS()
 			struct sockaddr_in6 *addr = (struct sockaddr_in6 *)(tmp->ai_addr);
 			localIPs.push_back(addr->sin6_addr);
 		}
+		else if (tmp->ai_family == AF_INET)
+		{
+			struct sockaddr_in *addr = (struct sockaddr_in *)(tmp->ai_addr);
+			localIPs.push_back(MapIPv4Address(ntohl(addr->sin_addr.s_addr)));
+		}
 		tmp = tmp->ai_next;
 	}
 	
@@ -1506,6 +2405,20 @@ void RTPUDPv6Transmitter::AddLoopbackAddress()
 
 	if (!found)
 		localIPs.push_back(in6addr_loopback);
+
+	if (dualstack)
+	{
+		in6_addr loopback4 = MapIPv4Address(INADDR_LOOPBACK);
+
+		found = false;
+		for (it = localIPs.begin() ; !found && it != localIPs.end() ; it++)
+		{
+			if (memcmp(&(*it), &loopback4, sizeof(in6_addr)) == 0)
+				found = true;
+		}
+		if (!found)
+			localIPs.push_back(loopback4);
+	}
 }
 
 #endif // RTP_SUPPORT_IPV6
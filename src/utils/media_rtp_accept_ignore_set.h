@@ -0,0 +1,282 @@
+/**
+ * \file media_rtp_accept_ignore_set.h
+ */
+
+#ifndef MEDIA_RTP_ACCEPT_IGNORE_SET_H
+
+#define MEDIA_RTP_ACCEPT_IGNORE_SET_H
+
+#include "rtpconfig.h"
+#include "media_rtp_errors.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/**
+ * 传输器接受列表和忽略列表使用的 (IP地址, 端口) 集合。
+ *
+ * 所有条目保存在一个开放寻址（线性探测）的连续数组中，查询一个数据包的来源只需
+ * 两次探测，与条目数量无关，也不需要为每个条目单独分配内存。
+ *
+ * 每个出现在集合中的IP地址都有一个端口为零的条目，它记录该地址是否选择了所有端口；
+ * 其余端口号非零的条目在选择了所有端口时表示例外的端口，否则表示被选择的端口。
+ * 删除条目时使用后移删除，不留下墓碑，因此频繁增删不会使探测序列变长。
+ *
+ * 此类本身不是线程安全的，由传输器在其内部锁的保护下使用。
+ */
+template <class Address, class AddressHash = std::hash<Address> >
+class RTPAcceptIgnoreSet {
+public:
+  RTPAcceptIgnoreSet() : m_count(0), m_shift(64) {}
+
+  /** 添加一个条目，\c port 为零时选择该地址的所有端口。
+   *  已选择所有端口时，添加单个端口不起作用。 */
+  int Add(const Address &ip, uint16_t port);
+
+  /** 删除一个条目。\c port 为零时取消该地址的所有选择；已选择所有端口时，
+   *  删除单个端口会把它记为例外。该地址没有条目或端口不在集合中时返回错误。 */
+  int Delete(const Address &ip, uint16_t port);
+
+  /** 删除所有条目，但保留已分配的数组。 */
+  void Clear();
+
+  /** 返回 (\c ip, \c port) 是否被选择，即选择了所有端口且该端口不是例外，
+   *  或者该端口被单独选择。 */
+  bool IsSelected(const Address &ip, uint16_t port) const;
+
+  /** 返回条目数量，包括每个地址的端口为零的条目。 */
+  size_t GetSize() const { return m_count; }
+
+  /** 集合中的一个条目，\c all 只对端口为零的条目有意义。 */
+  struct Entry {
+    Address ip;
+    uint16_t port;
+    bool all;
+  };
+
+  /** 按任意顺序返回所有条目，供需要完整列表的代码（例如内核套接字过滤器）使用。 */
+  void GetEntries(std::vector<Entry> &entries) const;
+
+private:
+  struct Slot {
+    Address ip;
+    uint16_t port;
+    bool used;
+    bool all;        // 只对端口为零的条目有意义
+    size_t numports; // 端口为零的条目记录该地址有多少个端口条目
+  };
+
+  size_t GetHomeSlot(const Address &ip, uint16_t port) const;
+  size_t Find(const Address &ip, uint16_t port) const;
+  int Insert(const Address &ip, uint16_t port, bool all);
+  int InsertPort(const Address &ip, uint16_t port);
+  void EraseAt(size_t idx);
+  void ErasePorts(const Address &ip);
+  int Grow();
+
+  std::vector<Slot> m_slots; // 容量为零或2的幂
+  size_t m_count;
+  unsigned int m_shift; // 64 减去容量的以2为底的对数
+};
+
+#define RTPACCEPTIGNORESET_NOTFOUND ((size_t)-1)
+#define RTPACCEPTIGNORESET_MINCAPACITY 16
+
+template <class Address, class AddressHash>
+inline size_t RTPAcceptIgnoreSet<Address, AddressHash>::GetHomeSlot(const Address &ip, uint16_t port) const {
+  // 斐波那契散列：乘法把地址和端口的所有位混合到高位，再取高位作为槽位编号
+  uint64_t h = (uint64_t)AddressHash()(ip) ^ ((uint64_t)port << 48);
+  return (size_t)((h * 0x9E3779B97F4A7C15ULL) >> m_shift);
+}
+
+template <class Address, class AddressHash>
+inline size_t RTPAcceptIgnoreSet<Address, AddressHash>::Find(const Address &ip, uint16_t port) const {
+  if (m_count == 0)
+    return RTPACCEPTIGNORESET_NOTFOUND;
+
+  size_t mask = m_slots.size() - 1;
+  for (size_t i = GetHomeSlot(ip, port);; i = (i + 1) & mask) {
+    const Slot &slot = m_slots[i];
+    if (!slot.used)
+      return RTPACCEPTIGNORESET_NOTFOUND;
+    if (slot.port == port && slot.ip == ip)
+      return i;
+  }
+}
+
+template <class Address, class AddressHash>
+inline bool RTPAcceptIgnoreSet<Address, AddressHash>::IsSelected(const Address &ip, uint16_t port) const {
+  size_t idx = Find(ip, 0);
+  if (idx == RTPACCEPTIGNORESET_NOTFOUND)
+    return false;
+
+  bool listed = (port != 0 && Find(ip, port) != RTPACCEPTIGNORESET_NOTFOUND);
+  return (m_slots[idx].all) ? !listed : listed;
+}
+
+template <class Address, class AddressHash>
+int RTPAcceptIgnoreSet<Address, AddressHash>::Add(const Address &ip, uint16_t port) {
+  size_t idx = Find(ip, 0);
+  if (idx == RTPACCEPTIGNORESET_NOTFOUND) { // 需要为此地址创建条目
+    int status = Insert(ip, 0, (port == 0));
+    if (status < 0 || port == 0)
+      return status;
+    return InsertPort(ip, port);
+  }
+
+  if (port == 0) { // 选择所有端口，之前的端口条目不再需要
+    m_slots[idx].all = true;
+    ErasePorts(ip);
+    return 0;
+  }
+  if (m_slots[idx].all || Find(ip, port) != RTPACCEPTIGNORESET_NOTFOUND)
+    return 0;
+  return InsertPort(ip, port);
+}
+
+template <class Address, class AddressHash>
+int RTPAcceptIgnoreSet<Address, AddressHash>::Delete(const Address &ip, uint16_t port) {
+  size_t idx = Find(ip, 0);
+  if (idx == RTPACCEPTIGNORESET_NOTFOUND)
+    return MEDIA_RTP_ERR_OPERATION_FAILED;
+
+  if (port == 0) { // 删除所有选择，保留地址条目本身
+    m_slots[idx].all = false;
+    ErasePorts(ip);
+    return 0;
+  }
+
+  size_t portidx = Find(ip, port);
+  if (m_slots[idx].all) { // 把要删除的端口记为例外
+    if (portidx != RTPACCEPTIGNORESET_NOTFOUND)
+      return MEDIA_RTP_ERR_OPERATION_FAILED;
+    return InsertPort(ip, port);
+  }
+  if (portidx == RTPACCEPTIGNORESET_NOTFOUND)
+    return MEDIA_RTP_ERR_OPERATION_FAILED;
+  m_slots[idx].numports--; // 后移删除之前，idx 仍然有效
+  EraseAt(portidx);
+  return 0;
+}
+
+template <class Address, class AddressHash>
+void RTPAcceptIgnoreSet<Address, AddressHash>::Clear() {
+  for (size_t i = 0; i < m_slots.size(); i++)
+    m_slots[i].used = false;
+  m_count = 0;
+}
+
+template <class Address, class AddressHash>
+void RTPAcceptIgnoreSet<Address, AddressHash>::GetEntries(std::vector<Entry> &entries) const {
+  entries.clear();
+  for (size_t i = 0; i < m_slots.size(); i++) {
+    if (!m_slots[i].used)
+      continue;
+
+    Entry e = {m_slots[i].ip, m_slots[i].port, m_slots[i].all};
+    entries.push_back(e);
+  }
+}
+
+template <class Address, class AddressHash>
+int RTPAcceptIgnoreSet<Address, AddressHash>::Insert(const Address &ip, uint16_t port, bool all) {
+  // 负载因子保持在一半以下，线性探测的平均探测长度因此很短
+  if ((m_count + 1) * 2 > m_slots.size()) {
+    int status = Grow();
+    if (status < 0)
+      return status;
+  }
+
+  size_t mask = m_slots.size() - 1;
+  size_t i = GetHomeSlot(ip, port);
+  while (m_slots[i].used)
+    i = (i + 1) & mask;
+
+  m_slots[i].ip = ip;
+  m_slots[i].port = port;
+  m_slots[i].all = all;
+  m_slots[i].numports = 0;
+  m_slots[i].used = true;
+  m_count++;
+  return 0;
+}
+
+template <class Address, class AddressHash>
+int RTPAcceptIgnoreSet<Address, AddressHash>::InsertPort(const Address &ip, uint16_t port) {
+  int status = Insert(ip, port, false);
+  if (status < 0)
+    return status;
+
+  // 插入可能扩容，地址条目的位置要重新查找
+  m_slots[Find(ip, 0)].numports++;
+  return 0;
+}
+
+template <class Address, class AddressHash>
+void RTPAcceptIgnoreSet<Address, AddressHash>::EraseAt(size_t idx) {
+  size_t mask = m_slots.size() - 1;
+  size_t hole = idx;
+
+  // 把探测序列中位于空洞之后、且本应位于空洞或更前位置的条目前移
+  for (size_t j = (hole + 1) & mask; m_slots[j].used; j = (j + 1) & mask) {
+    size_t home = GetHomeSlot(m_slots[j].ip, m_slots[j].port);
+    bool inrange = (hole <= j) ? (hole < home && home <= j) : (hole < home || home <= j);
+    if (inrange)
+      continue;
+    m_slots[hole] = m_slots[j];
+    hole = j;
+  }
+  m_slots[hole].used = false;
+  m_count--;
+}
+
+template <class Address, class AddressHash>
+void RTPAcceptIgnoreSet<Address, AddressHash>::ErasePorts(const Address &ip) {
+  size_t idx = Find(ip, 0);
+  size_t numports = m_slots[idx].numports;
+
+  // 地址没有端口条目（例如为新地址选择所有端口）时不需要扫描数组
+  if (numports == 0)
+    return;
+
+  // 后移删除会移动条目，所以先收集端口，再逐个查找删除；找齐之后停止扫描
+  std::vector<uint16_t> ports;
+  for (size_t i = 0; i < m_slots.size() && ports.size() < numports; i++) {
+    if (m_slots[i].used && m_slots[i].port != 0 && m_slots[i].ip == ip)
+      ports.push_back(m_slots[i].port);
+  }
+  for (size_t i = 0; i < ports.size(); i++)
+    EraseAt(Find(ip, ports[i]));
+  m_slots[Find(ip, 0)].numports = 0;
+}
+
+template <class Address, class AddressHash>
+int RTPAcceptIgnoreSet<Address, AddressHash>::Grow() {
+  size_t newcapacity = (m_slots.empty()) ? RTPACCEPTIGNORESET_MINCAPACITY : m_slots.size() * 2;
+  std::vector<Slot> oldslots(newcapacity);
+
+  for (size_t i = 0; i < newcapacity; i++)
+    oldslots[i].used = false;
+  oldslots.swap(m_slots);
+
+  unsigned int bits = 0;
+  while (((size_t)1 << bits) < newcapacity)
+    bits++;
+  m_shift = 64 - bits;
+
+  // 在新数组中重新放置所有条目，不需要比较，直接找空槽位
+  size_t mask = newcapacity - 1;
+  for (size_t i = 0; i < oldslots.size(); i++) {
+    if (!oldslots[i].used)
+      continue;
+
+    size_t j = GetHomeSlot(oldslots[i].ip, oldslots[i].port);
+    while (m_slots[j].used)
+      j = (j + 1) & mask;
+    m_slots[j] = oldslots[i];
+  }
+  return 0;
+}
+
+#endif // MEDIA_RTP_ACCEPT_IGNORE_SET_H
@@ -0,0 +1,117 @@
+#include "media_rtp_buffer_pool.h"
+
+// 缓冲区之前的头部，大小按最大对齐要求填充，使缓冲区本身可以存放任意对象
+union RTPBufferPoolHeader
+{
+	RTPBufferPool *pool;
+	std::max_align_t align;
+};
+
+RTPBufferPool *RTPBufferPool::Create(size_t buffersize, size_t maxidle)
+{
+	return new RTPBufferPool(buffersize, maxidle);
+}
+
+RTPBufferPool::RTPBufferPool(size_t buffersize, size_t maxidle)
+{
+	m_bufferSize = buffersize;
+	m_maxIdle = maxidle;
+	m_refCount = 1;
+	m_destroyed = false;
+
+	// 预留空闲列表的空间，归还缓冲区时不再分配内存
+	m_idleBlocks.reserve(maxidle);
+}
+
+RTPBufferPool::~RTPBufferPool()
+{
+	for (size_t i = 0 ; i < m_idleBlocks.size() ; i++)
+		delete [] m_idleBlocks[i];
+}
+
+void RTPBufferPool::Destroy()
+{
+	bool deletepool = false;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		for (size_t i = 0 ; i < m_idleBlocks.size() ; i++)
+			delete [] m_idleBlocks[i];
+		m_idleBlocks.clear();
+		m_destroyed = true;
+		m_refCount--;
+		deletepool = (m_refCount == 0);
+	}
+	if (deletepool)
+		delete this;
+}
+
+uint8_t *RTPBufferPool::Allocate()
+{
+	uint8_t *block = 0;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (!m_idleBlocks.empty())
+		{
+			block = m_idleBlocks.back();
+			m_idleBlocks.pop_back();
+		}
+		m_refCount++;
+	}
+
+	if (block == 0)
+	{
+		block = new uint8_t[sizeof(RTPBufferPoolHeader)+m_bufferSize];
+		if (block == 0)
+		{
+			ReleaseBlock(0);
+			return 0;
+		}
+		((RTPBufferPoolHeader *)block)->pool = this;
+	}
+	return block+sizeof(RTPBufferPoolHeader);
+}
+
+uint8_t *RTPBufferPool::AllocateUnpooled(size_t size)
+{
+	uint8_t *block = new uint8_t[sizeof(RTPBufferPoolHeader)+size];
+	if (block == 0)
+		return 0;
+	((RTPBufferPoolHeader *)block)->pool = 0;
+	return block+sizeof(RTPBufferPoolHeader);
+}
+
+void RTPBufferPool::Release(void *buffer)
+{
+	if (buffer == 0)
+		return;
+
+	uint8_t *block = ((uint8_t *)buffer)-sizeof(RTPBufferPoolHeader);
+	RTPBufferPool *pool = ((RTPBufferPoolHeader *)block)->pool;
+
+	if (pool == 0)
+		delete [] block;
+	else
+		pool->ReleaseBlock(block);
+}
+
+void RTPBufferPool::ReleaseBlock(uint8_t *block)
+{
+	bool deletepool = false;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (block != 0 && !m_destroyed && m_idleBlocks.size() < m_maxIdle)
+		{
+			m_idleBlocks.push_back(block);
+			block = 0;
+		}
+		m_refCount--;
+		deletepool = (m_refCount == 0);
+	}
+	if (block != 0)
+		delete [] block;
+	if (deletepool)
+		delete this;
+}
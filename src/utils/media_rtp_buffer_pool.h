@@ -0,0 +1,62 @@
+/**
+ * \file media_rtp_buffer_pool.h
+ */
+
+#ifndef MEDIA_RTP_BUFFER_POOL_H
+
+#define MEDIA_RTP_BUFFER_POOL_H
+
+#include "rtpconfig.h"
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/**
+ * 固定大小缓冲区的池，供传输器的接收路径使用。
+ *
+ * 传输器直接把数据报接收到从池中取出的缓冲区里，缓冲区随 RTPRawPacket 交给
+ * RTPPacket 或 RTCPCompoundPacket，最终在这些对象销毁时通过 Release 归还到池中，
+ * 稳定状态下接收路径不需要任何内存分配。
+ *
+ * 每个缓冲区前面有一个记录所属缓冲池的小头部，因此 Release 是静态函数，
+ * 可以在任意线程中调用。缓冲池带有引用计数：创建者调用 Destroy 之后，
+ * 仍在使用中的缓冲区可以继续使用，最后一个缓冲区归还时缓冲池才会被删除。
+ */
+class RTPBufferPool {
+  MEDIA_RTP_NO_COPY(RTPBufferPool)
+public:
+  /** 创建缓冲区大小为 \c buffersize 的缓冲池，最多保留 \c maxidle 个空闲缓冲区，
+   *  超出的缓冲区在归还时直接释放。 */
+  static RTPBufferPool *Create(size_t buffersize, size_t maxidle);
+
+  /** 放弃创建者对缓冲池的引用，空闲缓冲区会被立即释放。 */
+  void Destroy();
+
+  /** 返回池中每个缓冲区的大小。 */
+  size_t GetBufferSize() const { return m_bufferSize; }
+
+  /** 从池中取出一个缓冲区，池为空时分配一个新的缓冲区；失败时返回零。 */
+  uint8_t *Allocate();
+
+  /** 分配一个大小为 \c size、不属于任何缓冲池的缓冲区，同样用 Release 释放。 */
+  static uint8_t *AllocateUnpooled(size_t size);
+
+  /** 释放由 Allocate 或 AllocateUnpooled 返回的缓冲区。 */
+  static void Release(void *buffer);
+
+private:
+  RTPBufferPool(size_t buffersize, size_t maxidle);
+  ~RTPBufferPool();
+
+  void ReleaseBlock(uint8_t *block);
+
+  std::mutex m_mutex;
+  std::vector<uint8_t *> m_idleBlocks;
+  size_t m_bufferSize;
+  size_t m_maxIdle;
+  size_t m_refCount; // 创建者的引用加上所有未归还的缓冲区
+  bool m_destroyed;
+};
+
+#endif // MEDIA_RTP_BUFFER_POOL_H
@@ -0,0 +1,87 @@
+#include "media_rtp_received_message.h"
+#include <string.h>
+#include <time.h>
+#ifdef RTP_HAVE_UDP_GRO
+	#include <netinet/udp.h>
+#endif // RTP_HAVE_UDP_GRO
+
+RTPReceivedMessage::RTPReceivedMessage(const struct msghdr *msg, size_t len, bool parsecontrol) : m_timestamp(0, 0)
+{
+	m_msg = msg;
+	m_length = len;
+	m_segmentSize = len;
+
+	if (!parsecontrol)
+		return;
+
+#if defined(RTP_HAVE_UDP_GRO) || defined(RTP_HAVE_SO_TIMESTAMPING)
+	struct msghdr *hdr = const_cast<struct msghdr *>(msg);
+
+	for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(hdr) ; cmsg != 0 ; cmsg = CMSG_NXTHDR(hdr,cmsg))
+	{
+#ifdef RTP_HAVE_UDP_GRO
+		if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+		{
+			int gsosize = 0;
+
+			// 分段大小不小于缓冲区时只有一个数据报
+			memcpy(&gsosize,CMSG_DATA(cmsg),sizeof(int));
+			if (gsosize > 0 && (size_t)gsosize < len)
+				m_segmentSize = (size_t)gsosize;
+		}
+#endif // RTP_HAVE_UDP_GRO
+#ifdef RTP_HAVE_SO_TIMESTAMPING
+		if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS)
+		{
+			struct timespec ts;
+
+			memcpy(&ts,CMSG_DATA(cmsg),sizeof(struct timespec));
+			m_timestamp = RTPTime((int64_t)ts.tv_sec,(uint32_t)(ts.tv_nsec/1000));
+		}
+#endif // RTP_HAVE_SO_TIMESTAMPING
+	}
+#endif // RTP_HAVE_UDP_GRO || RTP_HAVE_SO_TIMESTAMPING
+}
+
+size_t RTPReceivedMessage::GetNumSegments() const
+{
+	if (m_length == 0)
+		return 1;
+	return (m_length+m_segmentSize-1)/m_segmentSize;
+}
+
+size_t RTPReceivedMessage::GetSegmentLength(size_t idx) const
+{
+	size_t offset = GetSegmentOffset(idx);
+
+	if (offset >= m_length)
+		return 0;
+	if (m_length-offset < m_segmentSize)
+		return m_length-offset;
+	return m_segmentSize;
+}
+
+void RTPReceivedMessage::CopySegment(size_t idx, uint8_t *dest) const
+{
+	size_t len = GetSegmentLength(idx);
+	size_t skip = GetSegmentOffset(idx);
+	size_t copied = 0;
+
+	for (size_t i = 0 ; i < (size_t)m_msg->msg_iovlen && copied < len ; i++)
+	{
+		const struct iovec &iov = m_msg->msg_iov[i];
+
+		if (skip >= iov.iov_len)
+		{
+			skip -= iov.iov_len;
+			continue;
+		}
+
+		size_t num = iov.iov_len-skip;
+		if (num > len-copied)
+			num = len-copied;
+		memcpy(dest+copied,((const uint8_t *)iov.iov_base)+skip,num);
+		copied += num;
+		skip = 0;
+	}
+}
@@ -0,0 +1,57 @@
+/**
+ * \file media_rtp_received_message.h
+ */
+
+#ifndef MEDIA_RTP_RECEIVED_MESSAGE_H
+
+#define MEDIA_RTP_RECEIVED_MESSAGE_H
+
+#include "rtpconfig.h"
+#include "media_rtp_utils.h"
+#include <sys/socket.h>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * UDP 传输器用 recvmsg 或 recvmmsg 接收到的一个消息。
+ *
+ * 构造时读取控制消息：启用 UDP GRO 后，内核可能把来自同一来源的多个数据报合并到
+ * 一个缓冲区中，控制消息给出的分段大小就是原始数据报的长度，最后一个数据报可能更短；
+ * 启用接收时间戳后还会有内核记录的到达时间，合并的数据报共用第一个数据报的时间。
+ * 之后可以按原始数据报逐个取出分段，数据可以跨越消息的多个 iovec。
+ */
+class RTPReceivedMessage {
+public:
+  /** \c msg 是接收时填写的消息头，\c len 是接收到的字节数。\c parsecontrol 为
+   *  \c false 时不读取控制消息，整个缓冲区是一个数据报。 */
+  RTPReceivedMessage(const struct msghdr *msg, size_t len, bool parsecontrol);
+
+  /** 返回接收到的字节数。 */
+  size_t GetLength() const { return m_length; }
+
+  /** 返回分段的大小，即除最后一个以外每个数据报的长度。 */
+  size_t GetSegmentSize() const { return m_segmentSize; }
+
+  /** 返回数据报的数量；空的数据报也算作一个长度为零的分段。 */
+  size_t GetNumSegments() const;
+
+  /** 返回第 \c idx 个数据报在缓冲区中的偏移。 */
+  size_t GetSegmentOffset(size_t idx) const { return idx * m_segmentSize; }
+
+  /** 返回第 \c idx 个数据报的长度。 */
+  size_t GetSegmentLength(size_t idx) const;
+
+  /** 把第 \c idx 个数据报复制到 \c dest，\c dest 至少有 GetSegmentLength 字节。 */
+  void CopySegment(size_t idx, uint8_t *dest) const;
+
+  /** 返回内核记录的接收时间，没有时为零。 */
+  const RTPTime &GetTimestamp() const { return m_timestamp; }
+
+private:
+  const struct msghdr *m_msg;
+  size_t m_length;
+  size_t m_segmentSize;
+  RTPTime m_timestamp;
+};
+
+#endif // MEDIA_RTP_RECEIVED_MESSAGE_H
@@ -0,0 +1,241 @@
+#include "media_rtp_socket_filter.h"
+
+#ifdef RTP_HAVE_SO_ATTACH_FILTER
+
+#include "media_rtp_errors.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <errno.h>
+
+#define RTPSOCKETFILTER_UDPHEADERSIZE					8
+// RTCP 复合包至少包含一个 RR，RTP 数据包至少有12字节的头部
+#define RTPSOCKETFILTER_MINPAYLOADSIZE					8
+#define RTPSOCKETFILTER_ACCEPT							0xFFFFFFFF
+#define RTPSOCKETFILTER_DROP							0
+// 条件跳转的偏移只有8位
+#define RTPSOCKETFILTER_MAXJUMP							255
+
+RTPSocketFilter::RTPSocketFilter(int family)
+{
+	m_complete = true;
+	if (family == AF_INET6)
+	{
+		m_addrOffset = 8;
+		m_addrLength = 16;
+	}
+	else
+	{
+		m_addrOffset = 12;
+		m_addrLength = 4;
+	}
+}
+
+void RTPSocketFilter::Clear()
+{
+	m_addresses.clear();
+}
+
+void RTPSocketFilter::AddEntry(const uint8_t *addr, uint16_t port, bool allports)
+{
+	AddressInfo &info = m_addresses[std::vector<uint8_t>(addr,addr+m_addrLength)];
+
+	if (port == 0)
+	{
+		info.present = true;
+		info.all = allports;
+	}
+	else
+		info.ports.push_back(port);
+}
+
+void RTPSocketFilter::Compile(bool acceptlisted)
+{
+	m_program.clear();
+	m_complete = true;
+
+	// 载荷太短，或者第一个字节的版本字段不是2（RTP 和 RTCP 都是如此）时丢弃
+	struct sock_filter header[] = {
+		BPF_STMT(BPF_LD|BPF_W|BPF_LEN, 0),
+		BPF_JUMP(BPF_JMP|BPF_JGE|BPF_K, RTPSOCKETFILTER_UDPHEADERSIZE+RTPSOCKETFILTER_MINPAYLOADSIZE, 1, 0),
+		BPF_STMT(BPF_RET|BPF_K, RTPSOCKETFILTER_DROP),
+		BPF_STMT(BPF_LD|BPF_B|BPF_ABS, RTPSOCKETFILTER_UDPHEADERSIZE),
+		BPF_STMT(BPF_ALU|BPF_AND|BPF_K, 0xC0),
+		BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, 0x80, 1, 0),
+		BPF_STMT(BPF_RET|BPF_K, RTPSOCKETFILTER_DROP),
+	};
+	m_program.insert(m_program.end(),header,header+sizeof(header)/sizeof(struct sock_filter));
+	size_t headerlength = m_program.size();
+
+	if (m_addrLength == 4)
+		AppendIPv4Addresses(acceptlisted);
+	else
+	{
+		std::map<std::vector<uint8_t>, AddressInfo>::const_iterator it;
+		for (it = m_addresses.begin() ; it != m_addresses.end() ; ++it)
+			AppendAddressBlock(it->first,it->second,acceptlisted,true);
+	}
+
+	// 没有匹配任何地址的数据报没有被选择
+	uint32_t defaultverdict = (acceptlisted)?RTPSOCKETFILTER_DROP:RTPSOCKETFILTER_ACCEPT;
+	if (m_program.size() + 1 > BPF_MAXINSNS)
+	{
+		// 列表太长，只检查格式，地址和端口留给用户空间
+		m_program.resize(headerlength);
+		defaultverdict = RTPSOCKETFILTER_ACCEPT;
+		m_complete = false;
+	}
+	struct sock_filter ret = BPF_STMT(BPF_RET|BPF_K, defaultverdict);
+	m_program.push_back(ret);
+}
+
+void RTPSocketFilter::AppendIPv4Addresses(bool acceptlisted)
+{
+	if (m_addresses.empty())
+		return;
+
+	// IPv4 地址只有一个字，载入一次后一直留在累加器中：只有端口块会载入端口，
+	// 而端口块总是以返回指令结束
+	struct sock_filter load = BPF_STMT(BPF_LD|BPF_W|BPF_ABS, (uint32_t)(SKF_NET_OFF + (int)m_addrOffset));
+	m_program.push_back(load);
+
+	// 选择了所有端口、没有例外的地址最常见，每个只用一条比较指令，匹配时跳到这一组
+	// 末尾共用的返回指令；一组的长度受8位跳转偏移的限制
+	uint32_t selected = (acceptlisted)?RTPSOCKETFILTER_ACCEPT:RTPSOCKETFILTER_DROP;
+	std::vector<uint32_t> group;
+	std::map<std::vector<uint8_t>, AddressInfo>::const_iterator it;
+
+	for (it = m_addresses.begin() ; it != m_addresses.end() ; ++it)
+	{
+		if (!it->second.present || !it->second.all || !it->second.ports.empty())
+			continue;
+
+		const std::vector<uint8_t> &addr = it->first;
+		group.push_back(((uint32_t)addr[0] << 24)|((uint32_t)addr[1] << 16)|((uint32_t)addr[2] << 8)|(uint32_t)addr[3]);
+		if (group.size() == RTPSOCKETFILTER_MAXJUMP)
+			AppendIPv4Group(group,selected);
+	}
+	if (!group.empty())
+		AppendIPv4Group(group,selected);
+
+	for (it = m_addresses.begin() ; it != m_addresses.end() ; ++it)
+	{
+		if (!(it->second.all && it->second.ports.empty()))
+			AppendAddressBlock(it->first,it->second,acceptlisted,false);
+	}
+}
+
+void RTPSocketFilter::AppendIPv4Group(std::vector<uint32_t> &group, uint32_t selected)
+{
+	size_t num = group.size();
+
+	// 比较指令之后是跳过返回指令的无条件跳转，然后是返回指令
+	for (size_t i = 0 ; i < num ; i++)
+	{
+		struct sock_filter cmp = BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, group[i], (uint8_t)(num - i), 0);
+		m_program.push_back(cmp);
+	}
+
+	struct sock_filter skip = BPF_JUMP(BPF_JMP|BPF_JA, 1, 0, 0);
+	struct sock_filter ret = BPF_STMT(BPF_RET|BPF_K, selected);
+	m_program.push_back(skip);
+	m_program.push_back(ret);
+	group.clear();
+}
+
+void RTPSocketFilter::AppendAddressBlock(const std::vector<uint8_t> &addr, const AddressInfo &info, bool acceptlisted,
+                                         bool loadaddress)
+{
+	if (!info.present)
+		return;
+
+	// 每个地址一个程序块：先逐字比较源地址，不匹配时跳到下一个块；匹配时载入源端口，
+	// 与端口条目逐个比较。块的结尾各自带有返回指令，跳转偏移因此不会超过块的长度。
+	// \c loadaddress 为 false 时源地址已经在累加器中
+	uint32_t selected = (acceptlisted)?RTPSOCKETFILTER_ACCEPT:RTPSOCKETFILTER_DROP;
+	uint32_t unselected = (acceptlisted)?RTPSOCKETFILTER_DROP:RTPSOCKETFILTER_ACCEPT;
+	size_t numwords = m_addrLength/4;
+	size_t wordlength = (loadaddress)?2:1; // 每个字的指令数
+	size_t numports = info.ports.size();
+	size_t blocklength;
+
+	if (!info.all && numports == 0) // 什么都没有选择，与不匹配的地址相同
+		return;
+
+	if (numports == 0)
+		blocklength = numwords*wordlength + 1;
+	else
+		blocklength = numwords*wordlength + 1 + numports + 2;
+
+	bool passtouser = false;
+	if (blocklength - wordlength > RTPSOCKETFILTER_MAXJUMP)
+	{
+		// 端口太多，无法用8位的跳转偏移表示，此地址的数据报全部交给用户空间判断
+		passtouser = true;
+		blocklength = numwords*wordlength + 1;
+	}
+
+	for (size_t i = 0 ; i < numwords ; i++)
+	{
+		uint32_t word = ((uint32_t)addr[i*4] << 24)|((uint32_t)addr[i*4+1] << 16)|((uint32_t)addr[i*4+2] << 8)|(uint32_t)addr[i*4+3];
+		struct sock_filter load = BPF_STMT(BPF_LD|BPF_W|BPF_ABS, (uint32_t)(SKF_NET_OFF + (int)(m_addrOffset + i*4)));
+		struct sock_filter cmp = BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, word, 0, (uint8_t)(blocklength - (i + 1)*wordlength));
+
+		if (loadaddress)
+			m_program.push_back(load);
+		m_program.push_back(cmp);
+	}
+
+	if (passtouser)
+	{
+		struct sock_filter ret = BPF_STMT(BPF_RET|BPF_K, RTPSOCKETFILTER_ACCEPT);
+		m_program.push_back(ret);
+		return;
+	}
+
+	if (numports == 0) // 选择了所有端口，没有例外
+	{
+		struct sock_filter ret = BPF_STMT(BPF_RET|BPF_K, selected);
+		m_program.push_back(ret);
+		return;
+	}
+
+	// 端口在列表中时的结果：选择了所有端口时列表中是例外端口，否则是被选择的端口
+	uint32_t inlist = (info.all)?unselected:selected;
+	uint32_t notinlist = (info.all)?selected:unselected;
+	struct sock_filter loadport = BPF_STMT(BPF_LD|BPF_H|BPF_ABS, 0);
+
+	m_program.push_back(loadport);
+	for (size_t i = 0 ; i < numports ; i++)
+	{
+		struct sock_filter cmp = BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, info.ports[i], (uint8_t)(numports - i), 0);
+		m_program.push_back(cmp);
+	}
+
+	struct sock_filter retnotinlist = BPF_STMT(BPF_RET|BPF_K, notinlist);
+	struct sock_filter retinlist = BPF_STMT(BPF_RET|BPF_K, inlist);
+	m_program.push_back(retnotinlist);
+	m_program.push_back(retinlist);
+}
+
+int RTPSocketFilter::Attach(int sock) const
+{
+	if (m_program.empty())
+		return MEDIA_RTP_ERR_INVALID_STATE;
+
+	struct sock_fprog prog;
+
+	prog.len = (unsigned short)m_program.size();
+	prog.filter = const_cast<struct sock_filter *>(&m_program[0]);
+	if (setsockopt(sock,SOL_SOCKET,SO_ATTACH_FILTER,(const char *)&prog,sizeof(struct sock_fprog)) != 0)
+		return MEDIA_RTP_ERR_OPERATION_FAILED;
+	return 0;
+}
+
+int RTPSocketFilter::Detach(int sock)
+{
+	if (setsockopt(sock,SOL_SOCKET,SO_DETACH_FILTER,0,0) != 0 && errno != ENOENT)
+		return MEDIA_RTP_ERR_OPERATION_FAILED;
+	return 0;
+}
+
+#endif // RTP_HAVE_SO_ATTACH_FILTER
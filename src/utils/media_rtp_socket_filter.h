@@ -0,0 +1,81 @@
+/**
+ * \file media_rtp_socket_filter.h
+ */
+
+#ifndef MEDIA_RTP_SOCKET_FILTER_H
+
+#define MEDIA_RTP_SOCKET_FILTER_H
+
+#include "rtpconfig.h"
+
+#ifdef RTP_HAVE_SO_ATTACH_FILTER
+
+#include <linux/filter.h>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+/**
+ * 附加到 UDP 接收套接字上的经典 BPF 过滤程序（SO_ATTACH_FILTER）。
+ *
+ * 程序在内核中丢弃载荷太短或版本字段不为2的数据报，以及被接受列表或忽略列表排除的
+ * 数据报，这些数据报因此不会被复制到用户空间。程序只是预先过滤：传输器仍然在用户空间
+ * 检查接受列表和忽略列表；列表太长、无法表示为一个程序时，程序只检查数据报的格式，
+ * 地址和端口全部留给用户空间判断，IsComplete 因此返回 false。
+ * IPv4 中选择了所有端口、没有例外端口的地址每个只占一条指令，这样的地址可以有约四千个。
+ *
+ * UDP 套接字的过滤程序从 UDP 头部开始读取数据，源地址通过网络层头部读取。
+ */
+class RTPSocketFilter {
+  MEDIA_RTP_NO_COPY(RTPSocketFilter)
+public:
+  /** 创建用于 \c family（AF_INET 或 AF_INET6）套接字的过滤程序。 */
+  RTPSocketFilter(int family);
+
+  /** 删除所有条目。 */
+  void Clear();
+
+  /** 添加一个接受或忽略列表条目，\c addr 是网络字节序的地址。端口为零的条目代表地址
+   *  本身，\c allports 表示是否选择了该地址的所有端口；其他条目是单独选择的端口，
+   *  或者在选择了所有端口时的例外端口。 */
+  void AddEntry(const uint8_t *addr, uint16_t port, bool allports);
+
+  /** 根据已添加的条目生成程序。\c acceptlisted 为 true 时只接受被选择的数据报
+   *  （AcceptSome），否则丢弃被选择的数据报（IgnoreSome，没有条目时相当于 AcceptAll）。 */
+  void Compile(bool acceptlisted);
+
+  /** 返回最近生成的程序是否包含了所有条目。程序超过内核的长度限制（BPF_MAXINSNS）时
+   *  返回 false，此时程序只检查数据报格式。 */
+  bool IsComplete() const { return m_complete; }
+
+  /** 把最近生成的程序附加到套接字上，替换套接字上原有的程序。 */
+  int Attach(int sock) const;
+
+  /** 删除套接字上附加的程序，套接字没有程序时也返回成功。 */
+  static int Detach(int sock);
+
+private:
+  class AddressInfo {
+  public:
+    AddressInfo() : all(false), present(false) {}
+
+    bool all;
+    bool present; // 是否添加了端口为零的条目
+    std::vector<uint16_t> ports;
+  };
+
+  void AppendIPv4Addresses(bool acceptlisted);
+  void AppendIPv4Group(std::vector<uint32_t> &group, uint32_t selected);
+  void AppendAddressBlock(const std::vector<uint8_t> &addr, const AddressInfo &info, bool acceptlisted,
+                          bool loadaddress);
+
+  size_t m_addrOffset, m_addrLength; // 源地址在网络层头部中的偏移和长度
+  std::map<std::vector<uint8_t>, AddressInfo> m_addresses;
+  std::vector<struct sock_filter> m_program;
+  bool m_complete;
+};
+
+#endif // RTP_HAVE_SO_ATTACH_FILTER
+
+#endif // MEDIA_RTP_SOCKET_FILTER_H
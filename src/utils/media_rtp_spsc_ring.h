@@ -0,0 +1,188 @@
+/**
+ * \file media_rtp_spsc_ring.h
+ */
+
+#ifndef MEDIA_RTP_SPSC_RING_H
+
+#define MEDIA_RTP_SPSC_RING_H
+
+#include "rtpconfig.h"
+#include "media_rtp_errors.h"
+#include <assert.h>
+#include <atomic>
+#include <cstddef>
+
+#define RTPSPSCRING_CACHELINESIZE 64
+
+/**
+ * 有界的无锁单生产者单消费者环形队列，传输器用它把接收到的数据包交给处理线程。
+ *
+ * 生产者（轮询套接字的线程）和消费者（处理数据包的线程）各自只写自己的索引，
+ * 两个索引位于不同的缓存行中，并各自缓存了对方索引的最近值，因此 Push 和 Pop
+ * 通常不会访问对方写入的缓存行，也从不阻塞。多个生产者或多个消费者需要由调用者
+ * 在各自一侧串行化（例如传输器在主锁内调用 Push）。没有定义 NDEBUG 时，同一侧
+ * 被两个线程同时进入会触发断言。
+ *
+ * 元素类型应该是指针之类可以廉价复制的类型。
+ */
+template <class T>
+class RTPSPSCRing {
+  MEDIA_RTP_NO_COPY(RTPSPSCRing)
+public:
+  RTPSPSCRing() : m_head(0), m_cachedTail(0), m_tail(0), m_cachedHead(0), m_slots(0), m_mask(0) {
+#ifndef NDEBUG
+    m_producers = 0;
+    m_consumers = 0;
+#endif // NDEBUG
+  }
+  ~RTPSPSCRing() { delete[] m_slots; }
+
+  /** 分配至少能容纳 \c capacity 个元素的存储空间（容量向上取整为2的幂）。
+   *  队列必须为空，调用时不能有其他线程访问队列。 */
+  int Init(size_t capacity);
+
+  /** 释放存储空间，之后 Push 总是失败。调用前应先取出所有元素。 */
+  void Destroy();
+
+  /** 返回队列的容量。 */
+  size_t GetCapacity() const { return (m_slots == 0) ? 0 : m_mask + 1; }
+
+  /** 由生产者调用：在队尾加入一个元素，队列已满时返回 false。 */
+  bool Push(const T &value);
+
+  /** 由生产者调用：返回队列是否已满。 */
+  bool IsFull() { return GetFreeSpace() == 0; }
+
+  /** 由生产者调用：返回至少还能加入多少个元素。 */
+  size_t GetFreeSpace();
+
+  /** 由消费者调用：取出队首的元素，队列为空时返回 false。 */
+  bool Pop(T *value);
+
+  /** 返回队列是否为空。可以在任何线程中调用，其他线程并发修改队列时结果只是一个提示。 */
+  bool IsEmpty() const;
+
+private:
+#ifndef NDEBUG
+  // 检查同一侧没有被两个线程同时进入
+  class SideGuard {
+  public:
+    explicit SideGuard(std::atomic<int> &users) : m_users(users) {
+      int prev = m_users.fetch_add(1, std::memory_order_acquire);
+      assert(prev == 0 && "RTPSPSCRing: concurrent access from the same side");
+      (void)prev;
+    }
+    ~SideGuard() { m_users.fetch_sub(1, std::memory_order_release); }
+
+  private:
+    std::atomic<int> &m_users;
+  };
+
+  std::atomic<int> m_producers, m_consumers;
+#define RTPSPSCRING_PRODUCER SideGuard producerguard(m_producers);
+#define RTPSPSCRING_CONSUMER SideGuard consumerguard(m_consumers);
+#else
+#define RTPSPSCRING_PRODUCER
+#define RTPSPSCRING_CONSUMER
+#endif // NDEBUG
+
+  // 消费者写入的索引，以及它读到的生产者索引
+  alignas(RTPSPSCRING_CACHELINESIZE) std::atomic<size_t> m_head;
+  size_t m_cachedTail;
+  // 生产者写入的索引，以及它读到的消费者索引
+  alignas(RTPSPSCRING_CACHELINESIZE) std::atomic<size_t> m_tail;
+  size_t m_cachedHead;
+  // 两侧都只读的部分
+  alignas(RTPSPSCRING_CACHELINESIZE) T *m_slots;
+  size_t m_mask;
+};
+
+template <class T>
+int RTPSPSCRing<T>::Init(size_t capacity) {
+  if (capacity == 0)
+    return MEDIA_RTP_ERR_INVALID_PARAMETER;
+
+  size_t size = 1;
+  while (size < capacity)
+    size <<= 1;
+
+  T *slots = new T[size];
+  if (slots == 0)
+    return MEDIA_RTP_ERR_RESOURCE_ERROR;
+
+  delete[] m_slots;
+  m_slots = slots;
+  m_mask = size - 1;
+  m_head.store(0, std::memory_order_relaxed);
+  m_tail.store(0, std::memory_order_relaxed);
+  m_cachedHead = 0;
+  m_cachedTail = 0;
+  return 0;
+}
+
+template <class T>
+void RTPSPSCRing<T>::Destroy() {
+  delete[] m_slots;
+  m_slots = 0;
+  m_mask = 0;
+  m_head.store(0, std::memory_order_relaxed);
+  m_tail.store(0, std::memory_order_relaxed);
+  m_cachedHead = 0;
+  m_cachedTail = 0;
+}
+
+template <class T>
+inline bool RTPSPSCRing<T>::Push(const T &value) {
+  RTPSPSCRING_PRODUCER
+  if (m_slots == 0)
+    return false;
+
+  // 索引单调递增，相减得到元素数量，溢出回绕后结果仍然正确
+  size_t tail = m_tail.load(std::memory_order_relaxed);
+  if (tail - m_cachedHead > m_mask) {
+    m_cachedHead = m_head.load(std::memory_order_acquire);
+    if (tail - m_cachedHead > m_mask)
+      return false;
+  }
+
+  m_slots[tail & m_mask] = value;
+  m_tail.store(tail + 1, std::memory_order_release);
+  return true;
+}
+
+template <class T>
+inline size_t RTPSPSCRing<T>::GetFreeSpace() {
+  RTPSPSCRING_PRODUCER
+  if (m_slots == 0)
+    return 0;
+
+  size_t tail = m_tail.load(std::memory_order_relaxed);
+  if (tail - m_cachedHead > m_mask)
+    m_cachedHead = m_head.load(std::memory_order_acquire);
+  return m_mask + 1 - (tail - m_cachedHead);
+}
+
+template <class T>
+inline bool RTPSPSCRing<T>::Pop(T *value) {
+  RTPSPSCRING_CONSUMER
+  size_t head = m_head.load(std::memory_order_relaxed);
+  if (head == m_cachedTail) {
+    m_cachedTail = m_tail.load(std::memory_order_acquire);
+    if (head == m_cachedTail)
+      return false;
+  }
+
+  *value = m_slots[head & m_mask];
+  m_head.store(head + 1, std::memory_order_release);
+  return true;
+}
+
+template <class T>
+inline bool RTPSPSCRing<T>::IsEmpty() const {
+  return (m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire));
+}
+
+#undef RTPSPSCRING_PRODUCER
+#undef RTPSPSCRING_CONSUMER
+
+#endif // MEDIA_RTP_SPSC_RING_H
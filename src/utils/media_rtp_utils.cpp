@@ -5,6 +5,12 @@
 #include <thread>
 #include <chrono>
 #include <sys/select.h>
+#ifdef RTP_HAVE_POLL
+#include <poll.h>
+#endif // RTP_HAVE_POLL
+#include <climits>
+#include <cmath>
+#include <vector>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <errno.h>
@@ -151,6 +157,54 @@ bool RTPTime::operator>=(const RTPTime &t) const {
     return m_seconds >= t.m_seconds;
 }
 
+#ifdef RTP_HAVE_POLL
+
+// RTPSelect 实现 (基于poll，描述符的值不受 FD_SETSIZE 限制)
+int RTPSelect(const int *sockets, int8_t *readflags, size_t numsocks, RTPTime timeout) {
+    const size_t stacksize = 8;
+    struct pollfd stackfds[stacksize];
+    std::vector<struct pollfd> heapfds;
+    struct pollfd *fds = stackfds;
+
+    // 传输器通常只等待两三个描述符，只有数量较多时才分配内存
+    if (numsocks > stacksize) {
+        heapfds.resize(numsocks);
+        fds = &heapfds[0];
+    }
+
+    for (size_t i = 0; i < numsocks; i++) {
+        fds[i].fd = sockets[i];
+        fds[i].events = POLLIN;
+        fds[i].revents = 0;
+        readflags[i] = 0;
+    }
+
+    int timeoutms = -1;
+    if (timeout.GetDouble() >= 0) {
+        // 向上取整到毫秒，避免把很短的超时变成忙等
+        double ms = std::ceil(timeout.GetDouble() * 1000.0);
+        timeoutms = (ms > static_cast<double>(INT_MAX)) ? INT_MAX : static_cast<int>(ms);
+    }
+
+    int status = poll(fds, numsocks, timeoutms);
+    if (status < 0) {
+        // 忽略 EINTR 中断
+        if (errno == EINTR)
+            return 0;
+        return MEDIA_RTP_ERR_OPERATION_FAILED;
+    }
+
+    if (status > 0) {
+        for (size_t i = 0; i < numsocks; i++) {
+            if (fds[i].revents)
+                readflags[i] = 1;
+        }
+    }
+    return status;
+}
+
+#else
+
 // RTPSelect 实现 (基于select，不使用poll)
 int RTPSelect(const int *sockets, int8_t *readflags, size_t numsocks, RTPTime timeout) {
     struct timeval tv;
@@ -187,4 +241,6 @@ int RTPSelect(const int *sockets, int8_t *readflags, size_t numsocks, RTPTime ti
         }
     }
     return status;
-}
\ No newline at end of file
+}
+
+#endif // RTP_HAVE_POLL
\ No newline at end of file
@@ -95,7 +95,7 @@ private:
 };
 
 /**
- * 网络socket选择函数 (基于select实现)
+ * 网络socket选择函数 (支持时基于poll实现，否则基于select)
  * 
  * @param sockets   要检查的socket数组
  * @param readflags 输出标志数组，如果对应socket有数据则设置为1
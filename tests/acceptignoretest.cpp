@@ -0,0 +1,282 @@
+#include "media_rtp_accept_ignore_set.h"
+#include "media_rtp_errors.h"
+#include "rtptestcheck.h"
+#include <stdlib.h>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+struct IdentityHash
+{
+	size_t operator()(uint32_t ip) const						{ return ip; }
+};
+
+typedef RTPAcceptIgnoreSet<uint32_t, IdentityHash> AddressSet;
+
+// 与 RTPAcceptIgnoreSet::GetHomeSlot 相同的计算，用来构造在数组末尾回绕的探测序列
+static size_t HomeSlot(uint32_t ip, uint16_t port, size_t capacity)
+{
+	unsigned int bits = 0;
+	while (((size_t)1 << bits) < capacity)
+		bits++;
+
+	uint64_t h = (uint64_t)ip ^ ((uint64_t)port << 48);
+	return (size_t)((h * 0x9E3779B97F4A7C15ULL) >> (64-bits));
+}
+
+static uint16_t FindPort(uint32_t ip, size_t home, uint16_t after)
+{
+	for (uint32_t port = (uint32_t)after+1 ; port < 65536 ; port++)
+	{
+		if (HomeSlot(ip, (uint16_t)port, RTPACCEPTIGNORESET_MINCAPACITY) == home)
+			return (uint16_t)port;
+	}
+	return 0;
+}
+
+static void TestWrappedCluster()
+{
+	const size_t last = RTPACCEPTIGNORESET_MINCAPACITY-1;
+	uint32_t ip = 1;
+
+	// 地址本身的条目放在数组中间，不影响末尾的探测序列
+	while (HomeSlot(ip, 0, RTPACCEPTIGNORESET_MINCAPACITY) != last/2)
+		ip++;
+
+	// 端口 e 的起始槽位是倒数第二个，a、b 和 d 是最后一个，c 是第一个：
+	// 它们依次占据槽位 14, 15, 0, 1, 2
+	uint16_t e = FindPort(ip, last-1, 0);
+	uint16_t a = FindPort(ip, last, 0);
+	uint16_t b = FindPort(ip, last, a);
+	uint16_t c = FindPort(ip, 0, 0);
+	uint16_t d = FindPort(ip, last, b);
+	Check("Wrapping ports found", e != 0 && a != 0 && b != 0 && c != 0 && d != 0);
+
+	AddressSet set;
+	set.Add(ip, e);
+	set.Add(ip, a);
+	set.Add(ip, b);
+	set.Add(ip, c);
+	set.Add(ip, d);
+	Check("Cluster inserted", set.GetSize() == 6 && set.IsSelected(ip, e) && set.IsSelected(ip, a) &&
+	      set.IsSelected(ip, b) && set.IsSelected(ip, c) && set.IsSelected(ip, d));
+
+	// 空洞之后的条目都已经在起始槽位或之后，包括回绕之后的 b 和 d，一个都不能前移
+	Check("Delete in front of a wrapped cluster", set.Delete(ip, e) == 0);
+	Check("Lookup after delete in front of the cluster", !set.IsSelected(ip, e) && set.IsSelected(ip, a) &&
+	      set.IsSelected(ip, b) && set.IsSelected(ip, c) && set.IsSelected(ip, d) && set.GetSize() == 5);
+
+	// 删除回绕之前的条目，其余三个都要跨过数组末尾前移
+	Check("Delete before the wrap", set.Delete(ip, a) == 0);
+	Check("Lookup after delete before the wrap", !set.IsSelected(ip, a) && set.IsSelected(ip, b) &&
+	      set.IsSelected(ip, c) && set.IsSelected(ip, d) && set.GetSize() == 4);
+
+	// 删除回绕之后起始槽位为零的条目
+	Check("Delete after the wrap", set.Delete(ip, c) == 0);
+	Check("Lookup after delete after the wrap", !set.IsSelected(ip, c) && set.IsSelected(ip, b) &&
+	      set.IsSelected(ip, d) && set.GetSize() == 3);
+
+	Check("Deleted entries stay deleted", set.Delete(ip, e) < 0 && set.Delete(ip, a) < 0 && set.Delete(ip, c) < 0);
+	Check("Re-add after delete", set.Add(ip, a) == 0 && set.Add(ip, c) == 0 && set.GetSize() == 5 &&
+	      set.IsSelected(ip, a) && set.IsSelected(ip, b) && set.IsSelected(ip, c) && set.IsSelected(ip, d));
+}
+
+static void TestGrowth()
+{
+	AddressSet set;
+	bool ok = true;
+
+	// 从最小容量开始多次扩容，每次扩容都重新放置所有条目
+	for (uint32_t ip = 0 ; ip < 64 ; ip++)
+	{
+		for (uint16_t port = 1 ; port <= 32 ; port++)
+		{
+			if (set.Add(0x0a000000+ip, (uint16_t)(5000+port*2)) < 0)
+				ok = false;
+		}
+	}
+	Check("Many entries added", ok && set.GetSize() == 64*33);
+
+	ok = true;
+	for (uint32_t ip = 0 ; ip < 64 ; ip++)
+	{
+		for (uint16_t port = 1 ; port <= 32 ; port++)
+		{
+			if (!set.IsSelected(0x0a000000+ip, (uint16_t)(5000+port*2)) ||
+			    set.IsSelected(0x0a000000+ip, (uint16_t)(5001+port*2)))
+				ok = false;
+		}
+	}
+	Check("Lookups after growth", ok && !set.IsSelected(0x0a000040, 5002));
+
+	vector<AddressSet::Entry> entries;
+	set.GetEntries(entries);
+	Check("All entries listed", entries.size() == set.GetSize());
+
+	// 删除一半的端口，其余的仍然可以找到
+	ok = true;
+	for (uint32_t ip = 0 ; ip < 64 ; ip++)
+	{
+		for (uint16_t port = 1 ; port <= 32 ; port += 2)
+		{
+			if (set.Delete(0x0a000000+ip, (uint16_t)(5000+port*2)) < 0)
+				ok = false;
+		}
+	}
+	for (uint32_t ip = 0 ; ip < 64 ; ip++)
+	{
+		for (uint16_t port = 1 ; port <= 32 ; port++)
+		{
+			if (set.IsSelected(0x0a000000+ip, (uint16_t)(5000+port*2)) != (port%2 == 0))
+				ok = false;
+		}
+	}
+	Check("Lookups after deleting half", ok && set.GetSize() == 64*17);
+
+	set.Clear();
+	Check("Clear", set.GetSize() == 0 && !set.IsSelected(0x0a000000, 5004));
+	Check("Usable after Clear", set.Add(0x0a000000, 5004) == 0 && set.IsSelected(0x0a000000, 5004));
+}
+
+static void TestExceptions()
+{
+	AddressSet set;
+	const uint32_t ip = 0x7f000001, other = 0x7f000002;
+
+	Check("Unknown address not selected", !set.IsSelected(ip, 5000));
+	Check("Delete of unknown address fails", set.Delete(ip, 0) < 0 && set.Delete(ip, 5000) < 0);
+
+	Check("Single port", set.Add(ip, 5000) == 0 && set.IsSelected(ip, 5000) && !set.IsSelected(ip, 5002) &&
+	      !set.IsSelected(ip, 0) && !set.IsSelected(other, 5000));
+	Check("Delete of unselected port fails", set.Delete(ip, 5002) < 0);
+
+	Check("All ports", set.Add(ip, 0) == 0 && set.IsSelected(ip, 5000) && set.IsSelected(ip, 5002) &&
+	      set.IsSelected(ip, 0));
+	Check("All ports replaces single ports", set.GetSize() == 1);
+	Check("Adding a port when all are selected has no effect", set.Add(ip, 5000) == 0 && set.GetSize() == 1);
+
+	Check("Deleting a port records an exception", set.Delete(ip, 5000) == 0 && !set.IsSelected(ip, 5000) &&
+	      set.IsSelected(ip, 5002) && set.GetSize() == 2);
+	Check("Deleting the exception again fails", set.Delete(ip, 5000) < 0);
+	Check("Adding an excepted port has no effect", set.Add(ip, 5000) == 0 && !set.IsSelected(ip, 5000));
+
+	Check("Selecting all ports again clears exceptions", set.Add(ip, 0) == 0 && set.IsSelected(ip, 5000) &&
+	      set.GetSize() == 1);
+
+	Check("Deleting all ports", set.Delete(ip, 0) == 0 && !set.IsSelected(ip, 5000) && !set.IsSelected(ip, 5002));
+	Check("Single port after deleting all", set.Add(ip, 5002) == 0 && set.IsSelected(ip, 5002) &&
+	      !set.IsSelected(ip, 5000));
+
+	vector<AddressSet::Entry> entries;
+	set.GetEntries(entries);
+	bool ok = (entries.size() == 2);
+	for (size_t i = 0 ; i < entries.size() ; i++)
+	{
+		if (entries[i].ip != ip || (entries[i].port != 0 && entries[i].port != 5002) ||
+		    (entries[i].port == 0 && entries[i].all))
+			ok = false;
+	}
+	Check("Entries", ok);
+}
+
+// 以 std::map 实现的参照模型，与类的文档描述一致
+struct ModelEntry
+{
+	ModelEntry() : all(false) { }
+
+	bool all;
+	set<uint16_t> ports;
+};
+
+static bool ModelSelected(const map<uint32_t, ModelEntry> &model, uint32_t ip, uint16_t port)
+{
+	map<uint32_t, ModelEntry>::const_iterator it = model.find(ip);
+	if (it == model.end())
+		return false;
+
+	bool listed = (port != 0 && it->second.ports.count(port) != 0);
+	return (it->second.all)?!listed:listed;
+}
+
+static void TestRandom()
+{
+	map<uint32_t, ModelEntry> model;
+	AddressSet set;
+	bool ok = true;
+
+	srand(4321);
+	for (int round = 0 ; round < 50000 && ok ; round++)
+	{
+		// 地址和端口的范围都很小，条目频繁地增删
+		uint32_t ip = 0x0a000000+(uint32_t)(rand()%12);
+		uint16_t port = (rand()%8 == 0)?0:(uint16_t)(5000+rand()%24);
+		bool exists = (model.find(ip) != model.end());
+		ModelEntry &entry = model[ip];
+		bool expectfail = false;
+
+		if (rand()%2 == 0)
+		{
+			if (port == 0)
+			{
+				entry.all = true;
+				entry.ports.clear();
+			}
+			else if (!entry.all)
+				entry.ports.insert(port);
+			if (set.Add(ip, port) < 0)
+				ok = false;
+		}
+		else
+		{
+			if (!exists)
+			{
+				model.erase(ip);
+				expectfail = true;
+			}
+			else if (port == 0)
+			{
+				entry.all = false;
+				entry.ports.clear();
+			}
+			else if (entry.all)
+				expectfail = !entry.ports.insert(port).second;
+			else
+				expectfail = (entry.ports.erase(port) == 0);
+			if ((set.Delete(ip, port) < 0) != expectfail)
+				ok = false;
+		}
+
+		size_t size = 0;
+		for (map<uint32_t, ModelEntry>::const_iterator it = model.begin() ; it != model.end() ; ++it)
+			size += 1+it->second.ports.size();
+		if (set.GetSize() != size)
+			ok = false;
+
+		if (round%16 == 0)
+		{
+			for (uint32_t i = 0 ; i < 13 ; i++)
+			{
+				for (uint16_t p = 4999 ; p < 5025 ; p++)
+				{
+					if (set.IsSelected(0x0a000000+i, p) != ModelSelected(model, 0x0a000000+i, p))
+						ok = false;
+				}
+			}
+		}
+	}
+	Check("Random operations match the model", ok);
+}
+
+int main(void)
+{
+	TestWrappedCluster();
+	TestGrowth();
+	TestExceptions();
+	TestRandom();
+
+	return CheckSummary();
+}
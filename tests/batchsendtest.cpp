@@ -0,0 +1,209 @@
+#include "rtpconfig.h"
+#include "media_rtp_utils.h"
+#include "media_rtp_errors.h"
+#include "media_rtp_endpoint.h"
+#include "media_rtp_session.h"
+#include "media_rtp_session_params.h"
+#include "media_rtp_packet_factory.h"
+#include "media_rtp_udpv4_transmitter.h"
+#include "rtptestcheck.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define NUMFRAGMENTS	5
+#define FRAGMENTSIZE	1000
+#define LASTSIZE		300
+#define FRAMEINC		3000
+
+// 计数修改传出数据的回调，原样发送
+class ChangingSession : public RTPSession
+{
+public:
+	ChangingSession() : m_numChanged(0) { }
+
+	void EnableChange() { SetChangeOutgoingData(true); }
+
+	int m_numChanged;
+protected:
+	int OnChangeRTPOrRTCPData(const void *origdata, size_t origlen, bool isrtp, void **senddata, size_t *sendlen)
+	{
+		if (isrtp)
+			m_numChanged++;
+		*senddata = const_cast<void *>(origdata);
+		*sendlen = origlen;
+		return 0;
+	}
+};
+
+// 一个视频帧：等长的分片和较短的最后一个分片，只有最后一个分片带标记和时间戳增量
+class Frame
+{
+public:
+	Frame()
+	{
+		for (int i = 0 ; i < NUMFRAGMENTS ; i++)
+		{
+			size_t len = (i == NUMFRAGMENTS-1)?LASTSIZE:FRAGMENTSIZE;
+			bool last = (i == NUMFRAGMENTS-1);
+
+			m_data[i].assign(len, (uint8_t)('a'+i));
+			m_packets[i] = RTPPacketDescriptor(&m_data[i][0], len, 96, last, (last)?FRAMEINC:0);
+		}
+	}
+
+	const RTPPacketDescriptor *GetPackets() const { return m_packets; }
+	RTPPacketDescriptor *GetPackets() { return m_packets; }
+	const vector<uint8_t> &GetData(int i) const { return m_data[i]; }
+private:
+	vector<uint8_t> m_data[NUMFRAGMENTS];
+	RTPPacketDescriptor m_packets[NUMFRAGMENTS];
+};
+
+static void TestBuilder()
+{
+	RTPPacketBuilder builder;
+	Frame frame;
+	const uint8_t extension[4] = { 1, 2, 3, 4 };
+
+	checkerror(builder.Init(1400));
+	uint16_t seqnr = builder.GetSequenceNumber();
+	uint32_t timestamp = builder.GetTimestamp();
+
+	frame.GetPackets()[0].SetExtension(0xbede, extension, 1);
+	checkerror(builder.BuildPackets(frame.GetPackets(), NUMFRAGMENTS));
+
+	const struct iovec *packets = builder.GetPackets();
+	bool lengthsOK = (builder.GetNumPackets() == NUMFRAGMENTS);
+	for (int i = 0 ; lengthsOK && i < NUMFRAGMENTS ; i++)
+	{
+		size_t expected = 12+frame.GetData(i).size()+((i == 0)?8:0);
+		if (packets[i].iov_len != expected)
+			lengthsOK = false;
+		if (i > 0 && (uint8_t *)packets[i].iov_base != (uint8_t *)packets[i-1].iov_base+packets[i-1].iov_len)
+			lengthsOK = false;
+	}
+	Check("Packets built back to back", lengthsOK);
+	Check("Sequence numbers and timestamp advance", builder.GetSequenceNumber() == (uint16_t)(seqnr+NUMFRAGMENTS) &&
+	      builder.GetTimestamp() == timestamp+FRAMEINC && builder.GetPacketCount() == NUMFRAGMENTS);
+
+	RTPPacketView first((const uint8_t *)packets[0].iov_base, packets[0].iov_len, RTPTime(0,0));
+	Check("Extension built", first.GetCreationError() == 0 && first.GetExtensionID() == 0xbede &&
+	      first.GetExtensionLength() == 4 && first.GetPayloadLength() == FRAGMENTSIZE);
+
+	// 一个无效的数据包使整批都不构建
+	Frame bad;
+	vector<uint8_t> big(1400, 0);
+	bad.GetPackets()[2] = RTPPacketDescriptor(&big[0], big.size(), 96, false, 0);
+	Check("Too large packet rejected", builder.BuildPackets(bad.GetPackets(), NUMFRAGMENTS) < 0 &&
+	      builder.GetSequenceNumber() == (uint16_t)(seqnr+NUMFRAGMENTS) && builder.GetPacketCount() == NUMFRAGMENTS);
+
+	bad = Frame();
+	bad.GetPackets()[3].payloadtype = 72;
+	Check("Invalid payload type rejected", builder.BuildPackets(bad.GetPackets(), NUMFRAGMENTS) == MEDIA_RTP_ERR_INVALID_PARAMETER &&
+	      builder.GetSequenceNumber() == (uint16_t)(seqnr+NUMFRAGMENTS));
+}
+
+// 接收一帧，检查序列号、时间戳、标记和载荷
+static bool ReceiveFrame(int receiver, const Frame &frame, uint16_t seqnr, uint32_t *timestamp)
+{
+	uint8_t buf[2048];
+	bool ok = true;
+
+	for (int i = 0 ; i < NUMFRAGMENTS ; i++)
+	{
+		ssize_t len = recv(receiver, (char *)buf, sizeof(buf), 0);
+		RTPPacketView view(buf, (len > 0)?(size_t)len:0, RTPTime(0,0));
+
+		if (view.GetCreationError() < 0)
+			return false;
+		if (i == 0)
+			*timestamp = view.GetTimestamp();
+		if (view.GetSequenceNumber() != (uint16_t)(seqnr+i) || view.GetTimestamp() != *timestamp ||
+		    view.HasMarker() != (i == NUMFRAGMENTS-1) || view.GetPayloadType() != 96 ||
+		    view.GetPayloadLength() != frame.GetData(i).size() ||
+		    memcmp(view.GetPayloadData(), &frame.GetData(i)[0], frame.GetData(i).size()) != 0)
+			ok = false;
+	}
+	return ok;
+}
+
+static void TestSession(uint16_t portbase, bool gso)
+{
+	int receiver = socket(AF_INET, SOCK_DGRAM, 0);
+	struct sockaddr_in addr;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(portbase+10);
+	if (receiver == RTPSOCKERR || ::bind(receiver, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+	{
+		cerr << "Can't create receiver socket" << endl;
+		exit(-1);
+	}
+
+	ChangingSession sess;
+	RTPSessionParams sessparams;
+	RTPUDPv4TransmissionParams transparams;
+
+	sessparams.SetOwnTimestampUnit(1.0/90000.0);
+	transparams.SetPortbase(portbase);
+	transparams.SetUDPSegmentationOffload(gso);
+	checkerror(sess.Create(sessparams, &transparams));
+	checkerror(sess.AddDestination(RTPEndpoint(INADDR_LOOPBACK, portbase+10)));
+
+	string prefix = (gso)?"GSO: ":"";
+	Frame frame;
+	uint16_t seqnr = sess.GetNextSequenceNumber();
+	uint32_t timestamp = 0, nexttimestamp = 0;
+
+	checkerror(sess.SendPackets(frame.GetPackets(), NUMFRAGMENTS));
+	Check(prefix+"First frame received", ReceiveFrame(receiver, frame, seqnr, &timestamp));
+
+	checkerror(sess.SendPackets(frame.GetPackets(), NUMFRAGMENTS));
+	Check(prefix+"Second frame follows the first", ReceiveFrame(receiver, frame, (uint16_t)(seqnr+NUMFRAGMENTS), &nexttimestamp) &&
+	      nexttimestamp == timestamp+FRAMEINC);
+
+	// 无效的批量不发送任何数据包，也不使用序列号
+	Frame bad;
+	bad.GetPackets()[1].payloadtype = 200;
+	Check(prefix+"Invalid batch rejected", sess.SendPackets(bad.GetPackets(), NUMFRAGMENTS) == MEDIA_RTP_ERR_INVALID_PARAMETER &&
+	      sess.GetNextSequenceNumber() == (uint16_t)(seqnr+2*NUMFRAGMENTS));
+	Check(prefix+"Empty batch rejected", sess.SendPackets(frame.GetPackets(), 0) == MEDIA_RTP_ERR_INVALID_PARAMETER);
+
+	// 修改传出数据时每个数据包分别经过回调
+	sess.EnableChange();
+	checkerror(sess.SendPackets(frame.GetPackets(), NUMFRAGMENTS));
+	Check(prefix+"Changed frame received", ReceiveFrame(receiver, frame, (uint16_t)(seqnr+2*NUMFRAGMENTS), &timestamp) &&
+	      sess.m_numChanged == NUMFRAGMENTS);
+
+	sess.Destroy();
+	RTPCLOSE(receiver);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2)
+	{
+		cerr << "Usage: " << argv[0] << " portbase" << endl;
+		return -1;
+	}
+
+	uint16_t portbase = (uint16_t)atoi(argv[1]);
+
+	TestBuilder();
+	TestSession(portbase, false);
+	TestSession(portbase+20, true);
+
+	return CheckSummary();
+}
@@ -0,0 +1,189 @@
+#include "rtpconfig.h"
+#include "media_rtp_utils.h"
+#include "media_rtp_errors.h"
+#include "media_rtp_endpoint.h"
+#include "media_rtp_udpv4_transmitter.h"
+#include "media_rtp_packet_factory.h"
+#include "rtptestcheck.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dlfcn.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdlib.h>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+#define NUMPACKETS		50
+
+// 记录传输器在 RTP 套接字上的 FIONREAD 和 recvmsg 调用：替换 libc 的函数，
+// 库是静态链接的，这里的定义优先于 libc 中的定义
+static int countsock = -1;
+static int numfionread = 0, numrecvmsg = 0;
+
+int ioctl(int fd, unsigned long request, ...) noexcept
+{
+	typedef int (*IoctlFunction)(int, unsigned long, void *);
+	static IoctlFunction next = (IoctlFunction)dlsym(RTLD_NEXT, "ioctl");
+	va_list ap;
+
+	va_start(ap, request);
+	void *arg = va_arg(ap, void *);
+	va_end(ap);
+
+	if (fd == countsock && request == FIONREAD)
+		numfionread++;
+	return next(fd, request, arg);
+}
+
+ssize_t recvmsg(int sock, struct msghdr *msg, int flags)
+{
+	typedef ssize_t (*RecvMsgFunction)(int, struct msghdr *, int);
+	static RecvMsgFunction next = (RecvMsgFunction)dlsym(RTLD_NEXT, "recvmsg");
+
+	if (sock == countsock && !(flags&MSG_ERRQUEUE))
+		numrecvmsg++;
+	return next(sock, msg, flags);
+}
+
+static int CreateSocket(uint16_t port)
+{
+	int sock = socket(AF_INET, SOCK_DGRAM, 0);
+	struct sockaddr_in addr;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(port);
+	if (sock < 0 || bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+	{
+		cerr << "Can't create socket on port " << port << endl;
+		exit(-1);
+	}
+	return sock;
+}
+
+static void SendPackets(uint16_t destport, int num)
+{
+	int sock = socket(AF_INET, SOCK_DGRAM, 0);
+	struct sockaddr_in addr;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(destport);
+
+	for (int i = 0 ; i < num ; i++)
+	{
+		uint8_t rtp[12+40] = { 0x80, 0x60, 0x00, (uint8_t)i, 0, 0, 0, 0, 0x12, 0x34, 0x56, 0x78 };
+		memset(rtp+12, i, 40);
+		sendto(sock, rtp, sizeof(rtp), 0, (struct sockaddr *)&addr, sizeof(addr));
+	}
+	close(sock);
+	RTPTime::Wait(RTPTime(0, 20000));
+}
+
+// 取出队列中的所有数据包，检查它们按顺序到达且内容完整
+static int TakePackets(RTPUDPv4Transmitter &trans, bool *ok)
+{
+	RTPRawPacket *pack;
+	int num = 0;
+
+	*ok = true;
+	while ((pack = trans.GetNextPacket()) != 0)
+	{
+		const uint8_t *data = pack->GetData();
+		if (pack->GetDataLength() != 12+40 || data[3] != (uint8_t)num || data[12+39] != (uint8_t)num)
+			*ok = false;
+		num++;
+		delete pack;
+	}
+	return num;
+}
+
+static bool IsBlocking(int sock)
+{
+	return !(fcntl(sock, F_GETFL) & O_NONBLOCK);
+}
+
+// existing 为 true 时使用自己创建的阻塞套接字，dontwait 对应 SetNonBlockingReceive
+static void TestDrain(uint16_t portbase, bool existing, bool dontwait)
+{
+	RTPUDPv4Transmitter trans;
+	RTPUDPv4TransmissionParams params;
+	int rtpsock = -1, rtcpsock = -1;
+
+	if (existing)
+	{
+		rtpsock = CreateSocket(portbase);
+		rtcpsock = CreateSocket(portbase+1);
+		params.SetUseExistingSockets(rtpsock, rtcpsock);
+		params.SetNonBlockingReceive(dontwait);
+	}
+	else
+		params.SetPortbase(portbase);
+	checkerror(trans.Init(false));
+	checkerror(trans.Create(1400, &params));
+
+	RTPUDPv4TransmissionInfo *inf = (RTPUDPv4TransmissionInfo *)trans.GetTransmissionInfo();
+	countsock = inf->GetRTPSocket();
+	trans.DeleteTransmissionInfo(inf);
+
+	string prefix = (!existing)?"Own sockets: ":((dontwait)?"Existing sockets, MSG_DONTWAIT: ":"Existing sockets, FIONREAD: ");
+	bool ok;
+
+	SendPackets(portbase, NUMPACKETS);
+	numfionread = numrecvmsg = 0;
+	checkerror(trans.Poll());
+	Check(prefix+"one poll drains all packets in order", TakePackets(trans, &ok) == NUMPACKETS && ok);
+
+	if (dontwait)
+	{
+		// 每个数据报一次 recvmsg，再加上一次返回 EAGAIN 的调用
+		Check(prefix+"one call per packet, no FIONREAD", numrecvmsg == NUMPACKETS+1 && numfionread == 0);
+	}
+	else
+		Check(prefix+"FIONREAD checked before reading", numfionread >= NUMPACKETS && numrecvmsg >= NUMPACKETS);
+
+	// 没有数据时轮询立即返回
+	RTPTime start = RTPTime::CurrentTime();
+	checkerror(trans.Poll());
+	RTPTime elapsed = RTPTime::CurrentTime();
+	elapsed -= start;
+	Check(prefix+"poll without data returns at once", elapsed.GetDouble() < 0.1 && TakePackets(trans, &ok) == 0);
+
+	countsock = -1;
+	trans.Destroy();
+
+	if (existing)
+	{
+		// MSG_DONTWAIT 只作用于单次调用，应用程序的套接字仍然是阻塞的
+		Check(prefix+"sockets stay blocking", IsBlocking(rtpsock) && IsBlocking(rtcpsock));
+		close(rtpsock);
+		close(rtcpsock);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2)
+	{
+		cerr << "Usage: " << argv[0] << " portbase" << endl;
+		return -1;
+	}
+
+	uint16_t portbase = (uint16_t)atoi(argv[1]);
+
+	TestDrain(portbase, false, true);
+	TestDrain(portbase+10, true, true);
+	TestDrain(portbase+20, true, false);
+
+	return CheckSummary();
+}
@@ -0,0 +1,131 @@
+#include "rtpconfig.h"
+#include <iostream>
+
+#ifdef RTP_SUPPORT_IPV6
+
+#include "media_rtp_utils.h"
+#include "media_rtp_session.h"
+#include "media_rtp_session_params.h"
+#include "media_rtp_errors.h"
+#include "media_rtp_source_data.h"
+#include "media_rtp_endpoint.h"
+#include "media_rtp_udpv4_transmitter.h"
+#include "media_rtp_udpv6_transmitter.h"
+#include "media_rtp_packet_factory.h"
+#include "rtptestcheck.h"
+#include <mutex>
+#include <string.h>
+#include <stdlib.h>
+#include <vector>
+
+using namespace std;
+
+// 按发送方地址的类型分别统计收到的 RTP 数据包
+class MySession : public RTPSession
+{
+public:
+	MySession() : RTPSession(), m_ipv4count(0), m_ipv6count(0) { }
+	~MySession() { }
+
+	int GetIPv4Count() { lock_guard<mutex> lock(m_mutex); return m_ipv4count; }
+	int GetIPv6Count() { lock_guard<mutex> lock(m_mutex); return m_ipv6count; }
+protected:
+	void OnValidatedRTPPacket(RTPSourceData *srcdat, RTPPacket *rtppack, bool isonprobation, bool *ispackethandled)
+	{
+		const RTPEndpoint *addr = srcdat->GetRTPDataAddress();
+
+		if (addr != 0)
+		{
+			lock_guard<mutex> lock(m_mutex);
+			if (addr->GetType() == RTPEndpoint::IPv4)
+				m_ipv4count++;
+			else if (addr->GetType() == RTPEndpoint::IPv6)
+				m_ipv6count++;
+		}
+		DeletePacket(rtppack);
+		*ispackethandled = true;
+	}
+private:
+	mutex m_mutex;
+	int m_ipv4count, m_ipv6count;
+};
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2)
+	{
+		cerr << "Usage: " << argv[0] << " portbase" << endl;
+		return -1;
+	}
+
+	uint16_t portbase = (uint16_t)atoi(argv[1]);
+	RTPSessionParams sessParams;
+	RTPUDPv6TransmissionParams dualParams, v6Params;
+	RTPUDPv4TransmissionParams v4Params;
+	MySession dualSess, v4Sess, v6Sess;
+
+	sessParams.SetProbationType(RTPSources::NoProbation);
+	sessParams.SetOwnTimestampUnit(1.0/8000.0);
+
+	// 双栈会话同时与一个 IPv4 会话和一个 IPv6 会话通信
+	dualParams.SetPortbase(portbase);
+	dualParams.SetDualStack(true);
+	v4Params.SetPortbase(portbase+2);
+	v6Params.SetPortbase(portbase+4);
+
+	checkerror(dualSess.Create(sessParams, &dualParams, RTPTransmitter::IPv6UDPProto));
+	checkerror(v4Sess.Create(sessParams, &v4Params, RTPTransmitter::IPv4UDPProto));
+	checkerror(v6Sess.Create(sessParams, &v6Params, RTPTransmitter::IPv6UDPProto));
+	cout << "Sessions created" << endl;
+
+	uint32_t localhost4 = ntohl(inet_addr("127.0.0.1"));
+
+	checkerror(dualSess.AddDestination(RTPEndpoint(localhost4, portbase+2)));
+	checkerror(dualSess.AddDestination(RTPEndpoint(in6addr_loopback, portbase+4)));
+	checkerror(v4Sess.AddDestination(RTPEndpoint(localhost4, portbase)));
+	checkerror(v6Sess.AddDestination(RTPEndpoint(in6addr_loopback, portbase)));
+
+	// 普通的 IPv6 会话不接受 IPv4 目标
+	if (v6Sess.AddDestination(RTPEndpoint(localhost4, portbase)) != MEDIA_RTP_ERR_INVALID_PARAMETER)
+	{
+		cerr << "IPv6 session accepted an IPv4 destination" << endl;
+		return -1;
+	}
+
+	vector<uint8_t> pack(160);
+	int num = 50;
+
+	for (int i = 1 ; i <= num ; i++)
+	{
+		checkerror(dualSess.SendPacket((void *)&pack[0],pack.size(),0,false,160));
+		checkerror(v4Sess.SendPacket((void *)&pack[0],pack.size(),0,false,160));
+		checkerror(v6Sess.SendPacket((void *)&pack[0],pack.size(),0,false,160));
+		RTPTime::Wait(RTPTime(0,10000));
+	}
+
+	// 后台线程会接收数据包并调用 OnValidatedRTPPacket
+	RTPTime::Wait(RTPTime(1,0));
+
+	cout << "Dual-stack session: " << dualSess.GetIPv4Count() << " from IPv4, " << dualSess.GetIPv6Count() << " from IPv6" << endl;
+	cout << "IPv4 session: " << v4Sess.GetIPv4Count() << ", IPv6 session: " << v6Sess.GetIPv6Count() << endl;
+
+	bool ok = (dualSess.GetIPv4Count() == num && dualSess.GetIPv6Count() == num &&
+	           v4Sess.GetIPv4Count() == num && v6Sess.GetIPv6Count() == num);
+
+	dualSess.BYEDestroy(RTPTime(1,0),0,0);
+	v4Sess.BYEDestroy(RTPTime(1,0),0,0);
+	v6Sess.BYEDestroy(RTPTime(1,0),0,0);
+
+	cout << "Done." << endl;
+	return (ok)?0:-1;
+}
+
+#else
+
+int main(void)
+{
+	std::cerr << "IPv6 support was not enabled at compile time" << std::endl;
+	return 0;
+}
+
+#endif // RTP_SUPPORT_IPV6
@@ -0,0 +1,161 @@
+#include "media_rtp_received_message.h"
+#include "rtptestcheck.h"
+#include <string.h>
+#ifdef RTP_HAVE_UDP_GRO
+	#include <netinet/udp.h>
+#endif // RTP_HAVE_UDP_GRO
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// 接收到的数据分布在两个 iovec 中，就像传输器的池缓冲区和溢出缓冲区
+class Message
+{
+public:
+	Message(size_t len, size_t firstlen)
+	{
+		for (size_t i = 0 ; i < len ; i++)
+			data.push_back((uint8_t)(i*7+1));
+		first.assign(data.begin(), data.begin()+firstlen);
+		second.assign(data.begin()+firstlen, data.end());
+		second.push_back(0); // 第二部分为空时也能取地址
+
+		iov[0].iov_base = &first[0];
+		iov[0].iov_len = first.size();
+		iov[1].iov_base = &second[0];
+		iov[1].iov_len = second.size()-1;
+
+		memset(&hdr, 0, sizeof(hdr));
+		memset(control, 0, sizeof(control));
+		hdr.msg_iov = iov;
+		hdr.msg_iovlen = 2;
+	}
+
+	void SetGSOSize(int gsosize)
+	{
+#ifdef RTP_HAVE_UDP_GRO
+		hdr.msg_control = control;
+		hdr.msg_controllen = CMSG_SPACE(sizeof(int));
+
+		struct cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr);
+		cmsg->cmsg_level = SOL_UDP;
+		cmsg->cmsg_type = UDP_GRO;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+		memcpy(CMSG_DATA(cmsg), &gsosize, sizeof(int));
+#else
+		(void)gsosize;
+#endif // RTP_HAVE_UDP_GRO
+	}
+
+	// 检查每个分段的长度和内容是否与原始数据一致
+	bool CheckSegments(const RTPReceivedMessage &message, const vector<size_t> &lengths) const
+	{
+		if (message.GetNumSegments() != lengths.size())
+			return false;
+
+		size_t offset = 0;
+		for (size_t i = 0 ; i < lengths.size() ; i++)
+		{
+			if (message.GetSegmentOffset(i) != offset || message.GetSegmentLength(i) != lengths[i])
+				return false;
+
+			vector<uint8_t> segment(lengths[i]+1, 0xAA);
+			message.CopySegment(i, &segment[0]);
+			if (lengths[i] > 0 && memcmp(&segment[0], &data[offset], lengths[i]) != 0)
+				return false;
+			if (segment[lengths[i]] != 0xAA) // 没有写出分段之外
+				return false;
+			offset += lengths[i];
+		}
+		return (offset == data.size());
+	}
+
+	struct msghdr hdr;
+private:
+	vector<uint8_t> data, first, second;
+	struct iovec iov[2];
+	uint64_t control[(CMSG_SPACE(sizeof(int))+7)/8];
+};
+
+static vector<size_t> Lengths(size_t a, size_t b = 0, size_t c = 0, size_t d = 0)
+{
+	vector<size_t> lengths;
+
+	lengths.push_back(a);
+	if (b != 0)
+		lengths.push_back(b);
+	if (c != 0)
+		lengths.push_back(c);
+	if (d != 0)
+		lengths.push_back(d);
+	return lengths;
+}
+
+static void TestSingle()
+{
+	Message msg(300, 200);
+	RTPReceivedMessage message(&msg.hdr, 300, true);
+
+	Check("Without GRO: one datagram", message.GetSegmentSize() == 300 && msg.CheckSegments(message, Lengths(300)));
+	Check("Without GRO: no timestamp", message.GetTimestamp().IsZero());
+
+	Message empty(0, 0);
+	RTPReceivedMessage emptymessage(&empty.hdr, 0, true);
+	Check("Empty datagram is one empty segment", emptymessage.GetNumSegments() == 1 &&
+	      emptymessage.GetSegmentLength(0) == 0);
+}
+
+#ifdef RTP_HAVE_UDP_GRO
+static void TestGRO()
+{
+	// 三个完整的分段和一个较短的最后分段，iovec 的边界在第二个分段中间
+	Message shortlast(340, 150);
+	shortlast.SetGSOSize(100);
+	RTPReceivedMessage message(&shortlast.hdr, 340, true);
+	Check("Short final segment", message.GetSegmentSize() == 100 &&
+	      shortlast.CheckSegments(message, Lengths(100, 100, 100, 40)));
+
+	// 最后一个分段正好完整
+	Message exact(300, 100);
+	exact.SetGSOSize(100);
+	RTPReceivedMessage exactmessage(&exact.hdr, 300, true);
+	Check("Full final segment", exact.CheckSegments(exactmessage, Lengths(100, 100, 100)));
+
+	// 分段大小等于整个数据报时只有一个数据报
+	Message whole(200, 120);
+	whole.SetGSOSize(200);
+	RTPReceivedMessage wholemessage(&whole.hdr, 200, true);
+	Check("Segment size equal to the whole datagram", wholemessage.GetSegmentSize() == 200 &&
+	      whole.CheckSegments(wholemessage, Lengths(200)));
+
+	Message larger(200, 200);
+	larger.SetGSOSize(1400);
+	RTPReceivedMessage largermessage(&larger.hdr, 200, true);
+	Check("Segment size larger than the datagram", larger.CheckSegments(largermessage, Lengths(200)));
+
+	Message zero(200, 200);
+	zero.SetGSOSize(0);
+	RTPReceivedMessage zeromessage(&zero.hdr, 200, true);
+	Check("Zero segment size ignored", zero.CheckSegments(zeromessage, Lengths(200)));
+
+	// 套接字没有请求控制消息时不读取它们
+	Message ignored(340, 150);
+	ignored.SetGSOSize(100);
+	RTPReceivedMessage ignoredmessage(&ignored.hdr, 340, false);
+	Check("Control messages not parsed", ignored.CheckSegments(ignoredmessage, Lengths(340)));
+}
+#endif // RTP_HAVE_UDP_GRO
+
+int main(void)
+{
+	TestSingle();
+#ifdef RTP_HAVE_UDP_GRO
+	TestGRO();
+#else
+	cout << "UDP GRO not supported, skipping the split tests" << endl;
+#endif // RTP_HAVE_UDP_GRO
+
+	return CheckSummary();
+}
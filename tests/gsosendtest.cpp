@@ -0,0 +1,197 @@
+#include "rtpconfig.h"
+#include "media_rtp_utils.h"
+#include "media_rtp_errors.h"
+#include "media_rtp_endpoint.h"
+#include "media_rtp_udpv4_transmitter.h"
+#include "rtptestcheck.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#ifdef RTP_HAVE_UDP_SEGMENT
+	#include <netinet/udp.h>
+#endif // RTP_HAVE_UDP_SEGMENT
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define NUMPACKETS		8
+
+// 记录带 UDP_SEGMENT 控制消息的 sendmsg 调用：替换 libc 的 sendmsg，库是静态链接的，
+// 这里的定义优先于 libc 中的定义。设置 failgso 时这些调用以 EIO 失败，
+// 就像网卡无法进行校验和卸载时一样
+static int numgsocalls = 0;
+static bool failgso = false;
+
+ssize_t sendmsg(int sock, const struct msghdr *msg, int flags)
+{
+	typedef ssize_t (*SendMsgFunction)(int, const struct msghdr *, int);
+	static SendMsgFunction next = (SendMsgFunction)dlsym(RTLD_NEXT, "sendmsg");
+
+#ifdef RTP_HAVE_UDP_SEGMENT
+	for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg) ; cmsg != 0 ; cmsg = CMSG_NXTHDR(const_cast<struct msghdr *>(msg), cmsg))
+	{
+		if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_SEGMENT)
+		{
+			numgsocalls++;
+			if (failgso)
+			{
+				errno = EIO;
+				return -1;
+			}
+		}
+	}
+#endif // RTP_HAVE_UDP_SEGMENT
+	return next(sock, msg, flags);
+}
+
+static bool GSOSupported()
+{
+#ifdef RTP_HAVE_UDP_SEGMENT
+	int sock = socket(AF_INET, SOCK_DGRAM, 0);
+	int gsosize = 0;
+	bool ok = (sock >= 0 && setsockopt(sock, SOL_UDP, UDP_SEGMENT, &gsosize, sizeof(int)) == 0);
+
+	if (sock >= 0)
+		close(sock);
+	return ok;
+#else
+	return false;
+#endif // RTP_HAVE_UDP_SEGMENT
+}
+
+static int CreateReceiver(uint16_t port)
+{
+	int sock = socket(AF_INET, SOCK_DGRAM, 0);
+	struct sockaddr_in addr;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port);
+	if (sock < 0 || bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+	{
+		cerr << "Can't create receiver socket on port " << port << endl;
+		exit(-1);
+	}
+	return sock;
+}
+
+// 两组等长的数据包：第一组以一个较短的数据包结束，第二组全部等长
+class Batch
+{
+public:
+	Batch(uint8_t first)
+	{
+		for (int i = 0 ; i < NUMPACKETS ; i++)
+		{
+			size_t len = (i == 3)?300:1000;
+			uint8_t seq = (uint8_t)(first+i);
+
+			data[i].assign(len, seq);
+			data[i][0] = 0x80;
+			data[i][1] = 0x60;
+			data[i][2] = 0;
+			data[i][3] = seq;
+			iov[i].iov_base = &data[i][0];
+			iov[i].iov_len = len;
+		}
+	}
+
+	// 套接字上的数据报必须与批量中的数据包逐个相同，且没有多余的数据报
+	bool Received(int sock) const
+	{
+		uint8_t buf[70000];
+
+		for (int i = 0 ; i < NUMPACKETS ; i++)
+		{
+			ssize_t len = recv(sock, buf, sizeof(buf), MSG_DONTWAIT);
+			if (len < 0 || (size_t)len != data[i].size() || memcmp(buf, &data[i][0], data[i].size()) != 0)
+				return false;
+		}
+		return (recv(sock, buf, sizeof(buf), MSG_DONTWAIT) < 0);
+	}
+
+	struct iovec iov[NUMPACKETS];
+private:
+	vector<uint8_t> data[NUMPACKETS];
+};
+
+// 发送两个批量到两个目标，返回两个目标是否都收到了相同的数据包
+static bool SendBatches(RTPUDPv4Transmitter &trans, int receiverA, int receiverB, uint8_t first)
+{
+	bool ok = true;
+
+	for (int i = 0 ; i < 2 ; i++)
+	{
+		Batch batch((uint8_t)(first+i*NUMPACKETS));
+
+		checkerror(trans.SendRTPDataBatch(batch.iov, NUMPACKETS));
+		RTPTime::Wait(RTPTime(0, 20000));
+		if (!batch.Received(receiverA) || !batch.Received(receiverB))
+			ok = false;
+	}
+	return ok;
+}
+
+static void TestSend(uint16_t portbase, bool gso, bool fail)
+{
+	RTPUDPv4Transmitter trans;
+	RTPUDPv4TransmissionParams params;
+
+	params.SetPortbase(portbase);
+	params.SetUDPSegmentationOffload(gso);
+	checkerror(trans.Init(false));
+	checkerror(trans.Create(1400, &params));
+
+	int receiverA = CreateReceiver(portbase+10);
+	int receiverB = CreateReceiver(portbase+12);
+	checkerror(trans.AddDestination(RTPEndpoint(INADDR_LOOPBACK, portbase+10)));
+	checkerror(trans.AddDestination(RTPEndpoint(INADDR_LOOPBACK, portbase+12)));
+
+	string prefix = (!gso)?"GSO disabled: ":((fail)?"GSO rejected: ":"GSO: ");
+	bool supported = GSOSupported();
+
+	numgsocalls = 0;
+	failgso = fail;
+	Check(prefix+"every destination receives the same packets", SendBatches(trans, receiverA, receiverB, 0));
+
+	if (!gso)
+		Check(prefix+"no segmented sends", numgsocalls == 0);
+	else if (!supported)
+		cout << "UDP GSO not supported, the packets are sent one by one" << endl;
+	else if (!fail)
+		Check(prefix+"one segmented send per group and destination", numgsocalls == 2*2*2);
+	else
+		Check(prefix+"not tried again after the first failure", numgsocalls == 1);
+
+	failgso = false;
+	close(receiverA);
+	close(receiverB);
+	trans.Destroy();
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2)
+	{
+		cerr << "Usage: " << argv[0] << " portbase" << endl;
+		return -1;
+	}
+
+	uint16_t portbase = (uint16_t)atoi(argv[1]);
+
+	TestSend(portbase, true, false);
+	TestSend(portbase+20, true, true);
+	TestSend(portbase+40, false, false);
+
+	return CheckSummary();
+}
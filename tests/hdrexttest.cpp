@@ -0,0 +1,186 @@
+#include "media_rtp_header_extensions.h"
+#include "media_rtp_packet_factory.h"
+#include "media_rtp_errors.h"
+#include "media_rtp_utils.h"
+#include "rtptestcheck.h"
+#include <string.h>
+#include <stdlib.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static void TestMap()
+{
+	RTPHeaderExtensionMap map;
+
+	Check("Empty map", map.GetID(RTPHeaderExtensionMap::AbsoluteSendTime) == 0 &&
+	      map.GetType(3) == RTPHeaderExtensionMap::None);
+
+	checkerror(map.Register<RTPAbsoluteSendTimeExtension>(3));
+	checkerror(map.Register("urn:ietf:params:rtp-hdrext:ssrc-audio-level", 1));
+	Check("Registered by type and URI", map.GetID(RTPHeaderExtensionMap::AbsoluteSendTime) == 3 &&
+	      map.GetType(3) == RTPHeaderExtensionMap::AbsoluteSendTime &&
+	      map.GetID(RTPHeaderExtensionMap::AudioLevel) == 1);
+
+	Check("Identifier in use rejected", map.Register<RTPMidExtension>(3) == MEDIA_RTP_ERR_INVALID_STATE);
+	Check("Second identifier rejected", map.Register<RTPAbsoluteSendTimeExtension>(4) == MEDIA_RTP_ERR_INVALID_STATE);
+	Check("Same registration accepted", map.Register<RTPAbsoluteSendTimeExtension>(3) == 0);
+	Check("Identifier zero rejected", map.Register<RTPMidExtension>(0) == MEDIA_RTP_ERR_INVALID_PARAMETER);
+	Check("Unknown URI rejected", map.Register("urn:example:unknown", 5) == MEDIA_RTP_ERR_INVALID_PARAMETER);
+
+	checkerror(map.Unregister(RTPHeaderExtensionMap::AbsoluteSendTime));
+	Check("Unregistered", map.GetID(RTPHeaderExtensionMap::AbsoluteSendTime) == 0 &&
+	      map.GetType(3) == RTPHeaderExtensionMap::None && map.Register<RTPMidExtension>(3) == 0);
+
+	Check("URI of a type", strcmp(RTPHeaderExtensionMap::GetURI(RTPHeaderExtensionMap::Mid), "urn:ietf:params:rtp-hdrext:sdes:mid") == 0 &&
+	      RTPHeaderExtensionMap::GetURI(RTPHeaderExtensionMap::None) == 0);
+}
+
+// 用写入器的扩展构建数据包，返回数据包的数据
+static vector<uint8_t> BuildPacket(const RTPHeaderExtensionWriter &writer)
+{
+	const uint8_t payload[20] = { 0 };
+	RTPPacketBuilder builder;
+
+	checkerror(builder.Init(1400));
+	checkerror(builder.BuildPacketEx(payload, sizeof(payload), 96, false, 0, writer.GetProfile(), writer.GetData(), writer.GetNumWords()));
+	return vector<uint8_t>(builder.GetPacket(), builder.GetPacket()+builder.GetPacketLength());
+}
+
+static void TestOneByte()
+{
+	RTPHeaderExtensionMap map;
+	checkerror(map.Register<RTPAbsoluteSendTimeExtension>(1));
+	checkerror(map.Register<RTPTransportSequenceNumberExtension>(2));
+	checkerror(map.Register<RTPAudioLevelExtension>(3));
+	checkerror(map.Register<RTPMidExtension>(4));
+
+	uint8_t buffer[64];
+	RTPHeaderExtensionWriter writer(buffer, sizeof(buffer));
+	RTPAudioLevel level = { true, 42 };
+	RTPHeaderExtensionString mid = { "video", 5 };
+
+	checkerror(writer.Add<RTPAbsoluteSendTimeExtension>(map, 0x123456));
+	checkerror(writer.Add<RTPTransportSequenceNumberExtension>(map, 0xabcd));
+	checkerror(writer.Add<RTPAudioLevelExtension>(map, level));
+	checkerror(writer.Add<RTPMidExtension>(map, mid));
+	Check("One-byte format", writer.GetProfile() == RTP_HDREXT_ONEBYTEPROFILE);
+	Check("Elements packed", writer.GetNumWords() == 4 && buffer[0] == 0x12 && buffer[1] == 0x12 &&
+	      buffer[4] == 0x21 && buffer[7] == 0x30 && buffer[8] == (0x80|42) && buffer[9] == 0x44 && buffer[15] == 0);
+	Check("Unregistered type rejected", writer.Add<RTPAbsoluteSendTimeExtension>(RTPHeaderExtensionMap(), 1) == MEDIA_RTP_ERR_INVALID_STATE);
+
+	vector<uint8_t> data = BuildPacket(writer);
+	RTPPacketView view(&data[0], data.size(), RTPTime(0,0));
+	checkerror(view.GetCreationError());
+
+	uint32_t sendtime = 0;
+	uint16_t seqnr = 0;
+	RTPAudioLevel gotlevel = { false, 0 };
+	RTPHeaderExtensionString gotmid = { 0, 0 };
+	Check("Typed values found", map.Find<RTPAbsoluteSendTimeExtension>(view, &sendtime) && sendtime == 0x123456 &&
+	      map.Find<RTPTransportSequenceNumberExtension>(view, &seqnr) && seqnr == 0xabcd &&
+	      map.Find<RTPAudioLevelExtension>(view, &gotlevel) && gotlevel.voiceactivity && gotlevel.level == 42 &&
+	      map.Find<RTPMidExtension>(view, &gotmid) && gotmid.length == 5 && memcmp(gotmid.data, "video", 5) == 0);
+	Check("Value points into the packet", (const uint8_t *)gotmid.data > view.GetPacketData() &&
+	      (const uint8_t *)gotmid.data < view.GetPayloadData());
+
+	RTPHeaderExtensionMap other;
+	checkerror(other.Register<RTPAbsoluteSendTimeExtension>(9));
+	Check("Missing element not found", !other.Find<RTPAbsoluteSendTimeExtension>(view, &sendtime));
+
+	string ids;
+	RTPHeaderExtensionIterator it(view);
+	while (it.Next())
+		ids += to_string(it.GetID())+":"+to_string(it.GetLength())+" ";
+	Check("Iterator visits every element", ids == "1:3 2:2 3:1 4:5 " && !it.IsMalformed() && !it.IsTwoByte());
+
+	// 同样的扩展在 RTPPacket 上
+	RTPPacket pack(96, &data[0], 0, 0, 0, 0, false, 0, 0, true, view.GetExtensionID(), (uint16_t)(view.GetExtensionLength()/4),
+	               view.GetExtensionData(), 0);
+	checkerror(pack.GetCreationError());
+	Check("Found in an RTPPacket", map.Find<RTPTransportSequenceNumberExtension>(pack, &seqnr) && seqnr == 0xabcd);
+}
+
+static void TestTwoByte()
+{
+	uint8_t buffer[64];
+	RTPHeaderExtensionWriter writer(buffer, sizeof(buffer));
+	uint8_t longdata[20];
+	const uint8_t shortdata[2] = { 7, 8 };
+
+	for (size_t i = 0 ; i < sizeof(longdata) ; i++)
+		longdata[i] = (uint8_t)i;
+
+	checkerror(writer.Add(1, shortdata, sizeof(shortdata)));
+	checkerror(writer.Add(2, shortdata, 1));
+	Check("Starts in one-byte format", writer.GetProfile() == RTP_HDREXT_ONEBYTEPROFILE && writer.GetNumWords() == 2);
+
+	// 长于 16 字节的元素使已有的元素改为双字节格式
+	checkerror(writer.Add(20, longdata, sizeof(longdata)));
+	checkerror(writer.Add(3, 0, 0));
+	Check("Converted to two-byte format", writer.GetProfile() == RTP_HDREXT_TWOBYTEPROFILE &&
+	      writer.GetNumWords() == (4+3+22+2+3)/4);
+
+	RTPHeaderExtensionIterator it(writer.GetProfile(), writer.GetData(), writer.GetNumWords()*4);
+	bool ok = it.IsTwoByte();
+	ok = ok && it.Next() && it.GetID() == 1 && it.GetLength() == 2 && it.GetData()[1] == 8;
+	ok = ok && it.Next() && it.GetID() == 2 && it.GetLength() == 1 && it.GetData()[0] == 7;
+	ok = ok && it.Next() && it.GetID() == 20 && it.GetLength() == 20 && memcmp(it.GetData(), longdata, 20) == 0;
+	ok = ok && it.Next() && it.GetID() == 3 && it.GetLength() == 0;
+	ok = ok && !it.Next() && !it.IsMalformed();
+	Check("Elements kept after the conversion", ok);
+
+	Check("Application bits accepted", RTPHeaderExtensionIterator(RTP_HDREXT_TWOBYTEPROFILE|0x5, writer.GetData(), writer.GetNumWords()*4).Find(20));
+	Check("Other profiles have no elements", !RTPHeaderExtensionIterator(0x1234, writer.GetData(), writer.GetNumWords()*4).Next());
+
+	// 缓冲区放不下时已有的元素不变
+	uint8_t small[8];
+	RTPHeaderExtensionWriter smallwriter(small, sizeof(small));
+	checkerror(smallwriter.Add(1, shortdata, 2));
+	checkerror(smallwriter.Add(2, shortdata, 2));
+	Check("Conversion that does not fit rejected", smallwriter.Add(15, shortdata, 1) == MEDIA_RTP_ERR_RESOURCE_ERROR &&
+	      smallwriter.GetProfile() == RTP_HDREXT_ONEBYTEPROFILE && smallwriter.GetNumWords() == 2 && small[0] == 0x11);
+	Check("Invalid elements rejected", smallwriter.Add(0, shortdata, 1) == MEDIA_RTP_ERR_INVALID_PARAMETER &&
+	      writer.Add(4, longdata, 256) == MEDIA_RTP_ERR_INVALID_PARAMETER);
+}
+
+static void TestParsing()
+{
+	// 元素之间的填充字节被跳过，标识符 15 结束遍历
+	const uint8_t padded[8] = { 0x10, 0xaa, 0x00, 0x00, 0x20, 0xbb, 0xf0, 0x31 };
+	RTPHeaderExtensionIterator it(RTP_HDREXT_ONEBYTEPROFILE, padded, sizeof(padded));
+	bool ok = it.Next() && it.GetID() == 1 && it.GetData()[0] == 0xaa;
+	ok = ok && it.Next() && it.GetID() == 2 && it.GetData()[0] == 0xbb;
+	ok = ok && !it.Next() && !it.IsMalformed();
+	Check("Padding skipped and identifier 15 stops", ok);
+
+	const uint8_t truncated[4] = { 0x13, 0x01, 0x02, 0x03 };
+	RTPHeaderExtensionIterator bad(RTP_HDREXT_ONEBYTEPROFILE, truncated, sizeof(truncated));
+	Check("Element past the end is malformed", !bad.Next() && bad.IsMalformed());
+
+	const uint8_t twobyte[4] = { 0x05, 0x05, 0x01, 0x02 };
+	RTPHeaderExtensionIterator badtwo(RTP_HDREXT_TWOBYTEPROFILE, twobyte, sizeof(twobyte));
+	Check("Two-byte element past the end is malformed", !badtwo.Next() && badtwo.IsMalformed());
+
+	// 没有扩展的数据包
+	const uint8_t payload[4] = { 1, 2, 3, 4 };
+	RTPPacket pack(96, payload, sizeof(payload), 0, 0, 0, false, 0, 0, false, 0, 0, 0, 0);
+	RTPPacketView view(pack);
+	RTPHeaderExtensionIterator none(view);
+	Check("Packet without extension", !none.IsSupported() && !none.Next());
+
+	RTPTime t(1.5);
+	Check("abs-send-time from a time", RTPAbsoluteSendTimeExtension::FromTime(t) == ((((uint32_t)t.GetNTPTime().GetMSW()&0x3f) << 18)|(1u << 17)));
+}
+
+int main(void)
+{
+	TestMap();
+	TestOneByte();
+	TestTwoByte();
+	TestParsing();
+
+	return CheckSummary();
+}
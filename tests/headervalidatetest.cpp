@@ -0,0 +1,193 @@
+#include "media_rtp_header_validator.h"
+#include "media_rtp_packet_factory.h"
+#include "media_rtcp_packet_factory.h"
+#include "media_rtp_endpoint.h"
+#include "media_rtp_errors.h"
+#include "media_rtp_utils.h"
+#include "rtptestcheck.h"
+#include <netinet/in.h>
+#include <string.h>
+#include <stdlib.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static RTPRawPacket *MakeRawPacket(const vector<uint8_t> &data, bool rtp)
+{
+	uint8_t *buf = new uint8_t[data.size()+1];
+	if (!data.empty())
+		memcpy(buf, &data[0], data.size());
+	return new RTPRawPacket(buf, data.size(), false, RTPEndpoint(INADDR_LOOPBACK,5000), RTPTime(10,0), rtp);
+}
+
+// 完整解析是否接受数据包
+static bool IsParsed(const vector<uint8_t> &data, bool rtp)
+{
+	vector<uint8_t> copy(data);
+	copy.push_back(0); // 避免空数据包时取地址
+
+	if (rtp)
+	{
+		RTPPacketView view(&copy[0], data.size(), RTPTime(0,0));
+		return view.GetCreationError() == 0;
+	}
+	RTCPCompoundPacket pack(&copy[0], data.size(), false);
+	return pack.GetCreationError() == 0;
+}
+
+static bool ValidateOne(const vector<uint8_t> &data, bool rtp)
+{
+	RTPRawPacket *raw = MakeRawPacket(data, rtp);
+	bool valid = false;
+
+	RTPHeaderValidator::Validate(&raw, 1, &valid);
+	delete raw;
+	return valid;
+}
+
+// 头部大多合理、只有个别字段出错的随机数据包
+static vector<uint8_t> RandomPacket(bool rtp)
+{
+	size_t len = rand()%96;
+	vector<uint8_t> data(len);
+
+	for (size_t i = 0 ; i < len ; i++)
+		data[i] = (uint8_t)rand();
+	if (len > 0 && rand()%8 != 0)
+		data[0] = (uint8_t)((data[0]&0x3f)|0x80);
+	if (len > 1 && rand()%4 == 0)
+		data[1] = (uint8_t)(200+rand()%5);
+	if (!rtp && len > 3)
+	{
+		data[2] = 0;
+		data[3] = (uint8_t)(rand()%26);
+	}
+	if (len > 0 && rand()%4 == 0)
+		data[len-1] = (uint8_t)(rand()%8);
+	return data;
+}
+
+static void TestFuzz()
+{
+	const RTPHeaderValidator::Implementation impls[3] = { RTPHeaderValidator::Scalar, RTPHeaderValidator::SSE41, RTPHeaderValidator::AVX2 };
+	const size_t count = 37; // 不是批大小的倍数
+	bool agree = true, neverstricter = true;
+	size_t numvalid = 0, numtotal = 0;
+
+	srand(1234);
+	for (int round = 0 ; round < 2000 ; round++)
+	{
+		vector<vector<uint8_t> > data(count);
+		vector<bool> isrtp(count);
+		RTPRawPacket *packets[count];
+		bool results[3][count];
+
+		for (size_t i = 0 ; i < count ; i++)
+		{
+			isrtp[i] = (rand()%2 == 0);
+			data[i] = RandomPacket(isrtp[i]);
+			packets[i] = MakeRawPacket(data[i], isrtp[i]);
+		}
+
+		for (int k = 0 ; k < 3 ; k++)
+			RTPHeaderValidator::Validate(packets, count, results[k], impls[k]);
+
+		for (size_t i = 0 ; i < count ; i++)
+		{
+			if (results[1][i] != results[0][i] || results[2][i] != results[0][i])
+				agree = false;
+			if (!results[0][i] && IsParsed(data[i], isrtp[i]))
+				neverstricter = false;
+			if (results[0][i])
+				numvalid++;
+			numtotal++;
+			delete packets[i];
+		}
+	}
+
+	cout << "Implementation: " << (int)RTPHeaderValidator::GetBestImplementation() << ", "
+	     << numvalid << " of " << numtotal << " random packets passed" << endl;
+	Check("Implementations agree", agree);
+	Check("Never rejects a packet the parsers accept", neverstricter);
+	Check("Random packets of both kinds", numvalid > 0 && numvalid < numtotal);
+}
+
+static vector<uint8_t> MakeRTPPacket(bool padding, uint8_t numpadbytes)
+{
+	const uint32_t csrcs[2] = { 0x11111111, 0x22222222 };
+	const uint8_t payload[8] = { 0 };
+
+	RTPPacket pack(96, payload, sizeof(payload), 1, 1000, 0x12345678, false, 2, csrcs, false, 0, 0, 0, 0);
+	vector<uint8_t> data(pack.GetPacketData(), pack.GetPacketData()+pack.GetPacketLength());
+	if (padding)
+	{
+		data[0] |= 0x20;
+		data.back() = numpadbytes;
+	}
+	return data;
+}
+
+static void TestRTP()
+{
+	vector<uint8_t> good = MakeRTPPacket(false, 0);
+	Check("Valid RTP packet", ValidateOne(good, true) && IsParsed(good, true));
+
+	vector<uint8_t> bad = good;
+	bad[0] = (uint8_t)((bad[0]&0x3f)|0x40);
+	Check("Wrong version rejected", !ValidateOne(bad, true));
+
+	bad = good;
+	bad[1] = RTP_RTCPTYPE_SR;
+	Check("Marker and SR payload type rejected", !ValidateOne(bad, true));
+
+	bad = good;
+	bad[0] |= 0x0f; // 15 个 CSRC 超过了数据包
+	Check("CSRC count past the end rejected", !ValidateOne(bad, true));
+
+	bad = good;
+	bad[0] |= 0x10;
+	bad.resize(12+8+2);
+	Check("Extension header past the end rejected", !ValidateOne(bad, true));
+
+	Check("Padding accepted", ValidateOne(MakeRTPPacket(true, 8), true));
+	Check("Zero padding rejected", !ValidateOne(MakeRTPPacket(true, 0), true));
+	Check("Padding past the header rejected", !ValidateOne(MakeRTPPacket(true, 9), true));
+	Check("Short packet rejected", !ValidateOne(vector<uint8_t>(good.begin(), good.begin()+11), true) &&
+	      !ValidateOne(vector<uint8_t>(), true));
+}
+
+static void TestRTCP()
+{
+	// 一个没有报告块的 RR 加一个 BYE
+	const uint8_t compound[16] = { 0x80, 201, 0, 1, 1, 2, 3, 4, 0x81, 203, 0, 1, 1, 2, 3, 4 };
+	vector<uint8_t> good(compound, compound+sizeof(compound));
+	Check("Valid RTCP packet", ValidateOne(good, false) && IsParsed(good, false));
+	Check("RTCP packet on the RTP path rejected", !ValidateOne(good, true));
+
+	vector<uint8_t> bad = good;
+	bad[1] = 202;
+	Check("First packet not SR or RR rejected", !ValidateOne(bad, false));
+
+	bad = good;
+	bad[3] = 4;
+	Check("Length past the end rejected", !ValidateOne(bad, false));
+
+	bad = good;
+	bad[0] |= 0x20;
+	Check("Padding before the last packet rejected", !ValidateOne(bad, false));
+
+	bad = good;
+	bad[0] = 0x40|0x01;
+	Check("Wrong version rejected", !ValidateOne(bad, false));
+}
+
+int main(void)
+{
+	TestFuzz();
+	TestRTP();
+	TestRTCP();
+
+	return CheckSummary();
+}
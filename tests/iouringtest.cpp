@@ -0,0 +1,184 @@
+#include "rtpconfig.h"
+#include <iostream>
+
+#ifdef RTP_HAVE_IO_URING
+
+#include "media_rtp_utils.h"
+#include "media_rtp_session.h"
+#include "media_rtp_session_params.h"
+#include "media_rtp_errors.h"
+#include "media_rtp_source_data.h"
+#include "media_rtp_endpoint.h"
+#include "media_rtp_iouring_transmitter.h"
+#include "media_rtp_packet_factory.h"
+#include "rtptestcheck.h"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <vector>
+
+using namespace std;
+
+class MyRTPSession : public RTPSession
+{
+public:
+	MyRTPSession() : RTPSession(), m_count(0) { }
+	~MyRTPSession() { }
+
+	int GetPacketCount() const { return m_count; }
+protected:
+	void OnValidatedRTPPacket(RTPSourceData *srcdat, RTPPacket *rtppack, bool isonprobation, bool *ispackethandled)
+	{
+		m_count++;
+		DeletePacket(rtppack);
+		*ispackethandled = true;
+	}
+private:
+	int m_count;
+};
+
+class MyIOUringTransmitter : public RTPIOUringTransmitter
+{
+public:
+	MyIOUringTransmitter(const string &name) : RTPIOUringTransmitter(), m_name(name) { }
+protected:
+	void OnSendError(const RTPEndpoint &addr, bool rtp, int errcode)
+	{
+		cout << m_name << ": Error " << errcode << " sending " << ((rtp)?"RTP":"RTCP") << " data to port " << addr.GetRtpPort() << endl;
+	}
+private:
+	string m_name;
+};
+
+// 直接轮询传输器：数据包的数据和数据包对象都来自缓冲池，销毁传输器后仍然可以使用
+static void TestPooledPackets(uint16_t portbase)
+{
+	RTPIOUringTransmitter trans;
+	RTPIOUringTransmissionParams params;
+
+	params.SetPortbase(portbase);
+	checkerror(trans.Init(false));
+	checkerror(trans.Create(1400, &params));
+
+	int sock = socket(AF_INET, SOCK_DGRAM, 0);
+	struct sockaddr_in addr;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(portbase);
+
+	const int num = 20;
+	for (int i = 0 ; i < num ; i++)
+	{
+		uint8_t rtp[12+100] = { 0x80, 0x60, 0x00, (uint8_t)i, 0, 0, 0, 0, 0x12, 0x34, 0x56, 0x78 };
+		memset(rtp+12, i, 100);
+		sendto(sock, rtp, sizeof(rtp), 0, (struct sockaddr *)&addr, sizeof(addr));
+	}
+	RTPTime::Wait(RTPTime(0, 20000));
+	checkerror(trans.Poll());
+
+	vector<RTPRawPacket *> packets;
+	RTPRawPacket *pack;
+	bool pooled = true;
+
+	while ((pack = trans.GetNextPacket()) != 0)
+	{
+		if (!pack->IsDataPooled())
+			pooled = false;
+		packets.push_back(pack);
+	}
+	Check("Pooled: all packets received", packets.size() == (size_t)num);
+	Check("Pooled: packet data comes from the buffer pool", pooled);
+
+	// 数据在传输器销毁之后才检查，缓冲区环中的缓冲区早已被内核重用
+	trans.Destroy();
+
+	bool intact = true;
+	for (size_t i = 0 ; i < packets.size() ; i++)
+	{
+		const uint8_t *data = packets[i]->GetData();
+		if (packets[i]->GetDataLength() != 12+100 || data[3] != (uint8_t)i || data[12] != (uint8_t)i ||
+		    data[12+99] != (uint8_t)i || !packets[i]->IsRTP() ||
+		    packets[i]->GetSenderAddress()->GetRtpPort() == 0)
+			intact = false;
+		delete packets[i];
+	}
+	Check("Pooled: packets intact after the transmitter is destroyed", intact);
+	close(sock);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2)
+	{
+		cerr << "Usage: " << argv[0] << " portbase" << endl;
+		return -1;
+	}
+
+	uint16_t portbase = (uint16_t)atoi(argv[1]);
+
+	TestPooledPackets(portbase+10);
+
+	RTPSessionParams sessParams;
+	RTPIOUringTransmissionParams transParams1, transParams2;
+	MyIOUringTransmitter trans1("Transmitter1"), trans2("Transmitter2");
+	MyRTPSession sess1, sess2;
+
+	sessParams.SetProbationType(RTPSources::NoProbation);
+	sessParams.SetOwnTimestampUnit(1.0/8000.0);
+
+	transParams1.SetPortbase(portbase);
+	transParams2.SetPortbase(portbase+2);
+	transParams2.SetRTPReceiveBuffer(1024*1024);
+
+	bool threadsafe = true;
+
+	checkerror(trans1.Init(threadsafe));
+	checkerror(trans2.Init(threadsafe));
+	checkerror(trans1.Create(1400, &transParams1));
+	checkerror(trans2.Create(1400, &transParams2));
+
+	checkerror(sess1.Create(sessParams, &trans1));
+	cout << "Session 1 created " << endl;
+	checkerror(sess2.Create(sessParams, &trans2));
+	cout << "Session 2 created " << endl;
+
+	checkerror(sess1.AddDestination(RTPEndpoint(ntohl(inet_addr("127.0.0.1")), portbase+2)));
+	checkerror(sess2.AddDestination(RTPEndpoint(ntohl(inet_addr("127.0.0.1")), portbase)));
+
+	vector<uint8_t> pack(160);
+	int num = 100;
+
+	for (int i = 1 ; i <= num ; i++)
+	{
+		checkerror(sess1.SendPacket((void *)&pack[0],pack.size(),0,false,160));
+		if (i%10 == 0)
+			RTPTime::Wait(RTPTime(0,10000));
+	}
+
+	// 后台线程会接收数据包并调用 OnValidatedRTPPacket
+	RTPTime::Wait(RTPTime(1,0));
+
+	cout << "Received " << sess2.GetPacketCount() << "/" << num << " packets" << endl;
+
+	Check("Session: all packets received", sess2.GetPacketCount() == num);
+
+	sess1.BYEDestroy(RTPTime(1,0),0,0);
+	sess2.BYEDestroy(RTPTime(1,0),0,0);
+
+	return CheckSummary();
+}
+
+#else
+
+int main(void)
+{
+	std::cerr << "io_uring support was not enabled at compile time" << std::endl;
+	return 0;
+}
+
+#endif // RTP_HAVE_IO_URING
@@ -0,0 +1,341 @@
+#include "rtpconfig.h"
+#include <iostream>
+
+#ifdef RTP_HAVE_SO_ATTACH_FILTER
+
+#include "media_rtp_utils.h"
+#include "media_rtp_errors.h"
+#include "media_rtp_endpoint.h"
+#include "media_rtp_udpv4_transmitter.h"
+#include "media_rtp_session.h"
+#include "media_rtp_session_params.h"
+#include "media_rtp_packet_factory.h"
+#include "rtptestcheck.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <string>
+#include <atomic>
+
+using namespace std;
+
+static int CreateSender(uint16_t port, uint32_t ip = INADDR_LOOPBACK)
+{
+	int sock = socket(AF_INET,SOCK_DGRAM,0);
+	struct sockaddr_in addr;
+
+	memset(&addr,0,sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(ip);
+	addr.sin_port = htons(port);
+	if (sock < 0 || bind(sock,(struct sockaddr *)&addr,sizeof(addr)) != 0)
+	{
+		cerr << "Can't create sender socket on port " << port << endl;
+		exit(-1);
+	}
+	return sock;
+}
+
+// 从 sender 发送一个数据报，然后直接从接收套接字上读取：数据报被内核中的过滤程序
+// 丢弃时，套接字上没有任何数据
+static bool IsDelivered(int sender, int receiver, uint16_t destport, const uint8_t *data, size_t len)
+{
+	struct sockaddr_in addr;
+
+	memset(&addr,0,sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(destport);
+	sendto(sender,data,len,0,(struct sockaddr *)&addr,sizeof(addr));
+	RTPTime::Wait(RTPTime(0,20000));
+
+	uint8_t buf[2048];
+	bool delivered = false;
+	while (recv(receiver,buf,sizeof(buf),MSG_DONTWAIT) >= 0)
+		delivered = true;
+	return delivered;
+}
+
+static void Check(const string &what, bool delivered, bool expected)
+{
+	cout << what << ": " << ((delivered)?"delivered":"dropped") << endl;
+	if (delivered != expected)
+	{
+		cerr << "  expected " << ((expected)?"delivered":"dropped") << endl;
+		numfailed++;
+	}
+}
+
+// 从 sender 发送一个数据报，由传输器在用户空间按列表检查后返回是否进入了队列
+static bool IsQueued(RTPUDPv4Transmitter &trans, int sender, uint16_t destport, const uint8_t *data, size_t len)
+{
+	struct sockaddr_in addr;
+
+	memset(&addr,0,sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(destport);
+	sendto(sender,data,len,0,(struct sockaddr *)&addr,sizeof(addr));
+	RTPTime::Wait(RTPTime(0,20000));
+	checkerror(trans.Poll());
+
+	bool queued = false;
+	RTPRawPacket *pack;
+	while ((pack = trans.GetNextPacket()) != 0)
+	{
+		queued = true;
+		delete pack;
+	}
+	return queued;
+}
+
+// IPv4 选择了所有端口的地址很多时程序仍然完整；超过内核的长度限制时程序只检查格式，
+// 传输器报告这一点，列表在用户空间照常检查
+static void TestLargeLists(uint16_t portbase)
+{
+	uint16_t portA = portbase+10, portB = portbase+12;
+	RTPUDPv4Transmitter trans;
+	RTPUDPv4TransmissionParams params;
+
+	params.SetPortbase(portbase);
+	params.SetKernelPacketFilter(true);
+	checkerror(trans.Init(true));
+	checkerror(trans.Create(1400,&params));
+
+	RTPUDPv4TransmissionInfo *inf = (RTPUDPv4TransmissionInfo *)trans.GetTransmissionInfo();
+	int rtpsock = inf->GetRTPSocket();
+	trans.DeleteTransmissionInfo(inf);
+
+	int senderA = CreateSender(portA);
+	int senderB = CreateSender(portB);
+	int senderC = CreateSender(portA,INADDR_LOOPBACK+1); // 127.0.0.2
+	uint8_t rtp[12] = { 0x80, 0x60, 0x00, 0x01, 0, 0, 0, 0, 0x12, 0x34, 0x56, 0x78 };
+	uint8_t junk[12] = { 'n', 'o', 't', ' ', 'r', 't', 'p', ' ', 'd', 'a', 't', 'a' };
+
+	// 127.0.0.2 在排序后的地址中间，选择所有端口；127.0.0.1 只选择端口 A
+	checkerror(trans.SetReceiveMode(RTPTransmitter::AcceptSome));
+	for (uint32_t i = 0 ; i < 2000 ; i++)
+		checkerror(trans.AddToAcceptList(RTPEndpoint(0x0a000000+i,0)));
+	for (uint32_t i = 0 ; i < 1000 ; i++)
+		checkerror(trans.AddToAcceptList(RTPEndpoint(0xc8000000+i,0)));
+	checkerror(trans.AddToAcceptList(RTPEndpoint(INADDR_LOOPBACK+1,0)));
+	checkerror(trans.AddToAcceptList(RTPEndpoint(INADDR_LOOPBACK,portA)));
+	checkerror(trans.Poll());
+
+	Check("3002 addresses: program complete", trans.IsKernelFilterComplete());
+	Check("3002 addresses, all ports",IsDelivered(senderC,rtpsock,portbase,rtp,sizeof(rtp)),true);
+	Check("3002 addresses, listed port",IsDelivered(senderA,rtpsock,portbase,rtp,sizeof(rtp)),true);
+	Check("3002 addresses, other port",IsDelivered(senderB,rtpsock,portbase,rtp,sizeof(rtp)),false);
+
+	// 超过长度限制：内核只检查格式，未选择的数据报在用户空间丢弃
+	for (uint32_t i = 0 ; i < 3000 ; i++)
+		checkerror(trans.AddToAcceptList(RTPEndpoint(0xac100000+i,0)));
+	checkerror(trans.Poll());
+
+	Check("6002 addresses: program incomplete", !trans.IsKernelFilterComplete());
+	Check("6002 addresses, other port passes the kernel",IsDelivered(senderB,rtpsock,portbase,rtp,sizeof(rtp)),true);
+	Check("6002 addresses, wrong version",IsDelivered(senderB,rtpsock,portbase,junk,sizeof(junk)),false);
+	Check("6002 addresses: other port dropped in user space", !IsQueued(trans,senderB,portbase,rtp,sizeof(rtp)));
+	Check("6002 addresses: listed port queued", IsQueued(trans,senderA,portbase,rtp,sizeof(rtp)));
+	Check("6002 addresses: all ports queued", IsQueued(trans,senderC,portbase,rtp,sizeof(rtp)));
+
+	// 列表变短后程序重新包含所有条目
+	trans.ClearAcceptList();
+	checkerror(trans.AddToAcceptList(RTPEndpoint(INADDR_LOOPBACK,portA)));
+	checkerror(trans.Poll());
+	Check("Short list again: program complete", trans.IsKernelFilterComplete());
+	Check("Short list again, other port",IsDelivered(senderB,rtpsock,portbase,rtp,sizeof(rtp)),false);
+
+	close(senderA);
+	close(senderB);
+	close(senderC);
+	trans.Destroy();
+}
+
+// 逐个添加大量条目：每次添加只作标记，程序在 Poll 中只生成一次
+static void TestManyEntries(uint16_t portbase)
+{
+	const int numEntries = 500;
+	uint16_t portA = portbase+10, portB = portbase+12;
+	RTPUDPv4Transmitter trans;
+	RTPUDPv4TransmissionParams params;
+
+	params.SetPortbase(portbase);
+	params.SetKernelPacketFilter(true);
+	checkerror(trans.Init(true));
+	checkerror(trans.Create(1400,&params));
+
+	RTPUDPv4TransmissionInfo *inf = (RTPUDPv4TransmissionInfo *)trans.GetTransmissionInfo();
+	int rtpsock = inf->GetRTPSocket();
+	trans.DeleteTransmissionInfo(inf);
+
+	int senderA = CreateSender(portA);
+	int senderB = CreateSender(portB);
+	uint8_t rtp[12] = { 0x80, 0x60, 0x00, 0x01, 0, 0, 0, 0, 0x12, 0x34, 0x56, 0x78 };
+
+	checkerror(trans.SetReceiveMode(RTPTransmitter::AcceptSome));
+
+	double start = RTPTime::CurrentTime().GetDouble();
+	for (int i = 0 ; i < numEntries ; i++)
+		checkerror(trans.AddToAcceptList(RTPEndpoint(0x0a000000+(uint32_t)i,5000)));
+	checkerror(trans.AddToAcceptList(RTPEndpoint(INADDR_LOOPBACK,portA)));
+	double addtime = RTPTime::CurrentTime().GetDouble()-start;
+
+	start = RTPTime::CurrentTime().GetDouble();
+	checkerror(trans.Poll());
+	double polltime = RTPTime::CurrentTime().GetDouble()-start;
+
+	cout << numEntries+1 << " entries added in " << addtime << " s, program built in " << polltime << " s" << endl;
+	Check("Many entries: adding does not rebuild the program each time", addtime < 0.1);
+	Check("Many entries, listed port",IsDelivered(senderA,rtpsock,portbase,rtp,sizeof(rtp)),true);
+	Check("Many entries, other port",IsDelivered(senderB,rtpsock,portbase,rtp,sizeof(rtp)),false);
+
+	close(senderA);
+	close(senderB);
+	trans.Destroy();
+}
+
+class CountingSession : public RTPSession
+{
+public:
+	CountingSession() : RTPSession(), numreceived(0) { }
+
+	atomic<int> numreceived;
+protected:
+	void OnValidatedRTPPacket(RTPSourceData *, RTPPacket *rtppack, bool, bool *ispackethandled)
+	{
+		numreceived++;
+		DeletePacket(rtppack);
+		*ispackethandled = true;
+	}
+};
+
+// 轮询线程在等待数据时，新接受的来源不必等到等待超时才能通过内核中的程序
+static void TestWakeWaiter(uint16_t portbase)
+{
+	const int numPackets = 5;
+	RTPSessionParams sessParams;
+	sessParams.SetProbationType(RTPSources::NoProbation);
+	sessParams.SetOwnTimestampUnit(1.0/8000.0);
+
+	RTPUDPv4TransmissionParams recvParams;
+	recvParams.SetPortbase(portbase);
+	recvParams.SetKernelPacketFilter(true);
+
+	CountingSession receiver;
+	checkerror(receiver.Create(sessParams,&recvParams));
+	checkerror(receiver.SetReceiveMode(RTPTransmitter::AcceptSome));
+
+	RTPUDPv4TransmissionParams sendParams;
+	sendParams.SetPortbase(portbase+20);
+
+	RTPSession sender;
+	checkerror(sender.Create(sessParams,&sendParams));
+	checkerror(sender.AddDestination(RTPEndpoint(INADDR_LOOPBACK,portbase)));
+
+	// 让轮询线程进入等待，第一个 RTCP 数据包要几秒后才发送
+	RTPTime::Wait(RTPTime(0,200000));
+	checkerror(receiver.AddToAcceptList(RTPEndpoint(INADDR_LOOPBACK,portbase+20)));
+	RTPTime::Wait(RTPTime(0,50000));
+
+	uint8_t payload[160] = { 0 };
+	for (int i = 0 ; i < numPackets ; i++)
+		checkerror(sender.SendPacket(payload,sizeof(payload),0,false,160));
+	for (int i = 0 ; i < 50 && receiver.numreceived < numPackets ; i++)
+		RTPTime::Wait(RTPTime(0,10000));
+
+	cout << receiver.numreceived << " of " << numPackets << " packets received after the accept list changed" << endl;
+	Check("Waiting poll thread rebuilds the program", receiver.numreceived == numPackets);
+
+	sender.BYEDestroy(RTPTime(0,100000),0,0);
+	receiver.BYEDestroy(RTPTime(0,100000),0,0);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2)
+	{
+		cerr << "Usage: " << argv[0] << " portbase" << endl;
+		return -1;
+	}
+
+	uint16_t portbase = (uint16_t)atoi(argv[1]);
+	uint16_t portA = portbase+10, portB = portbase+12;
+	uint32_t localhost = INADDR_LOOPBACK;
+
+	RTPUDPv4Transmitter trans;
+	RTPUDPv4TransmissionParams params;
+
+	params.SetPortbase(portbase);
+	params.SetKernelPacketFilter(true);
+	checkerror(trans.Init(false));
+	checkerror(trans.Create(1400,&params));
+
+	RTPUDPv4TransmissionInfo *inf = (RTPUDPv4TransmissionInfo *)trans.GetTransmissionInfo();
+	int rtpsock = inf->GetRTPSocket();
+	trans.DeleteTransmissionInfo(inf);
+
+	int senderA = CreateSender(portA);
+	int senderB = CreateSender(portB);
+
+	uint8_t rtp[12] = { 0x80, 0x60, 0x00, 0x01, 0, 0, 0, 0, 0x12, 0x34, 0x56, 0x78 };
+	uint8_t junk[12] = { 'n', 'o', 't', ' ', 'r', 't', 'p', ' ', 'd', 'a', 't', 'a' };
+
+	// 接受所有来源时，只检查数据报格式
+	Check("AcceptAll, RTP packet",IsDelivered(senderA,rtpsock,portbase,rtp,sizeof(rtp)),true);
+	Check("AcceptAll, wrong version",IsDelivered(senderA,rtpsock,portbase,junk,sizeof(junk)),false);
+	Check("AcceptAll, too short",IsDelivered(senderA,rtpsock,portbase,rtp,4),false);
+
+	// 列表变化后，程序在下一次 Poll 时重新生成
+	checkerror(trans.SetReceiveMode(RTPTransmitter::AcceptSome));
+	checkerror(trans.Poll());
+	Check("AcceptSome, empty list",IsDelivered(senderA,rtpsock,portbase,rtp,sizeof(rtp)),false);
+
+	checkerror(trans.AddToAcceptList(RTPEndpoint(localhost,portA)));
+	checkerror(trans.Poll());
+	Check("AcceptSome, listed port",IsDelivered(senderA,rtpsock,portbase,rtp,sizeof(rtp)),true);
+	Check("AcceptSome, listed port, wrong version",IsDelivered(senderA,rtpsock,portbase,junk,sizeof(junk)),false);
+	Check("AcceptSome, other port",IsDelivered(senderB,rtpsock,portbase,rtp,sizeof(rtp)),false);
+
+	// 选择所有端口，再把 B 的端口作为例外删除
+	checkerror(trans.AddToAcceptList(RTPEndpoint(localhost,0)));
+	checkerror(trans.Poll());
+	Check("AcceptSome, all ports",IsDelivered(senderB,rtpsock,portbase,rtp,sizeof(rtp)),true);
+	checkerror(trans.DeleteFromAcceptList(RTPEndpoint(localhost,portB)));
+	checkerror(trans.Poll());
+	Check("AcceptSome, all ports, excepted port",IsDelivered(senderB,rtpsock,portbase,rtp,sizeof(rtp)),false);
+	Check("AcceptSome, all ports, other port",IsDelivered(senderA,rtpsock,portbase,rtp,sizeof(rtp)),true);
+
+	checkerror(trans.SetReceiveMode(RTPTransmitter::IgnoreSome));
+	checkerror(trans.AddToIgnoreList(RTPEndpoint(localhost,portA)));
+	checkerror(trans.Poll());
+	Check("IgnoreSome, ignored port",IsDelivered(senderA,rtpsock,portbase,rtp,sizeof(rtp)),false);
+	Check("IgnoreSome, other port",IsDelivered(senderB,rtpsock,portbase,rtp,sizeof(rtp)),true);
+	trans.ClearIgnoreList();
+	checkerror(trans.Poll());
+	Check("IgnoreSome, cleared list",IsDelivered(senderA,rtpsock,portbase,rtp,sizeof(rtp)),true);
+
+	close(senderA);
+	close(senderB);
+	trans.Destroy();
+
+	TestManyEntries(portbase+30);
+	TestWakeWaiter(portbase+60);
+	TestLargeLists(portbase+90);
+
+	return CheckSummary();
+}
+
+#else
+
+int main(void)
+{
+	std::cerr << "SO_ATTACH_FILTER support was not enabled at compile time" << std::endl;
+	return 0;
+}
+
+#endif // RTP_HAVE_SO_ATTACH_FILTER
@@ -0,0 +1,233 @@
+#include "media_rtp_sources.h"
+#include "media_rtp_source_data.h"
+#include "media_rtp_packet_factory.h"
+#include "media_rtp_endpoint.h"
+#include "media_rtp_errors.h"
+#include "media_rtp_utils.h"
+#include "rtptestcheck.h"
+#include <netinet/in.h>
+#include <string.h>
+#include <stdlib.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define TESTSSRC 0x12345678
+
+// 带两个 CSRC 和一个两字长的头部扩展的数据包
+static vector<uint8_t> MakePacket(uint16_t seqnr, size_t payloadlen)
+{
+	const uint32_t csrcs[2] = { 0x11111111, 0x22222222 };
+	const uint8_t extension[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+	vector<uint8_t> payload(payloadlen, 0x5a);
+
+	RTPPacket pack(96,&payload[0],payload.size(),seqnr,1000+seqnr,TESTSSRC,true,2,csrcs,true,0xbede,2,extension,0);
+	checkerror(pack.GetCreationError());
+	return vector<uint8_t>(pack.GetPacketData(), pack.GetPacketData()+pack.GetPacketLength());
+}
+
+static RTPRawPacket *MakeRawPacket(const vector<uint8_t> &data)
+{
+	uint8_t *buf = new uint8_t[data.size()];
+	memcpy(buf, &data[0], data.size());
+	return new RTPRawPacket(buf, data.size(), false, RTPEndpoint(INADDR_LOOPBACK,5000), RTPTime(10,0), true);
+}
+
+static bool IsValid(vector<uint8_t> data)
+{
+	RTPPacketView view(&data[0], data.size(), RTPTime(0,0));
+	return view.GetCreationError() == 0;
+}
+
+static void TestView()
+{
+	vector<uint8_t> data = MakePacket(4321, 100);
+	RTPRawPacket *rawpack = MakeRawPacket(data);
+	RTPPacketView view(*rawpack);
+
+	Check("View created", view.GetCreationError() == 0);
+	Check("View header fields", view.GetPayloadType() == 96 && view.HasMarker() && view.GetSequenceNumber() == 4321 &&
+	      view.GetExtendedSequenceNumber() == 4321 && view.GetTimestamp() == 1000+4321 && view.GetSSRC() == TESTSSRC);
+	Check("View CSRCs", view.GetCSRCCount() == 2 && view.GetCSRC(0) == 0x11111111 && view.GetCSRC(1) == 0x22222222 &&
+	      view.GetCSRC(2) == 0);
+	Check("View extension", view.HasExtension() && view.GetExtensionID() == 0xbede && view.GetExtensionLength() == 8 &&
+	      view.GetExtensionData()[0] == 1 && view.GetExtensionData()[7] == 8);
+	Check("View payload", view.GetPayloadLength() == 100 && view.GetPayloadData()[0] == 0x5a &&
+	      view.GetPayloadData() == view.GetPacketData()+12+8+12 && view.GetPacketLength() == data.size());
+	Check("View points into the raw buffer", view.GetPacketData() == rawpack->GetData() &&
+	      view.GetReceiveTime().GetDouble() == 10.0);
+
+	// 从视图创建的实例接管缓冲区，字段与视图相同
+	view.SetExtendedSequenceNumber(0x10000+4321);
+	const uint8_t *buffer = rawpack->GetData();
+	RTPPacket pack(view, *rawpack);
+	Check("Packet created from the view", pack.GetCreationError() == 0 && pack.GetPacketData() == buffer &&
+	      rawpack->GetData() == 0);
+	Check("Packet fields match the view", pack.GetExtendedSequenceNumber() == 0x10000+4321 && pack.GetSSRC() == TESTSSRC &&
+	      pack.GetCSRC(1) == 0x22222222 && pack.GetExtensionID() == 0xbede && pack.GetExtensionLength() == 8 &&
+	      pack.GetPayloadLength() == 100 && pack.GetPayloadData() == buffer+32 && pack.HasMarker());
+
+	// 视图不是在该原始数据包上创建的
+	RTPRawPacket *other = MakeRawPacket(data);
+	RTPPacket mismatch(view, *other);
+	Check("Packet needs the raw packet of the view", mismatch.GetCreationError() == MEDIA_RTP_ERR_INVALID_PARAMETER &&
+	      other->GetData() != 0);
+
+	// 在已有实例上创建的视图
+	RTPPacketView packview(pack);
+	Check("View on a packet", packview.GetCreationError() == 0 && packview.GetExtendedSequenceNumber() == 0x10000+4321 &&
+	      packview.GetPayloadLength() == 100);
+
+	delete other;
+	delete rawpack;
+}
+
+static void TestValidation()
+{
+	vector<uint8_t> good = MakePacket(1, 10);
+	Check("Valid packet accepted", IsValid(good));
+
+	Check("Short packet rejected", !IsValid(vector<uint8_t>(good.begin(), good.begin()+11)));
+
+	vector<uint8_t> data = good;
+	data[0] = (data[0]&0x3f)|0x40;
+	Check("Wrong version rejected", !IsValid(data));
+
+	data = good;
+	data[1] = 0x80|(200&127);
+	Check("RTCP SR rejected", !IsValid(data));
+
+	data = good;
+	data[0] |= 0x20;
+	data.back() = 0;
+	Check("Zero padding rejected", !IsValid(data));
+
+	data = good;
+	data[0] |= 0x20;
+	data.back() = 10;
+	Check("Padding with payload accepted", IsValid(data));
+	data.back() = 200;
+	Check("Padding past the header rejected", !IsValid(data));
+
+	// 头部扩展的头部不在数据包内
+	data = vector<uint8_t>(good.begin(), good.begin()+12+8+2);
+	Check("Truncated extension header rejected", !IsValid(data));
+
+	data = good;
+	data[12+8+2] = 0xff;
+	Check("Extension past the end rejected", !IsValid(data));
+
+	// 不在 RTP 端口上收到的数据
+	uint8_t *buf = new uint8_t[good.size()];
+	memcpy(buf, &good[0], good.size());
+	RTPRawPacket rtcp(buf, good.size(), false, RTPEndpoint(INADDR_LOOPBACK,5000), RTPTime(0,0), false);
+	RTPPacketView view(rtcp);
+	Check("RTCP raw packet rejected", view.GetCreationError() == MEDIA_RTP_ERR_PROTOCOL_ERROR);
+}
+
+// 偶数序列号的数据包在视图上处理，奇数序列号的数据包留给 OnValidatedRTPPacket
+class ViewSources : public RTPSources
+{
+public:
+	ViewSources() : RTPSources(RTPSources::NoProbation), m_numSeen(0), m_numHandled(0), m_numValidated(0), m_extensionsOK(true) { }
+
+	int m_numSeen, m_numHandled, m_numValidated;
+	bool m_extensionsOK;
+protected:
+	void OnRTPPacketView(const RTPPacketView &, const RTPTime &, const RTPEndpoint *)
+	{
+		m_numSeen++;
+	}
+
+	void OnValidatedRTPPacketView(RTPSourceData *, const RTPPacketView &view, bool, bool *ispackethandled)
+	{
+		if (view.GetExtensionID() != 0xbede || view.GetCSRC(0) != 0x11111111)
+			m_extensionsOK = false;
+		if (view.GetSequenceNumber()%2 == 0)
+		{
+			m_numHandled++;
+			*ispackethandled = true;
+		}
+	}
+
+	void OnValidatedRTPPacket(RTPSourceData *, RTPPacket *rtppack, bool, bool *)
+	{
+		if (rtppack->GetSequenceNumber()%2 == 1)
+			m_numValidated++;
+	}
+};
+
+static void TestSources()
+{
+	ViewSources sources;
+	RTPRawPacket *rawpack;
+
+	for (uint16_t i = 1 ; i <= 10 ; i++)
+	{
+		rawpack = MakeRawPacket(MakePacket(i, 20));
+		checkerror(sources.ProcessRawPacket(rawpack, (RTPTransmitter *)0, false));
+
+		// 在视图上处理的数据包的缓冲区仍然属于原始数据包
+		Check("Buffer kept by the raw packet", (i%2 == 0) == (rawpack->GetData() != 0));
+		delete rawpack;
+	}
+
+	Check("Every packet seen", sources.m_numSeen == 10 && sources.m_extensionsOK);
+	Check("Handled on the view", sources.m_numHandled == 5);
+	Check("Others reach OnValidatedRTPPacket", sources.m_numValidated == 5);
+
+	RTPSourceData *srcdat = sources.GetSourceInfo(TESTSSRC);
+	string seqnrs;
+	RTPPacket *pack;
+	while (srcdat != 0 && (pack = srcdat->GetNextPacket()) != 0)
+	{
+		seqnrs += to_string(pack->GetSequenceNumber())+" ";
+		delete pack;
+	}
+	Check("Only kept packets are queued", seqnrs == "1 3 5 7 9 ");
+	Check("CSRCs processed", sources.GetSourceInfo(0x22222222) != 0);
+}
+
+// 只重写了原来的 OnRTPPacket 的应用程序
+class LegacySources : public RTPSources
+{
+public:
+	LegacySources() : RTPSources(RTPSources::NoProbation), m_lastData(0) { }
+
+	string m_seqnrs;
+	const uint8_t *m_lastData;
+protected:
+	void OnRTPPacket(RTPPacket *pack, const RTPTime &, const RTPEndpoint *)
+	{
+		m_seqnrs += to_string(pack->GetSequenceNumber())+" ";
+		m_lastData = pack->GetPacketData();
+	}
+};
+
+static void TestLegacyCallback()
+{
+	LegacySources sources;
+
+	for (uint16_t i = 1 ; i <= 3 ; i++)
+	{
+		RTPRawPacket *rawpack = MakeRawPacket(MakePacket(i, 20));
+		const uint8_t *data = rawpack->GetData();
+
+		checkerror(sources.ProcessRawPacket(rawpack, (RTPTransmitter *)0, false));
+		Check("Old callback uses the receive buffer", sources.m_lastData == data);
+		delete rawpack;
+	}
+	Check("Old callback still called", sources.m_seqnrs == "1 2 3 ");
+}
+
+int main(void)
+{
+	TestView();
+	TestValidation();
+	TestSources();
+	TestLegacyCallback();
+
+	return CheckSummary();
+}
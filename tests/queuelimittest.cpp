@@ -0,0 +1,326 @@
+#include "media_rtp_sources.h"
+#include "media_rtp_source_data.h"
+#include "media_rtp_packet_factory.h"
+#include "media_rtp_udpv4_transmitter.h"
+#include "media_rtp_endpoint.h"
+#include "media_rtp_errors.h"
+#include "media_rtp_utils.h"
+#include "rtptestcheck.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <iostream>
+#include <list>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define TESTSSRC 0x12345678
+
+// 载荷的第一个字节为 'K' 的数据包属于关键帧
+class KeyFrameSources : public RTPSources
+{
+public:
+	KeyFrameSources() : RTPSources(RTPSources::NoProbation), numcalls(0) { }
+
+	bool IsKeyFramePacket(RTPSourceData *, RTPPacket *rtppack)
+	{
+		numcalls++;
+		return (rtppack->GetPayloadLength() > 0 && rtppack->GetPayloadData()[0] == 'K');
+	}
+
+	size_t numcalls;
+};
+
+static void AddPacket(RTPSources &sources, uint16_t seqnr, bool marker, char kind = 'P', size_t payloadlen = 100)
+{
+	vector<uint8_t> payload(payloadlen,0);
+	payload[0] = (uint8_t)kind;
+
+	RTPPacket *pack = new RTPPacket(96,&payload[0],payload.size(),seqnr,seqnr*10,TESTSSRC,marker,0,0,false,0,0,0,0);
+	checkerror(pack->GetCreationError());
+
+	RTPEndpoint addr(INADDR_LOOPBACK,5000);
+	bool stored = false;
+	checkerror(sources.ProcessRTPPacket(pack,RTPTime::CurrentTime(),&addr,&stored));
+	if (!stored)
+		delete pack;
+}
+
+// 返回队列中数据包的序列号，各个序列号用空格分隔
+static string GetQueuedSequenceNumbers(RTPSources &sources)
+{
+	RTPSourceData *srcdat = sources.GetSourceInfo(TESTSSRC);
+	string s;
+	RTPPacket *pack;
+
+	if (srcdat == 0)
+		return s;
+	while ((pack = srcdat->GetNextPacket()) != 0)
+	{
+		if (!s.empty())
+			s += " ";
+		s += to_string(pack->GetSequenceNumber());
+		delete pack;
+	}
+	return s;
+}
+
+static void TestSourceQueues()
+{
+	{
+		RTPSources sources(RTPSources::NoProbation);
+		sources.SetPacketQueueLimits(4,0,RTPSources::DropOldest);
+		for (uint16_t i = 1 ; i <= 10 ; i++)
+			AddPacket(sources,i,true);
+
+		RTPSourceData *srcdat = sources.GetSourceInfo(TESTSSRC);
+		Check("DropOldest, dropped count",srcdat != 0 && srcdat->INF_GetNumDroppedPackets() == 6 && sources.GetNumDroppedPackets() == 6);
+		Check("DropOldest, queued bytes",srcdat != 0 && srcdat->INF_GetNumQueuedBytes() == 4*(12+100));
+		Check("DropOldest, newest packets kept",GetQueuedSequenceNumbers(sources) == "7 8 9 10");
+		Check("DropOldest, queued bytes after reading",srcdat != 0 && srcdat->INF_GetNumQueuedBytes() == 0);
+	}
+
+	{
+		RTPSources sources(RTPSources::NoProbation);
+		sources.SetPacketQueueLimits(4,0,RTPSources::DropNewest);
+		for (uint16_t i = 1 ; i <= 10 ; i++)
+			AddPacket(sources,i,true);
+
+		Check("DropNewest, dropped count",sources.GetNumDroppedPackets() == 6 && sources.GetNumDroppedBytes() == 6*(12+100));
+		Check("DropNewest, oldest packets kept",GetQueuedSequenceNumbers(sources) == "1 2 3 4");
+	}
+
+	{
+		// 字节数的限制：三个112字节的数据包
+		RTPSources sources(RTPSources::NoProbation);
+		sources.SetPacketQueueLimits(0,3*(12+100),RTPSources::DropOldest);
+		for (uint16_t i = 1 ; i <= 5 ; i++)
+			AddPacket(sources,i,true);
+		Check("Byte limit",GetQueuedSequenceNumbers(sources) == "3 4 5");
+
+		// 比字节限制还大的数据包仍然可以单独放入队列
+		AddPacket(sources,6,true,'P',1000);
+		Check("Byte limit, oversized packet",GetQueuedSequenceNumbers(sources) == "6");
+	}
+
+	{
+		// 每帧两个数据包，第二个数据包设置了标记位；第一帧是关键帧
+		KeyFrameSources sources;
+		sources.SetPacketQueueLimits(6,0,RTPSources::DropNonKeyFrames);
+		AddPacket(sources,1,false,'K');
+		AddPacket(sources,2,true,'K');
+		for (uint16_t i = 3 ; i <= 8 ; i += 2)
+		{
+			AddPacket(sources,i,false);
+			AddPacket(sources,i+1,true);
+		}
+		// 第七个数据包使队列超过限制，最旧的非关键帧（3和4）被整帧丢弃
+		Check("DropNonKeyFrames, whole frame dropped",GetQueuedSequenceNumbers(sources) == "1 2 5 6 7 8");
+		Check("DropNonKeyFrames, dropped count",sources.GetNumDroppedPackets() == 2);
+	}
+
+	{
+		// 只有关键帧和未结束的帧时丢弃最旧的数据包
+		KeyFrameSources sources;
+		sources.SetPacketQueueLimits(2,0,RTPSources::DropNonKeyFrames);
+		AddPacket(sources,1,true,'K');
+		AddPacket(sources,2,false);
+		AddPacket(sources,3,false);
+		Check("DropNonKeyFrames, fallback to oldest",GetQueuedSequenceNumbers(sources) == "2 3");
+	}
+
+	{
+		// 队列前部是大量关键帧时，每次超过限制都不应该重新检查它们
+		KeyFrameSources sources;
+		sources.SetPacketQueueLimits(1000,0,RTPSources::DropNonKeyFrames);
+		for (uint16_t i = 1 ; i < 1000 ; i++)
+			AddPacket(sources,i,true,'K');
+		for (uint16_t i = 1000 ; i < 6000 ; i++)
+			AddPacket(sources,i,true);
+
+		RTPSourceData *srcdat = sources.GetSourceInfo(TESTSSRC);
+		Check("DropNonKeyFrames, key frames kept",srcdat != 0 && srcdat->INF_GetNumQueuedPackets() == 1000 &&
+		      sources.GetNumDroppedPackets() == 5000-1);
+		Check("DropNonKeyFrames, linear number of key frame checks",sources.numcalls < 4*6000);
+	}
+}
+
+// 原来每次从队首重新检查的丢弃算法，用来验证增量的实现
+struct ModelPacket
+{
+	uint16_t seqnr;
+	bool marker, key;
+};
+
+static void ModelDropNonKeyFrame(list<ModelPacket> &queue, size_t &numdropped)
+{
+	list<ModelPacket>::iterator it, framestart = queue.begin();
+	bool keyframe = false;
+
+	for (it = queue.begin() ; it != queue.end() ; ++it)
+	{
+		if (it->key)
+			keyframe = true;
+		if (!it->marker)
+			continue;
+
+		++it;
+		if (!keyframe)
+		{
+			while (framestart != it)
+			{
+				framestart = queue.erase(framestart);
+				numdropped++;
+			}
+			return;
+		}
+		framestart = it;
+		--it;
+		keyframe = false;
+	}
+
+	// 没有完整的非关键帧，丢弃最旧的数据包
+	queue.pop_front();
+	numdropped++;
+}
+
+static void ModelAddPacket(list<ModelPacket> &queue, const ModelPacket &pack, size_t maxpackets, size_t &numdropped)
+{
+	list<ModelPacket>::iterator it = queue.end();
+
+	while (it != queue.begin())
+	{
+		--it;
+		if (it->seqnr == pack.seqnr)
+			return;
+		if (it->seqnr < pack.seqnr)
+		{
+			++it;
+			break;
+		}
+	}
+	queue.insert(it,pack);
+
+	while (queue.size() > 1 && queue.size() > maxpackets)
+		ModelDropNonKeyFrame(queue,numdropped);
+}
+
+static void TestDropNonKeyFramesRandom()
+{
+	bool ok = true;
+
+	srand(2468);
+	for (int round = 0 ; round < 200 && ok ; round++)
+	{
+		KeyFrameSources sources;
+		size_t maxpackets = 3+rand()%10;
+		list<ModelPacket> queue;
+		size_t numdropped = 0;
+		uint16_t next = 1000;
+
+		sources.SetPacketQueueLimits(maxpackets,0,RTPSources::DropNonKeyFrames);
+		for (int i = 0 ; i < 400 && ok ; i++)
+		{
+			if (rand()%5 == 0)
+			{
+				// 读取队首的数据包
+				RTPSourceData *srcdat = sources.GetSourceInfo(TESTSSRC);
+				RTPPacket *pack = (srcdat == 0)?0:srcdat->GetNextPacket();
+
+				if ((pack == 0) != queue.empty())
+					ok = false;
+				else if (pack != 0)
+				{
+					if (pack->GetSequenceNumber() != queue.front().seqnr)
+						ok = false;
+					queue.pop_front();
+				}
+				delete pack;
+				continue;
+			}
+
+			// 大多按顺序到达，有时乱序或重复
+			ModelPacket pack;
+			pack.seqnr = (uint16_t)(next-((rand()%4 == 0)?rand()%8:0));
+			pack.marker = (rand()%3 == 0);
+			pack.key = (rand()%4 == 0);
+			if (pack.seqnr == next)
+				next++;
+
+			AddPacket(sources,pack.seqnr,pack.marker,(pack.key)?'K':'P');
+			ModelAddPacket(queue,pack,maxpackets,numdropped);
+
+			RTPSourceData *srcdat = sources.GetSourceInfo(TESTSSRC);
+			if (srcdat == 0 || srcdat->INF_GetNumQueuedPackets() != queue.size() ||
+			    sources.GetNumDroppedPackets() != numdropped)
+				ok = false;
+		}
+	}
+	Check("DropNonKeyFrames, same result as a full rescan",ok);
+}
+
+static void TestTransmitterQueue(uint16_t portbase)
+{
+	RTPUDPv4Transmitter trans;
+	RTPUDPv4TransmissionParams params;
+
+	params.SetPortbase(portbase);
+	params.SetReceiveQueueLimits(4,0);
+	checkerror(trans.Init(false));
+	checkerror(trans.Create(1400,&params));
+
+	int sender = socket(AF_INET,SOCK_DGRAM,0);
+	struct sockaddr_in addr;
+
+	memset(&addr,0,sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(portbase);
+
+	uint8_t rtp[12] = { 0x80, 0x60, 0x00, 0x01, 0, 0, 0, 0, 0x12, 0x34, 0x56, 0x78 };
+	for (int i = 0 ; i < 10 ; i++)
+		sendto(sender,rtp,sizeof(rtp),0,(struct sockaddr *)&addr,sizeof(addr));
+	RTPTime::Wait(RTPTime(0,20000));
+
+	// 队列满时剩余的数据报留在套接字中，之后的 Poll 调用再读取它们
+	int counts[3];
+	for (int i = 0 ; i < 3 ; i++)
+	{
+		checkerror(trans.Poll());
+
+		RTPRawPacket *pack;
+		counts[i] = 0;
+		while ((pack = trans.GetNextPacket()) != 0)
+		{
+			counts[i]++;
+			delete pack;
+		}
+	}
+	cout << "Transmitter queue: " << counts[0] << " " << counts[1] << " " << counts[2] << endl;
+	Check("Transmitter queue, reading stops when full",counts[0] == 4 && counts[1] == 4 && counts[2] == 2);
+	Check("Transmitter queue, nothing dropped",trans.GetNumDroppedPackets() == 0);
+
+	close(sender);
+	trans.Destroy();
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2)
+	{
+		cerr << "Usage: " << argv[0] << " portbase" << endl;
+		return -1;
+	}
+
+	TestSourceQueues();
+	TestDropNonKeyFramesRandom();
+	TestTransmitterQueue((uint16_t)atoi(argv[1]));
+
+	return CheckSummary();
+}
@@ -0,0 +1,158 @@
+#include "rtpconfig.h"
+#include "media_rtp_utils.h"
+#include "media_rtp_errors.h"
+#include "media_rtp_endpoint.h"
+#include "media_rtp_udpv4_transmitter.h"
+#include "media_rtp_packet_factory.h"
+#include "rtptestcheck.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <string.h>
+#include <stdlib.h>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+#define NUMPACKETS		40
+#define BATCHSIZE		16
+
+// 记录传输器在 RTP 套接字上的接收调用：替换 libc 的 recvmmsg 和 recvmsg，
+// 库是静态链接的，这里的定义优先于 libc 中的定义
+static int countsock = -1;
+static int numrecvmmsg = 0, maxrecvmmsg = 0, numrecvmsg = 0;
+
+#ifdef RTP_HAVE_RECVMMSG
+int recvmmsg(int sock, struct mmsghdr *msgs, unsigned int vlen, int flags, struct timespec *timeout)
+{
+	typedef int (*RecvMMsgFunction)(int, struct mmsghdr *, unsigned int, int, struct timespec *);
+	static RecvMMsgFunction next = (RecvMMsgFunction)dlsym(RTLD_NEXT, "recvmmsg");
+
+	int num = next(sock, msgs, vlen, flags, timeout);
+	if (sock == countsock && num > 0)
+	{
+		numrecvmmsg++;
+		if (num > maxrecvmmsg)
+			maxrecvmmsg = num;
+	}
+	return num;
+}
+#endif // RTP_HAVE_RECVMMSG
+
+ssize_t recvmsg(int sock, struct msghdr *msg, int flags)
+{
+	typedef ssize_t (*RecvMsgFunction)(int, struct msghdr *, int);
+	static RecvMsgFunction next = (RecvMsgFunction)dlsym(RTLD_NEXT, "recvmsg");
+
+	ssize_t len = next(sock, msg, flags);
+	if (sock == countsock && len > 0 && !(flags&MSG_ERRQUEUE))
+		numrecvmsg++;
+	return len;
+}
+
+static void SendPackets(uint16_t destport, int num)
+{
+	int sock = socket(AF_INET, SOCK_DGRAM, 0);
+	struct sockaddr_in addr;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(destport);
+
+	for (int i = 0 ; i < num ; i++)
+	{
+		// 序列号和载荷都是数据包的编号，接收方据此检查顺序和内容
+		uint8_t rtp[12+100] = { 0x80, 0x60, 0x00, (uint8_t)i, 0, 0, 0, 0, 0x12, 0x34, 0x56, 0x78 };
+		memset(rtp+12, i, 100);
+		sendto(sock, rtp, sizeof(rtp), 0, (struct sockaddr *)&addr, sizeof(addr));
+	}
+	close(sock);
+
+	// 回环接口上的数据报在发送返回时已经进入接收队列，稍等只是为了保险
+	RTPTime::Wait(RTPTime(0, 20000));
+}
+
+// 取出队列中的所有数据包，检查它们按顺序到达且内容完整
+static int TakePackets(RTPUDPv4Transmitter &trans, bool *ok)
+{
+	RTPRawPacket *pack;
+	int num = 0;
+
+	*ok = true;
+	while ((pack = trans.GetNextPacket()) != 0)
+	{
+		const uint8_t *data = pack->GetData();
+		if (pack->GetDataLength() != 12+100 || data[3] != (uint8_t)num || data[12] != (uint8_t)num ||
+		    data[12+99] != (uint8_t)num)
+			*ok = false;
+		num++;
+		delete pack;
+	}
+	return num;
+}
+
+static void TestReceive(uint16_t portbase, size_t batchsize)
+{
+	RTPUDPv4Transmitter trans;
+	RTPUDPv4TransmissionParams params;
+
+	params.SetPortbase(portbase);
+	params.SetReceiveBatchSize(batchsize);
+	checkerror(trans.Init(false));
+	checkerror(trans.Create(1400, &params));
+
+	RTPUDPv4TransmissionInfo *inf = (RTPUDPv4TransmissionInfo *)trans.GetTransmissionInfo();
+	countsock = inf->GetRTPSocket();
+	trans.DeleteTransmissionInfo(inf);
+
+	string prefix = (batchsize > 1)?"Batch: ":"Single: ";
+	bool ok;
+
+	SendPackets(portbase, NUMPACKETS);
+	numrecvmmsg = maxrecvmmsg = numrecvmsg = 0;
+	checkerror(trans.Poll());
+
+	Check(prefix+"one poll delivers all packets in order", TakePackets(trans, &ok) == NUMPACKETS && ok);
+	if (batchsize > 1)
+	{
+#ifdef RTP_HAVE_RECVMMSG
+		cout << "  " << numrecvmmsg << " recvmmsg calls, at most " << maxrecvmmsg << " packets per call" << endl;
+		Check(prefix+"one call receives more than one packet", maxrecvmmsg > 1 && maxrecvmmsg <= BATCHSIZE);
+		Check(prefix+"one call per batch", numrecvmmsg == (NUMPACKETS+BATCHSIZE-1)/BATCHSIZE);
+		Check(prefix+"no single receives", numrecvmsg == 0);
+#else
+		cout << "recvmmsg not supported, the packets are received one by one" << endl;
+#endif // RTP_HAVE_RECVMMSG
+	}
+	else
+		Check(prefix+"one recvmsg per packet", numrecvmmsg == 0 && numrecvmsg == NUMPACKETS);
+
+	// 池缓冲区随数据包归还后可以再次接收
+	SendPackets(portbase, NUMPACKETS);
+	checkerror(trans.Poll());
+	Check(prefix+"second poll delivers all packets", TakePackets(trans, &ok) == NUMPACKETS && ok);
+
+	countsock = -1;
+	trans.Destroy();
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2)
+	{
+		cerr << "Usage: " << argv[0] << " portbase" << endl;
+		return -1;
+	}
+
+	uint16_t portbase = (uint16_t)atoi(argv[1]);
+
+	TestReceive(portbase, BATCHSIZE);
+	TestReceive(portbase+10, 1);
+
+	return CheckSummary();
+}
@@ -0,0 +1,145 @@
+#include "rtpconfig.h"
+#include <iostream>
+
+#ifdef RTP_HAVE_SO_REUSEPORT_CBPF
+
+#include "media_rtp_utils.h"
+#include "media_rtp_session.h"
+#include "media_rtp_session_params.h"
+#include "media_rtp_errors.h"
+#include "media_rtp_source_data.h"
+#include "media_rtp_endpoint.h"
+#include "media_rtp_udpv4_transmitter.h"
+#include "media_rtp_packet_factory.h"
+#include "rtptestcheck.h"
+#include <mutex>
+#include <map>
+#include <string.h>
+#include <stdlib.h>
+#include <vector>
+
+using namespace std;
+
+// 每个工作会话记录它从各个 SSRC 收到的 RTP 数据包数量
+class WorkerSession : public RTPSession
+{
+public:
+	WorkerSession() : RTPSession() { }
+	~WorkerSession() { }
+
+	map<uint32_t,int> GetCounts()
+	{
+		lock_guard<mutex> lock(m_mutex);
+		return m_counts;
+	}
+protected:
+	void OnValidatedRTPPacket(RTPSourceData *srcdat, RTPPacket *rtppack, bool isonprobation, bool *ispackethandled)
+	{
+		{
+			lock_guard<mutex> lock(m_mutex);
+			m_counts[rtppack->GetSSRC()]++;
+		}
+		DeletePacket(rtppack);
+		*ispackethandled = true;
+	}
+private:
+	mutex m_mutex;
+	map<uint32_t,int> m_counts;
+};
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2)
+	{
+		cerr << "Usage: " << argv[0] << " portbase" << endl;
+		return -1;
+	}
+
+	uint16_t portbase = (uint16_t)atoi(argv[1]);
+	const int numWorkers = 2;
+	const int numSenders = 4;
+	const int numPackets = 20;
+
+	RTPSessionParams sessParams;
+	sessParams.SetProbationType(RTPSources::NoProbation);
+	sessParams.SetOwnTimestampUnit(1.0/8000.0);
+
+	// 所有工作会话共享同一个端口基数，按创建顺序成为套接字组中的第 0、1 个成员
+	vector<WorkerSession *> workers;
+	for (int i = 0 ; i < numWorkers ; i++)
+	{
+		RTPUDPv4TransmissionParams transParams;
+		transParams.SetPortbase(portbase);
+		transParams.SetReusePortGroupSize(numWorkers);
+
+		WorkerSession *pSess = new WorkerSession();
+		checkerror(pSess->Create(sessParams, &transParams));
+		workers.push_back(pSess);
+	}
+	cout << numWorkers << " worker sessions share port " << portbase << endl;
+
+	vector<RTPSession *> senders;
+	for (int i = 0 ; i < numSenders ; i++)
+	{
+		RTPUDPv4TransmissionParams transParams;
+		transParams.SetPortbase(portbase + 2 + i*2);
+
+		RTPSession *pSess = new RTPSession();
+		checkerror(pSess->Create(sessParams, &transParams));
+		checkerror(pSess->AddDestination(RTPEndpoint(ntohl(inet_addr("127.0.0.1")), portbase)));
+		senders.push_back(pSess);
+	}
+
+	vector<uint8_t> pack(160);
+	for (int n = 0 ; n < numPackets ; n++)
+	{
+		for (int i = 0 ; i < numSenders ; i++)
+			checkerror(senders[i]->SendPacket((void *)&pack[0],pack.size(),0,false,160));
+		RTPTime::Wait(RTPTime(0,5000));
+	}
+
+	// 后台线程会接收数据包并调用 OnValidatedRTPPacket
+	RTPTime::Wait(RTPTime(1,0));
+
+	bool ok = true;
+	for (int i = 0 ; i < numSenders ; i++)
+	{
+		uint32_t ssrc = senders[i]->GetLocalSSRC();
+		int expectedWorker = (int)(ssrc%numWorkers);
+
+		for (int w = 0 ; w < numWorkers ; w++)
+		{
+			map<uint32_t,int> counts = workers[w]->GetCounts();
+			int num = (counts.find(ssrc) == counts.end())?0:counts[ssrc];
+			int expected = (w == expectedWorker)?numPackets:0;
+
+			cout << "SSRC " << hex << ssrc << dec << " -> worker " << w << ": " << num << " packets" << endl;
+			if (num != expected)
+				ok = false;
+		}
+	}
+
+	for (size_t i = 0 ; i < senders.size() ; i++)
+	{
+		senders[i]->BYEDestroy(RTPTime(0,100000),0,0);
+		delete senders[i];
+	}
+	for (size_t i = 0 ; i < workers.size() ; i++)
+	{
+		workers[i]->BYEDestroy(RTPTime(0,100000),0,0);
+		delete workers[i];
+	}
+
+	cout << ((ok)?"Done.":"Packets were not steered by SSRC") << endl;
+	return (ok)?0:-1;
+}
+
+#else
+
+int main(void)
+{
+	std::cerr << "SO_ATTACH_REUSEPORT_CBPF support was not enabled at compile time" << std::endl;
+	return 0;
+}
+
+#endif // RTP_HAVE_SO_REUSEPORT_CBPF
@@ -0,0 +1,42 @@
+/**
+ * \file rtptestcheck.h
+ * \brief 测试程序共用的检查函数
+ */
+
+#ifndef RTPTESTCHECK_H
+
+#define RTPTESTCHECK_H
+
+#include <stdlib.h>
+#include <iostream>
+#include <string>
+
+// 每个测试程序只有一个源文件，失败的检查在这里计数
+static int numfailed = 0;
+
+// 输出一项检查的结果
+static inline void Check(const std::string &what, bool ok)
+{
+	std::cout << what << ": " << ((ok)?"OK":"FAILED") << std::endl;
+	if (!ok)
+		numfailed++;
+}
+
+// 输出总的结果，返回程序的退出码
+static inline int CheckSummary()
+{
+	std::cout << ((numfailed == 0)?"All checks passed":"Some checks failed") << std::endl;
+	return (numfailed == 0)?0:-1;
+}
+
+// 库函数返回错误时，测试无法继续
+static inline void checkerror(int rtperr)
+{
+	if (rtperr < 0)
+	{
+		std::cerr << "Error " << rtperr << std::endl;
+		exit(-1);
+	}
+}
+
+#endif // RTPTESTCHECK_H
@@ -0,0 +1,242 @@
+#include "rtpconfig.h"
+#include "media_rtp_utils.h"
+#include "media_rtp_errors.h"
+#include "media_rtp_endpoint.h"
+#include "media_rtp_session.h"
+#include "media_rtp_session_params.h"
+#include "media_rtp_packet_factory.h"
+#include "media_rtp_udpv4_transmitter.h"
+#include "media_rtp_tcp_transmitter.h"
+#include "rtptestcheck.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// 修改传出数据时记下收到的完整RTP数据包，原样发送
+class ChangingSession : public RTPSession
+{
+public:
+	void EnableChange() { SetChangeOutgoingData(true); }
+
+	vector<uint8_t> m_lastRTP;
+protected:
+	int OnChangeRTPOrRTCPData(const void *origdata, size_t origlen, bool isrtp, void **senddata, size_t *sendlen)
+	{
+		if (isrtp)
+			m_lastRTP.assign((const uint8_t *)origdata, (const uint8_t *)origdata+origlen);
+		*senddata = const_cast<void *>(origdata);
+		*sendlen = origlen;
+		return 0;
+	}
+};
+
+// 载荷由三个不同长度的数据块组成
+class Payload
+{
+public:
+	Payload() : m_first(7, 'a'), m_second(1000, 'b'), m_third(33, 'c')
+	{
+		m_iov[0].iov_base = &m_first[0];
+		m_iov[0].iov_len = m_first.size();
+		m_iov[1].iov_base = &m_second[0];
+		m_iov[1].iov_len = m_second.size();
+		m_iov[2].iov_base = &m_third[0];
+		m_iov[2].iov_len = m_third.size();
+
+		m_all = m_first;
+		m_all.insert(m_all.end(), m_second.begin(), m_second.end());
+		m_all.insert(m_all.end(), m_third.begin(), m_third.end());
+	}
+
+	const struct iovec *GetIOV() const { return m_iov; }
+	size_t GetCount() const { return 3; }
+	const vector<uint8_t> &GetAll() const { return m_all; }
+private:
+	vector<uint8_t> m_first, m_second, m_third, m_all;
+	struct iovec m_iov[3];
+};
+
+static bool PayloadMatches(const RTPPacketView &view, const Payload &payload)
+{
+	return view.GetPayloadLength() == payload.GetAll().size() &&
+	       memcmp(view.GetPayloadData(), &payload.GetAll()[0], payload.GetAll().size()) == 0;
+}
+
+static void TestBuilder()
+{
+	RTPPacketBuilder builder;
+	const uint8_t extension[4] = { 1, 2, 3, 4 };
+
+	checkerror(builder.Init(1400));
+	checkerror(builder.AddCSRC(0x11111111));
+	uint16_t seqnr = builder.GetSequenceNumber();
+	uint32_t timestamp = builder.GetTimestamp();
+
+	checkerror(builder.BuildPacketHeader(1000, 96, true, 160));
+	Check("Header only", builder.GetPacketLength() == 12+4);
+	Check("Sequence number and timestamp advance", builder.GetSequenceNumber() == (uint16_t)(seqnr+1) &&
+	      builder.GetTimestamp() == timestamp+160);
+	Check("Payload counted", builder.GetPacketCount() == 1 && builder.GetPayloadOctetCount() == 1000);
+
+	checkerror(builder.BuildPacketHeaderEx(1000, 96, false, 160, 0xbede, extension, 1));
+	Check("Header with extension", builder.GetPacketLength() == 12+4+4+4);
+
+	Check("Total length checked", builder.BuildPacketHeader(1400, 96, false, 160) < 0);
+}
+
+static void TestUDP(uint16_t portbase)
+{
+	int receiver = socket(AF_INET, SOCK_DGRAM, 0);
+	struct sockaddr_in addr;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(portbase+10);
+	if (receiver == RTPSOCKERR || ::bind(receiver, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+	{
+		cerr << "Can't create receiver socket" << endl;
+		exit(-1);
+	}
+
+	ChangingSession sess;
+	RTPSessionParams sessparams;
+	RTPUDPv4TransmissionParams transparams;
+
+	sessparams.SetOwnTimestampUnit(1.0/8000.0);
+	transparams.SetPortbase(portbase);
+	checkerror(sess.Create(sessparams, &transparams));
+	checkerror(sess.AddDestination(RTPEndpoint(INADDR_LOOPBACK, portbase+10)));
+	checkerror(sess.SetDefaultPayloadType(96));
+	checkerror(sess.SetDefaultMark(false));
+	checkerror(sess.SetDefaultTimestampIncrement(160));
+
+	Payload payload;
+	uint8_t buf[2048];
+	ssize_t len;
+
+	uint16_t seqnr = sess.GetNextSequenceNumber();
+	checkerror(sess.SendPacketV(payload.GetIOV(), payload.GetCount(), 97, true, 160));
+	len = recv(receiver, (char *)buf, sizeof(buf), 0);
+	{
+		RTPPacketView view(buf, (len > 0)?(size_t)len:0, RTPTime(0,0));
+		Check("Gathered packet received", view.GetCreationError() == 0 && view.GetPacketLength() == 12+payload.GetAll().size());
+		Check("Gathered packet header", view.GetCreationError() == 0 && view.GetPayloadType() == 97 && view.HasMarker() &&
+		      view.GetSequenceNumber() == seqnr && view.GetSSRC() == sess.GetLocalSSRC());
+		Check("Gathered payload", view.GetCreationError() == 0 && PayloadMatches(view, payload));
+	}
+
+	const uint8_t extension[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+	checkerror(sess.SendPacketExV(payload.GetIOV(), payload.GetCount(), 0xbede, extension, 2));
+	len = recv(receiver, (char *)buf, sizeof(buf), 0);
+	{
+		RTPPacketView view(buf, (len > 0)?(size_t)len:0, RTPTime(0,0));
+		Check("Gathered packet with extension", view.GetCreationError() == 0 && view.GetPayloadType() == 96 &&
+		      view.GetSequenceNumber() == (uint16_t)(seqnr+1) && view.GetExtensionID() == 0xbede &&
+		      view.GetExtensionLength() == 8 && memcmp(view.GetExtensionData(), extension, 8) == 0 &&
+		      PayloadMatches(view, payload));
+	}
+
+	// 失败的调用不使用序列号
+	struct iovec many[RTPTRANS_MAXSENDIOV];
+	for (int i = 0 ; i < RTPTRANS_MAXSENDIOV ; i++)
+		many[i] = payload.GetIOV()[0];
+	Check("Too many blocks rejected", sess.SendPacketV(many, RTPTRANS_MAXSENDIOV) == MEDIA_RTP_ERR_INVALID_PARAMETER &&
+	      sess.GetNextSequenceNumber() == (uint16_t)(seqnr+2));
+	Check("Blocks up to the limit accepted", sess.SendPacketV(many, RTPTRANS_MAXSENDIOV-1) == 0);
+	len = recv(receiver, (char *)buf, sizeof(buf), 0);
+	Check("All blocks sent", len == (ssize_t)(12+(RTPTRANS_MAXSENDIOV-1)*payload.GetIOV()[0].iov_len));
+
+	// 修改传出数据的回调得到连续的完整数据包
+	sess.EnableChange();
+	checkerror(sess.SendPacketV(payload.GetIOV(), payload.GetCount()));
+	len = recv(receiver, (char *)buf, sizeof(buf), 0);
+	{
+		RTPPacketView view(buf, (len > 0)?(size_t)len:0, RTPTime(0,0));
+		Check("Changed packet is contiguous", sess.m_lastRTP.size() == (size_t)len &&
+		      memcmp(&sess.m_lastRTP[0], buf, len) == 0 && view.GetCreationError() == 0 && PayloadMatches(view, payload));
+	}
+
+	sess.Destroy();
+	RTPCLOSE(receiver);
+}
+
+static void TestTCP(uint16_t port)
+{
+	int listener = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in servAddr;
+
+	memset(&servAddr, 0, sizeof(servAddr));
+	servAddr.sin_family = AF_INET;
+	servAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	servAddr.sin_port = htons(port);
+	if (listener == RTPSOCKERR || ::bind(listener, (struct sockaddr *)&servAddr, sizeof(servAddr)) != 0 ||
+	    listen(listener, 1) != 0)
+	{
+		cerr << "Can't create listener socket" << endl;
+		exit(-1);
+	}
+
+	int client = socket(AF_INET, SOCK_STREAM, 0);
+	if (client == RTPSOCKERR || connect(client, (struct sockaddr *)&servAddr, sizeof(servAddr)) != 0)
+	{
+		cerr << "Can't connect to the listener socket" << endl;
+		exit(-1);
+	}
+	int server = accept(listener, 0, 0);
+
+	RTPTCPTransmitter trans;
+	RTPTCPTransmissionParams params;
+
+	checkerror(trans.Init(false));
+	checkerror(trans.Create(65535, &params));
+	checkerror(trans.AddDestination(RTPEndpoint(server)));
+
+	Payload payload;
+	checkerror(trans.SendRTPDataV(payload.GetIOV(), payload.GetCount()));
+
+	vector<uint8_t> stream;
+	uint8_t buf[4096];
+	while (stream.size() < 2+payload.GetAll().size())
+	{
+		ssize_t r = recv(client, (char *)buf, sizeof(buf), 0);
+		if (r <= 0)
+			break;
+		stream.insert(stream.end(), buf, buf+r);
+	}
+
+	size_t len = payload.GetAll().size();
+	Check("TCP frame length", stream.size() == len+2 && stream[0] == (uint8_t)(len >> 8) && stream[1] == (uint8_t)len);
+	Check("TCP frame data", stream.size() == len+2 && memcmp(&stream[2], &payload.GetAll()[0], len) == 0);
+
+	trans.Destroy();
+	RTPCLOSE(client);
+	RTPCLOSE(server);
+	RTPCLOSE(listener);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2)
+	{
+		cerr << "Usage: " << argv[0] << " portbase" << endl;
+		return -1;
+	}
+
+	uint16_t portbase = (uint16_t)atoi(argv[1]);
+
+	TestBuilder();
+	TestUDP(portbase);
+	TestTCP(portbase+20);
+
+	return CheckSummary();
+}
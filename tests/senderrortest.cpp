@@ -0,0 +1,210 @@
+#include "rtpconfig.h"
+#include "media_rtp_utils.h"
+#include "media_rtp_errors.h"
+#include "media_rtp_endpoint.h"
+#include "media_rtp_udpv4_transmitter.h"
+#include "rtptestcheck.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// 回环子网的广播地址：套接字没有设置 SO_BROADCAST，发送到这里总是以 EACCES 失败
+#define BROADCASTIP		0x7fffffff
+
+// 记录传输器报告的发送错误
+class ErrorTransmitter : public RTPUDPv4Transmitter
+{
+public:
+	struct SendError
+	{
+		SendError(const RTPEndpoint &a, bool r, int e) : addr(a), rtp(r), errcode(e) { }
+
+		RTPEndpoint addr;
+		bool rtp;
+		int errcode;
+	};
+
+	vector<SendError> errors;
+protected:
+	void OnSendError(const RTPEndpoint &addr, bool rtp, int errcode)
+	{
+		errors.push_back(SendError(addr, rtp, errcode));
+	}
+};
+
+// 在 RTP 和 RTCP 端口上各绑定一个接收套接字
+class Receiver
+{
+public:
+	Receiver(uint16_t port)
+	{
+		rtpsock = CreateSocket(port);
+		rtcpsock = CreateSocket(port+1);
+	}
+
+	~Receiver()
+	{
+		close(rtpsock);
+		close(rtcpsock);
+	}
+
+	// 返回套接字上数据报的数量，每个数据报都必须与发送的数据相同
+	static int Count(int sock, const uint8_t *data, size_t len)
+	{
+		uint8_t buf[2048];
+		ssize_t recvlen;
+		int num = 0;
+
+		while ((recvlen = recv(sock, buf, sizeof(buf), MSG_DONTWAIT)) >= 0)
+		{
+			if ((size_t)recvlen != len || memcmp(buf, data, len) != 0)
+				return -1;
+			num++;
+		}
+		return num;
+	}
+
+	int rtpsock, rtcpsock;
+private:
+	static int CreateSocket(uint16_t port)
+	{
+		int sock = socket(AF_INET, SOCK_DGRAM, 0);
+		struct sockaddr_in addr;
+
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		addr.sin_port = htons(port);
+		if (sock < 0 || bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+		{
+			cerr << "Can't create receiver socket on port " << port << endl;
+			exit(-1);
+		}
+		return sock;
+	}
+};
+
+// 目标列表没有固定的顺序，每个失败的目标都必须正好报告一次
+static bool ErrorsMatch(const vector<ErrorTransmitter::SendError> &errors, const vector<RTPEndpoint> &expected, bool rtp)
+{
+	vector<bool> found(expected.size(), false);
+
+	if (errors.size() != expected.size())
+		return false;
+	for (size_t i = 0 ; i < errors.size() ; i++)
+	{
+		if (errors[i].rtp != rtp || errors[i].errcode != EACCES)
+			return false;
+
+		size_t j = 0;
+		while (j < expected.size() && (found[j] || errors[i].addr != expected[j]))
+			j++;
+		if (j == expected.size())
+			return false;
+		found[j] = true;
+	}
+	return true;
+}
+
+// 六个目标中有三个不可达，它们的失败不影响同一次发送中的其他目标
+static void TestDestinations(uint16_t portbase)
+{
+	ErrorTransmitter trans;
+	RTPUDPv4TransmissionParams params;
+
+	params.SetPortbase(portbase);
+	checkerror(trans.Init(false));
+	checkerror(trans.Create(1400, &params));
+
+	Receiver A(portbase+10), B(portbase+12), C(portbase+14);
+	RTPEndpoint bad1(BROADCASTIP, portbase+20), bad2(BROADCASTIP, portbase+22), bad3(BROADCASTIP, portbase+24);
+	vector<RTPEndpoint> bad;
+
+	bad.push_back(bad1);
+	bad.push_back(bad2);
+	bad.push_back(bad3);
+	checkerror(trans.AddDestination(bad1));
+	checkerror(trans.AddDestination(RTPEndpoint(INADDR_LOOPBACK, portbase+10)));
+	checkerror(trans.AddDestination(bad2));
+	checkerror(trans.AddDestination(RTPEndpoint(INADDR_LOOPBACK, portbase+12)));
+	checkerror(trans.AddDestination(RTPEndpoint(INADDR_LOOPBACK, portbase+14)));
+	checkerror(trans.AddDestination(bad3));
+
+	uint8_t rtp[12+20] = { 0x80, 0x60, 0x00, 0x01, 0, 0, 0, 0, 0x12, 0x34, 0x56, 0x78 };
+	uint8_t rtcp[8] = { 0x80, 200, 0x00, 0x01, 0x12, 0x34, 0x56, 0x78 };
+	memset(rtp+12, 0x5a, 20);
+
+	Check("RTP: send succeeds despite failing destinations", trans.SendRTPData(rtp, sizeof(rtp)) == 0);
+	RTPTime::Wait(RTPTime(0, 20000));
+	Check("RTP: each failing destination reported once", ErrorsMatch(trans.errors, bad, true));
+	Check("RTP: the other destinations receive the packet", Receiver::Count(A.rtpsock, rtp, sizeof(rtp)) == 1 &&
+	      Receiver::Count(B.rtpsock, rtp, sizeof(rtp)) == 1 && Receiver::Count(C.rtpsock, rtp, sizeof(rtp)) == 1);
+
+	trans.errors.clear();
+	Check("RTCP: send succeeds despite failing destinations", trans.SendRTCPData(rtcp, sizeof(rtcp)) == 0);
+	RTPTime::Wait(RTPTime(0, 20000));
+	Check("RTCP: each failing destination reported once", ErrorsMatch(trans.errors, bad, false));
+	Check("RTCP: the other destinations receive the packet", Receiver::Count(A.rtcpsock, rtcp, sizeof(rtcp)) == 1 &&
+	      Receiver::Count(B.rtcpsock, rtcp, sizeof(rtcp)) == 1 && Receiver::Count(C.rtcpsock, rtcp, sizeof(rtcp)) == 1);
+
+	// 删除不可达的目标后不再报告错误
+	trans.errors.clear();
+	checkerror(trans.DeleteDestination(bad1));
+	checkerror(trans.DeleteDestination(bad2));
+	checkerror(trans.DeleteDestination(bad3));
+	checkerror(trans.SendRTPData(rtp, sizeof(rtp)));
+	RTPTime::Wait(RTPTime(0, 20000));
+	Check("No errors without failing destinations", trans.errors.empty() &&
+	      Receiver::Count(A.rtpsock, rtp, sizeof(rtp)) == 1 && Receiver::Count(B.rtpsock, rtp, sizeof(rtp)) == 1 &&
+	      Receiver::Count(C.rtpsock, rtp, sizeof(rtp)) == 1);
+
+	trans.Destroy();
+}
+
+// 只有一个目标且发送失败
+static void TestOnlyFailing(uint16_t portbase)
+{
+	ErrorTransmitter trans;
+	RTPUDPv4TransmissionParams params;
+
+	params.SetPortbase(portbase);
+	checkerror(trans.Init(false));
+	checkerror(trans.Create(1400, &params));
+
+	RTPEndpoint bad(BROADCASTIP, portbase+20);
+	vector<RTPEndpoint> expected(2, bad);
+	uint8_t rtp[12] = { 0x80, 0x60, 0x00, 0x01, 0, 0, 0, 0, 0x12, 0x34, 0x56, 0x78 };
+
+	checkerror(trans.AddDestination(bad));
+	checkerror(trans.SendRTPData(rtp, sizeof(rtp)));
+	checkerror(trans.SendRTPData(rtp, sizeof(rtp)));
+	Check("Single failing destination reported for every send", ErrorsMatch(trans.errors, expected, true));
+
+	trans.Destroy();
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2)
+	{
+		cerr << "Usage: " << argv[0] << " portbase" << endl;
+		return -1;
+	}
+
+	uint16_t portbase = (uint16_t)atoi(argv[1]);
+
+	TestDestinations(portbase);
+	TestOnlyFailing(portbase+40);
+
+	return CheckSummary();
+}
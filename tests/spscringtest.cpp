@@ -0,0 +1,133 @@
+#include "media_rtp_spsc_ring.h"
+#include "media_rtp_errors.h"
+#include "rtptestcheck.h"
+#include <iostream>
+#include <string>
+#include <thread>
+
+using namespace std;
+
+static void TestInit()
+{
+	RTPSPSCRing<int> ring;
+	int value;
+
+	Check("Push fails before Init", !ring.Push(1) && ring.GetCapacity() == 0 && ring.GetFreeSpace() == 0);
+	Check("Zero capacity rejected", ring.Init(0) == MEDIA_RTP_ERR_INVALID_PARAMETER);
+	Check("Capacity rounded up to a power of two", ring.Init(5) == 0 && ring.GetCapacity() == 8);
+	Check("Empty after Init", ring.IsEmpty() && !ring.Pop(&value) && ring.GetFreeSpace() == 8);
+
+	ring.Push(1);
+	ring.Destroy();
+	Check("Push fails after Destroy", !ring.Push(2) && ring.GetCapacity() == 0);
+}
+
+static void TestFullEmpty()
+{
+	RTPSPSCRing<int> ring;
+	bool ok = true;
+	int value;
+
+	ring.Init(4);
+	for (int i = 0 ; i < 4 ; i++)
+	{
+		if (ring.GetFreeSpace() != (size_t)(4-i) || !ring.Push(i))
+			ok = false;
+	}
+	Check("Fills to capacity", ok && ring.IsFull() && ring.GetFreeSpace() == 0 && !ring.IsEmpty());
+	Check("Push fails when full", !ring.Push(4));
+
+	Check("Pop frees a slot", ring.Pop(&value) && value == 0 && !ring.IsFull() && ring.GetFreeSpace() == 1);
+	Check("Push succeeds again", ring.Push(4) && ring.IsFull());
+
+	ok = true;
+	for (int i = 1 ; i <= 4 ; i++)
+	{
+		if (!ring.Pop(&value) || value != i)
+			ok = false;
+	}
+	Check("Drains in order", ok && ring.IsEmpty() && !ring.Pop(&value) && ring.GetFreeSpace() == 4);
+}
+
+static void TestWraparound()
+{
+	RTPSPSCRing<int> ring;
+	bool ok = true;
+	int next = 0, expected = 0, value;
+
+	// 每一轮加入的数量与容量互质，环中的位置不断回绕，并经过满和空的状态
+	ring.Init(8);
+	for (int round = 0 ; round < 1000 ; round++)
+	{
+		int num = 1+round%8;
+		for (int i = 0 ; i < num ; i++)
+		{
+			if (ring.Push(next))
+				next++;
+		}
+		for (int i = 0 ; i < 3 && ring.Pop(&value) ; i++)
+		{
+			if (value != expected++)
+				ok = false;
+		}
+	}
+	while (ring.Pop(&value))
+	{
+		if (value != expected++)
+			ok = false;
+	}
+	Check("Order preserved across wraparound", ok && expected == next && next > 1000);
+
+	// 重新初始化后从头开始
+	ring.Push(-1);
+	Check("Init resets the ring", ring.Init(8) == 0 && ring.IsEmpty() && ring.GetFreeSpace() == 8);
+}
+
+static void TestTwoThreads()
+{
+	const size_t count = 2000000;
+	RTPSPSCRing<size_t> ring;
+	size_t numpushed = 0;
+	bool ok = true;
+
+	ring.Init(64);
+
+	thread producer([&ring,&numpushed,count]() {
+		size_t next = 0;
+		while (next < count)
+		{
+			if (ring.Push(next))
+				next++;
+			else
+				this_thread::yield();
+		}
+		numpushed = next;
+	});
+
+	size_t expected = 0, value;
+	while (expected < count)
+	{
+		if (ring.Pop(&value))
+		{
+			if (value != expected)
+				ok = false;
+			expected++;
+		}
+		else
+			this_thread::yield();
+	}
+	producer.join();
+
+	Check("Two threads: every element received once, in order", ok && numpushed == count && expected == count);
+	Check("Two threads: empty afterwards", ring.IsEmpty() && ring.GetFreeSpace() == 64);
+}
+
+int main(void)
+{
+	TestInit();
+	TestFullEmpty();
+	TestWraparound();
+	TestTwoThreads();
+
+	return CheckSummary();
+}
@@ -0,0 +1,200 @@
+#include "rtpconfig.h"
+#include "media_rtp_utils.h"
+#include "media_rtp_errors.h"
+#include "media_rtp_endpoint.h"
+#include "media_rtp_tcp_transmitter.h"
+#include "media_rtp_packet_factory.h"
+#include "rtptestcheck.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <iostream>
+#include <map>
+#include <set>
+#include <vector>
+
+using namespace std;
+
+#define NUMCONNECTIONS		200
+#define FRAMESPERCONNECTION	3
+#define NUMCLOSED			5
+#define FRAMESIZE			100
+
+class MyTCPTransmitter : public RTPTCPTransmitter
+{
+public:
+	void OnReceiveError(int sock)
+	{
+		m_errorSockets.insert(sock);
+		DeleteDestination(RTPEndpoint(sock));
+	}
+
+	set<int> m_errorSockets;
+};
+
+static void WriteAll(int sock, const uint8_t *data, size_t len)
+{
+	if (send(sock, (const char *)data, len, MSG_NOSIGNAL) != (ssize_t)len)
+	{
+		cerr << "Can't write to client socket" << endl;
+		exit(-1);
+	}
+}
+
+// 等待并轮询，直到 done 返回 true 或者超时；收到的数据包按套接字计数
+template<class Done>
+static void RunLoop(MyTCPTransmitter &trans, map<int, int> &received, Done done)
+{
+	RTPTime start = RTPTime::CurrentTime();
+
+	while (!done() && RTPTime::CurrentTime().GetDouble() - start.GetDouble() < 10.0)
+	{
+		checkerror(trans.WaitForIncomingData(RTPTime(0,100000)));
+		checkerror(trans.Poll());
+
+		RTPRawPacket *pack;
+		while ((pack = trans.GetNextPacket()) != 0)
+		{
+			if (pack->GetDataLength() == FRAMESIZE)
+				received[pack->GetSenderAddress()->GetSocket()]++;
+			delete pack;
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2)
+	{
+		cerr << "Usage: " << argv[0] << " portnumber" << endl;
+		return -1;
+	}
+
+	int listener = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in servAddr;
+
+	memset(&servAddr, 0, sizeof(servAddr));
+	servAddr.sin_family = AF_INET;
+	servAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	servAddr.sin_port = htons(atoi(argv[1]));
+	if (listener == RTPSOCKERR || ::bind(listener, (struct sockaddr *)&servAddr, sizeof(servAddr)) != 0 ||
+	    listen(listener, NUMCONNECTIONS) != 0)
+	{
+		cerr << "Can't create listener socket" << endl;
+		return -1;
+	}
+
+	MyTCPTransmitter trans;
+	RTPTCPTransmissionParams params;
+
+	// 接收队列很小，就绪的套接字必须在多次 Poll 之间保留下来
+	params.SetEdgeTriggered(true);
+	params.SetReceiveQueueLimits(8, 0);
+	checkerror(trans.Init(false));
+	checkerror(trans.Create(65535, &params));
+
+	vector<int> clients, servers;
+	for (int i = 0 ; i < NUMCONNECTIONS ; i++)
+	{
+		int client = socket(AF_INET, SOCK_STREAM, 0);
+		if (client == RTPSOCKERR || connect(client, (struct sockaddr *)&servAddr, sizeof(servAddr)) != 0)
+		{
+			cerr << "Can't connect to the listener socket" << endl;
+			return -1;
+		}
+		int server = accept(listener, 0, 0);
+		if (server == RTPSOCKERR)
+		{
+			cerr << "Can't accept incoming connection" << endl;
+			return -1;
+		}
+		clients.push_back(client);
+		servers.push_back(server);
+		checkerror(trans.AddDestination(RTPEndpoint(server)));
+	}
+	RTPCLOSE(listener);
+
+	// 每个帧前面是 RFC 4571 的两字节长度
+	uint8_t frame[2+FRAMESIZE];
+	memset(frame, 0, sizeof(frame));
+	frame[0] = (FRAMESIZE >> 8)&0xff;
+	frame[1] = FRAMESIZE&0xff;
+	frame[2] = 0x80;
+
+	// 先发送除最后一个帧的后半部分以外的数据，之后再补齐：边沿触发时，
+	// 后半部分的到达必须产生新的事件
+	for (int i = 0 ; i < NUMCONNECTIONS ; i++)
+	{
+		for (int j = 0 ; j < FRAMESPERCONNECTION-1 ; j++)
+			WriteAll(clients[i], frame, sizeof(frame));
+		WriteAll(clients[i], frame, sizeof(frame)/2);
+	}
+
+	// 接收队列满了以后，等待不能立即返回，否则轮询线程会空转
+	RTPTime::Wait(RTPTime(0,50000));
+	checkerror(trans.Poll());
+	int numWaits = 0;
+	RTPTime waitStart = RTPTime::CurrentTime();
+	while (RTPTime::CurrentTime().GetDouble()-waitStart.GetDouble() < 0.1)
+	{
+		checkerror(trans.WaitForIncomingData(RTPTime(0,200000)));
+		numWaits++;
+	}
+	Check("No busy wait while the receive queue is full", numWaits <= 20);
+
+	map<int, int> received;
+	int expected = NUMCONNECTIONS*(FRAMESPERCONNECTION-1);
+	RunLoop(trans, received, [&]() {
+		int total = 0;
+		for (map<int, int>::const_iterator it = received.begin() ; it != received.end() ; ++it)
+			total += it->second;
+		return total >= expected;
+	});
+
+	for (int i = 0 ; i < NUMCONNECTIONS ; i++)
+		WriteAll(clients[i], frame+sizeof(frame)/2, sizeof(frame)-sizeof(frame)/2);
+
+	expected = NUMCONNECTIONS*FRAMESPERCONNECTION;
+	RunLoop(trans, received, [&]() {
+		int total = 0;
+		for (map<int, int>::const_iterator it = received.begin() ; it != received.end() ; ++it)
+			total += it->second;
+		return total >= expected;
+	});
+
+	bool allComplete = true;
+	for (int i = 0 ; i < NUMCONNECTIONS ; i++)
+	{
+		if (received[servers[i]] != FRAMESPERCONNECTION)
+			allComplete = false;
+	}
+	Check("All frames received on every connection", allComplete);
+	Check("Nothing dropped", trans.GetNumDroppedPackets() == 0);
+
+	// 对端关闭的连接只产生一次事件，必须被报告为接收错误
+	for (int i = 0 ; i < NUMCLOSED ; i++)
+		RTPCLOSE(clients[i]);
+	RunLoop(trans, received, [&]() { return trans.m_errorSockets.size() >= NUMCLOSED; });
+
+	bool closedReported = (trans.m_errorSockets.size() == NUMCLOSED);
+	for (int i = 0 ; i < NUMCLOSED ; i++)
+	{
+		if (trans.m_errorSockets.find(servers[i]) == trans.m_errorSockets.end())
+			closedReported = false;
+	}
+	Check("Closed connections reported", closedReported);
+
+	trans.Destroy();
+	for (int i = 0 ; i < NUMCONNECTIONS ; i++)
+	{
+		if (i >= NUMCLOSED)
+			RTPCLOSE(clients[i]);
+		RTPCLOSE(servers[i]);
+	}
+
+	return CheckSummary();
+}
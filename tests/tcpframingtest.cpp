@@ -0,0 +1,154 @@
+#include "rtpconfig.h"
+#include "media_rtp_utils.h"
+#include "media_rtp_errors.h"
+#include "media_rtp_endpoint.h"
+#include "media_rtp_tcp_transmitter.h"
+#include "media_rtp_packet_factory.h"
+#include "rtptestcheck.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// 帧的内容由序号和长度决定，接收方可以逐字节核对
+static vector<uint8_t> MakeFrame(int index, size_t len)
+{
+	vector<uint8_t> frame(len);
+	for (size_t i = 0 ; i < len ; i++)
+		frame[i] = (uint8_t)(index*31+i);
+	// 第一个字节不像 RTCP 的负载类型，所有帧都作为 RTP 数据交付
+	if (len > 0)
+		frame[0] = 0x80;
+	return frame;
+}
+
+static void ConnectPair(uint16_t port, int *client, int *server)
+{
+	int listener = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in servAddr;
+
+	memset(&servAddr, 0, sizeof(servAddr));
+	servAddr.sin_family = AF_INET;
+	servAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	servAddr.sin_port = htons(port);
+	if (listener == RTPSOCKERR || ::bind(listener, (struct sockaddr *)&servAddr, sizeof(servAddr)) != 0 ||
+	    listen(listener, 1) != 0)
+	{
+		cerr << "Can't create listener socket" << endl;
+		exit(-1);
+	}
+
+	*client = socket(AF_INET, SOCK_STREAM, 0);
+	if (*client == RTPSOCKERR || connect(*client, (struct sockaddr *)&servAddr, sizeof(servAddr)) != 0)
+	{
+		cerr << "Can't connect to the listener socket" << endl;
+		exit(-1);
+	}
+	*server = accept(listener, 0, 0);
+	if (*server == RTPSOCKERR)
+	{
+		cerr << "Can't accept incoming connection" << endl;
+		exit(-1);
+	}
+	RTPCLOSE(listener);
+}
+
+// 发送 lengths 描述的帧，整个字节流按 chunksize 切分后分多次写入，每次写入后轮询一次；
+// 返回按顺序收到的帧是否与发送的完全相同
+static bool SendAndCompare(RTPTCPTransmitter &trans, int client, const vector<size_t> &lengths, size_t chunksize)
+{
+	vector<uint8_t> stream;
+	vector<vector<uint8_t> > frames;
+
+	for (size_t i = 0 ; i < lengths.size() ; i++)
+	{
+		frames.push_back(MakeFrame((int)i, lengths[i]));
+		stream.push_back((uint8_t)((lengths[i] >> 8)&0xff));
+		stream.push_back((uint8_t)(lengths[i]&0xff));
+		stream.insert(stream.end(), frames.back().begin(), frames.back().end());
+	}
+
+	size_t numReceived = 0;
+	bool ok = true;
+	size_t offset = 0;
+	RTPTime start = RTPTime::CurrentTime();
+
+	while (numReceived < frames.size() && RTPTime::CurrentTime().GetDouble() - start.GetDouble() < 10.0)
+	{
+		if (offset < stream.size())
+		{
+			size_t num = stream.size()-offset;
+			if (num > chunksize)
+				num = chunksize;
+			if (send(client, (const char *)&stream[offset], num, MSG_NOSIGNAL) != (ssize_t)num)
+			{
+				cerr << "Can't write to client socket" << endl;
+				exit(-1);
+			}
+			offset += num;
+		}
+
+		checkerror(trans.WaitForIncomingData(RTPTime(0,10000)));
+		checkerror(trans.Poll());
+
+		RTPRawPacket *pack;
+		while ((pack = trans.GetNextPacket()) != 0)
+		{
+			if (numReceived >= frames.size() || pack->GetDataLength() != frames[numReceived].size() ||
+			    (pack->GetDataLength() > 0 && memcmp(pack->GetData(), &frames[numReceived][0], pack->GetDataLength()) != 0))
+				ok = false;
+			numReceived++;
+			delete pack;
+		}
+	}
+	return ok && numReceived == frames.size();
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2)
+	{
+		cerr << "Usage: " << argv[0] << " portnumber" << endl;
+		return -1;
+	}
+
+	int client, server;
+	ConnectPair((uint16_t)atoi(argv[1]), &client, &server);
+
+	RTPTCPTransmitter trans;
+	RTPTCPTransmissionParams params;
+
+	// 很小的接收缓冲区，帧经常跨越缓冲区末尾或者比缓冲区还大
+	params.SetReceiveBufferSize(64);
+	checkerror(trans.Init(false));
+	checkerror(trans.Create(65535, &params));
+	checkerror(trans.AddDestination(RTPEndpoint(server)));
+
+	vector<size_t> small(200);
+	for (size_t i = 0 ; i < small.size() ; i++)
+		small[i] = i%20;
+	Check("Many small frames in one write", SendAndCompare(trans, client, small, 1000000));
+	Check("Small frames, one byte at a time", SendAndCompare(trans, client, small, 1));
+
+	vector<size_t> mixed;
+	size_t sizes[] = { 0, 1, 61, 62, 63, 64, 100, 3000, 12, 65535, 5, 2048, 2049 };
+	for (size_t i = 0 ; i < sizeof(sizes)/sizeof(sizes[0]) ; i++)
+		mixed.push_back(sizes[i]);
+	Check("Mixed sizes in one write", SendAndCompare(trans, client, mixed, 1000000));
+	Check("Mixed sizes in odd chunks", SendAndCompare(trans, client, mixed, 37));
+	Check("Mixed sizes in large chunks", SendAndCompare(trans, client, mixed, 4099));
+
+	trans.Destroy();
+	RTPCLOSE(client);
+	RTPCLOSE(server);
+
+	return CheckSummary();
+}
@@ -0,0 +1,217 @@
+#include "rtpconfig.h"
+#include "media_rtp_utils.h"
+#include "media_rtp_errors.h"
+#include "media_rtp_endpoint.h"
+#include "media_rtp_tcp_transmitter.h"
+#include "rtptestcheck.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define FRAMESIZE			1000
+#define NUMFRAMES			2000
+
+class MyTCPTransmitter : public RTPTCPTransmitter
+{
+public:
+	void OnSendError(int sock)
+	{
+		m_errorSockets.insert(sock);
+	}
+
+	set<int> m_errorSockets;
+};
+
+static void ConnectPair(int listener, const struct sockaddr_in &servAddr, int *client, int *server)
+{
+	*client = socket(AF_INET, SOCK_STREAM, 0);
+	if (*client == RTPSOCKERR || connect(*client, (struct sockaddr *)&servAddr, sizeof(servAddr)) != 0)
+	{
+		cerr << "Can't connect to the listener socket" << endl;
+		exit(-1);
+	}
+	*server = accept(listener, 0, 0);
+	if (*server == RTPSOCKERR)
+	{
+		cerr << "Can't accept incoming connection" << endl;
+		exit(-1);
+	}
+
+	// 小的套接字缓冲区，使发送队列很快就会被用到
+	int size = 16384;
+	setsockopt(*server, SOL_SOCKET, SO_SNDBUF, (const char *)&size, sizeof(int));
+	setsockopt(*client, SOL_SOCKET, SO_RCVBUF, (const char *)&size, sizeof(int));
+}
+
+// 读取对端发送的字节流并解析出 RFC 4571 帧，检查每个帧的长度和内容；没有帧被丢弃时
+// 还可以检查每个帧的内容是否为它的序号
+class FrameReader
+{
+public:
+	FrameReader(int sock, bool checkSequence) : m_sock(sock), m_checkSequence(checkSequence), m_numFrames(0), m_valid(true) { }
+
+	void Read()
+	{
+		uint8_t buf[65536];
+		ssize_t r;
+
+		while ((r = recv(m_sock, (char *)buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+		{
+			m_stream.insert(m_stream.end(), buf, buf+r);
+
+			size_t pos = 0;
+			while (m_stream.size()-pos >= 2)
+			{
+				size_t len = (((size_t)m_stream[pos]) << 8)|m_stream[pos+1];
+				if (m_stream.size()-pos-2 < len)
+					break;
+				if (len != FRAMESIZE || (m_checkSequence && m_stream[pos+2] != (uint8_t)(m_numFrames&0xff)))
+					m_valid = false;
+				for (size_t i = 1 ; i < len ; i++)
+				{
+					if (m_stream[pos+2+i] != m_stream[pos+2])
+						m_valid = false;
+				}
+				m_numFrames++;
+				pos += len+2;
+			}
+			m_stream.erase(m_stream.begin(), m_stream.begin()+pos);
+		}
+	}
+
+	int GetNumFrames() const { return m_numFrames; }
+	bool IsValid() const { return m_valid && m_stream.empty(); }
+private:
+	int m_sock;
+	bool m_checkSequence;
+	vector<uint8_t> m_stream;
+	int m_numFrames;
+	bool m_valid;
+};
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2)
+	{
+		cerr << "Usage: " << argv[0] << " portnumber" << endl;
+		return -1;
+	}
+
+	int listener = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in servAddr;
+
+	memset(&servAddr, 0, sizeof(servAddr));
+	servAddr.sin_family = AF_INET;
+	servAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	servAddr.sin_port = htons(atoi(argv[1]));
+	if (listener == RTPSOCKERR || ::bind(listener, (struct sockaddr *)&servAddr, sizeof(servAddr)) != 0 ||
+	    listen(listener, 4) != 0)
+	{
+		cerr << "Can't create listener socket" << endl;
+		return -1;
+	}
+
+	uint8_t frame[FRAMESIZE];
+
+	// 一个连接的对端及时读取，另一个的对端在发送结束前不读取
+	{
+		int fastClient, fastServer, slowClient, slowServer;
+		ConnectPair(listener, servAddr, &fastClient, &fastServer);
+		ConnectPair(listener, servAddr, &slowClient, &slowServer);
+
+		MyTCPTransmitter trans;
+		RTPTCPTransmissionParams params;
+
+		params.SetSendQueueLimit(64*1024);
+		checkerror(trans.Init(false));
+		checkerror(trans.Create(65535, &params));
+		checkerror(trans.AddDestination(RTPEndpoint(fastServer)));
+		checkerror(trans.AddDestination(RTPEndpoint(slowServer)));
+
+		FrameReader fastReader(fastClient, true), slowReader(slowClient, false);
+		RTPTime start = RTPTime::CurrentTime();
+
+		for (int i = 0 ; i < NUMFRAMES ; i++)
+		{
+			memset(frame, i&0xff, sizeof(frame));
+			checkerror(trans.SendRTPData(frame, sizeof(frame)));
+			if (i%8 == 0)
+			{
+				checkerror(trans.Poll());
+				fastReader.Read();
+			}
+		}
+		double sendTime = RTPTime::CurrentTime().GetDouble()-start.GetDouble();
+
+		// 等待时如果套接字变为可写则返回，Poll 发送排队的数据
+		while (fastReader.GetNumFrames() < NUMFRAMES && RTPTime::CurrentTime().GetDouble()-start.GetDouble() < 10.0)
+		{
+			checkerror(trans.WaitForIncomingData(RTPTime(0,10000)));
+			checkerror(trans.Poll());
+			fastReader.Read();
+		}
+
+		cout << "Sending took " << sendTime << " seconds, " << trans.GetNumDroppedSendPackets() << " frames dropped" << endl;
+		Check("Slow peer does not block sending", sendTime < 5.0);
+		Check("Fast peer receives every frame", fastReader.GetNumFrames() == NUMFRAMES && fastReader.IsValid());
+		Check("Frames dropped for the slow peer", trans.GetNumDroppedSendPackets() > 0 &&
+		      trans.GetNumDroppedSendBytes() == trans.GetNumDroppedSendPackets()*FRAMESIZE);
+		Check("No send errors", trans.m_errorSockets.empty());
+
+		// 慢的对端开始读取：收到的是完整的帧，帧边界没有错乱
+		for (int i = 0 ; i < 200 ; i++)
+		{
+			checkerror(trans.WaitForIncomingData(RTPTime(0,10000)));
+			checkerror(trans.Poll());
+			slowReader.Read();
+		}
+		Check("Slow peer receives whole frames", slowReader.IsValid() &&
+		      slowReader.GetNumFrames()+(int)trans.GetNumDroppedSendPackets() == NUMFRAMES);
+
+		trans.Destroy();
+		RTPCLOSE(fastClient);
+		RTPCLOSE(fastServer);
+		RTPCLOSE(slowClient);
+		RTPCLOSE(slowServer);
+	}
+
+	// 使用 Disconnect 策略时，发送队列已满的连接被移除并报告
+	{
+		int client, server;
+		ConnectPair(listener, servAddr, &client, &server);
+
+		MyTCPTransmitter trans;
+		RTPTCPTransmissionParams params;
+
+		params.SetSendQueueLimit(64*1024);
+		params.SetSendQueuePolicy(RTPTCPTransmissionParams::Disconnect);
+		checkerror(trans.Init(false));
+		checkerror(trans.Create(65535, &params));
+		checkerror(trans.AddDestination(RTPEndpoint(server)));
+
+		memset(frame, 0, sizeof(frame));
+		for (int i = 0 ; i < NUMFRAMES && trans.m_errorSockets.empty() ; i++)
+			checkerror(trans.SendRTPData(frame, sizeof(frame)));
+
+		Check("Disconnect reported", trans.m_errorSockets.size() == 1 && trans.m_errorSockets.count(server) == 1);
+		Check("Disconnected destination removed", trans.DeleteDestination(RTPEndpoint(server)) == MEDIA_RTP_ERR_INVALID_STATE);
+
+		trans.Destroy();
+		RTPCLOSE(client);
+		RTPCLOSE(server);
+	}
+
+	RTPCLOSE(listener);
+
+	return CheckSummary();
+}
@@ -0,0 +1,307 @@
+#include "rtpconfig.h"
+#include "media_rtp_utils.h"
+#include "media_rtp_errors.h"
+#include "media_rtp_endpoint.h"
+#include "media_rtp_session.h"
+#include "media_rtp_session_params.h"
+#include "media_rtp_source_data.h"
+#include "media_rtp_tcp_server_transmitter.h"
+#include "rtptestcheck.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <atomic>
+#include <mutex>
+
+using namespace std;
+
+#define NUMREACTORS			4
+#define NUMCLIENTS			100
+#define PACKETSPERCLIENT	5
+#define PAYLOADSIZE			20
+#define NUMCLOSED			10
+#define SENDPAYLOADSIZE		100
+
+class MyServerTransmitter : public RTPTCPServerTransmitter
+{
+public:
+	MyServerTransmitter() : m_numClosed(0) { }
+
+	vector<int> GetAccepted()
+	{
+		lock_guard<mutex> lock(m_mutex);
+		return m_accepted;
+	}
+
+	atomic<int> m_numClosed;
+protected:
+	void OnNewConnection(int sock)
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_accepted.push_back(sock);
+	}
+
+	void OnConnectionClosed(int)
+	{
+		m_numClosed++;
+	}
+private:
+	mutex m_mutex;
+	vector<int> m_accepted;
+};
+
+// 数据包在会话的轮询线程中处理，按 SSRC 计数
+class MyRTPSession : public RTPSession
+{
+public:
+	map<uint32_t, int> GetReceived()
+	{
+		lock_guard<mutex> lock(m_mutex);
+		return m_received;
+	}
+
+	int GetTotalReceived()
+	{
+		lock_guard<mutex> lock(m_mutex);
+		int total = 0;
+		for (map<uint32_t, int>::const_iterator it = m_received.begin() ; it != m_received.end() ; ++it)
+			total += it->second;
+		return total;
+	}
+protected:
+	void OnValidatedRTPPacket(RTPSourceData *srcdat, RTPPacket *rtppack, bool, bool *ispackethandled)
+	{
+		{
+			lock_guard<mutex> lock(m_mutex);
+			if (rtppack->GetPayloadLength() == PAYLOADSIZE)
+				m_received[srcdat->GetSSRC()]++;
+		}
+		DeletePacket(rtppack);
+		*ispackethandled = true;
+	}
+private:
+	mutex m_mutex;
+	map<uint32_t, int> m_received;
+};
+
+static void WriteAll(int sock, const uint8_t *data, size_t len)
+{
+	if (send(sock, (const char *)data, len, MSG_NOSIGNAL) != (ssize_t)len)
+	{
+		cerr << "Can't write to client socket" << endl;
+		exit(-1);
+	}
+}
+
+// RFC 4571 帧中的一个 RTP 数据包，每个客户端使用自己的 SSRC
+static vector<uint8_t> MakeFrame(uint32_t ssrc, uint16_t seq)
+{
+	vector<uint8_t> frame(2+12+PAYLOADSIZE, 0);
+	frame[0] = 0;
+	frame[1] = 12+PAYLOADSIZE;
+	frame[2] = 0x80;
+	frame[3] = 96;
+	frame[4] = (uint8_t)(seq >> 8);
+	frame[5] = (uint8_t)seq;
+	frame[6+4] = (uint8_t)(ssrc >> 24);
+	frame[6+5] = (uint8_t)(ssrc >> 16);
+	frame[6+6] = (uint8_t)(ssrc >> 8);
+	frame[6+7] = (uint8_t)ssrc;
+	return frame;
+}
+
+// 读取客户端收到的帧，返回负载类型为 96 且长度正确的 RTP 帧的数量；
+// 对端关闭连接时设置 closed
+static int ReadFrames(int sock, vector<uint8_t> &stream, bool *closed)
+{
+	uint8_t buf[4096];
+	ssize_t r;
+	int num = 0;
+
+	while ((r = recv(sock, (char *)buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+		stream.insert(stream.end(), buf, buf+r);
+	if (closed != 0)
+		*closed = (r == 0);
+
+	size_t pos = 0;
+	while (stream.size()-pos >= 2)
+	{
+		size_t len = (((size_t)stream[pos]) << 8)|stream[pos+1];
+		if (stream.size()-pos-2 < len)
+			break;
+		if (len == 12+SENDPAYLOADSIZE && (stream[pos+3]&0x7f) == 96)
+			num++;
+		pos += len+2;
+	}
+	stream.erase(stream.begin(), stream.begin()+pos);
+	return num;
+}
+
+template<class Done>
+static bool WaitUntil(Done done)
+{
+	RTPTime start = RTPTime::CurrentTime();
+	while (!done())
+	{
+		if (RTPTime::CurrentTime().GetDouble()-start.GetDouble() > 10.0)
+			return false;
+		RTPTime::Wait(RTPTime(0,10000));
+	}
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2)
+	{
+		cerr << "Usage: " << argv[0] << " portnumber" << endl;
+		return -1;
+	}
+
+	uint16_t port = (uint16_t)atoi(argv[1]);
+
+	MyServerTransmitter trans;
+	RTPTCPServerTransmissionParams transparams;
+
+	transparams.SetBindIP(INADDR_LOOPBACK);
+	transparams.SetPort(port);
+	transparams.SetNumReactors(NUMREACTORS);
+	checkerror(trans.Init(true));
+	checkerror(trans.Create(65535, &transparams));
+
+	RTPTransmissionInfo *info = trans.GetTransmissionInfo();
+	RTPTCPServerTransmissionInfo *serverinfo = static_cast<RTPTCPServerTransmissionInfo *>(info);
+	Check("Listening on the requested port", serverinfo->GetPort() == port && serverinfo->GetNumReactors() == NUMREACTORS);
+	trans.DeleteTransmissionInfo(info);
+
+	MyRTPSession sess;
+	RTPSessionParams sessparams;
+
+	sessparams.SetOwnTimestampUnit(1.0/8000.0);
+	sessparams.SetProbationType(RTPSources::NoProbation);
+	sessparams.SetUsePollThread(true);
+	sessparams.SetNeedThreadSafety(true);
+	checkerror(sess.Create(sessparams, &trans));
+	checkerror(sess.SetDefaultPayloadType(96));
+	checkerror(sess.SetDefaultMark(false));
+	checkerror(sess.SetDefaultTimestampIncrement(160));
+
+	struct sockaddr_in servAddr;
+	memset(&servAddr, 0, sizeof(servAddr));
+	servAddr.sin_family = AF_INET;
+	servAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	servAddr.sin_port = htons(port);
+
+	vector<int> clients;
+	for (int i = 0 ; i < NUMCLIENTS ; i++)
+	{
+		int client = socket(AF_INET, SOCK_STREAM, 0);
+		if (client == RTPSOCKERR || connect(client, (struct sockaddr *)&servAddr, sizeof(servAddr)) != 0)
+		{
+			cerr << "Can't connect to the server" << endl;
+			return -1;
+		}
+		clients.push_back(client);
+	}
+
+	Check("All connections accepted", WaitUntil([&]() { return trans.GetNumConnections() == NUMCLIENTS; }));
+
+	// 每个客户端发送的数据包都经过会话处理
+	for (int j = 0 ; j < PACKETSPERCLIENT ; j++)
+	{
+		for (int i = 0 ; i < NUMCLIENTS ; i++)
+		{
+			vector<uint8_t> frame = MakeFrame(0x1000+i, (uint16_t)j);
+			WriteAll(clients[i], &frame[0], frame.size());
+		}
+	}
+
+	WaitUntil([&]() { return sess.GetTotalReceived() >= NUMCLIENTS*PACKETSPERCLIENT; });
+
+	map<uint32_t, int> received = sess.GetReceived();
+	bool allReceived = (received.size() == NUMCLIENTS);
+	for (int i = 0 ; i < NUMCLIENTS ; i++)
+	{
+		if (received[0x1000+i] != PACKETSPERCLIENT)
+			allReceived = false;
+	}
+	Check("Packets from every client reach the session", allReceived);
+	Check("Nothing dropped", trans.GetNumDroppedPackets() == 0);
+
+	// 会话发送的数据包到达每个客户端
+	uint8_t payload[SENDPAYLOADSIZE];
+	memset(payload, 0x5a, sizeof(payload));
+	checkerror(sess.SendPacket(payload, sizeof(payload)));
+
+	vector<vector<uint8_t> > streams(NUMCLIENTS);
+	vector<int> numFrames(NUMCLIENTS, 0);
+	bool allSent = WaitUntil([&]() {
+		bool done = true;
+		for (int i = 0 ; i < NUMCLIENTS ; i++)
+		{
+			numFrames[i] += ReadFrames(clients[i], streams[i], 0);
+			if (numFrames[i] < 1)
+				done = false;
+		}
+		return done;
+	});
+	bool exactlyOnce = true;
+	for (int i = 0 ; i < NUMCLIENTS ; i++)
+	{
+		if (numFrames[i] != 1)
+			exactlyOnce = false;
+	}
+	Check("Sent packet reaches every client once", allSent && exactlyOnce);
+
+	// 对端关闭的连接被关闭并报告
+	for (int i = 0 ; i < NUMCLOSED ; i++)
+		RTPCLOSE(clients[i]);
+	Check("Closed connections removed", WaitUntil([&]() {
+		return trans.m_numClosed == NUMCLOSED && trans.GetNumConnections() == NUMCLIENTS-NUMCLOSED;
+	}));
+
+	// DeleteDestination 关闭服务器一侧的连接，客户端看到连接结束
+	vector<int> accepted = trans.GetAccepted();
+	Check("Every connection reported", accepted.size() == NUMCLIENTS);
+
+	int deleted = -1;
+	for (size_t i = 0 ; i < accepted.size() && deleted < 0 ; i++)
+	{
+		if (trans.DeleteDestination(RTPEndpoint(accepted[i])) == 0)
+			deleted = accepted[i];
+	}
+	Check("Connection deleted", deleted >= 0 && WaitUntil([&]() { return trans.m_numClosed == NUMCLOSED+1; }));
+
+	int numEnded = 0;
+	WaitUntil([&]() {
+		numEnded = 0;
+		for (int i = NUMCLOSED ; i < NUMCLIENTS ; i++)
+		{
+			bool closed = false;
+			ReadFrames(clients[i], streams[i], &closed);
+			if (closed)
+				numEnded++;
+		}
+		return numEnded == 1;
+	});
+	Check("Client of the deleted connection sees the end of the stream", numEnded == 1);
+
+	sess.Destroy();
+	trans.Destroy();
+	Check("Destroy closes the remaining connections", trans.GetNumConnections() == 0);
+
+	for (int i = NUMCLOSED ; i < NUMCLIENTS ; i++)
+		RTPCLOSE(clients[i]);
+
+	return CheckSummary();
+}
@@ -0,0 +1,213 @@
+#include "rtpconfig.h"
+#include "media_rtp_utils.h"
+#include "media_rtp_session.h"
+#include "media_rtp_session_params.h"
+#include "media_rtp_errors.h"
+#include "media_rtp_endpoint.h"
+#include "media_rtp_udpv4_transmitter.h"
+#include "media_rtp_packet_factory.h"
+#include "rtptestcheck.h"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <atomic>
+#include <string.h>
+#include <stdlib.h>
+#include <vector>
+
+using namespace std;
+
+const size_t packetSize = 12000;
+const int numPackets = 200;
+
+// 记录会话调用 WaitForSendCompletion 的次数，以及每次发送后尚未完成的零拷贝发送数量
+class CountingTransmitter : public RTPUDPv4Transmitter
+{
+public:
+	CountingTransmitter() : numwaits(0), maxpending(0) { }
+
+	int WaitForSendCompletion(const void *data, size_t len)
+	{
+		numwaits++;
+		return RTPUDPv4Transmitter::WaitForSendCompletion(data, len);
+	}
+
+	int SendRTPData(const void *data, size_t len)
+	{
+		int status = RTPUDPv4Transmitter::SendRTPData(data, len);
+		size_t num = GetNumPendingZeroCopySends();
+		if (num > maxpending)
+			maxpending = num;
+		return status;
+	}
+
+	int numwaits;
+	size_t maxpending;
+};
+
+// 修改传出数据时把数据包复制到自己的缓冲区中发送
+class SenderSession : public RTPSession
+{
+public:
+	SenderSession(RTPTransmitter *t) : RTPSession(), trans(t), buffer(packetSize+64) { }
+
+	void EnableChangeOutgoingData() { SetChangeOutgoingData(true); }
+protected:
+	int OnChangeRTPOrRTCPData(const void *origdata, size_t origlen, bool isrtp, void **senddata, size_t *sendlen)
+	{
+		if (!isrtp || origlen > buffer.size())
+		{
+			*senddata = const_cast<void *>(origdata);
+			*sendlen = origlen;
+			return 0;
+		}
+
+		// 重用缓冲区之前等待内核读完上一次发送的数据
+		trans->WaitForSendCompletion(&buffer[0], buffer.size());
+		memcpy(&buffer[0], origdata, origlen);
+		*senddata = &buffer[0];
+		*sendlen = origlen;
+		return 0;
+	}
+
+	void OnSentRTPOrRTCPData(void *, size_t, bool) { }
+private:
+	RTPTransmitter *trans;
+	vector<uint8_t> buffer;
+};
+
+class ReceiverSession : public RTPSession
+{
+public:
+	ReceiverSession() : RTPSession(), numreceived(0), numbad(0) { }
+
+	atomic<int> numreceived, numbad;
+protected:
+	void OnValidatedRTPPacket(RTPSourceData *, RTPPacket *rtppack, bool, bool *ispackethandled)
+	{
+		if (rtppack->GetPayloadLength() != packetSize || rtppack->GetPayloadData()[0] != (uint8_t)(rtppack->GetSequenceNumber()))
+			numbad++;
+		numreceived++;
+		DeletePacket(rtppack);
+		*ispackethandled = true;
+	}
+};
+
+static bool ZeroCopySupported()
+{
+#ifdef RTP_HAVE_MSG_ZEROCOPY
+	int sock = socket(AF_INET, SOCK_DGRAM, 0);
+	int enable = 1;
+	bool ok = (sock >= 0 && setsockopt(sock, SOL_SOCKET, SO_ZEROCOPY, &enable, sizeof(int)) == 0);
+
+	if (sock >= 0)
+		close(sock);
+	return ok;
+#else
+	return false;
+#endif // RTP_HAVE_MSG_ZEROCOPY
+}
+
+// 发送一组数据包，返回发送函数本身花费的时间
+static double SendBurst(SenderSession &sender, uint16_t firstseq)
+{
+	vector<uint8_t> payload(packetSize);
+	double sendtime = 0;
+
+	for (int i = 0 ; i < numPackets ; i++)
+	{
+		// 第一个字节是序列号的低位，接收方据此检查内容
+		payload[0] = (uint8_t)(firstseq+i);
+
+		double start = RTPTime::CurrentTime().GetDouble();
+		checkerror(sender.SendPacket(&payload[0], payload.size(), 96, false, 160));
+		sendtime += RTPTime::CurrentTime().GetDouble()-start;
+
+		// 给接收线程时间读出数据，以免接收缓冲区溢出
+		if (i%10 == 9)
+			RTPTime::Wait(RTPTime(0, 2000));
+	}
+	return sendtime;
+}
+
+static bool WaitUntilDrained(CountingTransmitter &trans, ReceiverSession &receiver, int expected)
+{
+	for (int i = 0 ; i < 200 ; i++)
+	{
+		if (trans.GetNumPendingZeroCopySends() == 0 && receiver.numreceived >= expected)
+			return true;
+		RTPTime::Wait(RTPTime(0, 10000));
+	}
+	return false;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2)
+	{
+		cerr << "Usage: " << argv[0] << " portbase" << endl;
+		return -1;
+	}
+
+	uint16_t portbase = (uint16_t)atoi(argv[1]);
+	bool zerocopy = ZeroCopySupported();
+
+	RTPSessionParams sessParams;
+	sessParams.SetProbationType(RTPSources::NoProbation);
+	sessParams.SetOwnTimestampUnit(1.0/8000.0);
+	sessParams.SetMaximumPacketSize(packetSize+64);
+
+	RTPUDPv4TransmissionParams recvParams;
+	recvParams.SetPortbase(portbase);
+	recvParams.SetRTPReceiveBuffer(8*1024*1024);
+
+	ReceiverSession receiver;
+	checkerror(receiver.Create(sessParams, &recvParams));
+
+	RTPUDPv4TransmissionParams sendParams;
+	sendParams.SetPortbase(portbase+2);
+	sendParams.SetZeroCopyThreshold(8000);
+
+	CountingTransmitter trans;
+	checkerror(trans.Init(true));
+	checkerror(trans.Create(packetSize+64, &sendParams));
+
+	SenderSession sender(&trans);
+	checkerror(sender.Create(sessParams, &trans));
+	checkerror(sender.AddDestination(RTPEndpoint(ntohl(inet_addr("127.0.0.1")), portbase)));
+
+	if (!zerocopy)
+		cout << "MSG_ZEROCOPY not supported, the packets are copied" << endl;
+
+	// 直接发送构建器的缓冲区：每个数据包只在构建之前等待一次
+	uint16_t seq = sender.GetNextSequenceNumber();
+	double sendtime = SendBurst(sender, seq);
+	cout << numPackets << " packets sent in " << sendtime << " s" << endl;
+	Check("Builder path: one wait per packet, before the buffer is reused", trans.numwaits == numPackets);
+	Check("Builder path: sends do not block", sendtime < 1.0);
+	if (zerocopy)
+		Check("Builder path: sends were zerocopy", trans.maxpending > 0);
+	Check("Builder path: completions drained", WaitUntilDrained(trans, receiver, numPackets));
+	Check("Builder path: all packets received intact", receiver.numreceived == numPackets && receiver.numbad == 0);
+
+	// 修改传出数据时发送应用程序的缓冲区，会话在发送后不再等待
+	trans.numwaits = 0;
+	trans.maxpending = 0;
+	sender.EnableChangeOutgoingData();
+	seq = sender.GetNextSequenceNumber();
+	sendtime = SendBurst(sender, seq);
+	cout << numPackets << " changed packets sent in " << sendtime << " s" << endl;
+	Check("Changed data: no wait after the send", trans.numwaits == 2*numPackets);
+	Check("Changed data: sends do not block", sendtime < 1.0);
+	if (zerocopy)
+		Check("Changed data: sends were zerocopy", trans.maxpending > 0);
+	Check("Changed data: completions drained", WaitUntilDrained(trans, receiver, 2*numPackets));
+	Check("Changed data: all packets received intact", receiver.numreceived == 2*numPackets && receiver.numbad == 0);
+
+	sender.BYEDestroy(RTPTime(0, 100000), 0, 0);
+	trans.Destroy();
+	receiver.BYEDestroy(RTPTime(0, 100000), 0, 0);
+
+	return CheckSummary();
+}
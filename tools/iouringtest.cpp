@@ -0,0 +1,15 @@
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <unistd.h>
+
+int main(void)
+{
+	struct io_uring_params params = { 0 };
+	struct io_uring_buf_reg reg = { 0 };
+	unsigned int flags = IORING_RECV_MULTISHOT | IORING_CQE_F_MORE;
+
+	(void)flags;
+	reg.bgid = 0;
+	syscall(__NR_io_uring_register, -1, IORING_REGISTER_PBUF_RING, &reg, 1);
+	return (int)syscall(__NR_io_uring_setup, 1, &params);
+}
@@ -0,0 +1,13 @@
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <linux/filter.h>
+
+int main(void)
+{
+	struct sock_filter code[] = { BPF_STMT(BPF_RET|BPF_K, 0) };
+	struct sock_fprog prog = { 1, code };
+	int enable = 1;
+
+	setsockopt(-1, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(int));
+	return setsockopt(-1, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog));
+}
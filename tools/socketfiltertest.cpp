@@ -0,0 +1,12 @@
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <linux/filter.h>
+
+int main(void)
+{
+	struct sock_filter code[] = { BPF_STMT(BPF_LD|BPF_B|BPF_ABS, (unsigned int)SKF_NET_OFF), BPF_STMT(BPF_RET|BPF_K, 0) };
+	struct sock_fprog prog = { 2, code };
+
+	setsockopt(-1, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog));
+	return setsockopt(-1, SOL_SOCKET, SO_DETACH_FILTER, 0, 0);
+}
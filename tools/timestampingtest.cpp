@@ -0,0 +1,20 @@
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <string.h>
+
+int main(void)
+{
+	int enable = 1;
+	int flags = SOF_TIMESTAMPING_SOFTWARE|SOF_TIMESTAMPING_OPT_TSONLY|SOF_TIMESTAMPING_TX_SOFTWARE;
+	struct scm_timestamping ts;
+	struct sock_extended_err serr;
+
+	memset(&ts, 0, sizeof(ts));
+	serr.ee_origin = SO_EE_ORIGIN_TIMESTAMPING;
+	serr.ee_info = SCM_TSTAMP_SND;
+	setsockopt(-1, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(int));
+	setsockopt(-1, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(int));
+	return (int)ts.ts[0].tv_sec + SCM_TIMESTAMPNS + SCM_TIMESTAMPING + serr.ee_info;
+}
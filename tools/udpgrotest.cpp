@@ -0,0 +1,10 @@
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+
+int main(void)
+{
+	int enable = 1;
+	return setsockopt(-1, SOL_UDP, UDP_GRO, &enable, sizeof(int));
+}
@@ -0,0 +1,10 @@
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+
+int main(void)
+{
+	int gsosize = 1200;
+	return setsockopt(-1, SOL_UDP, UDP_SEGMENT, &gsosize, sizeof(int));
+}
@@ -0,0 +1,23 @@
+#include <immintrin.h>
+
+__attribute__((target("avx2"))) static int avx2test(void)
+{
+	__m256i a = _mm256_set1_epi32(1);
+	return _mm256_movemask_epi8(_mm256_cmpeq_epi32(a, a));
+}
+
+__attribute__((target("sse4.1"))) static int sse41test(void)
+{
+	__m128i a = _mm_set1_epi32(1);
+	return _mm_movemask_epi8(_mm_blendv_epi8(a, a, a));
+}
+
+int main(void)
+{
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return avx2test();
+	if (__builtin_cpu_supports("sse4.1"))
+		return sse41test();
+	return 0;
+}
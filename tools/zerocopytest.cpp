@@ -0,0 +1,14 @@
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <linux/errqueue.h>
+
+int main(void)
+{
+	int enable = 1;
+	struct sock_extended_err serr;
+
+	serr.ee_origin = SO_EE_ORIGIN_ZEROCOPY;
+	setsockopt(-1, SOL_SOCKET, SO_ZEROCOPY, &enable, sizeof(int));
+	send(-1, &serr, sizeof(serr), MSG_ZEROCOPY);
+	return recv(-1, &serr, sizeof(serr), MSG_ERRQUEUE);
+}